@@ -2301,10 +2301,17 @@ namespace dxvk {
     }
 
     if (BlendFactor != nullptr) {
-      for (uint32_t i = 0; i < 4; i++)
+      // Games commonly pass the same blend factor with every call,
+      // and emitting it anyway would break up draw batches.
+      bool dirty = false;
+
+      for (uint32_t i = 0; i < 4; i++) {
+        dirty |= m_state.om.blendFactor[i] != BlendFactor[i];
         m_state.om.blendFactor[i] = BlendFactor[i];
+      }
 
-      ApplyBlendFactor();
+      if (dirty)
+        ApplyBlendFactor();
     }
   }
 
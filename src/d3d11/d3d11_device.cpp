@@ -51,6 +51,7 @@ namespace dxvk {
     m_d3d11Formats      (m_dxvkDevice),
     m_d3d11Options      (m_dxvkDevice->instance()->config()),
     m_shaderOptions     (GetShaderOptions(m_dxvkDevice, m_d3d11Options)),
+    m_csChunkPool       (m_dxvkDevice.ptr()),
     m_maxFeatureLevel   (GetMaxFeatureLevel(m_dxvkDevice->instance(), m_dxvkDevice->adapter())),
     m_deviceFeatures    (m_dxvkDevice->instance(), m_dxvkDevice->adapter(), m_d3d11Options, m_featureLevel) {
     m_initializer = new D3D11Initializer(this);
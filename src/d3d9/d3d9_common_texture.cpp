@@ -10,6 +10,72 @@
 
 namespace dxvk {
 
+  static bool DirtyBoxesTouch(const D3DBOX& a, const D3DBOX& b) {
+    return a.Left  <= b.Right  && b.Left  <= a.Right
+        && a.Top   <= b.Bottom && b.Top   <= a.Bottom
+        && a.Front <= b.Back   && b.Front <= a.Back;
+  }
+
+
+  static D3DBOX UnionDirtyBoxes(const D3DBOX& a, const D3DBOX& b) {
+    D3DBOX result;
+    result.Left   = std::min(a.Left,   b.Left);
+    result.Right  = std::max(a.Right,  b.Right);
+    result.Top    = std::min(a.Top,    b.Top);
+    result.Bottom = std::max(a.Bottom, b.Bottom);
+    result.Front  = std::min(a.Front,  b.Front);
+    result.Back   = std::max(a.Back,   b.Back);
+    return result;
+  }
+
+
+  static uint64_t GetDirtyBoxVolume(const D3DBOX& box) {
+    return uint64_t(box.Right - box.Left)
+         * uint64_t(box.Bottom - box.Top)
+         * uint64_t(box.Back - box.Front);
+  }
+
+
+  void D3D9DirtyRegion::add(D3DBOX box) {
+    // Merge with all boxes that overlap or touch the new box. The
+    // merged box may then touch other boxes, so start over.
+    for (uint32_t i = 0; i < count; ) {
+      if (DirtyBoxesTouch(boxes[i], box)) {
+        box = UnionDirtyBoxes(boxes[i], box);
+        boxes[i] = boxes[--count];
+        i = 0;
+      } else {
+        i += 1;
+      }
+    }
+
+    if (count == MaxBoxes) {
+      // Merge with the box that adds the least amount of
+      // area that does not need to be uploaded otherwise
+      uint32_t bestIndex = 0u;
+      uint64_t bestCost = ~0ull;
+
+      for (uint32_t i = 0; i < count; i++) {
+        uint64_t cost = GetDirtyBoxVolume(UnionDirtyBoxes(boxes[i], box))
+                      - GetDirtyBoxVolume(boxes[i]);
+
+        if (cost < bestCost) {
+          bestIndex = i;
+          bestCost = cost;
+        }
+      }
+
+      box = UnionDirtyBoxes(boxes[bestIndex], box);
+      boxes[bestIndex] = boxes[--count];
+
+      add(box);
+      return;
+    }
+
+    boxes[count++] = box;
+  }
+
+
   D3D9CommonTexture::D3D9CommonTexture(
           D3D9DeviceEx*             pDevice,
           IUnknown*                 pInterface,
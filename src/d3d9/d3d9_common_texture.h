@@ -9,6 +9,7 @@
 #include "../dxvk/dxvk_device.h"
 
 #include "../util/util_bit.h"
+#include "../util/util_lru.h"
 
 namespace dxvk {
 
@@ -53,6 +54,28 @@ namespace dxvk {
     VkImageUsageFlags   ImageUsage = 0;
   };
 
+  /**
+   * \brief Dirty region of a texture layer
+   *
+   * Stores a small number of disjoint boxes, so that updates
+   * to distant parts of a texture do not require the entire
+   * area in between to be uploaded as well. Overlapping or
+   * adjacent boxes are merged, and if the box list is full,
+   * new boxes are merged with the box that grows the least.
+   */
+  struct D3D9DirtyRegion {
+    constexpr static uint32_t MaxBoxes = 4u;
+
+    uint32_t                      count = 0u;
+    std::array<D3DBOX, MaxBoxes>  boxes = { };
+
+    void add(D3DBOX box);
+
+    void clear() {
+      count = 0u;
+    }
+  };
+
   struct D3D9ColorView {
     inline Rc<DxvkImageView>& Pick(bool Srgb) {
       return Srgb ? this->Srgb : this->Color;
@@ -71,7 +94,7 @@ namespace dxvk {
 
   using D3D9SubresourceBitset = bit::bitset<caps::MaxSubresources>;
 
-  class D3D9CommonTexture {
+  class D3D9CommonTexture : public lru_node<D3D9CommonTexture> {
 
   public:
 
@@ -404,6 +427,9 @@ namespace dxvk {
         box.Bottom = std::min(box.Bottom, m_desc.Height);
         box.Back = std::min(box.Back, m_desc.Depth);
 
+        if (box.Left < box.Right && box.Top < box.Bottom && box.Front < box.Back)
+          m_dirtyRegions[layer].add(box);
+
         D3DBOX& dirtyBox = m_dirtyBoxes[layer];
         if (dirtyBox.Left == dirtyBox.Right) {
           dirtyBox = box;
@@ -417,19 +443,39 @@ namespace dxvk {
         }
       } else {
         m_dirtyBoxes[layer] = { 0, 0, m_desc.Width, m_desc.Height, 0, m_desc.Depth };
+
+        m_dirtyRegions[layer].clear();
+        m_dirtyRegions[layer].add(m_dirtyBoxes[layer]);
       }
     }
 
     void ClearDirtyBoxes() {
       for (uint32_t i = 0; i < m_dirtyBoxes.size(); i++) {
         m_dirtyBoxes[i] = { 0, 0, 0, 0, 0, 0 };
+        m_dirtyRegions[i].clear();
       }
     }
 
+    /**
+     * \brief Bounding box of all dirty regions of a layer
+     *
+     * \param [in] layer Array layer
+     * \returns Dirty box, in mip level 0 coordinates
+     */
     const D3DBOX& GetDirtyBox(uint32_t layer) const {
       return m_dirtyBoxes[layer];
     }
 
+    /**
+     * \brief Dirty regions of a layer
+     *
+     * \param [in] layer Array layer
+     * \returns Dirty boxes, in mip level 0 coordinates
+     */
+    const D3D9DirtyRegion& GetDirtyRegion(uint32_t layer) const {
+      return m_dirtyRegions[layer];
+    }
+
     static VkImageType GetImageTypeFromResourceType(
             D3DRESOURCETYPE  Dimension);
 
@@ -527,6 +573,7 @@ namespace dxvk {
     D3DTEXTUREFILTERTYPE          m_mipFilter = D3DTEXF_LINEAR;
 
     std::array<D3DBOX, 6>         m_dirtyBoxes;
+    std::array<D3D9DirtyRegion, 6> m_dirtyRegions;
 
     D3D9VkInteropTexture          m_d3d9Interop;
 
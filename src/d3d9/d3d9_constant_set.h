@@ -7,6 +7,7 @@
 
 #include "../dxso/dxso_isgn.h"
 
+#include "../util/util_flags.h"
 #include "../util/util_vector.h"
 
 #include <cstdint>
@@ -19,6 +20,8 @@ namespace dxvk {
     Bool
   };
 
+  using D3D9ConstantTypeFlags = Flags<D3D9ConstantType>;
+
   // We make an assumption later based on the packing of this struct for copying.
   struct D3D9ShaderConstantsVSSoftware {
     Vector4i iConsts[caps::MaxOtherConstantsSoftware];
@@ -48,7 +51,8 @@ namespace dxvk {
     D3D9SwvpConstantBuffers   swvp;
     D3D9ConstantBuffer        buffer;
     DxsoShaderMetaInfo        meta  = {};
-    bool                      dirty = true;
+    D3D9ConstantTypeFlags     dirty = D3D9ConstantTypeFlags(
+      D3D9ConstantType::Float, D3D9ConstantType::Int, D3D9ConstantType::Bool);
     uint32_t                  maxChangedConstF = 0;
     uint32_t                  maxChangedConstI = 0;
     uint32_t                  maxChangedConstB = 0;
@@ -56,6 +56,7 @@ namespace dxvk {
     , m_multithread        ( BehaviorFlags & D3DCREATE_MULTITHREADED )
     , m_isSWVP             ( (BehaviorFlags & D3DCREATE_SOFTWARE_VERTEXPROCESSING) != 0 )
     , m_isD3D8Compatible   ( pParent->IsD3D8Compatible() )
+    , m_csChunkPool        ( dxvkDevice.ptr() )
     , m_csThread           ( dxvkDevice, dxvkDevice->createContext() )
     , m_csChunk            ( AllocCsChunk() )
     , m_submissionFence    ( new sync::Fence() )
@@ -73,6 +74,9 @@ namespace dxvk {
     if (canSWVP)
       Logger::info("D3D9DeviceEx: Using extended constant set for software vertex processing.");
 
+    if (env::getEnvVar("DXVK_SHADER_CACHE") != "0" && m_d3d9Options.shaderDumpPath.empty())
+      m_shaderCache = D3D9ShaderCache::getInstance();
+
     if (m_dxvkDevice->debugFlags().test(DxvkDebugFlag::Markers))
       m_annotation = new D3D9UserDefinedAnnotation(this);
 
@@ -2774,6 +2778,8 @@ namespace dxvk {
 
     InitReturnPtr(ppSB);
 
+    m_recorder->Compile();
+
     *ppSB = m_recorder.ref();
     if (!m_isD3D8Compatible)
       m_losableResourceCounter++;
@@ -3173,26 +3179,46 @@ namespace dxvk {
     const uint32_t dataSize = GetUPDataSize(vertexCount, VertexStreamZeroStride);
     const uint32_t bufferSize = GetUPBufferSize(vertexCount, VertexStreamZeroStride);
 
-    auto upSlice = AllocUPBuffer(bufferSize);
-    FillUPVertexBuffer(upSlice.mapPtr, pVertexStreamZeroData, dataSize, bufferSize);
+    // If the vertex declaration reads past the end of the last vertex, the
+    // zero padding behind the vertex data must not be overwritten by a
+    // subsequent draw, so only batch draws that do not need any padding.
+    bool batched = dataSize == bufferSize && BatchDrawPrimitiveUP(
+      PrimitiveType, vertexCount, pVertexStreamZeroData, VertexStreamZeroStride);
 
-    EmitCs([this,
-      cBufferSlice  = std::move(upSlice.slice),
-      cPrimType     = PrimitiveType,
-      cStride       = VertexStreamZeroStride,
-      cVertexCount  = vertexCount
-    ](DxvkContext* ctx) mutable {
-      ApplyPrimitiveType(ctx, cPrimType);
+    if (!batched) {
+      auto upSlice = AllocUPBuffer(bufferSize);
+      FillUPVertexBuffer(upSlice.mapPtr, pVertexStreamZeroData, dataSize, bufferSize);
+
+      bool canBatch = upSlice.slice.buffer() == m_upBuffer;
+      VkDeviceSize offset = upSlice.slice.offset();
+
+      DxvkCsDataBlock* block = EmitCsCmd<VkDrawIndirectCommand>([this,
+        cBufferSlice  = std::move(upSlice.slice),
+        cPrimType     = PrimitiveType,
+        cStride       = VertexStreamZeroStride
+      ](DxvkContext* ctx, const VkDrawIndirectCommand* draws, size_t count) {
+        ApplyPrimitiveType(ctx, cPrimType);
+
+        // Bind vertex data for all draws in the batch at once, subsequent
+        // draws are placed behind the first one within the same buffer.
+        VkDeviceSize length = D3D9UPDrawBatch::getBufferLength(
+          cBufferSlice.length(), cStride, draws, count);
+
+        ctx->bindVertexBuffer(0, DxvkBufferSlice(cBufferSlice.buffer(), cBufferSlice.offset(), length), cStride);
+        ctx->draw(count, draws);
+        ctx->bindVertexBuffer(0, DxvkBufferSlice(), 0);
+      }, 1u);
 
       // Tests on Windows show that D3D9 does not do non-indexed instanced draws.
-      VkDrawIndirectCommand draw = { };
-      draw.vertexCount = cVertexCount;
-      draw.instanceCount = 1u;
+      auto draw = reinterpret_cast<VkDrawIndirectCommand*>(block->first());
+      draw->vertexCount = vertexCount;
+      draw->instanceCount = 1u;
+      draw->firstVertex = 0u;
+      draw->firstInstance = 0u;
 
-      ctx->bindVertexBuffer(0, std::move(cBufferSlice), cStride);
-      ctx->draw(1u, &draw);
-      ctx->bindVertexBuffer(0, DxvkBufferSlice(), 0);
-    });
+      if (canBatch && dataSize == bufferSize)
+        m_upDrawBatch.begin(block, PrimitiveType, VertexStreamZeroStride, offset);
+    }
 
     m_state.vertexBuffers[0].vertexBuffer = nullptr;
     m_state.vertexBuffers[0].offset       = 0;
@@ -3591,14 +3617,20 @@ namespace dxvk {
     bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
     bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
 
-    m_consts[DxsoProgramTypes::VertexShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::VertexShader].meta  = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
+    D3D9ConstantSets& constSet = m_consts[DxsoProgramTypes::VertexShader];
+
+    if (oldCopies || newCopies || !oldShader)
+      constSet.dirty.set(D3D9ConstantType::Float, D3D9ConstantType::Int, D3D9ConstantType::Bool);
+
+    constSet.meta = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
 
     if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::VertexShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
+      if (newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF)
+        constSet.dirty.set(D3D9ConstantType::Float);
+      if (newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI)
+        constSet.dirty.set(D3D9ConstantType::Int);
+      if (newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB)
+        constSet.dirty.set(D3D9ConstantType::Bool);
     }
 
     const bool wasUsingProgrammableVS = UseProgrammableVS();
@@ -3950,14 +3982,20 @@ namespace dxvk {
     bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
     bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
 
-    m_consts[DxsoProgramTypes::PixelShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::PixelShader].meta  = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
+    D3D9ConstantSets& constSet = m_consts[DxsoProgramTypes::PixelShader];
+
+    if (oldCopies || newCopies || !oldShader)
+      constSet.dirty.set(D3D9ConstantType::Float, D3D9ConstantType::Int, D3D9ConstantType::Bool);
+
+    constSet.meta = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
 
     if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::PixelShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
+      if (newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF)
+        constSet.dirty.set(D3D9ConstantType::Float);
+      if (newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI)
+        constSet.dirty.set(D3D9ConstantType::Int);
+      if (newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB)
+        constSet.dirty.set(D3D9ConstantType::Bool);
     }
 
     const D3D9ShaderMasks oldShaderMasks = PSShaderMasks();
@@ -4811,8 +4849,6 @@ namespace dxvk {
 
 
   D3D9BufferSlice D3D9DeviceEx::AllocUPBuffer(VkDeviceSize size) {
-    constexpr VkDeviceSize UPBufferSize = 1 << 20;
-
     if (unlikely(m_upBuffer == nullptr || size > UPBufferSize)) {
       VkMemoryPropertyFlags memoryFlags
         = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
@@ -4868,6 +4904,25 @@ namespace dxvk {
   }
 
 
+  bool D3D9DeviceEx::BatchDrawPrimitiveUP(
+          D3DPRIMITIVETYPE      PrimitiveType,
+          uint32_t              VertexCount,
+    const void*                 pVertexData,
+          uint32_t              Stride) {
+    VkDeviceSize dataOffset = 0u;
+
+    if (!m_upDrawBatch.append(m_csChunk.ptr(), PrimitiveType,
+        VertexCount, Stride, m_upBufferOffset, UPBufferSize, dataOffset))
+      return false;
+
+    VkDeviceSize dataSize = VkDeviceSize(VertexCount) * Stride;
+    std::memcpy(reinterpret_cast<char*>(m_upBufferMapPtr) + dataOffset, pVertexData, dataSize);
+
+    m_upBufferOffset = align(dataOffset + dataSize, CACHE_LINE_SIZE);
+    return true;
+  }
+
+
   D3D9BufferSlice D3D9DeviceEx::AllocStagingBuffer(VkDeviceSize size) {
     D3D9BufferSlice result;
     result.slice = m_stagingBuffer.alloc(size);
@@ -5316,15 +5371,28 @@ namespace dxvk {
     auto subresource = pResource->GetSubresourceFromIndex(
       formatInfo->aspectMask, Subresource);
 
-    const D3DBOX& box = pResource->GetDirtyBox(subresource.arrayLayer);
+    auto FlushBox = [&] (const D3DBOX& box) {
+      // The dirty box is only tracked for mip 0. Scale it for the mip level we're gonna upload.
+      VkExtent3D mip0Extent = { box.Right - box.Left, box.Bottom - box.Top, box.Back - box.Front };
+      VkExtent3D extent = util::computeMipLevelExtent(mip0Extent, subresource.mipLevel);
+      VkOffset3D mip0Offset = { int32_t(box.Left), int32_t(box.Top), int32_t(box.Front) };
+      VkOffset3D offset = util::computeMipLevelOffset(mip0Offset, subresource.mipLevel);
 
-    // The dirty box is only tracked for mip 0. Scale it for the mip level we're gonna upload.
-    VkExtent3D mip0Extent = { box.Right - box.Left, box.Bottom - box.Top, box.Back - box.Front };
-    VkExtent3D extent = util::computeMipLevelExtent(mip0Extent, subresource.mipLevel);
-    VkOffset3D mip0Offset = { int32_t(box.Left), int32_t(box.Top), int32_t(box.Front) };
-    VkOffset3D offset = util::computeMipLevelOffset(mip0Offset, subresource.mipLevel);
+      UpdateTextureFromBuffer(pResource, pResource, Subresource, Subresource, offset, extent, offset);
+    };
 
-    UpdateTextureFromBuffer(pResource, pResource, Subresource, Subresource, offset, extent, offset);
+    // Upload dirty regions individually so that small updates to different
+    // parts of a large texture do not upload everything in between. Formats
+    // that need conversion can only be converted as a whole, so use the
+    // bounding box in that case.
+    const D3D9DirtyRegion& region = pResource->GetDirtyRegion(subresource.arrayLayer);
+
+    if (pResource->GetFormatMapping().ConversionFormatInfo.FormatType == D3D9ConversionFormat_None && region.count) {
+      for (uint32_t i = 0; i < region.count; i++)
+        FlushBox(region.boxes[i]);
+    } else {
+      FlushBox(pResource->GetDirtyBox(subresource.arrayLayer));
+    }
 
     if (pResource->IsAutomaticMip())
       MarkTextureMipsDirty(pResource);
@@ -5922,6 +5990,8 @@ namespace dxvk {
     m_initializer->FlushCsChunk();
 
     m_csSeqNum = m_csThread.dispatchChunk(std::move(chunk));
+
+    m_upDrawBatch.reset();
   }
 
 
@@ -6088,10 +6158,14 @@ namespace dxvk {
 
     D3D9ConstantSets& constSet = m_consts[DxsoProgramType::VertexShader];
 
-    if (!constSet.dirty)
+    if (constSet.dirty.isClear())
       return;
 
-    constSet.dirty = false;
+    // Each constant type lives in its own buffer, so only re-upload the
+    // types that actually changed. This matters a lot with SWVP since
+    // the float buffer alone can be up to 128 kB in size.
+    D3D9ConstantTypeFlags dirty = constSet.dirty;
+    constSet.dirty.clrAll();
 
     uint32_t floatCount = constSet.maxChangedConstF;
     if (constSet.meta.needsConstantCopies) {
@@ -6110,7 +6184,7 @@ namespace dxvk {
 
     // Max copy source size is 8192 * 16 => always aligned to any plausible value
     // => we won't copy out of bounds
-    if (likely(constSet.meta.maxConstIndexF != 0)) {
+    if (likely(constSet.meta.maxConstIndexF != 0 && dirty.test(D3D9ConstantType::Float))) {
       auto mapPtr = CopySoftwareConstants(constSet.buffer, Src.fConsts, floatDataSize);
 
       if (constSet.meta.needsConstantCopies) {
@@ -6129,10 +6203,10 @@ namespace dxvk {
 
     // Max copy source size is 2048 * 16 => always aligned to any plausible value
     // => we won't copy out of bounds
-    if (likely(constSet.meta.maxConstIndexI != 0))
+    if (likely(constSet.meta.maxConstIndexI != 0 && dirty.test(D3D9ConstantType::Int)))
       CopySoftwareConstants(constSet.swvp.intBuffer, Src.iConsts, intDataSize);
 
-    if (likely(constSet.meta.maxConstIndexB != 0))
+    if (likely(constSet.meta.maxConstIndexB != 0 && dirty.test(D3D9ConstantType::Bool)))
       CopySoftwareConstants(constSet.swvp.boolBuffer, Src.bConsts, boolDataSize);
   }
 
@@ -6144,6 +6218,8 @@ namespace dxvk {
 
     auto mapPtr = dstBuffer.Alloc(size);
     std::memcpy(mapPtr, src, size);
+
+    m_constantUploadBytes.store(m_constantUploadBytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
     return mapPtr;
   }
 
@@ -6156,10 +6232,12 @@ namespace dxvk {
     */
     D3D9ConstantSets& constSet = m_consts[ShaderStage];
 
-    if (!constSet.dirty)
+    // Bool constants are passed in via spec constants with
+    // this layout, so changing those does not require an upload
+    if (!constSet.dirty.any(D3D9ConstantType::Float, D3D9ConstantType::Int))
       return;
 
-    constSet.dirty = false;
+    constSet.dirty.clrAll();
 
     uint32_t floatCount = constSet.maxChangedConstF;
     if (constSet.meta.needsConstantCopies) {
@@ -6183,6 +6261,8 @@ namespace dxvk {
     void* mapPtr = constSet.buffer.Alloc(bufferSize);
     auto* dst = reinterpret_cast<HardwareLayoutType*>(mapPtr);
 
+    m_constantUploadBytes.store(m_constantUploadBytes.load(std::memory_order_relaxed) + bufferSize, std::memory_order_relaxed);
+
     const uint32_t intDataSize = constSet.meta.maxConstIndexI * sizeof(Vector4i);
     if (constSet.meta.maxConstIndexI != 0)
       std::memcpy(dst->iConsts, Src.iConsts, intDataSize);
@@ -7125,11 +7205,7 @@ namespace dxvk {
         VkExtent2D { vp.Width,      vp.Height     }};
     }
 
-    EmitCs([
-      cViewport = state
-    ] (DxvkContext* ctx) {
-      ctx->setViewports(1, &cViewport);
-    });
+    m_drawStateDelta.setViewport(state);
   }
 
 
@@ -7179,11 +7255,7 @@ namespace dxvk {
       : uint16_t(0xffffu));
     msState.setAlphaToCoverage(m_atocEnabled);
 
-    EmitCs([
-      cState = msState
-    ] (DxvkContext* ctx) {
-      ctx->setMultisampleState(cState);
-    });
+    m_drawStateDelta.setMultisampleState(msState);
   }
 
 
@@ -7224,38 +7296,12 @@ namespace dxvk {
     for (uint32_t i = 0; i < 4; i++)
       writeMasks |= (state[ColorWriteIndex(i)] & 0xfu) << (4u * i);
 
-    EmitCs([
-      cMode       = mode,
-      cWriteMasks = writeMasks,
-      cAlphaMasks = m_rtSlotTracking.hasAlphaSwizzle
-    ](DxvkContext* ctx) {
-      for (uint32_t i = 0; i < 4; i++) {
-        DxvkBlendMode mode = cMode;
-        mode.setWriteMask(cWriteMasks >> (4u * i));
-
-        // Adjust the blend factor based on the render target alpha swizzle bit mask.
-        // Specific formats such as the XRGB ones require a ONE swizzle for alpha
-        // which cannot be directly applied with the image view of the attachment.
-        if (cAlphaMasks & (1 << i)) {
-          auto NormalizeFactor = [] (VkBlendFactor Factor) {
-            if (Factor == VK_BLEND_FACTOR_DST_ALPHA)
-              return VK_BLEND_FACTOR_ONE;
-            else if (Factor == VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA)
-              return VK_BLEND_FACTOR_ZERO;
-            return Factor;
-          };
-
-          mode.setColorOp(NormalizeFactor(mode.colorSrcFactor()),
-                          NormalizeFactor(mode.colorDstFactor()), mode.colorBlendOp());
-          mode.setAlphaOp(NormalizeFactor(mode.alphaSrcFactor()),
-                          NormalizeFactor(mode.alphaDstFactor()), mode.alphaBlendOp());
-        }
-
-        mode.normalize();
+    D3D9DrawBlendState blend;
+    blend.mode = mode;
+    blend.writeMasks = writeMasks;
+    blend.alphaMasks = m_rtSlotTracking.hasAlphaSwizzle;
 
-        ctx->setBlendMode(i, mode);
-      }
-    });
+    m_drawStateDelta.setBlendState(blend);
   }
 
 
@@ -7312,13 +7358,7 @@ namespace dxvk {
     state.setStencilOpFront(frontOp);
     state.setStencilOpBack(backOp);
 
-    EmitCs([
-      cState = state
-    ] (DxvkContext* ctx) mutable {
-      cState.normalize();
-
-      ctx->setDepthStencilState(cState);
-    });
+    m_drawStateDelta.setDepthStencilState(state);
   }
 
 
@@ -7337,11 +7377,7 @@ namespace dxvk {
       ? VkSampleCountFlags(0u)
       : VkSampleCountFlags(VK_SAMPLE_COUNT_1_BIT));
 
-    EmitCs([
-      cState  = state
-    ](DxvkContext* ctx) {
-      ctx->setRasterizerState(cState);
-    });
+    m_drawStateDelta.setRasterizerState(state);
   }
 
 
@@ -7358,11 +7394,7 @@ namespace dxvk {
     biases.depthBiasSlope    = slopeScaledDepthBias;
     biases.depthBiasClamp    = 0.0f;
 
-    EmitCs([
-      cBiases = biases
-    ](DxvkContext* ctx) {
-      ctx->setDepthBias(cBiases);
-    });
+    m_drawStateDelta.setDepthBias(biases);
   }
 
 
@@ -7402,6 +7434,22 @@ namespace dxvk {
   }
 
 
+  void D3D9DeviceEx::FlushDrawStateDelta() {
+    if (likely(m_drawStateDelta.empty()))
+      return;
+
+    size_t dwordCount = m_drawStateDelta.getPackedSize();
+
+    DxvkCsDataBlock* block = EmitCsCmd<uint32_t>([
+      cFlags = m_drawStateDelta.flags()
+    ] (DxvkContext* ctx, const uint32_t* data, size_t) {
+      D3D9DrawStateDelta::apply(ctx, cFlags, data);
+    }, dwordCount);
+
+    m_drawStateDelta.pack(reinterpret_cast<uint32_t*>(block->first()));
+  }
+
+
   void D3D9DeviceEx::BindAlphaTestState() {
     m_dirty.clr(D3D9DeviceDirtyFlag::AlphaTestState);
 
@@ -7793,13 +7841,11 @@ namespace dxvk {
         }
       }
 
-      EmitCs([
-        cDepthBounds = db
-      ] (DxvkContext* ctx) {
-        ctx->setDepthBounds(cDepthBounds);
-      });
+      m_drawStateDelta.setDepthBounds(db);
     }
 
+    FlushDrawStateDelta();
+
     BindSpecConstants();
 
     if (unlikely(m_dirty.test(D3D9DeviceDirtyFlag::VertexBuffers) && UploadVBOs)) {
@@ -8088,7 +8134,7 @@ namespace dxvk {
     m_state.vsConsts->bConsts[idx] &= ~mask;
     m_state.vsConsts->bConsts[idx] |= bits & mask;
 
-    m_consts[DxsoProgramTypes::VertexShader].dirty = true;
+    m_consts[DxsoProgramTypes::VertexShader].dirty.set(D3D9ConstantType::Bool);
   }
 
 
@@ -8096,7 +8142,7 @@ namespace dxvk {
     m_state.psConsts->bConsts[idx] &= ~mask;
     m_state.psConsts->bConsts[idx] |= bits & mask;
 
-    m_consts[DxsoProgramTypes::PixelShader].dirty = true;
+    m_consts[DxsoProgramTypes::PixelShader].dirty.set(D3D9ConstantType::Bool);
   }
 
 
@@ -8173,10 +8219,12 @@ namespace dxvk {
         ? constSet.meta.maxConstIndexF
         : constSet.meta.maxConstIndexI;
 
-      constSet.dirty |= StartRegister < maxCount;
+      if (StartRegister < maxCount)
+        constSet.dirty.set(ConstantType);
     } else if constexpr (ProgramType == DxsoProgramType::VertexShader) {
       if (unlikely(CanSWVP())) {
-        constSet.dirty |= StartRegister < constSet.meta.maxConstIndexB;
+        if (StartRegister < constSet.meta.maxConstIndexB)
+          constSet.dirty.set(ConstantType);
       }
     }
 
@@ -9123,15 +9171,16 @@ namespace dxvk {
 
     uint32_t threshold = (m_d3d9Options.textureMemory / 4) * 3;
 
-    auto iter = m_mappedTextures.leastRecentlyUsedIter();
-    while (m_memoryAllocator.MappedMemory() >= threshold && iter != m_mappedTextures.leastRecentlyUsedEndIter()) {
-      if (unlikely((*iter)->IsAnySubresourceLocked() != 0)) {
-        iter++;
-        continue;
+    D3D9CommonTexture* texture = m_mappedTextures.leastRecentlyUsed();
+    while (m_memoryAllocator.MappedMemory() >= threshold && texture != nullptr) {
+      D3D9CommonTexture* next = m_mappedTextures.next(texture);
+
+      if (likely(texture->IsAnySubresourceLocked() == 0)) {
+        texture->UnmapData();
+        m_mappedTextures.remove(texture);
       }
-      (*iter)->UnmapData();
 
-      iter = m_mappedTextures.remove(iter);
+      texture = next;
     }
 #endif
   }
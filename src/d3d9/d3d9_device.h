@@ -11,6 +11,8 @@
 #include "d3d9_adapter.h"
 #include "d3d9_constant_buffer.h"
 #include "d3d9_constant_set.h"
+#include "d3d9_draw_state.h"
+#include "d3d9_up_batch.h"
 #include "d3d9_mem.h"
 
 #include "d3d9_state.h"
@@ -23,6 +25,7 @@
 #include "../dxso/dxso_modinfo.h"
 
 #include "d3d9_fixed_function.h"
+#include "d3d9_shader_cache.h"
 #include "d3d9_swvp_emu.h"
 
 #include "d3d9_spec_constants.h"
@@ -221,6 +224,8 @@ namespace dxvk {
 
     constexpr static VkDeviceSize StagingBufferSize = 4ull << 20;
 
+    constexpr static VkDeviceSize UPBufferSize = 1ull << 20;
+
     friend class D3D9SwapChainEx;
     friend struct D3D9WindowContext;
     friend class D3D9ConstantBuffer;
@@ -1028,6 +1033,8 @@ namespace dxvk {
 
     void BindDepthBias();
 
+    void FlushDrawStateDelta();
+
     inline void UploadSoftwareConstantSet(const D3D9ShaderConstantsVSSoftware& Src, const D3D9ConstantLayout& Layout);
 
     inline void* CopySoftwareConstants(D3D9ConstantBuffer& dstBuffer, const void* src, uint32_t size);
@@ -1112,6 +1119,10 @@ namespace dxvk {
       return &m_d3d9Options;
     }
 
+    D3D9ShaderCache* GetShaderCache() const {
+      return m_shaderCache.ptr();
+    }
+
     Direct3DState9* GetRawState() {
       return &m_state;
     }
@@ -1251,6 +1262,13 @@ namespace dxvk {
       return m_swvpEmulator.GetShaderCount();
     }
 
+    /**
+     * \brief Returns the total number of bytes written to shader constant buffers.
+     */
+    uint64_t GetConstantUploadBytes() const {
+      return m_constantUploadBytes.load(std::memory_order_relaxed);
+    }
+
     void InjectCsChunk(
             DxvkCsChunkRef&&            Chunk,
             bool                        Synchronize);
@@ -1277,6 +1295,8 @@ namespace dxvk {
 
     template<bool AllowFlush = true, typename Cmd>
     void EmitCs(Cmd&& command) {
+      m_upDrawBatch.reset();
+
       if (unlikely(!m_csChunk->push(command))) {
         EmitCsChunk(std::move(m_csChunk));
         m_csChunk = AllocCsChunk();
@@ -1288,6 +1308,25 @@ namespace dxvk {
       }
     }
 
+    template<typename M, bool AllowFlush = true, typename Cmd>
+    DxvkCsDataBlock* EmitCsCmd(Cmd&& command, size_t count) {
+      m_upDrawBatch.reset();
+
+      DxvkCsDataBlock* block = m_csChunk->pushCmd<M, Cmd>(command, count);
+
+      if (unlikely(!block)) {
+        EmitCsChunk(std::move(m_csChunk));
+        m_csChunk = AllocCsChunk();
+
+        if constexpr (AllowFlush)
+          ConsiderFlush(GpuFlushType::ImplicitWeakHint);
+
+        block = m_csChunk->pushCmd<M, Cmd>(command, count);
+      }
+
+      return block;
+    }
+
     void EmitCsChunk(DxvkCsChunkRef&& chunk);
 
     void FlushCsChunk() {
@@ -1316,6 +1355,20 @@ namespace dxvk {
      */
     D3D9BufferSlice AllocUPBuffer(VkDeviceSize size);
 
+    /**
+     * \brief Appends a DrawPrimitiveUp draw to the pending batch
+     *
+     * Writes the vertex data to the UP buffer right behind the
+     * data of the previous draw and adds a draw to the previous
+     * multi-draw command. Fails if there is no compatible batch.
+     * \returns \c true if the draw was appended to the batch
+     */
+    bool BatchDrawPrimitiveUP(
+            D3DPRIMITIVETYPE      PrimitiveType,
+            uint32_t              VertexCount,
+      const void*                 pVertexData,
+            uint32_t              Stride);
+
     /**
      * \brief Allocates buffer memory for resource uploads
      */
@@ -1601,6 +1654,7 @@ namespace dxvk {
     D3D9Initializer*                m_initializer = nullptr;
     D3D9FormatHelper*               m_converter   = nullptr;
 
+    Rc<D3D9ShaderCache>             m_shaderCache;
     D3D9FFShaderModuleSet           m_ffModules;
     D3D9SWVPEmulator                m_swvpEmulator;
 
@@ -1619,6 +1673,7 @@ namespace dxvk {
     Rc<DxvkBuffer>                  m_upBuffer;
     VkDeviceSize                    m_upBufferOffset  = 0ull;
     void*                           m_upBufferMapPtr  = nullptr;
+    D3D9UPDrawBatch                 m_upDrawBatch;
 
     DxvkStagingBuffer               m_stagingBuffer;
     Rc<sync::Fence>                 m_stagingBufferFence;
@@ -1649,6 +1704,8 @@ namespace dxvk {
 
     D3D9RTSlotTracking              m_rtSlotTracking;
 
+    D3D9DrawStateDelta              m_drawStateDelta;
+
     D3D9VBSlotTracking              m_vbSlotTracking;
 
     D3D9SpecializationInfo          m_specInfo = D3D9SpecializationInfo();
@@ -1706,7 +1763,7 @@ namespace dxvk {
     D3D9SwapChainEx*                m_mostRecentlyUsedSwapchain = nullptr;
 
 #ifdef D3D9_ALLOW_UNMAPPING
-    lru_list<D3D9CommonTexture*>    m_mappedTextures;
+    lru_list<D3D9CommonTexture>     m_mappedTextures;
 #endif
 
     // m_state should be declared last (i.e. freed first), because it
@@ -1731,6 +1788,9 @@ namespace dxvk {
     alignas(CACHE_LINE_SIZE)
     std::atomic<uint64_t>           m_lastSamplerStats = { 0u };
 
+    // Constant upload statistics, read by the HUD
+    std::atomic<uint64_t>           m_constantUploadBytes = { 0u };
+
     bool m_unlockAdditionalFormats = false;
   };
 
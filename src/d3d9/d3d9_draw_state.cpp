@@ -0,0 +1,114 @@
+#include "d3d9_draw_state.h"
+
+namespace dxvk {
+
+  size_t D3D9DrawStateDelta::getPackedSize() const {
+    size_t size = 0u;
+
+    for (uint32_t flag : bit::BitMask(m_flags.raw())) {
+      switch (D3D9DrawStateFlag(flag)) {
+        case D3D9DrawStateFlag::Viewport:           size += getDwordCount<DxvkViewport>(); break;
+        case D3D9DrawStateFlag::BlendMode:          size += getDwordCount<D3D9DrawBlendState>(); break;
+        case D3D9DrawStateFlag::DepthStencilState:  size += getDwordCount<DxvkDepthStencilState>(); break;
+        case D3D9DrawStateFlag::RasterizerState:    size += getDwordCount<DxvkRasterizerState>(); break;
+        case D3D9DrawStateFlag::DepthBias:          size += getDwordCount<DxvkDepthBias>(); break;
+        case D3D9DrawStateFlag::MultisampleState:   size += getDwordCount<DxvkMultisampleState>(); break;
+        case D3D9DrawStateFlag::DepthBounds:        size += getDwordCount<DxvkDepthBounds>(); break;
+      }
+    }
+
+    return size;
+  }
+
+
+  void D3D9DrawStateDelta::pack(uint32_t* dst) {
+    for (uint32_t flag : bit::BitMask(m_flags.raw())) {
+      switch (D3D9DrawStateFlag(flag)) {
+        case D3D9DrawStateFlag::Viewport:           packState(dst, m_viewport); break;
+        case D3D9DrawStateFlag::BlendMode:          packState(dst, m_blend); break;
+        case D3D9DrawStateFlag::DepthStencilState:  packState(dst, m_depthStencil); break;
+        case D3D9DrawStateFlag::RasterizerState:    packState(dst, m_rasterizer); break;
+        case D3D9DrawStateFlag::DepthBias:          packState(dst, m_depthBias); break;
+        case D3D9DrawStateFlag::MultisampleState:   packState(dst, m_multisample); break;
+        case D3D9DrawStateFlag::DepthBounds:        packState(dst, m_depthBounds); break;
+      }
+    }
+
+    m_flags.clrAll();
+  }
+
+
+  void D3D9DrawStateDelta::apply(
+          DxvkContext*              ctx,
+          D3D9DrawStateFlags        flags,
+    const uint32_t*                 data) {
+    for (uint32_t flag : bit::BitMask(flags.raw())) {
+      switch (D3D9DrawStateFlag(flag)) {
+        case D3D9DrawStateFlag::Viewport: {
+          auto viewport = unpackState<DxvkViewport>(data);
+          ctx->setViewports(1, &viewport);
+        } break;
+
+        case D3D9DrawStateFlag::BlendMode: {
+          applyBlendState(ctx, unpackState<D3D9DrawBlendState>(data));
+        } break;
+
+        case D3D9DrawStateFlag::DepthStencilState: {
+          auto depthStencil = unpackState<DxvkDepthStencilState>(data);
+          depthStencil.normalize();
+
+          ctx->setDepthStencilState(depthStencil);
+        } break;
+
+        case D3D9DrawStateFlag::RasterizerState: {
+          ctx->setRasterizerState(unpackState<DxvkRasterizerState>(data));
+        } break;
+
+        case D3D9DrawStateFlag::DepthBias: {
+          ctx->setDepthBias(unpackState<DxvkDepthBias>(data));
+        } break;
+
+        case D3D9DrawStateFlag::MultisampleState: {
+          ctx->setMultisampleState(unpackState<DxvkMultisampleState>(data));
+        } break;
+
+        case D3D9DrawStateFlag::DepthBounds: {
+          ctx->setDepthBounds(unpackState<DxvkDepthBounds>(data));
+        } break;
+      }
+    }
+  }
+
+
+  void D3D9DrawStateDelta::applyBlendState(
+          DxvkContext*              ctx,
+    const D3D9DrawBlendState&       blend) {
+    for (uint32_t i = 0; i < 4; i++) {
+      DxvkBlendMode mode = blend.mode;
+      mode.setWriteMask(blend.writeMasks >> (4u * i));
+
+      // Adjust the blend factor based on the render target alpha swizzle bit mask.
+      // Specific formats such as the XRGB ones require a ONE swizzle for alpha
+      // which cannot be directly applied with the image view of the attachment.
+      if (blend.alphaMasks & (1 << i)) {
+        auto NormalizeFactor = [] (VkBlendFactor Factor) {
+          if (Factor == VK_BLEND_FACTOR_DST_ALPHA)
+            return VK_BLEND_FACTOR_ONE;
+          else if (Factor == VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA)
+            return VK_BLEND_FACTOR_ZERO;
+          return Factor;
+        };
+
+        mode.setColorOp(NormalizeFactor(mode.colorSrcFactor()),
+                        NormalizeFactor(mode.colorDstFactor()), mode.colorBlendOp());
+        mode.setAlphaOp(NormalizeFactor(mode.alphaSrcFactor()),
+                        NormalizeFactor(mode.alphaDstFactor()), mode.alphaBlendOp());
+      }
+
+      mode.normalize();
+
+      ctx->setBlendMode(i, mode);
+    }
+  }
+
+}
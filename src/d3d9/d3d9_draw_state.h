@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstring>
+
+#include "../dxvk/dxvk_context.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Draw state delta flags
+   *
+   * The order of these flags defines the order in
+   * which the states are packed into the CS command.
+   */
+  enum class D3D9DrawStateFlag : uint32_t {
+    Viewport,
+    BlendMode,
+    DepthStencilState,
+    RasterizerState,
+    DepthBias,
+    MultisampleState,
+    DepthBounds,
+  };
+
+  using D3D9DrawStateFlags = Flags<D3D9DrawStateFlag>;
+
+
+  /**
+   * \brief Blend state for all render targets
+   *
+   * Blend modes are identical for all render targets in D3D9,
+   * only the write masks and alpha swizzle fixups differ.
+   */
+  struct D3D9DrawBlendState {
+    DxvkBlendMode mode        = { };
+    uint16_t      writeMasks  = 0u;
+    uint8_t       alphaMasks  = 0u;
+  };
+
+
+  /**
+   * \brief Draw state delta
+   *
+   * Collects pipeline state changes on the application thread so that
+   * all states that changed between two draws can be emitted as a single
+   * packed CS command, rather than one small command for each state.
+   */
+  class D3D9DrawStateDelta {
+
+  public:
+
+    /**
+     * \brief Checks whether any states are pending
+     * \returns \c true if there are any state changes
+     */
+    bool empty() const {
+      return m_flags.isClear();
+    }
+
+    /**
+     * \brief Queries pending state flags
+     * \returns Pending state flags
+     */
+    D3D9DrawStateFlags flags() const {
+      return m_flags;
+    }
+
+    void setViewport(const DxvkViewport& viewport) {
+      m_flags.set(D3D9DrawStateFlag::Viewport);
+      m_viewport = viewport;
+    }
+
+    void setBlendState(const D3D9DrawBlendState& blend) {
+      m_flags.set(D3D9DrawStateFlag::BlendMode);
+      m_blend = blend;
+    }
+
+    void setDepthStencilState(const DxvkDepthStencilState& depthStencil) {
+      m_flags.set(D3D9DrawStateFlag::DepthStencilState);
+      m_depthStencil = depthStencil;
+    }
+
+    void setRasterizerState(const DxvkRasterizerState& rasterizer) {
+      m_flags.set(D3D9DrawStateFlag::RasterizerState);
+      m_rasterizer = rasterizer;
+    }
+
+    void setDepthBias(const DxvkDepthBias& depthBias) {
+      m_flags.set(D3D9DrawStateFlag::DepthBias);
+      m_depthBias = depthBias;
+    }
+
+    void setMultisampleState(const DxvkMultisampleState& multisample) {
+      m_flags.set(D3D9DrawStateFlag::MultisampleState);
+      m_multisample = multisample;
+    }
+
+    void setDepthBounds(const DxvkDepthBounds& depthBounds) {
+      m_flags.set(D3D9DrawStateFlag::DepthBounds);
+      m_depthBounds = depthBounds;
+    }
+
+    /**
+     * \brief Computes size of packed state data
+     * \returns Number of dwords required to pack all pending states
+     */
+    size_t getPackedSize() const;
+
+    /**
+     * \brief Packs pending states and resets the delta
+     *
+     * \param [out] dst Destination array, must provide
+     *    at least \c getPackedSize() dwords of storage.
+     */
+    void pack(uint32_t* dst);
+
+    /**
+     * \brief Applies packed states to a context
+     *
+     * \param [in] ctx Target context
+     * \param [in] flags States contained in the packed data
+     * \param [in] data Packed state data
+     */
+    static void apply(
+            DxvkContext*              ctx,
+            D3D9DrawStateFlags        flags,
+      const uint32_t*                 data);
+
+  private:
+
+    D3D9DrawStateFlags    m_flags;
+
+    DxvkViewport          m_viewport      = { };
+    D3D9DrawBlendState    m_blend         = { };
+    DxvkDepthStencilState m_depthStencil  = { };
+    DxvkRasterizerState   m_rasterizer    = { };
+    DxvkDepthBias         m_depthBias     = { };
+    DxvkMultisampleState  m_multisample   = { };
+    DxvkDepthBounds       m_depthBounds   = { };
+
+    template<typename T>
+    static constexpr size_t getDwordCount() {
+      return (sizeof(T) + sizeof(uint32_t) - 1u) / sizeof(uint32_t);
+    }
+
+    template<typename T>
+    static void packState(uint32_t*& dst, const T& state) {
+      std::memcpy(dst, &state, sizeof(state));
+      dst += getDwordCount<T>();
+    }
+
+    template<typename T>
+    static T unpackState(const uint32_t*& src) {
+      T state;
+      std::memcpy(&state, src, sizeof(state));
+      src += getDwordCount<T>();
+      return state;
+    }
+
+    static void applyBlendState(
+            DxvkContext*              ctx,
+      const D3D9DrawBlendState&       blend);
+
+  };
+
+}
@@ -2702,12 +2702,19 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
+    m_shader = LookupCachedShader(pDevice, shaderKey, name);
 
-    m_shader = compiler.compile();
+    if (!m_shader) {
+      D3D9FFShaderCompiler compiler(
+        pDevice->GetDXVKDevice(),
+        Key, name,
+        pDevice->GetOptions());
+
+      m_shader = compiler.compile();
+
+      if (auto cache = pDevice->GetShaderCache())
+        cache->addShader(GetShaderCacheKey(pDevice, shaderKey), m_shader, nullptr);
+    }
 
     Dump(pDevice, Key, name);
 
@@ -2723,12 +2730,19 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
+    m_shader = LookupCachedShader(pDevice, shaderKey, name);
 
-    m_shader = compiler.compile();
+    if (!m_shader) {
+      D3D9FFShaderCompiler compiler(
+        pDevice->GetDXVKDevice(),
+        Key, name,
+        pDevice->GetOptions());
+
+      m_shader = compiler.compile();
+
+      if (auto cache = pDevice->GetShaderCache())
+        cache->addShader(GetShaderCacheKey(pDevice, shaderKey), m_shader, nullptr);
+    }
 
     Dump(pDevice, Key, name);
 
@@ -2882,6 +2896,46 @@ namespace dxvk {
   }
 
 
+  D3D9ShaderCacheKey D3D9FFShader::GetShaderCacheKey(
+          D3D9DeviceEx*         pDevice,
+    const DxvkShaderKey&        ShaderKey) {
+    // Hash options member by member since the struct has padding
+    D3D9FixedFunctionOptions options(pDevice->GetOptions());
+
+    std::array<uint32_t, 2> data = {
+      uint32_t(options.invariantPosition),
+      uint32_t(options.forceSampleRateShading),
+    };
+
+    D3D9ShaderCacheKey key;
+    key.stage = uint32_t(ShaderKey.type());
+    key.fixedFunction = 1u;
+    key.codeHash = ShaderKey.sha1();
+    key.optionHash = Sha1Hash::compute(data);
+    return key;
+  }
+
+
+  Rc<DxvkShader> D3D9FFShader::LookupCachedShader(
+          D3D9DeviceEx*         pDevice,
+    const DxvkShaderKey&        ShaderKey,
+    const std::string&          Name) {
+    D3D9ShaderCache* cache = pDevice->GetShaderCache();
+
+    if (!cache)
+      return nullptr;
+
+    Rc<DxvkShader> shader = cache->lookupShader(
+      GetShaderCacheKey(pDevice, ShaderKey), Name, nullptr);
+
+    pDevice->GetDXVKDevice()->addStatCtr(shader
+      ? DxvkStatCounter::ShaderCacheHits
+      : DxvkStatCounter::ShaderCacheMisses, 1u);
+
+    return shader;
+  }
+
+
   template <typename T>
   void D3D9FFShader::Dump(D3D9DeviceEx* pDevice, const T& Key, const std::string& Name) {
     const std::string& dumpPath = pDevice->GetOptions()->shaderDumpPath;
@@ -5,8 +5,10 @@
 #include "d3d9_caps.h"
 
 #include "d3d9_state.h"
+#include "d3d9_shader_cache.h"
 
 #include "../dxvk/dxvk_shader.h"
+#include "../dxvk/dxvk_shader_key.h"
 
 #include "../dxso/dxso_isgn.h"
 
@@ -155,6 +157,15 @@ namespace dxvk {
 
     Rc<DxvkShader> m_shader;
 
+    static D3D9ShaderCacheKey GetShaderCacheKey(
+            D3D9DeviceEx*         pDevice,
+      const DxvkShaderKey&        ShaderKey);
+
+    static Rc<DxvkShader> LookupCachedShader(
+            D3D9DeviceEx*         pDevice,
+      const DxvkShaderKey&        ShaderKey,
+      const std::string&          Name);
+
   };
 
 
@@ -76,6 +76,45 @@ namespace dxvk::hud {
   }
 
 
+  HudConstantUploads::HudConstantUploads(D3D9DeviceEx* device)
+  : m_device        (device)
+  , m_lastBytes     (device->GetConstantUploadBytes())
+  , m_uploadString  ("") { }
+
+
+  void HudConstantUploads::update(dxvk::high_resolution_clock::time_point time) {
+    m_frameCount += 1;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - m_lastUpdate);
+
+    if (elapsed.count() < UpdateInterval)
+      return;
+
+    uint64_t bytes = m_device->GetConstantUploadBytes();
+    uint64_t bytesPerFrame = (bytes - m_lastBytes) / m_frameCount;
+
+    m_uploadString = str::format(bytesPerFrame >> 10, " kB / frame");
+    m_lastBytes = bytes;
+    m_frameCount = 0;
+    m_lastUpdate = time;
+  }
+
+
+  HudPos HudConstantUploads::render(
+    const Rc<DxvkCommandList>&ctx,
+    const HudPipelineKey&     key,
+    const HudOptions&         options,
+          HudRenderer&        renderer,
+          HudPos              position) {
+    position.y += 16;
+    renderer.drawText(16, position, 0xffc0ff00u, "Constants:");
+    renderer.drawText(16, { position.x + 155, position.y }, 0xffffffffu, m_uploadString);
+
+    position.y += 8;
+    return position;
+  }
+
+
   HudSWVPState::HudSWVPState(D3D9DeviceEx* device)
           : m_device          (device)
           , m_isSWVPText ("") {}
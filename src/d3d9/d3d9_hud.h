@@ -67,6 +67,39 @@ namespace dxvk::hud {
   };
 
 
+  /**
+   * \brief HUD item to display shader constant upload sizes
+   */
+  class HudConstantUploads : public HudItem {
+    constexpr static int64_t UpdateInterval = 500'000;
+  public:
+
+    HudConstantUploads(D3D9DeviceEx* device);
+
+    void update(dxvk::high_resolution_clock::time_point time);
+
+    HudPos render(
+      const Rc<DxvkCommandList>&ctx,
+      const HudPipelineKey&     key,
+      const HudOptions&         options,
+            HudRenderer&        renderer,
+            HudPos              position);
+
+  private:
+
+    D3D9DeviceEx* m_device;
+
+    uint64_t m_lastBytes  = 0;
+    uint64_t m_frameCount = 0;
+
+    dxvk::high_resolution_clock::time_point m_lastUpdate
+      = dxvk::high_resolution_clock::now();
+
+    std::string m_uploadString;
+
+  };
+
+
   /**
    * \brief HUD item to whether or not we're in SWVP mode
    */
@@ -6,6 +6,33 @@
 
 namespace dxvk {
 
+  static Sha1Hash HashCompileOptions(
+    const DxsoModuleInfo&       ModuleInfo,
+    const D3D9ConstantLayout&   Layout) {
+    // Hash options member by member since the struct has padding.
+    // Anything that affects code generation must be included here.
+    const DxsoOptions& options = ModuleInfo.options;
+
+    std::array<uint32_t, 13> data = {
+      uint32_t(options.strictConstantCopies),
+      uint32_t(options.d3d9FloatEmulation),
+      uint32_t(options.strictPow),
+      uint32_t(options.invariantPosition),
+      uint32_t(options.forceSamplerTypeSpecConstants),
+      uint32_t(options.forceSampleRateShading),
+      uint32_t(options.vertexFloatConstantBufferAsSSBO),
+      uint32_t(options.robustness2Supported),
+      uint32_t(options.sincosEmulation),
+      Layout.floatCount,
+      Layout.intCount,
+      Layout.boolCount,
+      Layout.bitmaskCount,
+    };
+
+    return Sha1Hash::compute(data);
+  }
+
+
   D3D9CommonShader::D3D9CommonShader() {}
 
   D3D9CommonShader::D3D9CommonShader(
@@ -48,16 +75,49 @@ namespace dxvk {
       }
     }
     
-    // Decide whether we need to create a pass-through
-    // geometry shader for vertex shader stream output
-
     const D3D9ConstantLayout& constantLayout = ShaderStage == VK_SHADER_STAGE_VERTEX_BIT
       ? pDevice->GetVertexConstantLayout()
       : pDevice->GetPixelConstantLayout();
-    m_shader       = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
-    m_isgn         = pModule->isgn();
-    m_usedSamplers = pModule->usedSamplers();
-    m_textureTypes = pModule->textureTypes();
+
+    // Try to load the shader from the on-disk cache first, and only
+    // run the DXSO compiler on a miss. Shader dumps bypass the cache.
+    D3D9ShaderCache* cache = pDevice->GetShaderCache();
+
+    D3D9ShaderCacheKey cacheKey;
+    D3D9ShaderReflection reflection;
+
+    if (cache) {
+      cacheKey.stage = uint32_t(ShaderStage);
+      cacheKey.codeHash = Key.sha1();
+      cacheKey.optionHash = HashCompileOptions(*pDxsoModuleInfo, constantLayout);
+
+      m_shader = cache->lookupShader(cacheKey, name, &reflection);
+
+      pDevice->GetDXVKDevice()->addStatCtr(m_shader
+        ? DxvkStatCounter::ShaderCacheHits
+        : DxvkStatCounter::ShaderCacheMisses, 1u);
+    }
+
+    if (!m_shader) {
+      m_shader = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
+
+      reflection.isgn                 = pModule->isgn();
+      reflection.usedSamplers         = pModule->usedSamplers();
+      reflection.usedRTs              = pModule->usedRTs();
+      reflection.textureTypes         = pModule->textureTypes();
+      reflection.meta                 = pModule->meta();
+      reflection.constants            = pModule->constants();
+      reflection.maxDefinedFloatConst = pModule->maxDefinedFloatConstant();
+      reflection.maxDefinedIntConst   = pModule->maxDefinedIntConstant();
+      reflection.maxDefinedBoolConst  = pModule->maxDefinedBoolConstant();
+
+      if (cache)
+        cache->addShader(cacheKey, m_shader, &reflection);
+    }
+
+    m_isgn         = reflection.isgn;
+    m_usedSamplers = reflection.usedSamplers;
+    m_textureTypes = reflection.textureTypes;
 
     // Shift up these sampler bits so we can just
     // do an or per-draw in the device.
@@ -65,14 +125,14 @@ namespace dxvk {
     if (ShaderStage == VK_SHADER_STAGE_VERTEX_BIT)
       m_usedSamplers <<= FirstVSSamplerSlot;
 
-    m_usedRTs              = pModule->usedRTs();
+    m_usedRTs              = reflection.usedRTs;
 
     m_info                 = pModule->info();
-    m_meta                 = pModule->meta();
-    m_constants            = pModule->constants();
-    m_maxDefinedFloatConst = pModule->maxDefinedFloatConstant();
-    m_maxDefinedIntConst   = pModule->maxDefinedIntConstant();
-    m_maxDefinedBoolConst  = pModule->maxDefinedBoolConstant();
+    m_meta                 = reflection.meta;
+    m_constants            = std::move(reflection.constants);
+    m_maxDefinedFloatConst = reflection.maxDefinedFloatConst;
+    m_maxDefinedIntConst   = reflection.maxDefinedIntConst;
+    m_maxDefinedBoolConst  = reflection.maxDefinedBoolConst;
 
     if (dumpPath.size() != 0) {
       std::ofstream dumpStream(
@@ -0,0 +1,518 @@
+#include <version.h>
+
+#include "d3d9_shader_cache.h"
+
+#include "../dxvk/dxvk_shader_cache.h"
+
+namespace dxvk {
+
+  D3D9ShaderCache::Instance D3D9ShaderCache::s_instance;
+
+  D3D9ShaderCache::D3D9ShaderCache()
+  : m_filePaths(getDefaultFilePaths()) {
+
+  }
+
+
+  D3D9ShaderCache::~D3D9ShaderCache() {
+    if (m_writer.joinable()) {
+      { std::unique_lock lock(m_writeMutex);
+        m_writeQueue.push(PendingShader());
+        m_writeCond.notify_one();
+      }
+
+      m_writer.join();
+    }
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderCache::lookupShader(
+    const D3D9ShaderCacheKey&         key,
+    const std::string&                name,
+          D3D9ShaderReflection*       reflection) {
+    if (!ensureStatus(Status::OpenReadWrite))
+      return nullptr;
+
+    auto entry = m_lut.find(key);
+
+    if (entry == m_lut.end()) {
+      if (Logger::logLevel() <= LogLevel::Debug)
+        Logger::debug(str::format("Shader cache miss: ", name));
+
+      return nullptr;
+    }
+
+    if (Logger::logLevel() <= LogLevel::Debug) {
+      Logger::debug(str::format("Shader cache hit: ", name,
+        " (offset: ", entry->second.offset,
+        ", size: ", entry->second.codeSize,
+        ", metadata: ", entry->second.metadataSize, ")"));
+    }
+
+    std::unique_lock lock(m_fileMutex);
+
+    // Another thread may have discarded the cache in the meantime
+    if (m_status.load(std::memory_order_relaxed) != Status::OpenReadWrite)
+      return nullptr;
+
+    auto shader = loadCachedShaderLocked(entry->second, name, reflection);
+
+    if (!shader) {
+      Logger::warn(str::format("Failed to load cached shader ", name,
+        ", discarding cache contents and continuing with an empty cache"));
+
+      // Stop serving lookups from the stale look-up table, but keep
+      // appending newly compiled shaders to the truncated files.
+      auto status = Status::OpenWriteOnly;
+
+      if (!openWriteOnlyLocked()) {
+        Logger::warn("Failed to re-initialize shader cache, disabling cache");
+        status = Status::CacheDisabled;
+      }
+
+      m_status.store(status, std::memory_order_release);
+    }
+
+    return shader;
+  }
+
+
+  void D3D9ShaderCache::addShader(
+    const D3D9ShaderCacheKey&         key,
+    const Rc<DxvkShader>&             shader,
+    const D3D9ShaderReflection*       reflection) {
+    if (!ensureStatus(Status::OpenWriteOnly))
+      return;
+
+    PendingShader entry;
+    entry.key = key;
+    entry.shader = dynamic_cast<DxvkSpirvShader*>(shader.ptr());
+
+    if (!entry.shader)
+      return;
+
+    if (reflection)
+      entry.reflection = *reflection;
+
+    // The look-up table is stale if the cache had to be discarded
+    bool isCached = m_status.load(std::memory_order_acquire) == Status::OpenReadWrite
+      && m_lut.find(key) != m_lut.end();
+
+    if (!isCached) {
+      std::unique_lock lock(m_writeMutex);
+      m_writeQueue.push(std::move(entry));
+      m_writeCond.notify_one();
+
+      if (!m_writer.joinable())
+        m_writer = dxvk::thread([this] { runWriter(); });
+    }
+  }
+
+
+  bool D3D9ShaderCache::ensureStatus(Status status) {
+    auto currentStatus = m_status.load(std::memory_order_acquire);
+
+    if (currentStatus == Status::Uninitialized)
+      currentStatus = initialize();
+
+    return currentStatus >= status;
+  }
+
+
+  D3D9ShaderCache::Status D3D9ShaderCache::initialize() {
+    std::unique_lock lock(m_fileMutex);
+    auto status = m_status.load(std::memory_order_relaxed);
+
+    if (status != Status::Uninitialized)
+      return status;
+
+    status = tryInitializeLocked();
+
+    m_status.store(status, std::memory_order_release);
+    return status;
+  }
+
+
+  D3D9ShaderCache::Status D3D9ShaderCache::tryInitializeLocked() {
+    if (m_filePaths.directory.empty() || m_filePaths.binFile.empty() || m_filePaths.lutFile.empty()) {
+      Logger::warn("No path found for D3D9 shader cache, consider setting DXVK_SHADER_CACHE_PATH.");
+      return Status::CacheDisabled;
+    }
+
+    if (openReadWriteLocked()) {
+      if (parseLut())
+        return Status::OpenReadWrite;
+    }
+
+    if (openWriteOnlyLocked())
+      return Status::OpenReadWrite;
+
+    return Status::CacheDisabled;
+  }
+
+
+  bool D3D9ShaderCache::openReadWriteLocked() {
+    auto path = m_filePaths.directory + env::PlatformDirSlash;
+
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowRead,
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Exclusive);
+
+    m_binFile.open(path + m_filePaths.binFile, flags);
+    m_lutFile.open(path + m_filePaths.lutFile, flags);
+
+    if (!m_binFile || !m_lutFile)
+      return false;
+
+    Logger::info(str::format("Found cache file: ", path + m_filePaths.binFile));
+    return true;
+  }
+
+
+  bool D3D9ShaderCache::openWriteOnlyLocked() {
+    auto path = m_filePaths.directory + env::PlatformDirSlash;
+
+    // Entries parsed so far point into the files that are about
+    // to be truncated, drop them so that shaders get written again.
+    m_lut.clear();
+
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    m_binFile.open(path + m_filePaths.binFile, flags);
+    m_lutFile.open(path + m_filePaths.lutFile, flags);
+
+    if (!m_binFile || !m_lutFile) {
+      if (!env::createDirectory(m_filePaths.directory)) {
+        Logger::warn(str::format("Failed to create directory: ", m_filePaths.directory));
+        return false;
+      }
+
+      m_binFile.open(path + m_filePaths.binFile, flags);
+      m_lutFile.open(path + m_filePaths.lutFile, flags);
+    }
+
+    if (!m_binFile)
+      Logger::warn(str::format("Failed to create ", path + m_filePaths.binFile, ", disabling cache"));
+
+    if (!m_lutFile)
+      Logger::warn(str::format("Failed to create ", path + m_filePaths.lutFile, ", disabling cache"));
+
+    if (!m_binFile || !m_lutFile)
+      return false;
+
+    Logger::info(str::format("Created cache file: ", path + m_filePaths.binFile));
+
+    LutHeader header = { };
+    header.magic = { 'D', '3', 'D', '9' };
+    header.formatVersion = LutFormatVersion;
+    header.versionString = DXVK_VERSION;
+
+    if (!writeHeader(m_lutFile, header)) {
+      Logger::warn(str::format("Failed to write cache header: ", path + m_filePaths.lutFile));
+      return false;
+    }
+
+    return true;
+  }
+
+
+  bool D3D9ShaderCache::parseLut() {
+    // The look-up table is small, read it in one go
+    std::vector<char> data(m_lutFile.size());
+
+    if (!m_lutFile.read(0u, data.size(), data.data())) {
+      Logger::warn("Failed to read cache look-up table.");
+      return false;
+    }
+
+    util::FileView view(data.data(), data.size());
+
+    LutHeader header;
+    size_t offset = 0u;
+
+    if (!DxvkShaderCache::readBytes(view, header.magic.data(), offset, header.magic.size())
+     || !DxvkShaderCache::read(view, offset, header.formatVersion)
+     || !DxvkShaderCache::readString(view, offset, header.versionString)) {
+      Logger::warn("Failed to parse cache file header.");
+      return false;
+    }
+
+    if (header.formatVersion != LutFormatVersion) {
+      Logger::warn(str::format("Cache format version ", header.formatVersion,
+        " not supported, expected ", LutFormatVersion, ". Discarding old cache."));
+      return false;
+    }
+
+    if (header.versionString != DXVK_VERSION) {
+      Logger::warn(str::format("Cache was created with DXVK version ", header.versionString,
+        ", but current version is ", DXVK_VERSION, ". Discarding old cache."));
+      return false;
+    }
+
+    while (offset < view.size()) {
+      D3D9ShaderCacheKey k;
+      LutEntry e;
+
+      if (!DxvkShaderCache::read(view, offset, k)
+       || !DxvkShaderCache::read(view, offset, e)) {
+        Logger::warn("Failed to parse cache look-up table.");
+        return false;
+      }
+
+      m_lut.insert_or_assign(k, e);
+    }
+
+    return true;
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderCache::loadCachedShaderLocked(
+    const LutEntry&                   entry,
+    const std::string&                name,
+          D3D9ShaderReflection*       reflection) {
+    // Read the entire entry with a single file access
+    std::vector<char> data(sizeof(uint32_t) + entry.codeSize + entry.metadataSize);
+
+    if (!m_binFile.read(entry.offset, data.size(), data.data())) {
+      Logger::warn("Failed to read cached shader");
+      return nullptr;
+    }
+
+    util::FileView view(data.data(), data.size());
+
+    size_t offset = 0u;
+    uint32_t dwordCount = 0u;
+
+    if (!DxvkShaderCache::read(view, offset, dwordCount)) {
+      Logger::warn("Failed to read cached shader size");
+      return nullptr;
+    }
+
+    std::vector<uint32_t> code(entry.codeSize / sizeof(uint32_t));
+
+    if (!DxvkShaderCache::readBytes(view, reinterpret_cast<char*>(code.data()), offset, entry.codeSize)) {
+      Logger::warn("Failed to read cached shader binary");
+      return nullptr;
+    }
+
+    if (entry.checksum != bit::fnv1a_hash(reinterpret_cast<const char*>(code.data()), entry.codeSize)) {
+      Logger::warn("Checksum mismatch for cached shader");
+      return nullptr;
+    }
+
+    DxvkSpirvShaderCreateInfo info;
+    info.debugName = name;
+
+    if (!DxvkShaderCache::read(view, offset, info.flatShadingInputs)) {
+      Logger::warn("Failed to read cached shader metadata");
+      return nullptr;
+    }
+
+    DxvkPipelineLayoutBuilder layout;
+
+    if (!DxvkShaderCache::readShaderLayout(view, offset, layout)) {
+      Logger::warn("Failed to read cached shader binding layout");
+      return nullptr;
+    }
+
+    D3D9ShaderReflection localReflection;
+
+    if (!readShaderReflection(view, offset, reflection ? *reflection : localReflection)) {
+      Logger::warn("Failed to read cached shader reflection data");
+      return nullptr;
+    }
+
+    return new DxvkSpirvShader(info, std::move(layout),
+      SpirvCompressedBuffer(dwordCount, std::move(code)));
+  }
+
+
+  bool D3D9ShaderCache::writeShaderToCache(const PendingShader& shader) {
+    const auto& code = shader.shader->getCompressedCode();
+    const auto& data = code.getCompressedData();
+
+    LutEntry entry = { };
+    entry.offset = m_binFile.size();
+    entry.codeSize = data.size() * sizeof(uint32_t);
+    entry.checksum = bit::fnv1a_hash(reinterpret_cast<const char*>(data.data()), entry.codeSize);
+
+    if (!DxvkShaderCache::write(m_binFile, uint32_t(code.dwords()))
+     || !DxvkShaderCache::writeBytes(m_binFile, reinterpret_cast<const char*>(data.data()), entry.codeSize)
+     || !DxvkShaderCache::write(m_binFile, shader.shader->getShaderMetadata().flatShadingInputs)
+     || !DxvkShaderCache::writeShaderLayout(m_binFile, shader.shader->getLayout())
+     || !writeShaderReflection(m_binFile, shader.reflection))
+      return false;
+
+    entry.metadataSize = uint32_t(uint64_t(m_binFile.size()) - (entry.offset + sizeof(uint32_t) + entry.codeSize));
+
+    return DxvkShaderCache::write(m_lutFile, shader.key)
+        && DxvkShaderCache::write(m_lutFile, entry);
+  }
+
+
+  void D3D9ShaderCache::runWriter() {
+    small_vector<PendingShader, 64u> localQueue;
+
+    env::setThreadName("dxvk-d3d9-cache");
+
+    bool stop = false;
+
+    while (!stop) {
+      std::unique_lock lock(m_writeMutex);
+
+      m_writeCond.wait(lock, [this] {
+        return !m_writeQueue.empty();
+      });
+
+      auto entry = std::move(m_writeQueue.front());
+      m_writeQueue.pop();
+
+      lock.unlock();
+
+      stop = !entry.shader;
+      bool drain = stop;
+
+      if (entry.shader) {
+        localQueue.push_back(std::move(entry));
+        drain = localQueue.size() == localQueue.capacity();
+      }
+
+      if (drain) {
+        std::unique_lock fileLock(m_fileMutex);
+
+        for (const auto& shader : localQueue) {
+          if (!writeShaderToCache(shader)) {
+            Logger::err("Failed to write cache file.");
+            m_status = Status::CacheDisabled;
+            return;
+          }
+        }
+
+        localQueue.clear();
+
+        m_binFile.flush();
+        m_lutFile.flush();
+      }
+    }
+  }
+
+
+  bool D3D9ShaderCache::writeShaderReflection(util::File& stream, const D3D9ShaderReflection& reflection) {
+    bool status = DxvkShaderCache::write(stream, reflection.isgn)
+               && DxvkShaderCache::write(stream, reflection.usedSamplers)
+               && DxvkShaderCache::write(stream, reflection.usedRTs)
+               && DxvkShaderCache::write(stream, reflection.textureTypes)
+               && DxvkShaderCache::write(stream, reflection.meta)
+               && DxvkShaderCache::write(stream, reflection.maxDefinedFloatConst)
+               && DxvkShaderCache::write(stream, reflection.maxDefinedIntConst)
+               && DxvkShaderCache::write(stream, reflection.maxDefinedBoolConst)
+               && DxvkShaderCache::write(stream, uint32_t(reflection.constants.size()));
+
+    for (const auto& constant : reflection.constants)
+      status = status && DxvkShaderCache::write(stream, constant);
+
+    return status;
+  }
+
+
+  bool D3D9ShaderCache::readShaderReflection(const util::FileView& stream, size_t& offset, D3D9ShaderReflection& reflection) {
+    bool status = DxvkShaderCache::read(stream, offset, reflection.isgn)
+               && DxvkShaderCache::read(stream, offset, reflection.usedSamplers)
+               && DxvkShaderCache::read(stream, offset, reflection.usedRTs)
+               && DxvkShaderCache::read(stream, offset, reflection.textureTypes)
+               && DxvkShaderCache::read(stream, offset, reflection.meta)
+               && DxvkShaderCache::read(stream, offset, reflection.maxDefinedFloatConst)
+               && DxvkShaderCache::read(stream, offset, reflection.maxDefinedIntConst)
+               && DxvkShaderCache::read(stream, offset, reflection.maxDefinedBoolConst);
+
+    uint32_t constantCount = 0u;
+    status = status && DxvkShaderCache::read(stream, offset, constantCount);
+
+    if (!status)
+      return false;
+
+    reflection.constants.resize(constantCount);
+
+    for (uint32_t i = 0u; i < constantCount; i++)
+      status = status && DxvkShaderCache::read(stream, offset, reflection.constants[i]);
+
+    return status;
+  }
+
+
+  bool D3D9ShaderCache::writeHeader(util::File& stream, const LutHeader& header) {
+    return DxvkShaderCache::writeBytes(stream, header.magic.data(), header.magic.size())
+        && DxvkShaderCache::write(stream, header.formatVersion)
+        && DxvkShaderCache::writeString(stream, header.versionString);
+  }
+
+
+  D3D9ShaderCache::FilePaths D3D9ShaderCache::getDefaultFilePaths() {
+    DxvkShaderCache::FilePaths irPaths = DxvkShaderCache::getDefaultFilePaths();
+
+    if (irPaths.directory.empty())
+      return FilePaths();
+
+    // Use the same base name as the IR cache so that
+    // all cache files for an app are easy to find
+    std::string baseName = irPaths.lutFile.substr(0u, irPaths.lutFile.find('.'));
+
+    FilePaths paths;
+    paths.directory = irPaths.directory;
+    paths.lutFile = baseName + ".d3d9.lut";
+    paths.binFile = baseName + ".d3d9.bin";
+    return paths;
+  }
+
+
+  Rc<D3D9ShaderCache> D3D9ShaderCache::getInstance() {
+    std::lock_guard lock(s_instance.mutex);
+
+    if (!s_instance.instance)
+      s_instance.instance = new D3D9ShaderCache();
+
+    return s_instance.instance;
+  }
+
+
+  void D3D9ShaderCache::freeInstance() {
+    std::lock_guard lock(s_instance.mutex);
+
+    // The ref count can only be incremented from 0 to 1 inside a
+    // locked context, so this check is safe. Don't destroy the
+    // object if another thread has essentially revived it.
+    if (!m_useCount.load(std::memory_order_relaxed)) {
+      if (s_instance.instance == this)
+        s_instance.instance = nullptr;
+
+      delete this;
+    }
+  }
+
+
+  size_t D3D9ShaderCacheKey::hash() const {
+    DxvkHashState hash;
+    hash.add(stage);
+    hash.add(fixedFunction);
+
+    for (uint32_t i = 0u; i < 5u; i++) {
+      hash.add(codeHash.dword(i));
+      hash.add(optionHash.dword(i));
+    }
+
+    return hash;
+  }
+
+
+  bool D3D9ShaderCacheKey::eq(const D3D9ShaderCacheKey& k) const {
+    return stage == k.stage
+        && fixedFunction == k.fixedFunction
+        && codeHash == k.codeHash
+        && optionHash == k.optionHash;
+  }
+
+}
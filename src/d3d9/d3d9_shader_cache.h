@@ -0,0 +1,216 @@
+#pragma once
+
+#include <queue>
+#include <unordered_map>
+
+#include "../dxso/dxso_isgn.h"
+
+#include "../dxvk/dxvk_shader_spirv.h"
+
+#include "../util/thread.h"
+#include "../util/util_file.h"
+
+#include "../util/sha1/sha1_util.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Shader reflection data
+   *
+   * Information gathered by the DXSO compiler that the
+   * device needs alongside the compiled shader, and that
+   * therefore needs to be cached as well.
+   */
+  struct D3D9ShaderReflection {
+    DxsoIsgn              isgn;
+    uint32_t              usedSamplers          = 0u;
+    uint32_t              usedRTs               = 0u;
+    uint32_t              textureTypes          = 0u;
+    DxsoShaderMetaInfo    meta;
+    DxsoDefinedConstants  constants;
+    int32_t               maxDefinedFloatConst  = -1;
+    int32_t               maxDefinedIntConst    = -1;
+    int32_t               maxDefinedBoolConst   = -1;
+  };
+
+
+  /**
+   * \brief Shader cache look-up key
+   *
+   * Identifies a shader by its source, i.e. the DXSO byte
+   * code or the fixed-function shader key, as well as all
+   * options that affect code generation.
+   */
+  struct D3D9ShaderCacheKey {
+    uint32_t  stage         = 0u;
+    uint32_t  fixedFunction = 0u;
+    Sha1Hash  codeHash      = { };
+    Sha1Hash  optionHash    = { };
+
+    size_t hash() const;
+
+    bool eq(const D3D9ShaderCacheKey& k) const;
+  };
+
+
+  /**
+   * \brief D3D9 shader cache
+   *
+   * On-disk cache for SPIR-V shaders generated from DXSO byte
+   * code or fixed-function state. Uses the same file layout
+   * as \c DxvkShaderCache, i.e. a binary blob storing the
+   * compressed SPIR-V and reflection data, and a look-up table
+   * that can be appended to.
+   */
+  class D3D9ShaderCache {
+
+  public:
+
+    struct FilePaths {
+      std::string directory;
+      std::string lutFile;
+      std::string binFile;
+    };
+
+    ~D3D9ShaderCache();
+
+    void incRef() {
+      m_useCount.fetch_add(1u, std::memory_order_acquire);
+    }
+
+    void decRef() {
+      if (m_useCount.fetch_sub(1u, std::memory_order_release) == 1u)
+        freeInstance();
+    }
+
+    /**
+     * \brief Looks up shader with matching key
+     *
+     * \param [in] key Shader key
+     * \param [in] name Shader debug name
+     * \param [out] reflection Shader reflection data, may
+     *    be \c nullptr if the caller is not interested.
+     * \returns Shader object, or \c nullptr if the shader in
+     *    question could not be found in the cache.
+     */
+    Rc<DxvkShader> lookupShader(
+      const D3D9ShaderCacheKey&         key,
+      const std::string&                name,
+            D3D9ShaderReflection*       reflection);
+
+    /**
+     * \brief Writes shader to cache file
+     *
+     * The shader will be written asynchronously. Only
+     * SPIR-V shaders can be written to the cache.
+     * \param [in] key Shader key
+     * \param [in] shader Shader to write to cache
+     * \param [in] reflection Shader reflection data, or
+     *    \c nullptr for fixed-function shaders
+     */
+    void addShader(
+      const D3D9ShaderCacheKey&         key,
+      const Rc<DxvkShader>&             shader,
+      const D3D9ShaderReflection*       reflection);
+
+    /**
+     * \brief Determines cache file path based on current environment and executable
+     * \returns File paths and file names for cache files
+     */
+    static FilePaths getDefaultFilePaths();
+
+    /**
+     * \brief Initializes shader cache
+     * \returns Shader cache instance
+     */
+    static Rc<D3D9ShaderCache> getInstance();
+
+  private:
+
+    struct Instance {
+      dxvk::mutex       mutex;
+      D3D9ShaderCache*  instance = nullptr;
+    };
+
+    static Instance s_instance;
+
+    constexpr static uint32_t LutFormatVersion = 2u;
+
+    struct LutHeader {
+      std::array<char, 4u>  magic = { };
+      uint32_t              formatVersion = 0u;
+      std::string           versionString = { };
+    };
+
+    struct LutEntry {
+      uint64_t offset = 0u;
+      uint32_t codeSize = 0u;
+      uint32_t metadataSize = 0u;
+      uint64_t checksum = 0u;
+    };
+
+    struct PendingShader {
+      D3D9ShaderCacheKey    key;
+      Rc<DxvkSpirvShader>   shader;
+      D3D9ShaderReflection  reflection;
+    };
+
+    enum class Status : uint32_t {
+      Uninitialized   = 0u,
+      CacheDisabled   = 1u,
+      OpenWriteOnly   = 2u,
+      OpenReadWrite   = 3u,
+    };
+
+    std::atomic<uint32_t>         m_useCount = { 0u };
+
+    FilePaths                     m_filePaths;
+    dxvk::mutex                   m_fileMutex;
+
+    util::File                    m_lutFile;
+    util::File                    m_binFile;
+
+    std::atomic<Status>           m_status = { Status::Uninitialized };
+
+    std::unordered_map<D3D9ShaderCacheKey, LutEntry, DxvkHash, DxvkEq> m_lut;
+
+    dxvk::mutex                   m_writeMutex;
+    dxvk::condition_variable      m_writeCond;
+    std::queue<PendingShader>     m_writeQueue;
+
+    dxvk::thread                  m_writer;
+
+    D3D9ShaderCache();
+
+    bool ensureStatus(Status status);
+
+    Status initialize();
+
+    Status tryInitializeLocked();
+
+    bool openReadWriteLocked();
+
+    bool openWriteOnlyLocked();
+
+    bool parseLut();
+
+    Rc<DxvkShader> loadCachedShaderLocked(
+      const LutEntry&                   entry,
+      const std::string&                name,
+            D3D9ShaderReflection*       reflection);
+
+    bool writeShaderToCache(const PendingShader& shader);
+
+    void runWriter();
+
+    void freeInstance();
+
+    static bool writeShaderReflection(util::File& stream, const D3D9ShaderReflection& reflection);
+
+    static bool readShaderReflection(const util::FileView& stream, size_t& offset, D3D9ShaderReflection& reflection);
+
+    static bool writeHeader(util::File& stream, const LutHeader& header);
+
+  };
+
+}
@@ -68,10 +68,7 @@ namespace dxvk {
     if (unlikely(m_parent->ShouldRecord()))
       return D3DERR_INVALIDCALL;
 
-    if (m_captures.flags.test(D3D9CapturedStateFlag::VertexDecl) && m_state.vertexDecl != nullptr)
-      m_parent->SetVertexDeclaration(m_state.vertexDecl.ptr());
-
-    ApplyOrCapture<D3D9StateFunction::Apply, false>();
+    m_program.Apply(m_parent, &m_state);
 
     return D3D_OK;
   }
@@ -370,6 +367,11 @@ namespace dxvk {
   }
 
 
+  void D3D9StateBlock::Compile() {
+    m_program.Compile(m_captures);
+  }
+
+
   void D3D9StateBlock::CapturePixelRenderStates() {
     m_captures.flags.set(D3D9CapturedStateFlag::RenderStates);
 
@@ -592,6 +594,8 @@ namespace dxvk {
 
       ApplyOrCapture<D3D9StateFunction::Capture, false>();
     }
+
+    Compile();
   }
 
 }
@@ -3,69 +3,12 @@
 #include "d3d9_device_child.h"
 #include "d3d9_device.h"
 #include "d3d9_state.h"
+#include "d3d9_stateblock_program.h"
 
 #include "../util/util_bit.h"
 
 namespace dxvk {
 
-  enum class D3D9CapturedStateFlag : uint32_t {
-    VertexDecl,
-    Indices,
-    RenderStates,
-    SamplerStates,
-    VertexBuffers,
-    Textures,
-    VertexShader,
-    PixelShader,
-    Viewport,
-    ScissorRect,
-    ClipPlanes,
-    VsConstants,
-    PsConstants,
-    StreamFreq,
-    Transforms,
-    TextureStages,
-    Material,
-    Lights
-  };
-
-  using D3D9CapturedStateFlags = Flags<D3D9CapturedStateFlag>;
-
-  struct D3D9StateCaptures {
-    D3D9CapturedStateFlags flags;
-
-    bit::bitset<RenderStateCount>                       renderStates;
-
-    bit::bitset<SamplerCount>                           samplers;
-    std::array<
-      bit::bitset<SamplerStateCount>,
-      SamplerCount>                                     samplerStates;
-
-    bit::bitset<caps::MaxStreams>                       vertexBuffers;
-    bit::bitset<SamplerCount>                           textures;
-    bit::bitset<caps::MaxClipPlanes>                    clipPlanes;
-    bit::bitset<caps::MaxStreams>                       streamFreq;
-    bit::bitset<caps::MaxTransforms>                    transforms;
-    bit::bitset<caps::TextureStageCount>                textureStages;
-    std::array<
-      bit::bitset<TextureStageStateCount>,
-      caps::TextureStageCount>                          textureStageStates;
-
-    struct {
-      bit::bitset<caps::MaxFloatConstantsSoftware>      fConsts;
-      bit::bitset<caps::MaxOtherConstantsSoftware>      iConsts;
-      bit::bitset<caps::MaxOtherConstantsSoftware>      bConsts;
-    } vsConsts;
-
-    struct {
-      bit::bitset<caps::MaxSM3FloatConstantsPS>         fConsts;
-      bit::bitset<caps::MaxOtherConstants>              iConsts;
-      bit::bitset<caps::MaxOtherConstants>              bConsts;
-    } psConsts;
-
-    bit::bitvector                                      lightEnabledChanges;
-  };
-
   enum class D3D9StateBlockType : uint8_t {
     None,
     All,
@@ -389,6 +332,16 @@ namespace dxvk {
     HRESULT SetVertexBoolBitfield(uint32_t idx, uint32_t mask, uint32_t bits);
     HRESULT SetPixelBoolBitfield (uint32_t idx, uint32_t mask, uint32_t bits);
 
+    /**
+     * \brief Compiles apply program
+     *
+     * Flattens the set of captured states into a list of operations,
+     * so that applying the state block does not need to iterate over
+     * capture masks. Must be called whenever the set of captured
+     * states changes, i.e. after creation or recording.
+     */
+    void Compile();
+
   private:
 
     void CapturePixelRenderStates();
@@ -406,6 +359,8 @@ namespace dxvk {
 
     D3D9DeviceState*     m_deviceState;
 
+    D3D9StateBlockProgram m_program;
+
   };
 
 }
\ No newline at end of file
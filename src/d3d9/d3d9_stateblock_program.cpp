@@ -0,0 +1,111 @@
+#include "d3d9_stateblock_program.h"
+
+namespace dxvk {
+
+  void D3D9StateBlockProgram::Compile(const D3D9StateCaptures& Captures) {
+    m_ops.clear();
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::VertexDecl))
+      EmitOp(D3D9StateBlockOpType::VertexDecl);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::StreamFreq)) {
+      for (uint32_t idx : bit::BitMask(Captures.streamFreq.dword(0)))
+        EmitOp(D3D9StateBlockOpType::StreamFreq, idx);
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Indices))
+      EmitOp(D3D9StateBlockOpType::Indices);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::RenderStates)) {
+      for (uint32_t i = 0; i < Captures.renderStates.dwordCount(); i++) {
+        for (uint32_t rs : bit::BitMask(Captures.renderStates.dword(i)))
+          EmitOp(D3D9StateBlockOpType::RenderState, i * 32 + rs);
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::SamplerStates)) {
+      for (uint32_t samplerIdx : bit::BitMask(Captures.samplers.dword(0))) {
+        for (uint32_t stateIdx : bit::BitMask(Captures.samplerStates[samplerIdx].dword(0)))
+          EmitOp(D3D9StateBlockOpType::SamplerState, stateIdx, 0u, samplerIdx);
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::VertexBuffers)) {
+      for (uint32_t idx : bit::BitMask(Captures.vertexBuffers.dword(0)))
+        EmitOp(D3D9StateBlockOpType::VertexBuffer, idx);
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Material))
+      EmitOp(D3D9StateBlockOpType::Material);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Textures)) {
+      for (uint32_t idx : bit::BitMask(Captures.textures.dword(0)))
+        EmitOp(D3D9StateBlockOpType::Texture, idx);
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::VertexShader))
+      EmitOp(D3D9StateBlockOpType::VertexShader);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::PixelShader))
+      EmitOp(D3D9StateBlockOpType::PixelShader);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Transforms)) {
+      for (uint32_t i = 0; i < Captures.transforms.dwordCount(); i++) {
+        for (uint32_t trans : bit::BitMask(Captures.transforms.dword(i)))
+          EmitOp(D3D9StateBlockOpType::Transform, i * 32 + trans);
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::TextureStages)) {
+      for (uint32_t stageIdx : bit::BitMask(Captures.textureStages.dword(0))) {
+        for (uint32_t stateIdx : bit::BitMask(Captures.textureStageStates[stageIdx].dword(0)))
+          EmitOp(D3D9StateBlockOpType::TextureStageState, stateIdx, 0u, stageIdx);
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Viewport))
+      EmitOp(D3D9StateBlockOpType::Viewport);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::ScissorRect))
+      EmitOp(D3D9StateBlockOpType::ScissorRect);
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::ClipPlanes)) {
+      for (uint32_t idx : bit::BitMask(Captures.clipPlanes.dword(0)))
+        EmitOp(D3D9StateBlockOpType::ClipPlane, idx);
+    }
+
+    // Merge consecutive constant registers into ranges so that
+    // each range only needs to be validated and uploaded once
+    if (Captures.flags.test(D3D9CapturedStateFlag::VsConstants)) {
+      EmitConstantRanges(D3D9StateBlockOpType::VsConstantsF, Captures.vsConsts.fConsts);
+      EmitConstantRanges(D3D9StateBlockOpType::VsConstantsI, Captures.vsConsts.iConsts);
+
+      for (uint32_t i = 0; i < Captures.vsConsts.bConsts.dwordCount(); i++) {
+        if (Captures.vsConsts.bConsts.dword(i))
+          EmitOp(D3D9StateBlockOpType::VsConstantsB, i, Captures.vsConsts.bConsts.dword(i));
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::PsConstants)) {
+      EmitConstantRanges(D3D9StateBlockOpType::PsConstantsF, Captures.psConsts.fConsts);
+      EmitConstantRanges(D3D9StateBlockOpType::PsConstantsI, Captures.psConsts.iConsts);
+
+      for (uint32_t i = 0; i < Captures.psConsts.bConsts.dwordCount(); i++) {
+        if (Captures.psConsts.bConsts.dword(i))
+          EmitOp(D3D9StateBlockOpType::PsConstantsB, i, Captures.psConsts.bConsts.dword(i));
+      }
+    }
+
+    if (Captures.flags.test(D3D9CapturedStateFlag::Lights)) {
+      // The number of lights may change when capturing
+      // state, so resolve the light list at apply time
+      EmitOp(D3D9StateBlockOpType::Lights);
+
+      for (uint32_t i = 0; i < Captures.lightEnabledChanges.dwordCount(); i++) {
+        for (uint32_t light : bit::BitMask(Captures.lightEnabledChanges.dword(i)))
+          EmitOp(D3D9StateBlockOpType::LightEnable, i * 32 + light);
+      }
+    }
+  }
+
+}
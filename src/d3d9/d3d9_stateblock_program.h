@@ -0,0 +1,287 @@
+#pragma once
+
+#include "d3d9_state.h"
+#include "d3d9_util.h"
+
+#include "../util/util_bit.h"
+
+namespace dxvk {
+
+  enum class D3D9CapturedStateFlag : uint32_t {
+    VertexDecl,
+    Indices,
+    RenderStates,
+    SamplerStates,
+    VertexBuffers,
+    Textures,
+    VertexShader,
+    PixelShader,
+    Viewport,
+    ScissorRect,
+    ClipPlanes,
+    VsConstants,
+    PsConstants,
+    StreamFreq,
+    Transforms,
+    TextureStages,
+    Material,
+    Lights
+  };
+
+  using D3D9CapturedStateFlags = Flags<D3D9CapturedStateFlag>;
+
+  struct D3D9StateCaptures {
+    D3D9CapturedStateFlags flags;
+
+    bit::bitset<RenderStateCount>                       renderStates;
+
+    bit::bitset<SamplerCount>                           samplers;
+    std::array<
+      bit::bitset<SamplerStateCount>,
+      SamplerCount>                                     samplerStates;
+
+    bit::bitset<caps::MaxStreams>                       vertexBuffers;
+    bit::bitset<SamplerCount>                           textures;
+    bit::bitset<caps::MaxClipPlanes>                    clipPlanes;
+    bit::bitset<caps::MaxStreams>                       streamFreq;
+    bit::bitset<caps::MaxTransforms>                    transforms;
+    bit::bitset<caps::TextureStageCount>                textureStages;
+    std::array<
+      bit::bitset<TextureStageStateCount>,
+      caps::TextureStageCount>                          textureStageStates;
+
+    struct {
+      bit::bitset<caps::MaxFloatConstantsSoftware>      fConsts;
+      bit::bitset<caps::MaxOtherConstantsSoftware>      iConsts;
+      bit::bitset<caps::MaxOtherConstantsSoftware>      bConsts;
+    } vsConsts;
+
+    struct {
+      bit::bitset<caps::MaxSM3FloatConstantsPS>         fConsts;
+      bit::bitset<caps::MaxOtherConstants>              iConsts;
+      bit::bitset<caps::MaxOtherConstants>              bConsts;
+    } psConsts;
+
+    bit::bitvector                                      lightEnabledChanges;
+  };
+
+  enum class D3D9StateBlockOpType : uint8_t {
+    VertexDecl,
+    StreamFreq,
+    Indices,
+    RenderState,
+    SamplerState,
+    VertexBuffer,
+    Material,
+    Texture,
+    VertexShader,
+    PixelShader,
+    Transform,
+    TextureStageState,
+    Viewport,
+    ScissorRect,
+    ClipPlane,
+    VsConstantsF,
+    VsConstantsI,
+    VsConstantsB,
+    PsConstantsF,
+    PsConstantsI,
+    PsConstantsB,
+    Lights,
+    LightEnable,
+  };
+
+  /**
+   * \brief Compiled state block operation
+   *
+   * Applies a single captured state, or a range of consecutive
+   * shader constants, to the device. State values are read from
+   * the state block when it gets applied, so that the compiled
+   * program remains valid when the state block captures state.
+   */
+  struct D3D9StateBlockOp {
+    D3D9StateBlockOpType  type;
+    uint8_t               stage;  ///< Sampler or texture stage
+    uint32_t              index;  ///< State, slot or first register
+    uint32_t              arg;    ///< Register count or bool mask
+  };
+
+  /**
+   * \brief State block apply program
+   *
+   * Flattened list of operations for a set of captured states. Does
+   * not depend on the device itself, so that the program can be applied
+   * to any object that provides the same state setters as the device.
+   */
+  class D3D9StateBlockProgram {
+
+  public:
+
+    /**
+     * \brief Compiles program for a set of captured states
+     *
+     * Operations are emitted in the same order in which
+     * the state block captures the corresponding states.
+     * \param [in] Captures Captured states
+     */
+    void Compile(const D3D9StateCaptures& Captures);
+
+    /**
+     * \brief Number of operations
+     * \returns Operation count
+     */
+    size_t GetOpCount() const {
+      return m_ops.size();
+    }
+
+    /**
+     * \brief Applies state
+     *
+     * \param [in] dst Object to apply state to, usually the device
+     * \param [in] src State to read state values from
+     */
+    template <typename Dst, typename Src>
+    void Apply(Dst* dst, const Src* src) const {
+      for (const auto& op : m_ops) {
+        switch (op.type) {
+          case D3D9StateBlockOpType::VertexDecl:
+            if (src->vertexDecl != nullptr)
+              dst->SetVertexDeclaration(src->vertexDecl.ptr());
+            break;
+
+          case D3D9StateBlockOpType::StreamFreq:
+            dst->SetStreamSourceFreq(op.index, src->streamFreq[op.index]);
+            break;
+
+          case D3D9StateBlockOpType::Indices:
+            dst->SetIndices(src->indices.ptr());
+            break;
+
+          case D3D9StateBlockOpType::RenderState:
+            dst->SetRenderState(D3DRENDERSTATETYPE(op.index), src->renderStates[op.index]);
+            break;
+
+          case D3D9StateBlockOpType::SamplerState:
+            dst->SetStateSamplerState(op.stage, D3DSAMPLERSTATETYPE(op.index), src->samplerStates[op.stage][op.index]);
+            break;
+
+          case D3D9StateBlockOpType::VertexBuffer: {
+            const auto& vbo = src->vertexBuffers[op.index];
+            dst->SetStreamSource(op.index, vbo.vertexBuffer.ptr(), vbo.offset, vbo.stride);
+          } break;
+
+          case D3D9StateBlockOpType::Material:
+            dst->SetMaterial(&src->material);
+            break;
+
+          case D3D9StateBlockOpType::Texture:
+            dst->SetStateTexture(op.index, src->textures[op.index]);
+            break;
+
+          case D3D9StateBlockOpType::VertexShader:
+            dst->SetVertexShader(src->vertexShader.ptr());
+            break;
+
+          case D3D9StateBlockOpType::PixelShader:
+            dst->SetPixelShader(src->pixelShader.ptr());
+            break;
+
+          case D3D9StateBlockOpType::Transform:
+            dst->SetStateTransform(op.index, reinterpret_cast<const D3DMATRIX*>(&src->transforms[op.index]));
+            break;
+
+          case D3D9StateBlockOpType::TextureStageState:
+            dst->SetStateTextureStageState(op.stage, D3D9TextureStageStateTypes(op.index), src->textureStages[op.stage][op.index]);
+            break;
+
+          case D3D9StateBlockOpType::Viewport:
+            dst->SetViewport(&src->viewport);
+            break;
+
+          case D3D9StateBlockOpType::ScissorRect:
+            dst->SetScissorRect(&src->scissorRect);
+            break;
+
+          case D3D9StateBlockOpType::ClipPlane:
+            dst->SetClipPlane(op.index, src->clipPlanes[op.index].coeff);
+            break;
+
+          case D3D9StateBlockOpType::VsConstantsF:
+            dst->SetVertexShaderConstantF(op.index, reinterpret_cast<const float*>(&src->vsConsts->fConsts[op.index]), op.arg);
+            break;
+
+          case D3D9StateBlockOpType::VsConstantsI:
+            dst->SetVertexShaderConstantI(op.index, reinterpret_cast<const int*>(&src->vsConsts->iConsts[op.index]), op.arg);
+            break;
+
+          case D3D9StateBlockOpType::VsConstantsB:
+            dst->SetVertexBoolBitfield(op.index, op.arg, src->vsConsts->bConsts[op.index]);
+            break;
+
+          case D3D9StateBlockOpType::PsConstantsF:
+            dst->SetPixelShaderConstantF(op.index, reinterpret_cast<const float*>(&src->psConsts->fConsts[op.index]), op.arg);
+            break;
+
+          case D3D9StateBlockOpType::PsConstantsI:
+            dst->SetPixelShaderConstantI(op.index, reinterpret_cast<const int*>(&src->psConsts->iConsts[op.index]), op.arg);
+            break;
+
+          case D3D9StateBlockOpType::PsConstantsB:
+            dst->SetPixelBoolBitfield(op.index, op.arg, src->psConsts->bConsts[op.index]);
+            break;
+
+          case D3D9StateBlockOpType::Lights: {
+            for (uint32_t i = 0; i < src->lights.size(); i++) {
+              if (src->lights[i].has_value())
+                dst->SetLight(i, &src->lights[i].value());
+            }
+          } break;
+
+          case D3D9StateBlockOpType::LightEnable:
+            dst->LightEnable(op.index, src->IsLightEnabled(op.index));
+            break;
+        }
+      }
+    }
+
+  private:
+
+    std::vector<D3D9StateBlockOp> m_ops;
+
+    void EmitOp(
+            D3D9StateBlockOpType  Type,
+            uint32_t              Index = 0u,
+            uint32_t              Arg   = 0u,
+            uint8_t               Stage = 0u) {
+      m_ops.push_back({ Type, Stage, Index, Arg });
+    }
+
+    template <typename T>
+    void EmitConstantRanges(D3D9StateBlockOpType Type, const T& Captures) {
+      uint32_t start = 0u;
+      uint32_t count = 0u;
+
+      for (uint32_t i = 0; i < Captures.dwordCount(); i++) {
+        for (uint32_t consts : bit::BitMask(Captures.dword(i))) {
+          uint32_t idx = i * 32 + consts;
+
+          if (idx == start + count && count) {
+            count += 1u;
+            continue;
+          }
+
+          if (count)
+            EmitOp(Type, start, count);
+
+          start = idx;
+          count = 1u;
+        }
+      }
+
+      if (count)
+        EmitOp(Type, start, count);
+    }
+
+  };
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "d3d9_include.h"
+
+#include "../dxvk/dxvk_cs.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Pending DrawPrimitiveUP batch
+   *
+   * Tracks the most recently emitted UP draw command so that
+   * subsequent UP draws can be appended to it, as long as no
+   * other CS commands were emitted in between. Does not depend
+   * on the device, so that batching can be tested in isolation.
+   */
+  class D3D9UPDrawBatch {
+
+  public:
+
+    /**
+     * \brief Checks whether draws can be appended
+     * \returns \c true if there is a pending batch
+     */
+    bool active() const {
+      return m_data != nullptr;
+    }
+
+    /**
+     * \brief Starts a new batch
+     *
+     * \param [in] data Data block of the draw command
+     * \param [in] primType Primitive type of the draw
+     * \param [in] stride Vertex stride
+     * \param [in] offset Offset of the vertex data of the
+     *    first draw within the UP buffer
+     */
+    void begin(
+            DxvkCsDataBlock*      data,
+            D3DPRIMITIVETYPE      primType,
+            uint32_t              stride,
+            VkDeviceSize          offset) {
+      m_data      = data;
+      m_primType  = primType;
+      m_stride    = stride;
+      m_offset    = offset;
+    }
+
+    /**
+     * \brief Ends the pending batch
+     *
+     * Must be called whenever any other command is added to the
+     * CS chunk, or when the chunk or the UP buffer get replaced.
+     */
+    void reset() {
+      m_data = nullptr;
+    }
+
+    /**
+     * \brief Appends a draw to the pending batch
+     *
+     * Places the vertex data at a multiple of the stride relative
+     * to the start of the batch so that it can be addressed by the
+     * first vertex index of the draw, and adds the draw to the data
+     * block of the pending draw command. Does not write any vertex
+     * data, the caller must copy it to the returned offset.
+     * \param [in] chunk CS chunk that the pending command was added to
+     * \param [in] primType Primitive type of the draw
+     * \param [in] vertexCount Number of vertices to draw
+     * \param [in] stride Vertex stride
+     * \param [in] bufferOffset Current allocation offset in the UP buffer
+     * \param [in] bufferSize Total size of the UP buffer
+     * \param [out] dataOffset Offset of the vertex data in the UP buffer
+     * \returns \c true if the draw was appended to the batch
+     */
+    bool append(
+            DxvkCsChunk*          chunk,
+            D3DPRIMITIVETYPE      primType,
+            uint32_t              vertexCount,
+            uint32_t              stride,
+            VkDeviceSize          bufferOffset,
+            VkDeviceSize          bufferSize,
+            VkDeviceSize&         dataOffset) const {
+      if (!m_data || m_primType != primType || m_stride != stride)
+        return false;
+
+      VkDeviceSize firstVertex = (bufferOffset - m_offset + stride - 1u) / stride;
+
+      dataOffset = m_offset + firstVertex * stride;
+
+      if (dataOffset + VkDeviceSize(vertexCount) * stride > bufferSize)
+        return false;
+
+      auto draw = reinterpret_cast<VkDrawIndirectCommand*>(chunk->pushData(m_data, 1u));
+
+      if (!draw)
+        return false;
+
+      draw->vertexCount = vertexCount;
+      draw->instanceCount = 1u;
+      draw->firstVertex = uint32_t(firstVertex);
+      draw->firstInstance = 0u;
+      return true;
+    }
+
+    /**
+     * \brief Computes vertex buffer range for a batch
+     *
+     * \param [in] length Length of the vertex data of the first draw
+     * \param [in] stride Vertex stride
+     * \param [in] draws Draws in the batch
+     * \param [in] count Number of draws
+     * \returns Vertex buffer range that covers all draws
+     */
+    static VkDeviceSize getBufferLength(
+            VkDeviceSize          length,
+            uint32_t              stride,
+      const VkDrawIndirectCommand* draws,
+            size_t                count) {
+      for (size_t i = 1; i < count; i++)
+        length = std::max(length, VkDeviceSize(draws[i].firstVertex + draws[i].vertexCount) * stride);
+
+      return length;
+    }
+
+  private:
+
+    DxvkCsDataBlock*  m_data      = nullptr;
+    D3DPRIMITIVETYPE  m_primType  = D3DPRIMITIVETYPE(0);
+    uint32_t          m_stride    = 0u;
+    VkDeviceSize      m_offset    = 0ull;
+
+  };
+
+}
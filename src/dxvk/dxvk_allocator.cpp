@@ -9,7 +9,7 @@
 namespace dxvk {
 
   DxvkPageAllocator::DxvkPageAllocator() {
-
+    m_buckets.fill(-1);
   }
 
 
@@ -27,60 +27,31 @@ namespace dxvk {
 
 
   int32_t DxvkPageAllocator::allocPages(uint32_t count, uint32_t alignment) {
-    int32_t index = searchFreeList(count);
-
-    while (index--) {
-      PageRange entry = m_freeList[index];
-
-      // The chunk index is the same regardless of alignment.
-      // Skip chunk if it does not accept new allocations.
-      uint32_t chunkIndex = entry.index >> ChunkPageBits;
-
-      if (unlikely(m_chunks[chunkIndex].disabled))
-        continue;
-
-      if (likely(!(entry.index & (alignment - 1u)))) {
-        // If the current free range is sufficiently aligned, we can use
-        // it as-is and simply modify the remaining free list entry.
-        uint32_t pageIndex = entry.index;
+    // Any free range in the search bucket or any bucket above it
+    // is large enough to hold the allocation, so unless alignment
+    // gets in the way or the chunk is disabled, the first range we
+    // look at will be used.
+    uint32_t searchBucket = computeSearchBucketIndex(count);
+    int32_t bucket = findBucket(searchBucket);
 
-        entry.index += count;
-        entry.count -= count;
+    while (bucket >= 0) {
+      int32_t pageIndex = allocFromBucket(bucket, count, alignment);
 
-        insertFreeRange(entry, index);
-
-        m_chunks[chunkIndex].pagesUsed += count;
+      if (likely(pageIndex >= 0))
         return pageIndex;
-      } else {
-        // Apply alignment and skip if the free range is too small.
-        uint32_t pageIndex = align(entry.index, alignment);
-
-        if (pageIndex + count > entry.index + entry.count)
-          continue;
-
-        // Insert free range before the first allocated page,
-        // guaranteed to be non-empty at this point.
-        PageRange prevRange = { };
-        prevRange.index = entry.index;
-        prevRange.count = pageIndex - entry.index;
 
-        insertFreeRange(prevRange, index);
-
-        // Insert free range after the last allocated page.
-        PageRange nextRange = { };
-        nextRange.index = pageIndex + count;
-        nextRange.count = entry.index + entry.count - nextRange.index;
-
-        if (nextRange.count)
-          insertFreeRange(nextRange, -1);
+      bucket = findBucket(bucket + 1u);
+    }
 
-        m_chunks[chunkIndex].pagesUsed += count;
+    // The bucket that the requested page count falls into may
+    // still contain free ranges that are large enough, only
+    // check those as a last resort.
+    uint32_t exactBucket = computeBucketIndex(count);
 
-        return pageIndex;
-      }
-    }
+    if (exactBucket < searchBucket && exactBucket < BucketCount)
+      return allocFromBucket(exactBucket, count, alignment);
 
-    return -1;    
+    return -1;
   }
 
 
@@ -99,56 +70,30 @@ namespace dxvk {
     int32_t nextRange = -1;
 
     if (index & ChunkPageMask)
-      prevRange = m_freeListLutByPage[index - 1];
+      prevRange = m_rangeLutByPage[index - 1];
 
     if ((index + count) & ChunkPageMask)
-      nextRange = m_freeListLutByPage[index + count];
+      nextRange = m_rangeLutByPage[index + count];
 
-    if (prevRange < 0) {
-      if (nextRange < 0) {
-        // No adjacent range, need to insert a new one
-        PageRange range = { };
-        range.index = index;
-        range.count = count;
+    uint32_t chunkIndex = index >> ChunkPageBits;
+    uint32_t pageCount = count;
 
-        insertFreeRange(range, -1);
-      } else {
-        // One adjacent range after the current one
-        PageRange range = m_freeList[nextRange];
-        range.index = index;
-        range.count += count;
+    if (prevRange >= 0) {
+      index = m_ranges[prevRange].index;
+      count += m_ranges[prevRange].count;
 
-        insertFreeRange(range, nextRange);
-      }
-    } else if (nextRange < 0) {
-        // One adjacent range before the current one
-      PageRange range = m_freeList[prevRange];
-      range.count += count;
+      removeFreeRange(prevRange);
+    }
 
-      insertFreeRange(range, prevRange);
-    } else {
-      // Two adjacent ranges, need to merge with both
-      // and replace one while removing the other.
-      PageRange prev = m_freeList[prevRange];
-      PageRange next = m_freeList[nextRange];
-
-      PageRange mergedRange = { };
-      mergedRange.index = prev.index;
-      mergedRange.count = next.index + next.count - prev.index;
-
-      PageRange emptyRange = { };
-
-      // Remove the range at the higher index, then replace the one at the
-      // lower index with the merged range. The order is important here since
-      // having overlapping entries in the free list would cause issues for
-      // the look-up table, and using the correct indices is important since
-      // the index for the second operation could otherwise be invalidated.
-      insertFreeRange(emptyRange, std::max(prevRange, nextRange));
-      insertFreeRange(mergedRange, std::min(prevRange, nextRange));
+    if (nextRange >= 0) {
+      count += m_ranges[nextRange].count;
+
+      removeFreeRange(nextRange);
     }
 
-    uint32_t chunkIndex = index >> ChunkPageBits;
-    return !(m_chunks[chunkIndex].pagesUsed -= count);
+    insertFreeRange(index, count);
+
+    return !(m_chunks[chunkIndex].pagesUsed -= pageCount);
   }
 
 
@@ -158,7 +103,7 @@ namespace dxvk {
     if (chunkIndex < 0) {
       chunkIndex = m_chunks.size();
 
-      m_freeListLutByPage.resize((chunkIndex + 1u) << ChunkPageBits, -1);
+      m_rangeLutByPage.resize((chunkIndex + 1u) << ChunkPageBits, -1);
       m_chunks.emplace_back();
     }
 
@@ -170,11 +115,8 @@ namespace dxvk {
     chunk.nextChunk = -1;
     chunk.disabled = false;
 
-    PageRange pageRange = { };
-    pageRange.index = uint32_t(chunkIndex) << ChunkPageBits;
-    pageRange.count = chunk.pageCount;
-
-    insertFreeRange(pageRange, -1);
+    if (chunk.pageCount)
+      insertFreeRange(uint32_t(chunkIndex) << ChunkPageBits, chunk.pageCount);
 
     return uint32_t(chunkIndex);
   }
@@ -187,13 +129,12 @@ namespace dxvk {
     chunk.nextChunk = std::exchange(m_freeChunk, int32_t(chunkIndex));
     chunk.disabled = true;
 
-    uint32_t pageIndex = chunkIndex << ChunkPageBits;
-
-    PageRange pageRange = { };
-    pageRange.index = pageIndex;
-    pageRange.count = 0;
+    // The chunk is entirely unused at this point, so
+    // there is exactly one free range covering it
+    int32_t rangeIndex = m_rangeLutByPage[chunkIndex << ChunkPageBits];
 
-    insertFreeRange(pageRange, m_freeListLutByPage[pageIndex]);
+    if (rangeIndex >= 0)
+      removeFreeRange(rangeIndex);
   }
 
 
@@ -234,10 +175,10 @@ namespace dxvk {
     if (lastCount)
       pageMask[fullCount] = (1u << lastCount) - 1u;
 
-    // Iterate over free list and set all pages included
-    // in the current chunk to 0.
-    for (PageRange range : m_freeList) {
-      if ((range.index >> ChunkPageBits) != chunkIndex)
+    // Iterate over all free ranges and set all pages
+    // included in the current chunk to 0.
+    for (PageRange range : m_ranges) {
+      if (!range.count || (range.index >> ChunkPageBits) != chunkIndex)
         continue;
 
       range.index &= ChunkPageMask;
@@ -266,92 +207,141 @@ namespace dxvk {
   }
 
 
-  int32_t DxvkPageAllocator::searchFreeList(uint32_t count) {
-    // Find the insertion index of a free list entry with the given page count.
-    // All entries with an index lower than but not equal to the return value
-    // will have a page count greater than or equal to count.
-    if (unlikely(m_freeList.empty()))
-      return 0u;
+  int32_t DxvkPageAllocator::findBucket(uint32_t first) const {
+    // Find the first non-empty bucket with an index
+    // greater than or equal to the given index
+    for (uint32_t i = first / 64u; i < m_bucketMask.size(); i++) {
+      uint64_t mask = m_bucketMask[i];
+
+      if (i == first / 64u)
+        mask &= ~uint64_t(0u) << (first % 64u);
+
+      if (mask)
+        return int32_t(64u * i + bit::tzcnt(mask));
+    }
+
+    return -1;
+  }
+
+
+  int32_t DxvkPageAllocator::allocFromBucket(uint32_t bucket, uint32_t count, uint32_t alignment) {
+    int32_t rangeIndex = m_buckets[bucket];
+
+    while (rangeIndex >= 0) {
+      PageRange range = m_ranges[rangeIndex];
+
+      // The chunk index is the same regardless of alignment.
+      // Skip chunk if it does not accept new allocations.
+      uint32_t chunkIndex = range.index >> ChunkPageBits;
+
+      // Apply alignment and skip if the free range is too small.
+      uint32_t pageIndex = align(range.index, alignment);
+
+      if (unlikely(m_chunks[chunkIndex].disabled)
+       || unlikely(pageIndex + count > range.index + range.count)) {
+        rangeIndex = range.next;
+        continue;
+      }
 
-    // Do a binary search, but optimize for the common
-    // case where we request a small page count
-    uint32_t lo = 0u;
-    uint32_t hi = m_freeList.size();
+      // Remove the range and re-insert any pages
+      // before or after the allocated page range.
+      removeFreeRange(rangeIndex);
 
-    if (count <= m_freeList.back().count)
-      return int32_t(hi);
+      if (unlikely(pageIndex > range.index))
+        insertFreeRange(range.index, pageIndex - range.index);
 
-    while (lo < hi) {
-      uint32_t mid = (lo + hi) / 2u;
+      if (pageIndex + count < range.index + range.count)
+        insertFreeRange(pageIndex + count, range.index + range.count - pageIndex - count);
 
-      if (count <= m_freeList[mid].count)
-        lo = mid + 1;
-      else
-        hi = mid;
+      m_chunks[chunkIndex].pagesUsed += count;
+      return int32_t(pageIndex);
     }
 
-    return int32_t(lo);
+    return -1;
   }
 
 
-  void DxvkPageAllocator::addLutEntry(const PageRange& range, int32_t index) {
-    m_freeListLutByPage[range.index] = index;
-    m_freeListLutByPage[range.index + range.count - 1u] = index;
-  }
+  void DxvkPageAllocator::insertFreeRange(uint32_t index, uint32_t count) {
+    int32_t rangeIndex = m_freeRange;
+
+    if (rangeIndex < 0) {
+      rangeIndex = int32_t(m_ranges.size());
+      m_ranges.emplace_back();
+    } else {
+      m_freeRange = m_ranges[rangeIndex].next;
+    }
+
+    // Insert range at the front of its bucket's list
+    uint32_t bucket = computeBucketIndex(count);
 
+    auto& range = m_ranges[rangeIndex];
+    range.index = index;
+    range.count = count;
+    range.prev = -1;
+    range.next = m_buckets[bucket];
 
-  void DxvkPageAllocator::removeLutEntry(const PageRange& range) {
-    m_freeListLutByPage[range.index] = -1;
-    m_freeListLutByPage[range.index + range.count - 1u] = -1;
+    if (range.next >= 0)
+      m_ranges[range.next].prev = rangeIndex;
+
+    m_buckets[bucket] = rangeIndex;
+    m_bucketMask[bucket / 64u] |= uint64_t(1u) << (bucket % 64u);
+
+    m_rangeLutByPage[index] = rangeIndex;
+    m_rangeLutByPage[index + count - 1u] = rangeIndex;
   }
 
 
-  void DxvkPageAllocator::insertFreeRange(PageRange newRange, int32_t currentIndex) {
-    size_t count = m_freeList.size();
-    size_t index = size_t(currentIndex);
+  void DxvkPageAllocator::removeFreeRange(int32_t rangeIndex) {
+    auto& range = m_ranges[rangeIndex];
 
-    if (unlikely(currentIndex < 0)) {
-      m_freeList.emplace_back();
-      index = count++;
-    }
+    uint32_t bucket = computeBucketIndex(range.count);
 
-    // Remove old range from the LUT since it gets replaced
-    PageRange oldRange = m_freeList[index];
+    if (range.prev >= 0)
+      m_ranges[range.prev].next = range.next;
+    else
+      m_buckets[bucket] = range.next;
 
-    if (likely(oldRange.count))
-      removeLutEntry(oldRange);
+    if (range.next >= 0)
+      m_ranges[range.next].prev = range.prev;
 
-    // Move range within the free list until the proper ordering
-    // is restored again and update LUT entries for all ranges we
-    // move in the process.
-    if (newRange.count < oldRange.count) {
-      while (index + 1u < count) {
-        PageRange next = m_freeList[index + 1u];
+    if (m_buckets[bucket] < 0)
+      m_bucketMask[bucket / 64u] &= ~(uint64_t(1u) << (bucket % 64u));
 
-        if (newRange.count >= next.count)
-          break;
+    m_rangeLutByPage[range.index] = -1;
+    m_rangeLutByPage[range.index + range.count - 1u] = -1;
 
-        addLutEntry(next, index);
-        m_freeList[index++] = next;
-      }
-    } else if (newRange.count > oldRange.count) {
-      while (index) {
-        PageRange prev = m_freeList[index - 1u];
+    // Mark range as unused and add it to the free list so
+    // that the entry can be reused for a new range later
+    range.index = 0u;
+    range.count = 0u;
+    range.prev = -1;
+    range.next = std::exchange(m_freeRange, rangeIndex);
+  }
 
-        if (newRange.count <= prev.count)
-          break;
 
-        addLutEntry(prev, index);
-        m_freeList[index--] = prev;
-      }
-    }
+  uint32_t DxvkPageAllocator::computeBucketIndex(uint32_t count) {
+    // Small ranges get their own bucket, larger ones are assigned
+    // one of BucketsPerLevel buckets based on the most significant
+    // bits, starting with the leading one.
+    uint32_t level = 31u - bit::lzcnt(std::max(count, 1u));
 
-    if (newRange.count) {
-      m_freeList[index] = newRange;
-      addLutEntry(newRange, index);
-    } else {
-      m_freeList.pop_back();
-    }
+    if (level < BucketLevelBits)
+      return count;
+
+    uint32_t shift = level - BucketLevelBits;
+    return ((shift + 1u) << BucketLevelBits) | ((count >> shift) & (BucketsPerLevel - 1u));
+  }
+
+
+  uint32_t DxvkPageAllocator::computeSearchBucketIndex(uint32_t count) {
+    // Round page count up to the next bucket boundary so that
+    // every free range in the resulting bucket is large enough
+    uint32_t level = 31u - bit::lzcnt(std::max(count, 1u));
+
+    if (level >= BucketLevelBits)
+      count += (1u << (level - BucketLevelBits)) - 1u;
+
+    return computeBucketIndex(count);
   }
 
 
@@ -13,13 +13,19 @@ namespace dxvk {
   /**
    * \brief Page allocator
    *
-   * Implements a best-fit allocation strategy for coarse allocations
-   * using an ordered free list. While allocating and freeing memory
-   * are both linear in the worst case, minimum-size allocations can
-   * generally be performed in constant time, with larger allocations
-   * getting gradually slower.
+   * Implements a good-fit allocation strategy for coarse allocations
+   * using segregated free lists. Free ranges are sorted into buckets
+   * by size, with exact buckets for small ranges and a fixed number
+   * of buckets per power of two for larger ones, and a bit mask of
+   * non-empty buckets allows finding a suitable free range in constant
+   * time. Freeing memory is constant time as well, since adjacent free
+   * ranges are looked up by page index.
    */
   class DxvkPageAllocator {
+    /// Number of buckets per power of two. Ranges smaller than
+    /// 2 * BucketsPerLevel pages get assigned an exact bucket.
+    constexpr static uint32_t BucketLevelBits = 3u;
+    constexpr static uint32_t BucketsPerLevel = 1u << BucketLevelBits;
 
   public:
 
@@ -40,6 +46,10 @@ namespace dxvk {
 
     constexpr static uint64_t MaxChunkSize = 1u << ChunkAddressBits;
 
+    /// Total number of free list buckets, enough to cover
+    /// free ranges of up to a full chunk in size.
+    constexpr static uint32_t BucketCount = (ChunkPageBits - BucketLevelBits + 2u) << BucketLevelBits;
+
 
     DxvkPageAllocator();
 
@@ -190,21 +200,34 @@ namespace dxvk {
     struct PageRange {
       uint32_t  index = 0u;
       uint32_t  count = 0u;
+      int32_t   prev  = -1;
+      int32_t   next  = -1;
     };
 
-    std::vector<PageRange>  m_freeList;
-    std::vector<int32_t>    m_freeListLutByPage;
+    using BucketMask = std::array<uint64_t, (BucketCount + 63u) / 64u>;
+
+    std::vector<PageRange>  m_ranges;
+    int32_t                 m_freeRange = -1;
+
+    std::array<int32_t, BucketCount> m_buckets;
+    BucketMask              m_bucketMask = { };
+
+    std::vector<int32_t>    m_rangeLutByPage;
 
     std::vector<ChunkInfo>  m_chunks;
     int32_t                 m_freeChunk = -1;
 
-    int32_t searchFreeList(uint32_t count);
+    int32_t findBucket(uint32_t first) const;
+
+    int32_t allocFromBucket(uint32_t bucket, uint32_t count, uint32_t alignment);
+
+    void insertFreeRange(uint32_t index, uint32_t count);
 
-    void addLutEntry(const PageRange& range, int32_t index);
+    void removeFreeRange(int32_t rangeIndex);
 
-    void removeLutEntry(const PageRange& range);
+    static uint32_t computeBucketIndex(uint32_t count);
 
-    void insertFreeRange(PageRange newRange, int32_t currentIndex);
+    static uint32_t computeSearchBucketIndex(uint32_t count);
 
   };
 
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "dxvk_barrier.h"
 
 namespace dxvk {
@@ -113,23 +115,14 @@ namespace dxvk {
 
 
   void DxvkBarrierTracker::clear() {
+    // Root nodes get reset when they are first used again, and
+    // all other nodes are discarded at once. This keeps the cost
+    // of a reset independent of the number of tracked ranges.
     m_rootMaskValid = 0u;
+    m_rootMaskSubtree = 0u;
 
-    while (m_rootMaskSubtree) {
-      // Free subtrees if any, but keep the root node intact
-      uint32_t rootIndex = bit::tzcnt(m_rootMaskSubtree) + 1u;
-
-      auto& root = m_nodes[rootIndex];
-
-      if (root.header) {
-        freeNode(root.child(0));
-        freeNode(root.child(1));
-
-        root.header = 0u;
-      }
-
-      m_rootMaskSubtree &= m_rootMaskSubtree - 1u;
-    }
+    m_nodes.resize(1u + 2u * HashTableSize);
+    m_free.clear();
   }
 
 
@@ -138,12 +131,7 @@ namespace dxvk {
       uint32_t nodeIndex = m_free.back();
       m_free.pop_back();
 
-      // Free any subtree that the node might still have
-      auto& node = m_nodes[nodeIndex];
-      freeNode(node.child(0));
-      freeNode(node.child(1));
-
-      node.header = 0u;
+      m_nodes[nodeIndex].header = 0u;
       return nodeIndex;
     } else {
       // Allocate entirely new node in the array
@@ -194,8 +182,8 @@ namespace dxvk {
     if (!(m_rootMaskValid & rootBit)) {
       m_rootMaskValid |= rootBit;
 
-      // Update root node as necessary. Also reset
-      // its red-ness if we set it during deletion.
+      // Reset the root node, it may still hold links
+      // to nodes that were discarded during a clear.
       auto& node = m_nodes[rootIndex];
       node.header = 0;
       node.addressRange = range;
@@ -231,9 +219,7 @@ namespace dxvk {
       node.setParent(parentIndex);
       node.addressRange = range;
 
-      // Only do the fixup to maintain red-black properties if
-      // we haven't marked the root node as red in a deletion.
-      if (parentIndex != rootIndex && !m_nodes[rootIndex].isRed())
+      if (parentIndex != rootIndex)
         rebalancePostInsert(nodeIndex, rootIndex);
 
       m_rootMaskSubtree |= rootBit;
@@ -261,15 +247,6 @@ namespace dxvk {
       node.addressRange = m_nodes[childIndex].addressRange;
       removeNode(childIndex, rootIndex);
     } else {
-      // Deletion is expected to be exceptionally rare, to the point of
-      // being irrelevant in practice since it can only ever happen if an
-      // app reads multiple disjoint blocks of a resource and then reads
-      // another range covering multiple of those blocks again. Instead
-      // of implementing a complex post-delete fixup, mark the root as
-      // red and allow the tree to go unbalanced until the next reset.
-      if (!node.isRed() && (nodeIndex != rootIndex))
-        m_nodes[rootIndex].setRed(true);
-
       // We're deleting the a node with one or no children. To avoid
       // special-casing the root node, copy the child node to it and
       // update links as necessary.
@@ -277,33 +254,33 @@ namespace dxvk {
       uint32_t parentIndex = node.parent();
 
       if (childIndex) {
+        // In a valid red-black tree, the only child of a node must be
+        // a red leaf, and the node itself must be black. Moving the
+        // child's payload into the node thus keeps the tree balanced.
         auto& child = m_nodes[childIndex];
 
-        uint32_t cl = child.child(0);
-        uint32_t cr = child.child(1);
-
-        node.setChild(0, cl);
-        node.setChild(1, cr);
-
-        if (nodeIndex != rootIndex)
-          node.setRed(child.isRed());
+        node.setChild(0, 0u);
+        node.setChild(1, 0u);
 
         node.addressRange = child.addressRange;
 
-        if (cl) m_nodes[cl].setParent(nodeIndex);
-        if (cr) m_nodes[cr].setParent(nodeIndex);
-
         child.header = 0u;
         freeNode(childIndex);
       } else if (nodeIndex != rootIndex) {
-        // Removing leaf node, update parent link and move on.
+        // Removing leaf node, update parent link and restore
+        // red-black properties if we removed a black node.
         auto& parent = m_nodes[parentIndex];
 
         uint32_t which = uint32_t(parent.child(1) == nodeIndex);
         parent.setChild(which, 0u);
 
+        bool isRed = node.isRed();
+
         node.header = 0;
         freeNode(nodeIndex);
+
+        if (!isRed)
+          rebalancePostRemove(0u, parentIndex, rootIndex);
       } else {
         // Removing root with no children, mark tree as invalid
         uint64_t rootBit = uint64_t(1u) << (rootIndex - 1u);
@@ -370,6 +347,80 @@ namespace dxvk {
   }
 
 
+  void DxvkBarrierTracker::rebalancePostRemove(
+          uint32_t                    nodeIndex,
+          uint32_t                    parentIndex,
+          uint32_t                    rootIndex) {
+    // The subtree rooted in the given node, which may be the null node,
+    // is missing one black node. Note that rotations keep the subtree
+    // root at its index and move node payloads instead, so the parent
+    // of the current node may change its index when rotating around it.
+    while (nodeIndex != rootIndex && !m_nodes[nodeIndex].isRed()) {
+      auto& p = m_nodes[parentIndex];
+
+      // The sibling is guaranteed to exist since the path through
+      // it contains at least one more black node than ours.
+      uint32_t side = uint32_t(p.child(0) != nodeIndex);
+      uint32_t siblingIndex = p.child(side ^ 1u);
+
+      if (m_nodes[siblingIndex].isRed()) {
+        // Red sibling, rotate it up so that we get a black sibling
+        // instead. The old parent payload moves to the sibling node.
+        m_nodes[siblingIndex].setRed(false);
+        p.setRed(true);
+
+        if (side) rotateRight(parentIndex, rootIndex);
+        else      rotateLeft(parentIndex, rootIndex);
+
+        parentIndex = siblingIndex;
+        siblingIndex = m_nodes[parentIndex].child(side ^ 1u);
+      }
+
+      auto& p2 = m_nodes[parentIndex];
+      auto& s = m_nodes[siblingIndex];
+
+      uint32_t nearIndex = s.child(side);
+      uint32_t farIndex = s.child(side ^ 1u);
+
+      if (!m_nodes[nearIndex].isRed() && !m_nodes[farIndex].isRed()) {
+        // Black sibling with no red children, push the
+        // missing black node up the tree by one level.
+        s.setRed(true);
+
+        nodeIndex = parentIndex;
+        parentIndex = p2.parent();
+        continue;
+      }
+
+      if (!m_nodes[farIndex].isRed()) {
+        // Only the near child is red, rotate it up into the sibling
+        // position. Since the sibling's index does not change, the
+        // new far child is the node that held the sibling before.
+        m_nodes[nearIndex].setRed(false);
+        s.setRed(true);
+
+        if (side) rotateLeft(siblingIndex, rootIndex);
+        else      rotateRight(siblingIndex, rootIndex);
+
+        farIndex = s.child(side ^ 1u);
+      }
+
+      // Far child is red. Rotate the sibling up into the parent position
+      // and recolor, which restores the missing black node on our path.
+      s.setRed(p2.isRed());
+      p2.setRed(false);
+      m_nodes[farIndex].setRed(false);
+
+      if (side) rotateRight(parentIndex, rootIndex);
+      else      rotateLeft(parentIndex, rootIndex);
+
+      return;
+    }
+
+    m_nodes[nodeIndex].setRed(false);
+  }
+
+
   void DxvkBarrierTracker::rotateLeft(
           uint32_t                    nodeIndex,
           uint32_t                    rootIndex) {
@@ -432,7 +483,9 @@ namespace dxvk {
 
 
   DxvkBarrierBatch::DxvkBarrierBatch(DxvkCmdBuffer cmdBuffer)
-  : m_cmdBuffer(cmdBuffer) { }
+  : m_cmdBuffer(cmdBuffer) {
+
+  }
 
 
   DxvkBarrierBatch::~DxvkBarrierBatch() {
@@ -462,6 +515,9 @@ namespace dxvk {
     }
 
     if (barrier.oldLayout != barrier.newLayout || barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex) {
+      if (tryMergeImageBarrier(m_imageBarriers, barrier))
+        return;
+
       auto& entry = m_imageBarriers.emplace_back(barrier);
 
       entry.srcStageMask &= vk::StageDeviceMask;
@@ -479,22 +535,150 @@ namespace dxvk {
 
   void DxvkBarrierBatch::flush(
     const Rc<DxvkCommandList>&        list) {
+    if (!(m_memoryBarrier.srcStageMask | m_memoryBarrier.dstStageMask) && m_imageBarriers.empty())
+      return;
+
+    if (m_cmdBuffer != DxvkCmdBuffer::ExecBuffer) {
+      recordBarriers(*list, m_memoryBarrier, m_imageBarriers);
+      return;
+    }
+
+    // If previously flushed barriers are still deferred, no command was
+    // recorded since, so the new barriers can be merged into the same
+    // pipeline barrier unless any layout transitions would conflict.
+    if (m_deferredList && !canDeferBarriers())
+      m_deferredList->flushDeferredBarriers();
+
+    deferBarriers();
+
+    if (!m_deferredList) {
+      m_deferredList = list.ptr();
+      m_deferredList->deferBarriers(this);
+    }
+  }
+
+
+  void DxvkBarrierBatch::finalize(
+    const Rc<DxvkCommandList>&        list) {
+    if (m_hostDstAccess) {
+      m_memoryBarrier.srcStageMask |= m_hostSrcStages;
+      m_memoryBarrier.dstStageMask |= VK_PIPELINE_STAGE_2_HOST_BIT;
+      m_memoryBarrier.dstAccessMask |= m_hostDstAccess;
+
+      m_hostSrcStages = 0u;
+      m_hostDstAccess = 0u;
+    }
+
+    flush(list);
+
+    if (m_deferredList)
+      m_deferredList->flushDeferredBarriers();
+  }
+
+
+  void DxvkBarrierBatch::recordDeferredBarriers(
+          DxvkCommandList&            list) {
+    // Barriers from different flushes may rely on execution dependency
+    // chains between them, e.g. a layout transition that only waits for
+    // the destination stages of a previous memory barrier. Apply the
+    // combined scopes to all barriers so that merging them is safe.
+    if (m_deferredCount > 1u) {
+      VkMemoryBarrier2 scope = m_deferredMemoryBarrier;
+
+      for (const auto& b : m_deferredImageBarriers) {
+        scope.srcStageMask |= b.srcStageMask;
+        scope.srcAccessMask |= b.srcAccessMask;
+        scope.dstStageMask |= b.dstStageMask;
+        scope.dstAccessMask |= b.dstAccessMask;
+      }
+
+      if (m_deferredMemoryBarrier.srcStageMask | m_deferredMemoryBarrier.dstStageMask)
+        m_deferredMemoryBarrier = scope;
+
+      for (auto& b : m_deferredImageBarriers) {
+        b.srcStageMask = scope.srcStageMask;
+        b.srcAccessMask = scope.srcAccessMask;
+        b.dstStageMask = scope.dstStageMask;
+        b.dstAccessMask = scope.dstAccessMask;
+      }
+    }
+
+    m_deferredList = nullptr;
+    m_deferredCount = 0u;
+
+    recordBarriers(list, m_deferredMemoryBarrier, m_deferredImageBarriers);
+  }
+
+
+  void DxvkBarrierBatch::recordBarriers(
+          DxvkCommandList&            list,
+          VkMemoryBarrier2&           memoryBarrier,
+          std::vector<VkImageMemoryBarrier2>& imageBarriers) {
     VkDependencyInfo depInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
 
-    if (m_memoryBarrier.srcStageMask | m_memoryBarrier.dstStageMask) {
+    if (memoryBarrier.srcStageMask | memoryBarrier.dstStageMask) {
       depInfo.memoryBarrierCount = 1;
-      depInfo.pMemoryBarriers = &m_memoryBarrier;
+      depInfo.pMemoryBarriers = &memoryBarrier;
     }
 
-    if (!m_imageBarriers.empty()) {
-      depInfo.imageMemoryBarrierCount = m_imageBarriers.size();
-      depInfo.pImageMemoryBarriers = m_imageBarriers.data();
+    if (!imageBarriers.empty()) {
+      depInfo.imageMemoryBarrierCount = imageBarriers.size();
+      depInfo.pImageMemoryBarriers = imageBarriers.data();
     }
 
     if (!(depInfo.memoryBarrierCount | depInfo.imageMemoryBarrierCount))
       return;
 
-    list->cmdPipelineBarrier(m_cmdBuffer, &depInfo);
+    if (depInfo.imageMemoryBarrierCount)
+      list.addStatCtr(DxvkStatCounter::CmdBarrierLayoutCount, 1u);
+
+    if (memoryBarrier.dstStageMask & VK_PIPELINE_STAGE_2_HOST_BIT)
+      list.addStatCtr(DxvkStatCounter::CmdBarrierHostCount, 1u);
+
+    if (m_mergedCount) {
+      list.addStatCtr(DxvkStatCounter::CmdBarrierMergedCount, m_mergedCount);
+      m_mergedCount = 0u;
+    }
+
+    list.cmdPipelineBarrier(m_cmdBuffer, &depInfo);
+
+    memoryBarrier.srcStageMask = 0u;
+    memoryBarrier.srcAccessMask = 0u;
+    memoryBarrier.dstStageMask = 0u;
+    memoryBarrier.dstAccessMask = 0u;
+
+    imageBarriers.clear();
+  }
+
+
+  bool DxvkBarrierBatch::canDeferBarriers() const {
+    // Two layout transitions for the same subresource
+    // cannot be part of the same pipeline barrier
+    for (const auto& b : m_imageBarriers) {
+      for (const auto& d : m_deferredImageBarriers) {
+        if (b.image == d.image && overlapsSubresources(b.subresourceRange, d.subresourceRange))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  void DxvkBarrierBatch::deferBarriers() {
+    // Count merged flushes as merged barriers for statistics
+    if (m_deferredCount++)
+      m_mergedCount += 1u;
+
+    m_deferredMemoryBarrier.srcStageMask |= m_memoryBarrier.srcStageMask;
+    m_deferredMemoryBarrier.srcAccessMask |= m_memoryBarrier.srcAccessMask;
+    m_deferredMemoryBarrier.dstStageMask |= m_memoryBarrier.dstStageMask;
+    m_deferredMemoryBarrier.dstAccessMask |= m_memoryBarrier.dstAccessMask;
+
+    for (const auto& b : m_imageBarriers) {
+      if (!tryMergeImageBarrier(m_deferredImageBarriers, b))
+        m_deferredImageBarriers.push_back(b);
+    }
 
     m_memoryBarrier.srcStageMask = 0u;
     m_memoryBarrier.srcAccessMask = 0u;
@@ -505,18 +689,108 @@ namespace dxvk {
   }
 
 
-  void DxvkBarrierBatch::finalize(
-    const Rc<DxvkCommandList>&        list) {
-    if (m_hostDstAccess) {
-      m_memoryBarrier.srcStageMask |= m_hostSrcStages;
-      m_memoryBarrier.dstStageMask |= VK_PIPELINE_STAGE_2_HOST_BIT;
-      m_memoryBarrier.dstAccessMask |= m_hostDstAccess;
+  bool DxvkBarrierBatch::tryMergeImageBarrier(
+          std::vector<VkImageMemoryBarrier2>& list,
+    const VkImageMemoryBarrier2&      barrier) {
+    // Only look at the most recent barriers, layout transitions for
+    // multiple subresources of the same image are usually added in
+    // direct succession, e.g. when processing mip levels one by one.
+    size_t count = list.size();
+    size_t first = count > MergeWindow ? count - MergeWindow : 0u;
+
+    for (size_t i = count; i > first; i--) {
+      auto& entry = list[i - 1u];
+
+      if (entry.image != barrier.image
+       || entry.oldLayout != barrier.oldLayout
+       || entry.newLayout != barrier.newLayout
+       || entry.srcQueueFamilyIndex != barrier.srcQueueFamilyIndex
+       || entry.dstQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+        continue;
+
+      if (!tryMergeSubresources(entry.subresourceRange, barrier.subresourceRange))
+        continue;
+
+      entry.srcStageMask |= barrier.srcStageMask & vk::StageDeviceMask;
+      entry.srcAccessMask |= barrier.srcAccessMask & vk::AccessWriteMask;
+      entry.dstStageMask |= barrier.dstStageMask & vk::StageDeviceMask;
+      entry.dstAccessMask |= barrier.dstAccessMask & vk::AccessDeviceMask;
+
+      m_mergedCount += 1u;
+      return true;
+    }
 
-      m_hostSrcStages = 0u;
-      m_hostDstAccess = 0u;
+    return false;
+  }
+
+
+  bool DxvkBarrierBatch::tryMergeSubresources(
+          VkImageSubresourceRange&  dst,
+    const VkImageSubresourceRange&  src) {
+    if (dst.aspectMask != src.aspectMask)
+      return false;
+
+    // Only merge ranges if they differ in one dimension, otherwise
+    // the union cannot be represented as a single subresource range
+    if (dst.baseMipLevel == src.baseMipLevel && dst.levelCount == src.levelCount)
+      return tryMergeRange(dst.baseArrayLayer, dst.layerCount, src.baseArrayLayer, src.layerCount);
+
+    if (dst.baseArrayLayer == src.baseArrayLayer && dst.layerCount == src.layerCount)
+      return tryMergeRange(dst.baseMipLevel, dst.levelCount, src.baseMipLevel, src.levelCount);
+
+    return false;
+  }
+
+
+  bool DxvkBarrierBatch::tryMergeRange(
+          uint32_t&                 dstBase,
+          uint32_t&                 dstCount,
+          uint32_t                  srcBase,
+          uint32_t                  srcCount) {
+    // VK_REMAINING_MIP_LEVELS and VK_REMAINING_ARRAY_LAYERS are
+    // the same value, and we cannot reason about those ranges
+    if (dstCount == VK_REMAINING_MIP_LEVELS || srcCount == VK_REMAINING_MIP_LEVELS)
+      return false;
+
+    // Identical ranges can occur if the same transition is
+    // requested multiple times, just merge the access masks
+    if (dstBase == srcBase && dstCount == srcCount)
+      return true;
+
+    if (dstBase + dstCount == srcBase) {
+      dstCount += srcCount;
+      return true;
     }
 
-    flush(list);
+    if (srcBase + srcCount == dstBase) {
+      dstBase = srcBase;
+      dstCount += srcCount;
+      return true;
+    }
+
+    return false;
+  }
+
+
+  bool DxvkBarrierBatch::overlapsSubresources(
+    const VkImageSubresourceRange&  a,
+    const VkImageSubresourceRange&  b) {
+    return (a.aspectMask & b.aspectMask)
+        && overlapsRange(a.baseMipLevel, a.levelCount, b.baseMipLevel, b.levelCount)
+        && overlapsRange(a.baseArrayLayer, a.layerCount, b.baseArrayLayer, b.layerCount);
+  }
+
+
+  bool DxvkBarrierBatch::overlapsRange(
+          uint32_t                  aBase,
+          uint32_t                  aCount,
+          uint32_t                  bBase,
+          uint32_t                  bCount) {
+    // Treat remaining levels or layers as unbounded
+    uint64_t aEnd = aCount == VK_REMAINING_MIP_LEVELS ? ~0ull : uint64_t(aBase) + aCount;
+    uint64_t bEnd = bCount == VK_REMAINING_MIP_LEVELS ? ~0ull : uint64_t(bBase) + bCount;
+
+    return aBase < bEnd && bBase < aEnd;
   }
 
 }
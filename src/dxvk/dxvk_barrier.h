@@ -192,11 +192,14 @@ namespace dxvk {
    * \brief Barrier tracker
    *
    * Provides a two-part hash table for read and written resource
-   * ranges, which is backed by binary trees to handle individual
-   * address ranges as well as collisions.
+   * ranges, which is backed by red-black trees to handle individual
+   * address ranges as well as collisions. Ranges stored in a tree
+   * never overlap, so ordering them by resource and start address
+   * is sufficient to find overlapping ranges in logarithmic time.
    */
   class DxvkBarrierTracker {
-    constexpr static uint32_t HashTableSize = 32u;
+    constexpr static uint32_t HashTableBits = 5u;
+    constexpr static uint32_t HashTableSize = 1u << HashTableBits;
   public:
 
     DxvkBarrierTracker();
@@ -263,6 +266,11 @@ namespace dxvk {
             uint32_t                    nodeIndex,
             uint32_t                    rootIndex);
 
+    void rebalancePostRemove(
+            uint32_t                    nodeIndex,
+            uint32_t                    parentIndex,
+            uint32_t                    rootIndex);
+
     void rebalancePostInsert(
             uint32_t                    nodeIndex,
             uint32_t                    rootIndex);
@@ -278,14 +286,15 @@ namespace dxvk {
     static uint32_t computeRootIndex(
       const DxvkAddressRange&           range,
             DxvkAccess                  access) {
-      // TODO revisit once we use internal allocation
-      // objects or resource cookies here.
-      size_t hash = uint64_t(range.resource) * 93887;
-             hash ^= (hash >> 16);
+      // Resource IDs are derived from allocation addresses, so the
+      // low bits are mostly the same. Use a multiplicative hash and
+      // take the top bits, which depend on all bits of the input.
+      uint64_t hash = uint64_t(range.resource) * 0x9e3779b97f4a7c15ull;
+      hash >>= 64u - HashTableBits;
 
       // Reserve the upper half of the implicit hash table for written
       // ranges, and add 1 because 0 refers to the actual null node.
-      return 1u + (hash % HashTableSize) + (access == DxvkAccess::Write ? HashTableSize : 0u);
+      return 1u + uint32_t(hash) + (access == DxvkAccess::Write ? HashTableSize : 0u);
     }
 
   };
@@ -295,10 +304,18 @@ namespace dxvk {
    * \brief Barrier batch
    *
    * Simple helper class to accumulate barriers that can then
-   * be recorded into a command buffer in a single step.
+   * be recorded into a command buffer in a single step. Layout
+   * transitions for adjacent subresources of the same image
+   * are merged into a single image barrier where possible.
+   *
+   * For the execution command buffer, flushed barriers are only
+   * recorded once the command list records the next command, so
+   * that barriers from subsequent flushes with no commands in
+   * between can be merged into the same pipeline barrier.
    */
   class DxvkBarrierBatch {
-
+    /** Number of most recent image barriers considered for merging */
+    constexpr static size_t MergeWindow = 8u;
   public:
 
     DxvkBarrierBatch(DxvkCmdBuffer cmdBuffer);
@@ -327,6 +344,9 @@ namespace dxvk {
 
     /**
      * \brief Flushes batched memory barriers
+     *
+     * Barriers for the execution command buffer may be
+     * deferred until the next command gets recorded.
      * \param [in] list Command list
      */
     void flush(
@@ -339,6 +359,16 @@ namespace dxvk {
     void finalize(
       const Rc<DxvkCommandList>&        list);
 
+    /**
+     * \brief Records deferred barriers
+     *
+     * Called by the command list before recording
+     * any command into the execution command buffer.
+     * \param [in] list Command list
+     */
+    void recordDeferredBarriers(
+            DxvkCommandList&            list);
+
     /**
      * \brief Check whether there are pending layout transitions
      * \returns \c true if there are any image layout transitions
@@ -374,6 +404,48 @@ namespace dxvk {
 
     std::vector<VkImageMemoryBarrier2> m_imageBarriers = { };
 
+    VkMemoryBarrier2      m_deferredMemoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+
+    std::vector<VkImageMemoryBarrier2> m_deferredImageBarriers = { };
+
+    DxvkCommandList*      m_deferredList  = nullptr;
+    uint32_t              m_deferredCount = 0u;
+
+    uint32_t              m_mergedCount   = 0u;
+
+    void recordBarriers(
+            DxvkCommandList&            list,
+            VkMemoryBarrier2&           memoryBarrier,
+            std::vector<VkImageMemoryBarrier2>& imageBarriers);
+
+    bool canDeferBarriers() const;
+
+    void deferBarriers();
+
+    bool tryMergeImageBarrier(
+            std::vector<VkImageMemoryBarrier2>& list,
+      const VkImageMemoryBarrier2&      barrier);
+
+    static bool overlapsSubresources(
+      const VkImageSubresourceRange&  a,
+      const VkImageSubresourceRange&  b);
+
+    static bool overlapsRange(
+            uint32_t                  aBase,
+            uint32_t                  aCount,
+            uint32_t                  bBase,
+            uint32_t                  bCount);
+
+    static bool tryMergeSubresources(
+            VkImageSubresourceRange&  dst,
+      const VkImageSubresourceRange&  src);
+
+    static bool tryMergeRange(
+            uint32_t&                 dstBase,
+            uint32_t&                 dstCount,
+            uint32_t                  srcBase,
+            uint32_t                  srcCount);
+
   };
 
 }
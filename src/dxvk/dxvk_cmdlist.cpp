@@ -1,4 +1,5 @@
 
+#include "dxvk_barrier.h"
 #include "dxvk_cmdlist.h"
 #include "dxvk_device.h"
 
@@ -387,6 +388,9 @@ namespace dxvk {
   
   
   void DxvkCommandList::finalize() {
+    if (m_deferredBarriers)
+      flushDeferredBarriers();
+
     // Record commands to upload descriptors if necessary, and
     // reset the descriptor range to not keep it alive for too
     // long. Descriptor ranges are tracked when bound.
@@ -419,6 +423,9 @@ namespace dxvk {
 
 
   void DxvkCommandList::next() {
+    if (m_deferredBarriers)
+      flushDeferredBarriers();
+
     bool push = m_cmd.sparseBind || m_cmd.execCommands;
 
     for (uint32_t i = 0; i < m_cmd.cmdBuffers.size(); i++) {
@@ -732,8 +739,19 @@ namespace dxvk {
   }
 
 
+  void DxvkCommandList::flushDeferredBarriers() {
+    // Reset first so that recording the barriers does not recurse
+    DxvkBarrierBatch* batch = std::exchange(m_deferredBarriers, nullptr);
+    batch->recordDeferredBarriers(*this);
+  }
+
+
   void DxvkCommandList::beginSecondaryCommandBuffer(
     const VkCommandBufferInheritanceInfo& inheritanceInfo) {
+    // Deferred barriers must go into the primary command buffer
+    if (m_deferredBarriers)
+      flushDeferredBarriers();
+
     VkCommandBuffer secondary = m_graphicsPool->getSecondaryCommandBuffer(inheritanceInfo);
 
     if (m_device->canUseDescriptorBuffer())
@@ -21,6 +21,8 @@
 
 namespace dxvk {
 
+  class DxvkBarrierBatch;
+
   /**
    * \brief Immediate descriptor write
    *
@@ -507,6 +509,29 @@ namespace dxvk {
             size_t                        pushDataSize,
       const void*                         pushData);
 
+    /**
+     * \brief Defers barriers until the next command
+     *
+     * The given barrier batch will be asked to record its deferred
+     * barriers before any other command is recorded into the
+     * execution command buffer. Only one batch can be deferred
+     * at a time.
+     * \param [in] batch Barrier batch
+     */
+    void deferBarriers(
+            DxvkBarrierBatch*             batch) {
+      m_deferredBarriers = batch;
+    }
+
+    /**
+     * \brief Records deferred barriers
+     *
+     * Called automatically when recording commands into
+     * the execution command buffer. Must only be called
+     * if barriers have been deferred.
+     */
+    void flushDeferredBarriers();
+
     /**
      * \brief Begins a secondary command buffer
      *
@@ -1293,15 +1318,24 @@ namespace dxvk {
 
     std::vector<DxvkGraphicsPipeline*> m_pipelines;
 
-    force_inline VkCommandBuffer getCmdBuffer() const {
+    DxvkBarrierBatch*         m_deferredBarriers = nullptr;
+
+    force_inline VkCommandBuffer getCmdBuffer() {
+      // Barriers must be recorded before any subsequent command
+      if (unlikely(m_deferredBarriers))
+        flushDeferredBarriers();
+
       // Allocation logic will always provide an execution buffer
       return m_cmd.cmdBuffers[uint32_t(DxvkCmdBuffer::ExecBuffer)];
     }
 
     force_inline VkCommandBuffer getCmdBuffer(DxvkCmdBuffer cmdBuffer) {
+      if (cmdBuffer == DxvkCmdBuffer::ExecBuffer)
+        return getCmdBuffer();
+
       VkCommandBuffer buffer = m_cmd.cmdBuffers[uint32_t(cmdBuffer)];
 
-      if (likely(cmdBuffer == DxvkCmdBuffer::ExecBuffer || buffer))
+      if (likely(buffer))
         return buffer;
 
       // Allocate a new command buffer if necessary
@@ -67,6 +67,8 @@ namespace dxvk {
     // Add a fast path to query debug utils support
     if (m_device->debugFlags().test(DxvkDebugFlag::Capture))
       m_features.set(DxvkContextFeature::DebugUtils);
+
+    this->refillRelocationBudget();
   }
   
   
@@ -103,6 +105,8 @@ namespace dxvk {
 
   void DxvkContext::endFrame() {
     m_renderPassIndex = 0u;
+
+    this->refillRelocationBudget();
   }
 
 
@@ -7779,12 +7783,26 @@ namespace dxvk {
     constexpr static uint32_t MaxRelocationsPerSubmission = 128u;
     constexpr static uint32_t MaxRelocatedMemoryPerSubmission = 16u << 20;
 
-    auto resourceList = m_common->memoryManager().pollRelocationList(
-      MaxRelocationsPerSubmission, MaxRelocatedMemoryPerSubmission);
+    // Also respect the per-frame budget so that relocating resources
+    // in the background is spread out over multiple frames. Applications
+    // that render without presenting would never get the budget refilled
+    // at the end of a frame, so also refill it periodically.
+    constexpr static auto RelocationBudgetInterval = std::chrono::milliseconds(16);
+
+    if (high_resolution_clock::now() - m_relocationBudgetTime >= RelocationBudgetInterval)
+      this->refillRelocationBudget();
+
+    if (!m_relocationBudget)
+      return;
+
+    auto resourceList = m_common->memoryManager().pollRelocationList(MaxRelocationsPerSubmission,
+      std::min<VkDeviceSize>(MaxRelocatedMemoryPerSubmission, m_relocationBudget));
 
     if (resourceList.empty())
       return;
 
+    VkDeviceSize relocatedSize = 0u;
+
     std::vector<DxvkRelocateBufferInfo> bufferInfos;
     std::vector<DxvkRelocateImageInfo> imageInfos;
 
@@ -7797,6 +7815,8 @@ namespace dxvk {
       if (!storage)
         continue;
 
+      relocatedSize += storage->getMemoryInfo().size;
+
       Rc<DxvkImage> image = dynamic_cast<DxvkImage*>(e.resource.ptr());
       Rc<DxvkBuffer> buffer = dynamic_cast<DxvkBuffer*>(e.resource.ptr());
 
@@ -7814,6 +7834,9 @@ namespace dxvk {
     if (bufferInfos.empty() && imageInfos.empty())
       return;
 
+    m_relocationBudget -= std::min(m_relocationBudget, relocatedSize);
+    m_device->addStatCtr(DxvkStatCounter::MemoryDefragBytes, relocatedSize);
+
     // If there are any resources to relocate, we have to stall the transfer
     // queue so that subsequent resource uploads do not overlap with resource
     // copies on the graphics timeline.
@@ -7833,6 +7856,12 @@ namespace dxvk {
   }
 
 
+  void DxvkContext::refillRelocationBudget() {
+    m_relocationBudget = m_device->config().memoryDefragBudget;
+    m_relocationBudgetTime = high_resolution_clock::now();
+  }
+
+
   Rc<DxvkSampler> DxvkContext::createBlitSampler(
           VkFilter                    filter) {
     DxvkSamplerKey samplerKey;
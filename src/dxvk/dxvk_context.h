@@ -1348,6 +1348,9 @@ namespace dxvk {
 
     uint64_t                m_trackingId = 0u;
     uint32_t                m_renderPassIndex = 0u;
+
+    VkDeviceSize            m_relocationBudget = 0u;
+    high_resolution_clock::time_point m_relocationBudgetTime = { };
     
     Rc<DxvkCommandList>     m_cmd;
     Rc<DxvkBuffer>          m_zeroBuffer;
@@ -1817,6 +1820,8 @@ namespace dxvk {
 
     void relocateQueuedResources();
 
+    void refillRelocationBudget();
+
     Rc<DxvkSampler> createBlitSampler(
             VkFilter                  filter);
 
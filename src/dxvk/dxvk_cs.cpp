@@ -18,6 +18,33 @@ namespace dxvk {
 
 
   void DxvkCsChunk::executeAll(DxvkContext* ctx) {
+    executeCommands([ctx] (DxvkCsCmd* cmd) {
+      cmd->exec(ctx);
+    });
+  }
+
+
+  void DxvkCsChunk::executeAll(DxvkContext* ctx, DxvkCsTraceWriter& trace) {
+    size_t index = 0u;
+
+    executeCommands([this, ctx, &trace, &index] (DxvkCsCmd* cmd) {
+      auto t0 = dxvk::high_resolution_clock::now();
+      cmd->exec(ctx);
+      auto t1 = dxvk::high_resolution_clock::now();
+
+      uint32_t type = index < m_traceTypes.size()
+        ? m_traceTypes[index] : DxvkCsTraceWriter::UnknownType;
+
+      trace.recordCommand(type,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0));
+
+      index += 1u;
+    });
+  }
+
+
+  template<typename Fn>
+  void DxvkCsChunk::executeCommands(const Fn& fn) {
     auto cmd = m_head;
     
     if (m_flags.test(DxvkCsChunkFlag::SingleUse)) {
@@ -25,16 +52,18 @@ namespace dxvk {
       
       while (cmd != nullptr) {
         auto next = cmd->next();
-        cmd->exec(ctx);
+        fn(cmd);
         cmd->~DxvkCsCmd();
         cmd = next;
       }
 
       m_head = nullptr;
       m_next = &m_head;
+
+      m_traceTypes.clear();
     } else {
       while (cmd != nullptr) {
-        cmd->exec(ctx);
+        fn(cmd);
         cmd = cmd->next();
       }
     }
@@ -54,28 +83,111 @@ namespace dxvk {
     m_next = &m_head;
 
     m_commandOffset = 0;
+
+    m_traceTypes.clear();
   }
   
   
-  DxvkCsChunkPool::DxvkCsChunkPool() {
-    
+  static std::atomic<uint64_t> g_chunkPoolId = { 0u };
+
+  /// Live chunk pools by ID. Used by exiting threads to check
+  /// whether the pools they hold cached chunks for still exist.
+  static dxvk::mutex g_chunkPoolMutex;
+  static std::unordered_map<uint64_t, DxvkCsChunkPool*> g_chunkPools;
+
+
+  /**
+   * \brief Thread-local list of chunk caches
+   *
+   * Stores one cache per pool that the thread has used, and
+   * returns cached chunks to their pools on thread exit.
+   */
+  struct DxvkCsChunkPool::ThreadCacheList {
+    struct Entry {
+      uint64_t      poolId;
+      ThreadCache*  cache;
+    };
+
+    std::vector<Entry> entries;
+
+    ~ThreadCacheList() {
+      std::lock_guard lock(g_chunkPoolMutex);
+
+      for (const auto& e : entries) {
+        auto pool = g_chunkPools.find(e.poolId);
+
+        if (pool != g_chunkPools.end())
+          pool->second->releaseThreadCache(e.cache);
+      }
+    }
+
+    void add(uint64_t poolId, ThreadCache* cache) {
+      std::lock_guard lock(g_chunkPoolMutex);
+
+      // Drop entries for pools that no longer exist. Pool IDs
+      // are never reused, and the caches have already been
+      // freed along with the pool, so this is safe.
+      for (size_t i = 0; i < entries.size(); ) {
+        if (g_chunkPools.find(entries[i].poolId) == g_chunkPools.end()) {
+          entries[i] = entries.back();
+          entries.pop_back();
+        } else {
+          i++;
+        }
+      }
+
+      entries.push_back({ poolId, cache });
+    }
+  };
+
+
+  DxvkCsChunkPool::DxvkCsChunkPool(DxvkDevice* device)
+  : m_device(device), m_poolId(++g_chunkPoolId) {
+    std::lock_guard lock(g_chunkPoolMutex);
+    g_chunkPools.insert({ m_poolId, this });
   }
   
   
   DxvkCsChunkPool::~DxvkCsChunkPool() {
-    for (DxvkCsChunk* chunk : m_chunks)
-      delete chunk;
+    { std::lock_guard lock(g_chunkPoolMutex);
+      g_chunkPools.erase(m_poolId);
+    }
+
+    for (const auto& magazine : m_magazines) {
+      for (uint32_t i = 0; i < magazine.count; i++)
+        delete magazine.chunks[i];
+    }
+
+    for (const auto& cache : m_threadCaches) {
+      for (uint32_t i = 0; i < cache->magazine.count; i++)
+        delete cache->magazine.chunks[i];
+    }
   }
   
   
   DxvkCsChunk* DxvkCsChunkPool::allocChunk(DxvkCsChunkFlags flags) {
+    ThreadCache* cache = getThreadCache();
     DxvkCsChunk* chunk = nullptr;
 
-    { std::lock_guard<dxvk::mutex> lock(m_mutex);
-      
-      if (m_chunks.size() != 0) {
-        chunk = m_chunks.back();
-        m_chunks.pop_back();
+    if (likely(cache->magazine.count)) {
+      chunk = cache->magazine.chunks[--cache->magazine.count];
+      cache->hits += 1u;
+    } else {
+      // Grab a full batch of chunks from the shared list. Also
+      // report stats here to avoid touching the stat counters
+      // every time a chunk gets allocated.
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+      if (!m_magazines.empty()) {
+        cache->magazine = m_magazines.back();
+        m_magazines.pop_back();
+
+        chunk = cache->magazine.chunks[--cache->magazine.count];
+      }
+
+      if (m_device) {
+        m_device->addStatCtr(DxvkStatCounter::CsChunkPoolHits, std::exchange(cache->hits, 0u));
+        m_device->addStatCtr(DxvkStatCounter::CsChunkPoolMisses, 1u);
       }
     }
     
@@ -89,184 +201,287 @@ namespace dxvk {
   
   void DxvkCsChunkPool::freeChunk(DxvkCsChunk* chunk) {
     chunk->reset();
-    
+
+    ThreadCache* cache = getThreadCache();
+
+    if (unlikely(cache->magazine.count == MagazineSize)) {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      m_magazines.push_back(cache->magazine);
+
+      cache->magazine.count = 0u;
+    }
+
+    cache->magazine.chunks[cache->magazine.count++] = chunk;
+  }
+
+
+  DxvkCsChunkPool::ThreadCache* DxvkCsChunkPool::getThreadCache() {
+    static thread_local ThreadCacheList t_caches;
+
+    // Threads rarely use more than a couple of pools,
+    // so a linear search is faster than any hash map
+    for (const auto& e : t_caches.entries) {
+      if (likely(e.poolId == m_poolId))
+        return e.cache;
+    }
+
+    ThreadCache* cache = createThreadCache();
+    t_caches.add(m_poolId, cache);
+    return cache;
+  }
+
+
+  DxvkCsChunkPool::ThreadCache* DxvkCsChunkPool::createThreadCache() {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+    return m_threadCaches.emplace_back(std::make_unique<ThreadCache>()).get();
+  }
+
+
+  void DxvkCsChunkPool::releaseThreadCache(
+          ThreadCache*              cache) {
     std::lock_guard<dxvk::mutex> lock(m_mutex);
-    m_chunks.push_back(chunk);
+
+    // Make cached chunks available to other threads
+    if (cache->magazine.count)
+      m_magazines.push_back(cache->magazine);
+
+    for (size_t i = 0; i < m_threadCaches.size(); i++) {
+      if (m_threadCaches[i].get() == cache) {
+        m_threadCaches[i] = std::move(m_threadCaches.back());
+        m_threadCaches.pop_back();
+        break;
+      }
+    }
   }
   
   
+  DxvkCsChunkQueue::DxvkCsChunkQueue() {
+    for (uint64_t i = 0; i < Capacity; i++)
+      m_cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+
+  DxvkCsChunkQueue::~DxvkCsChunkQueue() {
+
+  }
+
+
+  bool DxvkCsChunkQueue::tryPush(
+          DxvkCsChunkRef&         chunk,
+          uint64_t                seq,
+          uint64_t&               ticket) {
+    uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+    while (true) {
+      Cell& cell = m_cells[pos % Capacity];
+
+      int64_t diff = int64_t(cell.seq.load(std::memory_order_acquire) - pos);
+
+      if (!diff) {
+        // Cell is free, try to reserve it. On failure, this
+        // will update pos to the current enqueue position.
+        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // Cell still holds a chunk from the previous lap
+        return false;
+      } else {
+        // Another producer took the cell in the meantime
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    Cell& cell = m_cells[pos % Capacity];
+    cell.entry.chunk = std::move(chunk);
+    cell.entry.seq = seq;
+    cell.seq.store(pos + 1u, std::memory_order_release);
+
+    ticket = pos + 1u;
+    return true;
+  }
+
+
+  bool DxvkCsChunkQueue::tryPop(
+          DxvkCsQueuedChunk&      entry,
+          uint64_t&               ticket) {
+    uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    Cell& cell = m_cells[pos % Capacity];
+
+    if (cell.seq.load(std::memory_order_acquire) != pos + 1u)
+      return false;
+
+    entry.chunk = std::move(cell.entry.chunk);
+    entry.seq = cell.entry.seq;
+
+    // Release the cell for the next lap
+    cell.seq.store(pos + Capacity, std::memory_order_release);
+    m_dequeuePos.store(pos + 1u, std::memory_order_release);
+
+    ticket = pos + 1u;
+    return true;
+  }
+
+
   DxvkCsThread::DxvkCsThread(
     const Rc<DxvkDevice>&   device,
     const Rc<DxvkContext>&  context)
   : m_device(device), m_context(context),
+    m_trace(DxvkCsTraceWriter::create()),
     m_thread([this] { threadFunc(); }) {
     
   }
   
   
   DxvkCsThread::~DxvkCsThread() {
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      m_stopped.store(true);
-    }
-    
-    m_condOnAdd.notify_one();
+    m_stopped.store(true);
+    m_parkOnAdd.notify(false);
+
     m_thread.join();
   }
   
   
   uint64_t DxvkCsThread::dispatchChunk(DxvkCsChunkRef&& chunk) {
-    uint64_t seq;
+    // Assign the sequence number and queue the chunk in one go,
+    // otherwise concurrent callers could queue chunks out of order
+    // and the worker would publish sequence numbers going backwards.
+    // Callers are usually serialized anyway, so this is uncontended.
+    std::lock_guard lock(m_dispatchLock);
 
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      seq = ++m_queueOrdered.seqDispatch;
+    uint64_t seq = m_seqDispatch.load(std::memory_order_relaxed) + 1u;
+    pushChunk(DxvkCsQueue::Ordered, std::move(chunk), seq);
 
-      auto& entry = m_queueOrdered.queue.emplace_back();
-      entry.chunk = std::move(chunk);
-      entry.seq = seq;
-
-      m_condOnAdd.notify_one();
-    }
-    
+    m_seqDispatch.store(seq, std::memory_order_release);
     return seq;
   }
 
 
   void DxvkCsThread::injectChunk(DxvkCsQueue queue, DxvkCsChunkRef&& chunk, bool synchronize) {
-    uint64_t timeline = 0u;
-
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      auto& q = getQueue(queue);
-
-      if (synchronize)
-        timeline = ++q.seqDispatch;
-
-      auto& entry = q.queue.emplace_back();
-      entry.chunk = std::move(chunk);
-      entry.seq = timeline;
-
-      m_condOnAdd.notify_one();
-
-      if (queue == DxvkCsQueue::HighPriority) {
-        // Worker will check this flag after executing any
-        // chunk without causing additional lock contention
-        m_hasHighPrio.store(true, std::memory_order_release);
-      }
-    }
+    // Injected chunks do not get a sequence number, instead we wait
+    // for the worker to have processed the chunk's queue position.
+    uint64_t ticket = pushChunk(queue, std::move(chunk), 0u);
 
     if (synchronize) {
-      std::unique_lock<dxvk::mutex> lock(m_counterMutex);
+      auto& counter = m_retired[uint32_t(queue)];
 
-      m_condOnSync.wait(lock, [this, queue, timeline] {
-        return getCounter(queue).load(std::memory_order_acquire) >= timeline;
+      m_parkOnSync.wait([&counter, ticket] {
+        return counter.load(std::memory_order_acquire) >= ticket;
       });
     }
   }
 
 
   void DxvkCsThread::synchronize(uint64_t seq) {
-    // Avoid locking if we know the sync is a no-op, may
+    // Avoid waiting if we know the sync is a no-op, may
     // reduce overhead if this is being called frequently
     if (seq > m_seqOrdered.load(std::memory_order_acquire)) {
-      // We don't need to lock the queue here, if synchronization
-      // happens while another thread is submitting then there is
-      // an inherent race anyway
+      // If synchronization happens while another thread is
+      // submitting then there is an inherent race anyway
       if (seq == SynchronizeAll)
-        seq = m_queueOrdered.seqDispatch;
+        seq = m_seqDispatch.load(std::memory_order_acquire);
 
       auto t0 = dxvk::high_resolution_clock::now();
 
-      { std::unique_lock<dxvk::mutex> lock(m_counterMutex);
-        m_condOnSync.wait(lock, [this, seq] {
-          return m_seqOrdered.load(std::memory_order_acquire) >= seq;
-        });
-      }
+      m_parkOnSync.wait([this, seq] {
+        return m_seqOrdered.load(std::memory_order_acquire) >= seq;
+      });
 
       auto t1 = dxvk::high_resolution_clock::now();
       auto ticks = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
 
-      m_device->addStatCtr(DxvkStatCounter::CsSyncCount, 1);
-      m_device->addStatCtr(DxvkStatCounter::CsSyncTicks, ticks.count());
+      if (m_device) {
+        m_device->addStatCtr(DxvkStatCounter::CsSyncCount, 1);
+        m_device->addStatCtr(DxvkStatCounter::CsSyncTicks, ticks.count());
+      }
     }
   }
+
+
+  uint64_t DxvkCsThread::pushChunk(
+          DxvkCsQueue       queue,
+          DxvkCsChunkRef&&  chunk,
+          uint64_t          seq) {
+    auto& q = getQueue(queue);
+    uint64_t ticket = 0u;
+
+    while (!q.tryPush(chunk, seq, ticket)) {
+      // Queue is full, wait for the worker to catch up. This
+      // should only happen if the app is massively CPU-bound.
+      m_parkOnFull.wait([&q] {
+        return !q.isFull();
+      });
+    }
+
+    m_parkOnAdd.notify(false);
+    return ticket;
+  }
   
   
   void DxvkCsThread::threadFunc() {
     env::setThreadName("dxvk-cs");
 
-    // Local chunk queues, we use two queues and swap between
-    // them in order to potentially reduce lock contention.
-    std::vector<DxvkCsQueuedChunk> ordered;
-    std::vector<DxvkCsQueuedChunk> highPrio;
+    auto isIdle = [this] {
+      return m_queueOrdered.isEmpty()
+          && m_queueHighPrio.isEmpty();
+    };
 
     try {
       while (!m_stopped.load()) {
-        { std::unique_lock<dxvk::mutex> lock(m_mutex);
+        if (unlikely(isIdle())) {
+          // Notifications for processed chunks skip the memory barrier
+          // and may miss threads that were about to park, so make sure
+          // to wake those up before the worker goes to sleep itself.
+          m_parkOnFull.notify(true);
+          m_parkOnSync.notify(true);
 
-          auto pred = [this] { return
-              !m_queueOrdered.queue.empty()
-              || !m_queueHighPrio.queue.empty()
-              || m_stopped.load();
-          };
+          auto t0 = dxvk::high_resolution_clock::now();
 
-          if (unlikely(!pred())) {
-            auto t0 = dxvk::high_resolution_clock::now();
+          m_parkOnAdd.wait([this, &isIdle] {
+            return !isIdle() || m_stopped.load();
+          });
 
-            m_condOnAdd.wait(lock, [&] {
-              return pred();
-            });
+          auto t1 = dxvk::high_resolution_clock::now();
 
-            auto t1 = dxvk::high_resolution_clock::now();
+          if (m_device)
             m_device->addStatCtr(DxvkStatCounter::CsIdleTicks, std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count());
-          }
-
-          std::swap(ordered, m_queueOrdered.queue);
-          std::swap(highPrio, m_queueHighPrio.queue);
-
-          m_hasHighPrio.store(false, std::memory_order_release);
+          continue;
         }
 
-        size_t orderedIndex = 0u;
-        size_t highPrioIndex = 0u;
+        // Always drain the high-priority queue first in order
+        // to reduce possible synchronization delays
+        DxvkCsQueue queue = DxvkCsQueue::HighPriority;
 
-        while (highPrioIndex < highPrio.size() || orderedIndex < ordered.size()) {
-          // Re-fill local high-priority queue if the app has queued anything up
-          // in the meantime, we want to reduce possible synchronization delays.
-          if (highPrioIndex >= highPrio.size() && m_hasHighPrio.load(std::memory_order_acquire)) {
-            highPrio.clear();
-            highPrioIndex = 0u;
+        DxvkCsQueuedChunk entry;
+        uint64_t ticket = 0u;
 
-            std::unique_lock<dxvk::mutex> lock(m_mutex);
-            std::swap(highPrio, m_queueHighPrio.queue);
+        if (!m_queueHighPrio.tryPop(entry, ticket)) {
+          queue = DxvkCsQueue::Ordered;
 
-            m_hasHighPrio.store(false, std::memory_order_release);
-          }
+          if (!m_queueOrdered.tryPop(entry, ticket))
+            continue;
+        }
 
-          // Drain high-priority queue first
-          bool isHighPrio = highPrioIndex < highPrio.size();
-          auto& entry = isHighPrio ? highPrio[highPrioIndex++] : ordered[orderedIndex++];
+        // Wake up producers that may be waiting for the queue to drain
+        m_parkOnFull.notifyParked(true);
 
+        if (m_context)
           m_context->addStatCtr(DxvkStatCounter::CsChunkCount, 1);
 
+        if (unlikely(m_trace)) {
+          m_trace->beginChunk(uint32_t(queue));
+          entry.chunk->executeAll(m_context.ptr(), *m_trace);
+        } else {
           entry.chunk->executeAll(m_context.ptr());
+        }
 
-          if (entry.seq) {
-            // Use a separate mutex for the chunk counter, this will only
-            // ever be contested if synchronization is actually necessary.
-            std::lock_guard lock(m_counterMutex);
-
-            auto& counter = isHighPrio ? m_seqHighPrio : m_seqOrdered;
-            counter.store(entry.seq, std::memory_order_release);
-
-            m_condOnSync.notify_one();
-          }
+        // Immediately free the chunk to release
+        // references to any resources held by it
+        entry.chunk = DxvkCsChunkRef();
 
-          // Immediately free the chunk to release
-          // references to any resources held by it
-          entry.chunk = DxvkCsChunkRef();
-        }
+        if (entry.seq)
+          m_seqOrdered.store(entry.seq, std::memory_order_release);
 
-        ordered.clear();
-        highPrio.clear();
+        m_retired[uint32_t(queue)].store(ticket, std::memory_order_release);
+        m_parkOnSync.notifyParked(true);
       }
     } catch (const DxvkError& e) {
       Logger::err("Exception on CS thread!");
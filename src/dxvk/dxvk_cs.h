@@ -1,14 +1,17 @@
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
-#include <queue>
+#include <memory>
+#include <unordered_map>
 
 #include "../util/thread.h"
 
+#include "../util/sync/sync_futex.h"
+
 #include "dxvk_device.h"
 #include "dxvk_context.h"
+#include "dxvk_cs_trace.h"
 
 namespace dxvk {
 
@@ -228,6 +231,10 @@ namespace dxvk {
 
       auto next = new (ptr) FuncType(std::move(command));
       append(next);
+
+      if (unlikely(DxvkCsTraceWriter::isEnabled()))
+        m_traceTypes.push_back(DxvkCsTraceType<T>::getId());
+
       return true;
     }
 
@@ -261,6 +268,9 @@ namespace dxvk {
       auto next = new (ptr) FuncType(std::move(command));
       append(next);
 
+      if (unlikely(DxvkCsTraceWriter::isEnabled()))
+        m_traceTypes.push_back(DxvkCsTraceType<T>::getId());
+
       // Do some cursed pointer math here so that the block can figure out
       // where its data is stored based on its own address. This saves a
       // decent amount of CS chunk memory compared to storing a pointer.
@@ -308,6 +318,17 @@ namespace dxvk {
      * \param [in] ctx The context
      */
     void executeAll(DxvkContext* ctx);
+
+    /**
+     * \brief Executes all commands and records timings
+     *
+     * Behaves like \ref executeAll, but also writes
+     * the type and execution time of each command
+     * to the given trace.
+     * \param [in] ctx The context
+     * \param [in] trace Trace writer
+     */
+    void executeAll(DxvkContext* ctx, DxvkCsTraceWriter& trace);
     
     /**
      * \brief Resets chunk
@@ -326,6 +347,10 @@ namespace dxvk {
     DxvkCsCmd** m_next = &m_head;
 
     DxvkCsChunkFlags m_flags;
+
+    /// Type IDs of all recorded commands, in order.
+    /// Only populated if CS tracing is enabled.
+    std::vector<uint32_t> m_traceTypes;
     
     alignas(64)
     char m_data[DxvkCsChunkSize];
@@ -347,6 +372,9 @@ namespace dxvk {
       *m_next = cmd;
       m_next = cmd->chain();
     }
+
+    template<typename Fn>
+    void executeCommands(const Fn& fn);
     
   };
   
@@ -357,12 +385,20 @@ namespace dxvk {
    * Implements a pool of CS chunks which can be
    * recycled. The goal is to reduce the number
    * of dynamic memory allocations.
+   *
+   * Each thread using the pool has its own cache of chunks, so
+   * that allocating and freeing chunks normally does not touch
+   * any shared state. Chunks are exchanged with a shared list
+   * in batches, which allows chunks freed on the CS thread to
+   * be returned to the threads that allocate them. Threads keep
+   * one cache per pool, and return any cached chunks to their
+   * respective pools when they exit.
    */
   class DxvkCsChunkPool {
-    
+    constexpr static uint32_t MagazineSize = 16u;
   public:
     
-    DxvkCsChunkPool();
+    DxvkCsChunkPool(DxvkDevice* device);
     ~DxvkCsChunkPool();
     
     DxvkCsChunkPool             (const DxvkCsChunkPool&) = delete;
@@ -387,9 +423,33 @@ namespace dxvk {
     void freeChunk(DxvkCsChunk* chunk);
     
   private:
-    
+
+    struct Magazine {
+      uint32_t                                count = 0u;
+      std::array<DxvkCsChunk*, MagazineSize>  chunks = { };
+    };
+
+    struct ThreadCache {
+      Magazine  magazine = { };
+      uint64_t  hits = 0u;
+    };
+
+    struct ThreadCacheList;
+
+    DxvkDevice*               m_device;
+    uint64_t                  m_poolId;
+
     dxvk::mutex               m_mutex;
-    std::vector<DxvkCsChunk*> m_chunks;
+    std::vector<Magazine>     m_magazines;
+
+    std::vector<std::unique_ptr<ThreadCache>> m_threadCaches;
+
+    ThreadCache* getThreadCache();
+
+    ThreadCache* createThreadCache();
+
+    void releaseThreadCache(
+            ThreadCache*              cache);
     
   };
   
@@ -451,6 +511,10 @@ namespace dxvk {
     DxvkCsChunk* operator -> () const {
       return m_chunk;
     }
+
+    DxvkCsChunk* ptr() const {
+      return m_chunk;
+    }
     
     explicit operator bool () const {
       return m_chunk != nullptr;
@@ -495,12 +559,86 @@ namespace dxvk {
   /**
    * \brief Chunk queue
    *
-   * Stores queued chunks as well as the sequence
-   * counters for synchronization.
+   * Bounded lock-free queue that supports any number of producers
+   * and a single consumer. Each cell stores a sequence number that
+   * indicates whether it is ready to be written or read, so that
+   * producers only ever contend on the enqueue position.
    */
-  struct DxvkCsChunkQueue {
-    std::vector<DxvkCsQueuedChunk> queue;
-    uint64_t                       seqDispatch = 0u;
+  class DxvkCsChunkQueue {
+    constexpr static uint64_t Capacity = 1024u;
+  public:
+
+    DxvkCsChunkQueue();
+
+    ~DxvkCsChunkQueue();
+
+    /**
+     * \brief Tries to add a chunk to the queue
+     *
+     * Fails if the queue is full, in which case
+     * the chunk reference remains unchanged.
+     * \param [in] chunk Chunk to add
+     * \param [in] seq Sequence number of the chunk
+     * \param [out] ticket Position of the chunk in
+     *    the queue, plus one. Only valid on success.
+     * \returns \c true if the chunk was added
+     */
+    bool tryPush(
+            DxvkCsChunkRef&         chunk,
+            uint64_t                seq,
+            uint64_t&               ticket);
+
+    /**
+     * \brief Tries to remove the oldest chunk from the queue
+     *
+     * Must only be called from the consumer thread.
+     * \param [out] entry Chunk entry
+     * \param [out] ticket Position of the chunk in the
+     *    queue plus one, as returned by \c tryPush.
+     * \returns \c true if a chunk was removed
+     */
+    bool tryPop(
+            DxvkCsQueuedChunk&      entry,
+            uint64_t&               ticket);
+
+    /**
+     * \brief Checks whether the queue is empty
+     *
+     * Must only be called from the consumer thread. May return
+     * \c true if a producer has reserved a cell but has not
+     * written the chunk yet.
+     * \returns \c true if no chunk can be removed
+     */
+    bool isEmpty() const {
+      uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+      return m_cells[pos % Capacity].seq.load(std::memory_order_acquire) != pos + 1u;
+    }
+
+    /**
+     * \brief Checks whether the queue is full
+     * \returns \c true if all cells are in use
+     */
+    bool isFull() const {
+      return m_enqueuePos.load(std::memory_order_relaxed)
+          >= m_dequeuePos.load(std::memory_order_acquire) + Capacity;
+    }
+
+  private:
+
+    struct Cell {
+      std::atomic<uint64_t> seq = { 0u };
+      DxvkCsQueuedChunk     entry = { };
+    };
+
+    alignas(CACHE_LINE_SIZE)
+    std::atomic<uint64_t>         m_enqueuePos = { 0u };
+
+    alignas(CACHE_LINE_SIZE)
+    std::atomic<uint64_t>         m_dequeuePos = { 0u };
+
+    alignas(CACHE_LINE_SIZE)
+    std::array<Cell, Capacity>    m_cells;
+
   };
 
 
@@ -509,6 +647,10 @@ namespace dxvk {
    * 
    * Spawns a thread that will execute
    * commands on a DXVK context. 
+   *
+   * The device and context may be \c nullptr, in which case no
+   * statistics are gathered and commands receive a null context.
+   * This is only useful to measure dispatch overhead in isolation.
    */
   class DxvkCsThread {
 
@@ -526,6 +668,8 @@ namespace dxvk {
      * 
      * Can be used to efficiently play back large
      * command lists recorded on another thread.
+     * Sequence numbers are assigned in the order
+     * in which chunks get added to the queue.
      * \param [in] chunk The chunk to dispatch
      * \returns Sequence number of the submission
      */
@@ -574,23 +718,30 @@ namespace dxvk {
     Rc<DxvkDevice>              m_device;
     Rc<DxvkContext>             m_context;
 
+    /// Sequence number of the last dispatched chunk. Only
+    /// written while holding the dispatch lock, so that the
+    /// queue order always matches the sequence number order.
     alignas(CACHE_LINE_SIZE)
-    dxvk::mutex                 m_counterMutex;
+    dxvk::mutex                 m_dispatchLock;
+    std::atomic<uint64_t>       m_seqDispatch = { 0u };
 
-    std::atomic<uint64_t>       m_seqHighPrio = { 0u };
+    /// Sequence number of the last executed chunk, and number
+    /// of executed chunks per queue. Only written by the worker.
+    alignas(CACHE_LINE_SIZE)
     std::atomic<uint64_t>       m_seqOrdered  = { 0u };
+    std::array<std::atomic<uint64_t>, 2> m_retired = { };
 
     std::atomic<bool>           m_stopped     = { false };
-    std::atomic<bool>           m_hasHighPrio = { false };
 
-    alignas(CACHE_LINE_SIZE)
-    dxvk::mutex                 m_mutex;
-    dxvk::condition_variable    m_condOnAdd;
-    dxvk::condition_variable    m_condOnSync;
+    sync::ParkingSpot           m_parkOnAdd;
+    sync::ParkingSpot           m_parkOnSync;
+    sync::ParkingSpot           m_parkOnFull;
 
     DxvkCsChunkQueue            m_queueOrdered;
     DxvkCsChunkQueue            m_queueHighPrio;
 
+    std::unique_ptr<DxvkCsTraceWriter> m_trace;
+
     dxvk::thread                m_thread;
 
     auto& getQueue(DxvkCsQueue which) {
@@ -598,10 +749,10 @@ namespace dxvk {
         ? m_queueOrdered : m_queueHighPrio;
     }
 
-    auto& getCounter(DxvkCsQueue which) {
-      return which == DxvkCsQueue::Ordered
-        ? m_seqOrdered : m_seqHighPrio;
-    }
+    uint64_t pushChunk(
+            DxvkCsQueue       queue,
+            DxvkCsChunkRef&&  chunk,
+            uint64_t          seq);
 
     void threadFunc();
     
@@ -0,0 +1,173 @@
+#include <atomic>
+
+#include "dxvk_cs_trace.h"
+
+#include "../util/log/log.h"
+
+#include "../util/thread.h"
+#include "../util/util_env.h"
+#include "../util/util_string.h"
+
+namespace dxvk {
+
+  /** Flush buffered records once this many bytes are pending */
+  constexpr size_t TraceFlushThreshold = 1u << 20;
+
+
+  struct DxvkCsTraceTypeRegistry {
+    dxvk::mutex               mutex;
+    std::vector<std::string>  names;
+  };
+
+
+  static DxvkCsTraceTypeRegistry& getTypeRegistry() {
+    static DxvkCsTraceTypeRegistry s_registry;
+    return s_registry;
+  }
+
+
+  static std::string getTypeNameFromSignature(const std::string& signature) {
+    // GCC and Clang: "... getSignature() [with T = Name]"
+    size_t begin = signature.find("T = ");
+    size_t end = signature.rfind(']');
+
+    if (begin != std::string::npos && end != std::string::npos && end > begin)
+      return signature.substr(begin + 4u, end - begin - 4u);
+
+    // MSVC: "... DxvkCsTraceType<Name>::getSignature(void)"
+    begin = signature.find("DxvkCsTraceType<");
+    end = signature.rfind(">::getSignature");
+
+    if (begin != std::string::npos && end != std::string::npos && end > begin)
+      return signature.substr(begin + 16u, end - begin - 16u);
+
+    return signature;
+  }
+
+
+  const bool DxvkCsTraceWriter::s_enabled = !env::getEnvVar("DXVK_CS_TRACE_PATH").empty();
+
+
+  DxvkCsTraceWriter::DxvkCsTraceWriter(const std::string& path)
+  : m_file(path, util::FileFlags(util::FileFlag::AllowWrite, util::FileFlag::Truncate)),
+    m_startTime(high_resolution_clock::now()) {
+    if (!m_file) {
+      Logger::warn(str::format("Failed to create CS trace file: ", path));
+      return;
+    }
+
+    Logger::info(str::format("Writing CS trace to ", path));
+
+    DxvkCsTraceHeader header = { };
+    header.magic = { 'D', 'X', 'C', 'S' };
+    header.version = Version;
+
+    writeData(sizeof(header), &header);
+  }
+
+
+  DxvkCsTraceWriter::~DxvkCsTraceWriter() {
+    flush();
+  }
+
+
+  void DxvkCsTraceWriter::beginChunk(uint32_t queue) {
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      high_resolution_clock::now() - m_startTime);
+
+    writeRecord(DxvkCsTraceRecordType::Chunk, queue, timestamp.count());
+
+    if (m_buffer.size() >= TraceFlushThreshold)
+      flush();
+  }
+
+
+  void DxvkCsTraceWriter::recordCommand(
+          uint32_t                  type,
+          std::chrono::nanoseconds  duration) {
+    if (type == UnknownType)
+      return;
+
+    if (type >= m_types.size())
+      m_types.resize(type + 1u);
+
+    if (!m_types[type]) {
+      m_types[type] = true;
+
+      std::string name = getTypeName(type);
+      writeRecord(DxvkCsTraceRecordType::CommandType, type, name.size());
+      writeData(name.size(), name.data());
+    }
+
+    writeRecord(DxvkCsTraceRecordType::Command, type, duration.count());
+  }
+
+
+  uint32_t DxvkCsTraceWriter::registerType(const char* signature) {
+    auto& registry = getTypeRegistry();
+
+    std::lock_guard lock(registry.mutex);
+    registry.names.push_back(getTypeNameFromSignature(signature));
+    return uint32_t(registry.names.size() - 1u);
+  }
+
+
+  std::string DxvkCsTraceWriter::getTypeName(uint32_t type) {
+    auto& registry = getTypeRegistry();
+
+    std::lock_guard lock(registry.mutex);
+    return type < registry.names.size() ? registry.names[type] : std::string();
+  }
+
+
+  std::unique_ptr<DxvkCsTraceWriter> DxvkCsTraceWriter::create() {
+    static std::string s_path = env::getEnvVar("DXVK_CS_TRACE_PATH");
+    static std::atomic<uint32_t> s_counter = { 0u };
+
+    if (s_path.empty())
+      return nullptr;
+
+    std::string path = str::format(s_path, "/",
+      env::getExeBaseName(), "_", ++s_counter, ".dxcs");
+
+    auto writer = std::make_unique<DxvkCsTraceWriter>(path);
+
+    if (!writer->m_file)
+      return nullptr;
+
+    return writer;
+  }
+
+
+  void DxvkCsTraceWriter::writeRecord(
+          DxvkCsTraceRecordType     type,
+          uint32_t                  index,
+          uint64_t                  data) {
+    DxvkCsTraceRecord record = { };
+    record.type = type;
+    record.index = index;
+    record.data = data;
+
+    writeData(sizeof(record), &record);
+  }
+
+
+  void DxvkCsTraceWriter::writeData(
+          size_t                    size,
+    const void*                     data) {
+    auto ptr = reinterpret_cast<const char*>(data);
+    m_buffer.insert(m_buffer.end(), ptr, ptr + size);
+  }
+
+
+  void DxvkCsTraceWriter::flush() {
+    if (m_buffer.empty())
+      return;
+
+    if (m_file && !m_file.append(m_buffer.size(), m_buffer.data()))
+      Logger::warn("Failed to write CS trace");
+
+    m_buffer.clear();
+  }
+
+}
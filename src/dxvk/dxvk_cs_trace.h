@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../util/util_file.h"
+#include "../util/util_time.h"
+
+namespace dxvk {
+
+  /**
+   * \brief CS trace record type
+   */
+  enum class DxvkCsTraceRecordType : uint32_t {
+    CommandType = 0,  ///< Declares a command type. Followed by the type name.
+    Chunk       = 1,  ///< Marks the start of a chunk
+    Command     = 2,  ///< Executed command
+  };
+
+
+  /**
+   * \brief CS trace file header
+   */
+  struct DxvkCsTraceHeader {
+    std::array<char, 4> magic;
+    uint32_t            version;
+  };
+
+
+  /**
+   * \brief CS trace record
+   *
+   * Meaning of the fields depends on the record type:
+   * - \c CommandType: \c index is the type index, and \c data
+   *   is the length of the type name that follows the record.
+   * - \c Chunk: \c index is the queue the chunk was submitted to,
+   *   and \c data is the time since tracing started, in ns.
+   * - \c Command: \c index is the type index, and \c data is
+   *   the CPU time taken to execute the command, in ns.
+   *
+   * Type indices are only unique within a single trace file.
+   */
+  struct DxvkCsTraceRecord {
+    DxvkCsTraceRecordType type;
+    uint32_t              index;
+    uint64_t              data;
+  };
+
+
+  /**
+   * \brief CS trace writer
+   *
+   * Records the type and CPU execution time of each command
+   * executed on a CS thread, so that backend CPU overhead can
+   * be analyzed offline. Commands are identified by the type
+   * of the function object that implements them, which in
+   * practice identifies the place they were recorded from.
+   *
+   * Command arguments and resource contents are not recorded.
+   * Replaying a trace reproduces the chunk and command stream
+   * with the recorded execution times, which is useful to
+   * measure the overhead of the CS layer itself.
+   */
+  class DxvkCsTraceWriter {
+
+  public:
+
+    constexpr static uint32_t Version = 2u;
+
+    /** Type ID of commands recorded while tracing was disabled */
+    constexpr static uint32_t UnknownType = ~0u;
+
+    DxvkCsTraceWriter(const std::string& path);
+
+    ~DxvkCsTraceWriter();
+
+    /**
+     * \brief Checks whether tracing is enabled
+     *
+     * Command types are only recorded if this is \c true.
+     * \returns \c true if \c DXVK_CS_TRACE_PATH is set
+     */
+    static bool isEnabled() {
+      return s_enabled;
+    }
+
+    /**
+     * \brief Registers a command type
+     *
+     * \param [in] signature Function signature that
+     *    contains the name of the command type
+     * \returns Unique type ID
+     */
+    static uint32_t registerType(const char* signature);
+
+    /**
+     * \brief Queries name of a registered command type
+     *
+     * \param [in] type Type ID
+     * \returns Command type name
+     */
+    static std::string getTypeName(uint32_t type);
+
+    /**
+     * \brief Records start of a chunk
+     * \param [in] queue Queue index
+     */
+    void beginChunk(uint32_t queue);
+
+    /**
+     * \brief Records an executed command
+     *
+     * \param [in] type Command type ID
+     * \param [in] duration Execution time
+     */
+    void recordCommand(
+            uint32_t                  type,
+            std::chrono::nanoseconds  duration);
+
+    /**
+     * \brief Creates trace writer if requested
+     *
+     * Tracing is enabled by setting \c DXVK_CS_TRACE_PATH to
+     * the directory that trace files should be written to.
+     * \returns Trace writer, or \c nullptr if disabled
+     */
+    static std::unique_ptr<DxvkCsTraceWriter> create();
+
+  private:
+
+    static const bool             s_enabled;
+
+    util::File                    m_file;
+    high_resolution_clock::time_point m_startTime;
+
+    std::vector<char>             m_buffer;
+
+    std::vector<bool>             m_types;
+
+    void writeRecord(
+            DxvkCsTraceRecordType     type,
+            uint32_t                  index,
+            uint64_t                  data);
+
+    void writeData(
+            size_t                    size,
+      const void*                     data);
+
+    void flush();
+
+  };
+
+
+
+  /**
+   * \brief CS command type
+   *
+   * Assigns a unique ID to each command type the first time a
+   * command of that type gets recorded with tracing enabled.
+   * The type name is taken from the function signature so
+   * that tracing does not depend on RTTI.
+   * \tparam T Function object type
+   */
+  template<typename T>
+  class DxvkCsTraceType {
+
+  public:
+
+    /**
+     * \brief Queries type ID
+     * \returns Type ID
+     */
+    static uint32_t getId() {
+      static const uint32_t s_id = DxvkCsTraceWriter::registerType(getSignature());
+      return s_id;
+    }
+
+  private:
+
+    static const char* getSignature() {
+#ifdef _MSC_VER
+      return __FUNCSIG__;
+#else
+      return __PRETTY_FUNCTION__;
+#endif
+    }
+
+  };
+
+}
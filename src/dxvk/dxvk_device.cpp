@@ -38,7 +38,7 @@ namespace dxvk {
     determineShaderOptions();
 
     if (env::getEnvVar("DXVK_SHADER_CACHE") != "0" && DxvkShader::getShaderDumpPath().empty())
-      m_shaderCache = DxvkShaderCache::getInstance();
+      m_shaderCache = DxvkShaderCache::getInstance(m_options.maxShaderCacheSize);
   }
   
   
@@ -494,6 +494,8 @@ namespace dxvk {
     result.setCtr(DxvkStatCounter::PipeCountCompute,  pipe.numComputePipelines);
     result.setCtr(DxvkStatCounter::PipeTasksDone,     workers.tasksCompleted);
     result.setCtr(DxvkStatCounter::PipeTasksTotal,    workers.tasksTotal);
+    result.setCtr(DxvkStatCounter::PipeTasksQueued,   workers.tasksQueued);
+    result.setCtr(DxvkStatCounter::PipeTasksStolen,   workers.tasksStolen);
     result.setCtr(DxvkStatCounter::GpuIdleTicks,      m_submissionQueue.gpuIdleTicks());
 
     std::lock_guard<sync::Spinlock> lock(m_statLock);
@@ -508,9 +510,14 @@ namespace dxvk {
     const Rc<DxvkIrShaderConverter>&      converter) {
     Rc<DxvkIrShader> shader = nullptr;
 
-    if (m_shaderCache && !converter)
+    if (m_shaderCache && !converter) {
       shader = m_shaderCache->lookupShader(name, createInfo);
 
+      addStatCtr(shader
+        ? DxvkStatCounter::ShaderCacheHits
+        : DxvkStatCounter::ShaderCacheMisses, 1u);
+    }
+
     if (!shader && converter) {
       shader = new DxvkIrShader(createInfo, converter);
 
@@ -1151,6 +1151,18 @@ namespace dxvk {
     // pipeline, and that no pipelines get destroyed afterwards.
     std::unique_lock<dxvk::mutex> lock(m_mutex);
     m_useCount += 1;
+
+    if (likely(m_deferredStates.empty()))
+      return;
+
+    // The pipeline is in use again, queue up any optimized
+    // pipelines that were skipped while it was out of use.
+    std::vector<DxvkGraphicsPipelineStateInfo> states;
+    std::swap(states, m_deferredStates);
+    lock.unlock();
+
+    for (const auto& state : states)
+      m_workers->compileGraphicsPipeline(this, state, DxvkPipelinePriority::Low);
   }
 
 
@@ -1166,8 +1178,9 @@ namespace dxvk {
       if (m_device->config().enableGraphicsPipelineLibrary == Tristate::True)
         return;
 
-      // Exit early if there's nothing to do
-      if (m_basePipelines.empty())
+      // Exit early if there's nothing to do. Instances whose optimized
+      // pipeline got deferred still need their base pipelines.
+      if (m_basePipelines.empty() || !m_deferredStates.empty())
         return;
 
       // Remove any base pipeline references, but
@@ -1182,6 +1195,32 @@ namespace dxvk {
   }
 
 
+  bool DxvkGraphicsPipeline::deferPipeline(
+    const DxvkGraphicsPipelineStateInfo& state) {
+    if (!m_device->mustTrackPipelineLifetime())
+      return false;
+
+    // Only defer pipelines that can fall back to a base pipeline. This
+    // notably excludes pipelines compiled ahead of time from the state
+    // cache, which are not expected to be in use yet.
+    DxvkGraphicsPipelineInstance* instance = this->findInstance(state);
+
+    if (!instance || !instance->baseHandle.load(std::memory_order_acquire))
+      return false;
+
+    // The calling task holds a use reference, so the base pipeline
+    // cannot get destroyed until it is released, and any context that
+    // starts using the pipeline again will see the deferred state.
+    std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+    if (m_useCount > 1u)
+      return false;
+
+    m_deferredStates.push_back(state);
+    return true;
+  }
+
+
   DxvkGraphicsPipelineInstance* DxvkGraphicsPipeline::createInstance(
     const DxvkGraphicsPipelineStateInfo& state,
           bool                           doCreateBasePipeline) {
@@ -577,6 +577,19 @@ namespace dxvk {
      */
     void releasePipeline();
 
+    /**
+     * \brief Defers compiling an optimized pipeline
+     *
+     * Must be called by a pipeline worker that holds a use
+     * reference. If nothing else uses the pipeline, the state
+     * is recorded and queued again once the pipeline gets used
+     * again, and base pipelines are kept alive until then.
+     * \param [in] state Pipeline state
+     * \returns \c true if compilation was deferred
+     */
+    bool deferPipeline(
+      const DxvkGraphicsPipelineStateInfo&    state);
+
     /**
      * \brief Queries debug name for the pipeline
      *
@@ -617,6 +630,8 @@ namespace dxvk {
       DxvkGraphicsPipelineInstance>               m_pipelines;
     uint32_t                                      m_useCount = 0;
 
+    std::vector<DxvkGraphicsPipelineStateInfo>    m_deferredStates;
+
     std::unordered_map<
       DxvkGraphicsPipelineBaseInstanceKey,
       VkPipeline, DxvkHash, DxvkEq>               m_basePipelines;
@@ -712,6 +712,8 @@ namespace dxvk {
     determineBufferUsageFlagsPerMemoryType();
 
     updateMemoryHeapBudgets();
+
+    m_trace = DxvkMemoryTraceWriter::create();
   }
   
   
@@ -773,8 +775,10 @@ namespace dxvk {
       // very large. We will decide what to do if this fails.
       int64_t address = selectedPool.alloc(size, requirements.alignment);
 
-      if (likely(address >= 0))
+      if (likely(address >= 0)) {
+        traceEvent(DxvkMemoryTraceEvent::Alloc, type, selectedPool, address, size, requirements.alignment);
         return createAllocation(type, selectedPool, address, size, allocationInfo);
+      }
 
       // If we're not allowed to allocate additional device memory, move on.
       // Also do not try to revive any chunks marked for defragmentation since
@@ -785,10 +789,14 @@ namespace dxvk {
       // Otherwise, if there are any chunks marked for defragmentation, stop
       // that process and use any available memory for new allocations.
       if (selectedPool.pageAllocator.reviveChunks()) {
+        traceEvent(DxvkMemoryTraceEvent::ChunkEnableAll, type, selectedPool, 0u, 0u);
+
         address = selectedPool.alloc(size, requirements.alignment);
 
-        if (address >= 0)
+        if (address >= 0) {
+          traceEvent(DxvkMemoryTraceEvent::Alloc, type, selectedPool, address, size, requirements.alignment);
           return createAllocation(type, selectedPool, address, size, allocationInfo);
+        }
       }
 
       // If the allocation is very large, use a dedicated allocation instead
@@ -825,6 +833,9 @@ namespace dxvk {
           continue;
 
         mapDeviceMemory(memory, allocationInfo.properties);
+
+        traceEvent(DxvkMemoryTraceEvent::DedicatedAlloc, type,
+          selectedPool, vk::getObjectHandle(memory.memory), memory.size);
         return createAllocation(type, memory, allocationInfo);
       }
 
@@ -837,6 +848,8 @@ namespace dxvk {
 
       if (allocateChunkInPool(type, selectedPool, allocationInfo.properties, size, desiredSize)) {
         address = selectedPool.alloc(size, requirements.alignment);
+
+        traceEvent(DxvkMemoryTraceEvent::Alloc, type, selectedPool, address, size, requirements.alignment);
         return createAllocation(type, selectedPool, address, size, allocationInfo);
       }
     }
@@ -859,6 +872,9 @@ namespace dxvk {
 
       if (likely(memory.memory != VK_NULL_HANDLE)) {
         mapDeviceMemory(memory, allocationInfo.properties);
+
+        traceEvent(DxvkMemoryTraceEvent::DedicatedAlloc, type,
+          memory.mapPtr ? type.mappedPool : type.devicePool, vk::getObjectHandle(memory.memory), memory.size);
         return createAllocation(type, memory, allocationInfo);
       }
     }
@@ -1461,6 +1477,9 @@ namespace dxvk {
     // Add the newly created chunk to the pool
     uint32_t chunkIndex = pool.pageAllocator.addChunk(chunk.size);
 
+    traceEvent(DxvkMemoryTraceEvent::ChunkCreate, type, pool,
+      uint64_t(chunkIndex) << DxvkPageAllocator::ChunkAddressBits, chunk.size);
+
     pool.chunks.resize(std::max<size_t>(pool.chunks.size(), chunkIndex + 1u));
     pool.chunks[chunkIndex].memory = chunk;
     pool.chunks[chunkIndex].unusedTime = high_resolution_clock::time_point();
@@ -1482,6 +1501,7 @@ namespace dxvk {
 
     auto& chunk = pool.chunks[chunkIndex];
     chunk.unusedTime = high_resolution_clock::time_point();
+    chunk.defragTarget = false;
 
     auto allocation = m_allocationPool.create(this, &type);
 
@@ -1593,6 +1613,15 @@ namespace dxvk {
         if (unlikely(allocation->m_flags.test(DxvkAllocationFlag::OwnsMemory))) {
           // We free the actual allocation later, just update stats here.
           allocation->m_type->stats.memoryAllocated -= allocation->m_size;
+
+          if (unlikely(m_trace)) {
+            auto& pool = allocation->m_mapPtr
+              ? allocation->m_type->mappedPool
+              : allocation->m_type->devicePool;
+
+            traceEvent(DxvkMemoryTraceEvent::DedicatedFree, *allocation->m_type,
+              pool, vk::getObjectHandle(allocation->m_memory), allocation->m_size);
+          }
         } else {
           DxvkMemoryPool& pool = allocation->m_mapPtr
             ? allocation->m_type->mappedPool
@@ -1603,6 +1632,9 @@ namespace dxvk {
             pool.chunks[chunkIndex].removeAllocation(allocation);
           }
 
+          traceEvent(DxvkMemoryTraceEvent::Free, *allocation->m_type,
+            pool, allocation->m_address, allocation->m_size);
+
           if (unlikely(pool.free(allocation->m_address, allocation->m_size))) {
             uint32_t chunkIndex = allocation->m_address >> DxvkPageAllocator::ChunkAddressBits;
             pool.chunks[chunkIndex].canMove = true;
@@ -1647,6 +1679,9 @@ namespace dxvk {
       // still own the memory, so make sure to release it here.
       allocation->m_type->stats.memoryUsed -= allocation->m_size;
 
+      traceEvent(DxvkMemoryTraceEvent::Free, *allocation->m_type,
+        pool, allocation->m_address, allocation->m_size);
+
       if (unlikely(pool.free(allocation->m_address, allocation->m_size))) {
         if (freeEmptyChunksInPool(*allocation->m_type, pool, 0, high_resolution_clock::now()))
           updateMemoryHeapStats(allocation->m_type->properties.heapIndex);
@@ -1728,6 +1763,12 @@ namespace dxvk {
       }
 
       if (shouldFree) {
+        if (chunk.defragTarget)
+          m_device->addStatCtr(DxvkStatCounter::MemoryDefragChunks, 1u);
+
+        traceEvent(DxvkMemoryTraceEvent::ChunkDestroy, type, pool,
+          uint64_t(i) << DxvkPageAllocator::ChunkAddressBits, chunk.memory.size);
+
         freeDeviceMemory(type, chunk.memory);
         heapAllocated -= chunk.memory.size;
 
@@ -1847,6 +1888,9 @@ namespace dxvk {
         if (address < 0)
           break;
 
+        traceEvent(DxvkMemoryTraceEvent::Alloc, memoryType, memoryPool,
+          address, allocationSize, requirements.alignment);
+
         // Add allocation to the list and mark it as cacheable,
         // so it will get recycled as-is after use.
         allocation = createAllocation(memoryType, memoryPool,
@@ -2417,6 +2461,8 @@ namespace dxvk {
         continue;
 
       // Acquired the resource, add it to the relocation list.
+      traceEvent(DxvkMemoryTraceEvent::Relocate, type, pool, a->m_address, a->m_size);
+
       m_relocations.addResource(std::move(resource), a, mode);
     }
   }
@@ -2457,11 +2503,13 @@ namespace dxvk {
         return;
     }
 
-    // Find live chunk with the lowest number of pages used. Skip
-    // empty chunks since the goal here is to turn a used chunk
-    // into an empty one.
+    // Find live chunk with the lowest ratio of used pages to total pages,
+    // which is the cheapest one to free up relative to the amount of memory
+    // it would give back. Skip empty chunks since the goal here is to turn
+    // a used chunk into an empty one.
     uint32_t chunkIndex = 0u;
     uint32_t chunkPages = 0u;
+    uint32_t chunkSize = 0u;
 
     for (uint32_t i = 0; i < pool.chunks.size(); i++) {
       // Mark any empty chunk as dead for now as well so that we don't
@@ -2470,6 +2518,9 @@ namespace dxvk {
 
       if (!pagesUsed) {
         pool.pageAllocator.killChunk(i);
+
+        traceEvent(DxvkMemoryTraceEvent::ChunkDisable, type, pool,
+          uint64_t(i) << DxvkPageAllocator::ChunkAddressBits, 0u);
         continue;
       }
 
@@ -2486,9 +2537,12 @@ namespace dxvk {
         continue;
       }
 
-      if (!chunkPages || pagesUsed < chunkPages) {
+      uint32_t pageCount = pool.pageAllocator.pageCount(i);
+
+      if (!chunkPages || uint64_t(pagesUsed) * chunkSize < uint64_t(chunkPages) * pageCount) {
         chunkIndex = i;
         chunkPages = pagesUsed;
+        chunkSize = pageCount;
       }
     }
 
@@ -2517,15 +2571,24 @@ namespace dxvk {
     // revive it and mark the newly selected one instead so that it can be
     // moved into the previously dead chunk.
     for (uint32_t i = 0; i < pool.chunks.size(); i++) {
-      if (!pool.pageAllocator.chunkIsAvailable(i) && pool.pageAllocator.pagesUsed(i))
+      if (!pool.pageAllocator.chunkIsAvailable(i) && pool.pageAllocator.pagesUsed(i)) {
         pool.pageAllocator.reviveChunk(i);
+        pool.chunks[i].defragTarget = false;
+
+        traceEvent(DxvkMemoryTraceEvent::ChunkEnable, type, pool,
+          uint64_t(i) << DxvkPageAllocator::ChunkAddressBits, 0u);
+      }
     }
 
     // Mark the chunk as dead. If it does not subsequently get reactivated
     // because the game is loading more resources, the next worker iteration
     // will queue all live resources for relocation.
     pool.pageAllocator.killChunk(chunkIndex);
+    pool.chunks[chunkIndex].defragTarget = true;
     pool.nextDefragChunk = chunkIndex;
+
+    traceEvent(DxvkMemoryTraceEvent::ChunkDisable, type, pool,
+      uint64_t(chunkIndex) << DxvkPageAllocator::ChunkAddressBits, 0u);
   }
 
 
@@ -2597,12 +2660,16 @@ namespace dxvk {
         bool evicted = resource->requestEviction();
 
         if (evicted && (heapUsage + minUnusedMemory > heapBudget + memoryEvicted)) {
+          traceEvent(DxvkMemoryTraceEvent::Relocate, type, pool, a->m_address, a->m_size);
+
           m_relocations.addResource(std::move(resource), a, DxvkAllocationMode::NoDeviceMemory);
           memoryEvicted += a->getMemoryInfo().size;
         }
 
         if (!evicted && memoryEvicted) {
           // Relocate other resources within the chunk to reduce fragmentation
+          traceEvent(DxvkMemoryTraceEvent::Relocate, type, pool, a->m_address, a->m_size);
+
           m_relocations.addResource(std::move(resource), a, DxvkAllocationModes(
             DxvkAllocationMode::NoFallback, DxvkAllocationMode::NoAllocation));
         }
@@ -2613,10 +2680,19 @@ namespace dxvk {
       // fragmentation caused evicting a subset of resources from the chunk.
       if (memoryEvicted) {
         pool.pageAllocator.killChunk(chunkIndex);
+        chunk.defragTarget = true;
+
+        traceEvent(DxvkMemoryTraceEvent::ChunkDisable, type, pool,
+          uint64_t(chunkIndex) << DxvkPageAllocator::ChunkAddressBits, 0u);
 
         for (uint32_t i = 0u; i < pool.chunks.size(); i++) {
-          if (i != chunkIndex && pool.pageAllocator.pagesUsed(i))
+          if (i != chunkIndex && pool.pageAllocator.pagesUsed(i)) {
             pool.pageAllocator.reviveChunk(i);
+            pool.chunks[i].defragTarget = false;
+
+            traceEvent(DxvkMemoryTraceEvent::ChunkEnable, type, pool,
+              uint64_t(i) << DxvkPageAllocator::ChunkAddressBits, 0u);
+          }
         }
       }
     }
@@ -8,6 +8,7 @@
 #include "dxvk_allocator.h"
 #include "dxvk_descriptor.h"
 #include "dxvk_hash.h"
+#include "dxvk_memory_trace.h"
 
 #include "../util/util_time.h"
 
@@ -88,6 +89,9 @@ namespace dxvk {
     /// Whether defragmentation can be performed on this chunk.
     /// Only relevant for chunks in non-mappable device memory.
     VkBool32 canMove = true;
+    /// Whether resources are being moved out of this chunk
+    /// in order to free it. Reset when the chunk gets reused.
+    VkBool32 defragTarget = false;
 
     void addAllocation(DxvkResourceAllocation* allocation);
     void removeAllocation(DxvkResourceAllocation* allocation);
@@ -1380,6 +1384,8 @@ namespace dxvk {
 
     uint64_t            m_nextCookie = 0u;
 
+    std::unique_ptr<DxvkMemoryTraceWriter> m_trace;
+
     alignas(CACHE_LINE_SIZE)
     high_resolution_clock::time_point m_taskDeadline = { };
     std::array<DxvkMemoryStats, VK_MAX_MEMORY_HEAPS> m_adapterHeapStats = { };
@@ -1516,6 +1522,19 @@ namespace dxvk {
 
     bool enableDefrag() const;
 
+    force_inline void traceEvent(
+            DxvkMemoryTraceEvent  event,
+      const DxvkMemoryType&       type,
+      const DxvkMemoryPool&       pool,
+            uint64_t              address,
+            uint64_t              size,
+            uint64_t              alignment = 1u) {
+      if (unlikely(m_trace)) {
+        m_trace->recordEvent(event, 2u * type.index + uint32_t(&pool == &type.mappedPool),
+          address, size, alignment);
+      }
+    }
+
   };
   
 
@@ -0,0 +1,95 @@
+#include <atomic>
+
+#include "dxvk_memory_trace.h"
+
+#include "../util/log/log.h"
+
+#include "../util/util_bit.h"
+#include "../util/util_env.h"
+#include "../util/util_string.h"
+
+namespace dxvk {
+
+  /** Flush buffered records once this many are pending */
+  constexpr size_t TraceFlushThreshold = 1u << 15;
+
+
+  DxvkMemoryTraceWriter::DxvkMemoryTraceWriter(const std::string& path)
+  : m_file(path, util::FileFlags(util::FileFlag::AllowWrite, util::FileFlag::Truncate)),
+    m_startTime(high_resolution_clock::now()) {
+    if (!m_file) {
+      Logger::warn(str::format("Failed to create memory trace file: ", path));
+      return;
+    }
+
+    Logger::info(str::format("Writing memory trace to ", path));
+
+    DxvkMemoryTraceHeader header = { };
+    header.magic = { 'D', 'X', 'M', 'T' };
+    header.version = Version;
+
+    if (!m_file.append(sizeof(header), &header))
+      Logger::warn("Failed to write memory trace");
+
+    m_records.reserve(TraceFlushThreshold);
+  }
+
+
+  DxvkMemoryTraceWriter::~DxvkMemoryTraceWriter() {
+    flush();
+  }
+
+
+  void DxvkMemoryTraceWriter::recordEvent(
+          DxvkMemoryTraceEvent      type,
+          uint32_t                  pool,
+          uint64_t                  address,
+          uint64_t                  size,
+          uint64_t                  alignment) {
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      high_resolution_clock::now() - m_startTime);
+
+    auto& record = m_records.emplace_back();
+    record.type = type;
+    record.alignment = alignment > 1u ? uint8_t(bit::tzcnt(alignment)) : 0u;
+    record.pool = uint16_t(pool);
+    record.reserved = 0u;
+    record.timestamp = timestamp.count();
+    record.address = address;
+    record.size = size;
+
+    if (m_records.size() >= TraceFlushThreshold)
+      flush();
+  }
+
+
+  std::unique_ptr<DxvkMemoryTraceWriter> DxvkMemoryTraceWriter::create() {
+    static std::string s_path = env::getEnvVar("DXVK_MEMORY_TRACE_PATH");
+    static std::atomic<uint32_t> s_counter = { 0u };
+
+    if (s_path.empty())
+      return nullptr;
+
+    std::string path = str::format(s_path, "/",
+      env::getExeBaseName(), "_", ++s_counter, ".dxmt");
+
+    auto writer = std::make_unique<DxvkMemoryTraceWriter>(path);
+
+    if (!writer->m_file)
+      return nullptr;
+
+    return writer;
+  }
+
+
+  void DxvkMemoryTraceWriter::flush() {
+    if (m_records.empty())
+      return;
+
+    if (m_file && !m_file.append(m_records.size() * sizeof(DxvkMemoryTraceRecord), m_records.data()))
+      Logger::warn("Failed to write memory trace");
+
+    m_records.clear();
+  }
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "../util/util_file.h"
+#include "../util/util_time.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Memory trace event type
+   */
+  enum class DxvkMemoryTraceEvent : uint8_t {
+    ChunkCreate     = 0,  ///< Chunk added to a pool
+    ChunkDestroy    = 1,  ///< Chunk removed from a pool
+    ChunkDisable    = 2,  ///< Chunk stops accepting allocations
+    ChunkEnable     = 3,  ///< Chunk accepts allocations again
+    ChunkEnableAll  = 4,  ///< All chunks in a pool accept allocations again
+    Alloc           = 5,  ///< Sub-allocation from a pool
+    Free            = 6,  ///< Sub-allocation returned to a pool
+    DedicatedAlloc  = 7,  ///< Dedicated memory allocation
+    DedicatedFree   = 8,  ///< Dedicated memory allocation freed
+    Relocate        = 9,  ///< Sub-allocation queued for relocation
+  };
+
+
+  /**
+   * \brief Memory trace file header
+   */
+  struct DxvkMemoryTraceHeader {
+    std::array<char, 4> magic;
+    uint32_t            version;
+  };
+
+
+  /**
+   * \brief Memory trace record
+   *
+   * The pool index is computed from the memory type index as
+   * <tt>2 * type + mapped</tt>, where \c mapped is 1 for the
+   * pool used for host-visible allocations. Addresses are the
+   * allocator's internal addresses, i.e. the chunk index is
+   * stored in the upper bits as per \c DxvkPageAllocator.
+   * - Chunk events: \c address is the base address of the
+   *   chunk, and \c size is the chunk size for \c ChunkCreate
+   *   and \c ChunkDestroy. Both are 0 for \c ChunkEnableAll.
+   * - \c Alloc, \c Free and \c Relocate: \c address and \c size
+   *   describe the allocation, and \c alignment is the log2 of
+   *   the requested alignment for \c Alloc.
+   * - Dedicated allocations: \c address is the Vulkan memory
+   *   handle, and \c size is the allocation size.
+   */
+  struct DxvkMemoryTraceRecord {
+    DxvkMemoryTraceEvent  type;
+    uint8_t               alignment;
+    uint16_t              pool;
+    uint32_t              reserved;
+    uint64_t              timestamp;
+    uint64_t              address;
+    uint64_t              size;
+  };
+
+
+  /**
+   * \brief Memory trace writer
+   *
+   * Records memory allocator events with timestamps, so that
+   * allocation patterns of real applications can be replayed
+   * offline to analyze fragmentation and allocator performance.
+   * Must only be used while the allocator lock is held.
+   */
+  class DxvkMemoryTraceWriter {
+
+  public:
+
+    constexpr static uint32_t Version = 1u;
+
+    DxvkMemoryTraceWriter(const std::string& path);
+
+    ~DxvkMemoryTraceWriter();
+
+    /**
+     * \brief Records an event
+     *
+     * \param [in] type Event type
+     * \param [in] pool Pool index
+     * \param [in] address Allocation or chunk address
+     * \param [in] size Allocation or chunk size
+     * \param [in] alignment Allocation alignment
+     */
+    void recordEvent(
+            DxvkMemoryTraceEvent      type,
+            uint32_t                  pool,
+            uint64_t                  address,
+            uint64_t                  size,
+            uint64_t                  alignment = 1u);
+
+    /**
+     * \brief Creates trace writer if requested
+     *
+     * Tracing is enabled by setting \c DXVK_MEMORY_TRACE_PATH
+     * to the directory that trace files should be written to.
+     * \returns Trace writer, or \c nullptr if disabled
+     */
+    static std::unique_ptr<DxvkMemoryTraceWriter> create();
+
+  private:
+
+    util::File                    m_file;
+    high_resolution_clock::time_point m_startTime;
+
+    std::vector<DxvkMemoryTraceRecord> m_records;
+
+    void flush();
+
+  };
+
+}
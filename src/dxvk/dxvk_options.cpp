@@ -24,6 +24,12 @@ namespace dxvk {
 
     auto budget = config.getOption<int32_t>("dxvk.maxMemoryBudget", 0);
     maxMemoryBudget = VkDeviceSize(std::max(budget, 0)) << 20u;
+
+    auto defragBudget = config.getOption<int32_t>("dxvk.memoryDefragBudget", 64);
+    memoryDefragBudget = VkDeviceSize(std::max(defragBudget, 1)) << 20u;
+
+    auto cacheSize = config.getOption<int32_t>("dxvk.maxShaderCacheSize", 0);
+    maxShaderCacheSize = uint64_t(std::max(cacheSize, 0)) << 20u;
   }
 
 }
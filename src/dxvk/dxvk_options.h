@@ -66,6 +66,13 @@ namespace dxvk {
     /// Overrides memory budget for DXVK
     VkDeviceSize maxMemoryBudget = 0u;
 
+    /// Maximum amount of memory to relocate per frame
+    /// during defragmentation or eviction
+    VkDeviceSize memoryDefragBudget = 0u;
+
+    /// Maximum size of the shader cache files
+    uint64_t maxShaderCacheSize = 0u;
+
     /// Whether to use custom sin/cos approximation
     Tristate lowerSinCos = Tristate::Auto;
 
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "../util/thread.h"
+
+#include "../util/util_likely.h"
+#include "../util/util_math.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Pipeline priority
+   */
+  enum class DxvkPipelinePriority : uint32_t {
+    High    = 0,
+    Normal  = 1,
+    Low     = 2,
+  };
+
+  /**
+   * \brief Pipeline task queue
+   *
+   * Implements task scheduling for pipeline workers. Each worker
+   * owns one queue per priority, and new tasks are distributed
+   * among the queues of all workers that are allowed to process
+   * the given priority. Workers that run out of work steal tasks
+   * from other workers, always looking for tasks of a higher
+   * priority first, so that producers and workers only rarely
+   * contend for the same lock.
+   *
+   * Does not manage any threads by itself, workers are expected to
+   * call \c pop in a loop until it returns \c false.
+   * \tparam T Task type, must be movable
+   */
+  template<typename T>
+  class DxvkPipelineTaskQueue {
+
+  public:
+
+    /**
+     * \brief Sets up queues for the given worker count
+     *
+     * Must be called exactly once before any tasks are queued.
+     * \param [in] workerCount Number of workers
+     */
+    void init(uint32_t workerCount) {
+      // Number of workers that can process pipeline pipelines with normal
+      // priority. Any other workers can only build high-priority pipelines.
+      uint32_t npWorkerCount = std::max(((workerCount - 1) * 5) / 7, 1u);
+      uint32_t lpWorkerCount = std::max(((workerCount - 1) * 2) / 7, 1u);
+
+      m_workerCounts[uint32_t(DxvkPipelinePriority::High)] = workerCount;
+      m_workerCounts[uint32_t(DxvkPipelinePriority::Normal)] = npWorkerCount;
+      m_workerCounts[uint32_t(DxvkPipelinePriority::Low)] = lpWorkerCount;
+
+      m_workers.reserve(workerCount);
+
+      for (size_t i = 0; i < workerCount; i++) {
+        auto& worker = m_workers.emplace_back(std::make_unique<Worker>());
+        worker->maxPriority = DxvkPipelinePriority::Normal;
+
+        if (i >= npWorkerCount)
+          worker->maxPriority = DxvkPipelinePriority::High;
+        else if (i < lpWorkerCount)
+          worker->maxPriority = DxvkPipelinePriority::Low;
+      }
+    }
+
+    /**
+     * \brief Queries number of workers
+     * \returns Worker count, or 0 if not initialized
+     */
+    uint32_t getWorkerCount() const {
+      return uint32_t(m_workers.size());
+    }
+
+    /**
+     * \brief Queries lowest priority a worker can process
+     *
+     * \param [in] workerIndex Worker index
+     * \returns Lowest priority of tasks processed by the worker
+     */
+    DxvkPipelinePriority getMaxPriority(uint32_t workerIndex) const {
+      return m_workers[workerIndex]->maxPriority;
+    }
+
+    /**
+     * \brief Queries number of queued tasks
+     *
+     * The returned result may be immediately out of date.
+     * \returns Number of tasks that were not yet dequeued
+     */
+    uint64_t getQueuedCount() const {
+      uint64_t result = 0u;
+
+      for (const auto& count : m_tasksPending)
+        result += count.load(std::memory_order_relaxed);
+
+      return result;
+    }
+
+    /**
+     * \brief Queries number of stolen tasks
+     * \returns Number of tasks that were dequeued from
+     *    the queue of a worker other than the one they
+     *    were assigned to.
+     */
+    uint64_t getStolenCount() const {
+      return m_tasksStolen.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Checks whether workers should keep running
+     * \returns \c true if the queue is started
+     */
+    bool isRunning() const {
+      return m_running.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Allows workers to dequeue tasks
+     */
+    void start() {
+      m_running.store(true, std::memory_order_release);
+    }
+
+    /**
+     * \brief Stops workers
+     *
+     * Wakes up all idle workers, and makes any subsequent
+     * \c pop call return \c false. Queued tasks are kept.
+     */
+    void stop() {
+      std::unique_lock lock(m_sleepLock);
+      m_running.store(false);
+
+      for (uint32_t i = 0; i < m_sleepConds.size(); i++)
+        m_sleepConds[i].notify_all();
+    }
+
+    /**
+     * \brief Queues a task
+     *
+     * \param [in] task Task to queue
+     * \param [in] priority Task priority
+     */
+    void push(T&& task, DxvkPipelinePriority priority) {
+      uint32_t priorityIndex = uint32_t(priority);
+
+      // Distribute tasks evenly among all workers that can process
+      // the given priority. Idle workers will steal tasks from busy
+      // ones anyway, this is mostly to reduce lock contention.
+      uint32_t workerIndex = m_nextQueue.fetch_add(1u, std::memory_order_relaxed)
+        % m_workerCounts[priorityIndex];
+
+      // Count the task before making it visible, so that a worker that
+      // pops it right away can never decrement the counter below zero.
+      // This must also be ordered with the idle worker check below so
+      // that workers going to sleep concurrently will either see the
+      // new task or get notified.
+      m_tasksPending[priorityIndex] += 1;
+
+      auto& queue = m_workers[workerIndex]->queues[priorityIndex];
+
+      { std::lock_guard lock(queue.mutex);
+        queue.entries.push_back(std::move(task));
+        queue.size.store(queue.entries.size(), std::memory_order_release);
+      }
+
+      // If any workers are idle in a suitable set, notify the corresponding
+      // condition variable. If all workers are busy anyway, we know that the
+      // job is going to be picked up at some point anyway.
+      for (uint32_t i = priorityIndex; i < m_sleepConds.size(); i++) {
+        if (m_idleWorkers[i].load()) {
+          std::lock_guard lock(m_sleepLock);
+          m_sleepConds[i].notify_one();
+          break;
+        }
+      }
+    }
+
+    /**
+     * \brief Dequeues a task
+     *
+     * Waits until a task that the given worker can process becomes
+     * available, taking higher-priority tasks first and stealing
+     * tasks from other workers as necessary.
+     * \param [in] workerIndex Worker index
+     * \param [out] task Dequeued task
+     * \returns \c false if the queue was stopped
+     */
+    bool pop(uint32_t workerIndex, T& task) {
+      const DxvkPipelinePriority maxPriority = m_workers[workerIndex]->maxPriority;
+      const uint32_t maxPriorityIndex = uint32_t(maxPriority);
+
+      while (m_running.load(std::memory_order_acquire)) {
+        // Skip pending work if the queue gets stopped,
+        // exiting early is more important in this case.
+        if (tryPop(workerIndex, task))
+          return m_running.load(std::memory_order_acquire);
+
+        std::unique_lock lock(m_sleepLock);
+
+        m_idleWorkers[maxPriorityIndex] += 1;
+        m_sleepConds[maxPriorityIndex].wait(lock, [this, maxPriority] {
+          return hasPendingTasks(maxPriority) || !m_running.load();
+        });
+        m_idleWorkers[maxPriorityIndex] -= 1;
+      }
+
+      return false;
+    }
+
+  private:
+
+    struct alignas(CACHE_LINE_SIZE) Queue {
+      dxvk::mutex               mutex;
+      std::deque<T>             entries;
+      std::atomic<uint32_t>     size = { 0u };
+    };
+
+    struct Worker {
+      DxvkPipelinePriority      maxPriority = DxvkPipelinePriority::High;
+      std::array<Queue, 3>      queues;
+    };
+
+    std::atomic<bool>                       m_running     = { false };
+    std::atomic<uint64_t>                   m_tasksStolen = { 0ull };
+
+    alignas(CACHE_LINE_SIZE)
+    std::array<std::atomic<uint32_t>, 3>    m_tasksPending = { };
+    std::atomic<uint32_t>                   m_nextQueue = { 0u };
+
+    /// Number of workers that can process tasks of any
+    /// given priority. Workers are sorted such that all
+    /// workers that can process low-priority tasks come
+    /// first, followed by normal and then high priority.
+    std::array<uint32_t, 3>                 m_workerCounts = { };
+    std::vector<std::unique_ptr<Worker>>    m_workers;
+
+    dxvk::mutex                             m_sleepLock;
+    std::array<dxvk::condition_variable, 3> m_sleepConds;
+    std::array<std::atomic<uint32_t>, 3>    m_idleWorkers = { };
+
+    bool tryPop(uint32_t workerIndex, T& task) {
+      auto& worker = *m_workers[workerIndex];
+
+      // Check queues in order of priority to preserve the ordering guarantees
+      // across workers. Workers are sorted in such a way that any worker that
+      // can process a given priority can also receive tasks of that priority.
+      for (uint32_t i = 0; i <= uint32_t(worker.maxPriority); i++) {
+        if (!m_tasksPending[i].load(std::memory_order_acquire))
+          continue;
+
+        uint32_t workerCount = m_workerCounts[i];
+
+        // Start with the worker's own queue, then try to steal
+        // tasks from subsequent workers to spread out contention
+        for (uint32_t j = 0; j < workerCount; j++) {
+          uint32_t queueIndex = (workerIndex + j) % workerCount;
+
+          if (popQueue(m_workers[queueIndex]->queues[i], task)) {
+            // Only decrement after a successful pop, the task was
+            // counted before it was added to any queue.
+            m_tasksPending[i] -= 1;
+
+            if (j)
+              m_tasksStolen.fetch_add(1u, std::memory_order_relaxed);
+
+            return true;
+          }
+        }
+      }
+
+      return false;
+    }
+
+    bool hasPendingTasks(DxvkPipelinePriority maxPriority) const {
+      for (uint32_t i = 0; i <= uint32_t(maxPriority); i++) {
+        if (m_tasksPending[i].load())
+          return true;
+      }
+
+      return false;
+    }
+
+    static bool popQueue(Queue& queue, T& task) {
+      // Avoid locking queues that are known to be empty
+      if (!queue.size.load(std::memory_order_acquire))
+        return false;
+
+      std::lock_guard lock(queue.mutex);
+
+      if (queue.entries.empty())
+        return false;
+
+      task = std::move(queue.entries.front());
+
+      queue.entries.pop_front();
+      queue.size.store(queue.entries.size(), std::memory_order_release);
+      return true;
+    }
+
+  };
+
+}
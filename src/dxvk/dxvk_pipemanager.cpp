@@ -20,13 +20,9 @@ namespace dxvk {
   void DxvkPipelineWorkers::compilePipelineLibrary(
           DxvkShaderPipelineLibrary*      library,
           DxvkPipelinePriority            priority) {
-    std::unique_lock lock(m_lock);
     this->startWorkers();
 
-    m_tasksTotal += 1;
-
-    m_buckets[uint32_t(priority)].queue.emplace(library);
-    notifyWorkers(priority);
+    enqueueTask(new PipelineTask(library, priority));
   }
 
 
@@ -34,28 +30,25 @@ namespace dxvk {
           DxvkGraphicsPipeline*           pipeline,
     const DxvkGraphicsPipelineStateInfo&  state,
           DxvkPipelinePriority            priority) {
-    std::unique_lock lock(m_lock);
     this->startWorkers();
 
+    // Keep the pipeline in use while the task is pending so that
+    // its base pipelines stay alive until the optimized pipeline
+    // is ready. Redundant requests release the pipeline right away.
     pipeline->acquirePipeline();
-    m_tasksTotal += 1;
 
-    m_buckets[uint32_t(priority)].queue.emplace(pipeline, state);
-    notifyWorkers(priority);
+    if (!enqueueTask(new PipelineTask(pipeline, state, priority)))
+      pipeline->releasePipeline();
   }
 
 
   void DxvkPipelineWorkers::stopWorkers() {
-    { std::unique_lock lock(m_lock);
-
-      if (!m_workersRunning)
-        return;
+    std::unique_lock lock(m_lock);
 
-      m_workersRunning = false;
+    if (!m_queue.isRunning())
+      return;
 
-      for (uint32_t i = 0; i < m_buckets.size(); i++)
-        m_buckets[i].cond.notify_all();
-    }
+    m_queue.stop();
 
     for (auto& worker : m_workers)
       worker.join();
@@ -64,23 +57,97 @@ namespace dxvk {
   }
 
 
-  void DxvkPipelineWorkers::notifyWorkers(DxvkPipelinePriority priority) {
-    uint32_t index = uint32_t(priority);
+  bool DxvkPipelineWorkers::enqueueTask(
+          Rc<PipelineTask>&&              task) {
+    if (!registerTask(task))
+      return false;
+
+    m_tasksTotal += 1;
+
+    DxvkPipelinePriority priority = task->priority;
+    m_queue.push(std::move(task), priority);
+    return true;
+  }
+
+
+  bool DxvkPipelineWorkers::registerTask(
+    const Rc<PipelineTask>&               task) {
+    auto& shard = getTaskShard(task->object());
+
+    std::lock_guard lock(shard.mutex);
+    auto& tasks = shard.tasks[task->object()];
+
+    for (auto& pending : tasks) {
+      if (!pending->matches(*task))
+        continue;
+
+      // Drop the new task if an equivalent task is already queued
+      // with the same or a higher priority. Otherwise, cancel the
+      // pending task and queue the new one instead.
+      if (uint32_t(pending->priority) <= uint32_t(task->priority))
+        return false;
+
+      pending->status = PipelineTaskStatus::Cancelled;
+      pending = task;
+      return true;
+    }
+
+    tasks.push_back(task);
+    return true;
+  }
+
+
+  bool DxvkPipelineWorkers::beginTask(
+    const Rc<PipelineTask>&               task) {
+    auto& shard = getTaskShard(task->object());
+
+    std::lock_guard lock(shard.mutex);
+
+    if (task->status != PipelineTaskStatus::Pending)
+      return false;
+
+    task->status = PipelineTaskStatus::Running;
+
+    // Remove task from the look-up table so that new
+    // requests for the same object get queued again
+    auto entry = shard.tasks.find(task->object());
 
-    // If any workers are idle in a suitable set, notify the corresponding
-    // condition variable. If all workers are busy anyway, we know that the
-    // job is going to be picked up at some point anyway.
-    for (uint32_t i = index; i < m_buckets.size(); i++) {
-      if (m_buckets[i].idleWorkers) {
-        m_buckets[i].cond.notify_one();
-        break;
+    if (entry != shard.tasks.end()) {
+      auto& tasks = entry->second;
+
+      for (size_t i = 0; i < tasks.size(); i++) {
+        if (tasks[i] == task) {
+          tasks[i] = std::move(tasks.back());
+          tasks.pop_back();
+          break;
+        }
       }
+
+      if (tasks.empty())
+        shard.tasks.erase(entry);
     }
+
+    return true;
+  }
+
+
+  DxvkPipelineWorkers::PipelineTaskShard& DxvkPipelineWorkers::getTaskShard(
+    const void*                           object) {
+    size_t index = reinterpret_cast<uintptr_t>(object) / CACHE_LINE_SIZE;
+    return m_taskShards[index % m_taskShards.size()];
   }
 
 
   void DxvkPipelineWorkers::startWorkers() {
-    if (!std::exchange(m_workersRunning, true)) {
+    if (likely(m_queue.isRunning()))
+      return;
+
+    std::unique_lock lock(m_lock);
+
+    if (m_queue.isRunning())
+      return;
+
+    if (!m_queue.getWorkerCount()) {
       // Use all available cores by default
       uint32_t workerCount = dxvk::thread::hardware_concurrency();
 
@@ -94,74 +161,53 @@ namespace dxvk {
       if (m_device->config().numCompilerThreads > 0)
         workerCount = m_device->config().numCompilerThreads;
 
-      // Number of workers that can process pipeline pipelines with normal
-      // priority. Any other workers can only build high-priority pipelines.
-      uint32_t npWorkerCount = std::max(((workerCount - 1) * 5) / 7, 1u);
-      uint32_t lpWorkerCount = std::max(((workerCount - 1) * 2) / 7, 1u);
-
-      m_workers.reserve(workerCount);
+      m_queue.init(workerCount);
 
-      for (size_t i = 0; i < workerCount; i++) {
-        DxvkPipelinePriority priority = DxvkPipelinePriority::Normal;
+      Logger::info(str::format("DXVK: Using ", workerCount, " compiler threads"));
+    }
 
-        if (i >= npWorkerCount)
-          priority = DxvkPipelinePriority::High;
-        else if (i < lpWorkerCount)
-          priority = DxvkPipelinePriority::Low;
+    m_queue.start();
+    m_workers.reserve(m_queue.getWorkerCount());
 
-        auto& worker = m_workers.emplace_back([this, priority] {
-          runWorker(priority);
-        });
-        
-        worker.set_priority(ThreadPriority::Lowest);
-      }
+    for (uint32_t i = 0; i < m_queue.getWorkerCount(); i++) {
+      auto& worker = m_workers.emplace_back([this, i] {
+        runWorker(i);
+      });
 
-      Logger::info(str::format("DXVK: Using ", workerCount, " compiler threads"));
+      worker.set_priority(ThreadPriority::Lowest);
     }
   }
 
 
-  void DxvkPipelineWorkers::runWorker(DxvkPipelinePriority maxPriority) {
+  void DxvkPipelineWorkers::runWorker(uint32_t workerIndex) {
     static const std::array<char, 3> suffixes = { 'h', 'n', 'l' };
 
-    const uint32_t maxPriorityIndex = uint32_t(maxPriority);
-    env::setThreadName(str::format("dxvk-shader-", suffixes.at(maxPriorityIndex)));
-
-    while (true) {
-      PipelineEntry entry;
-
-      { std::unique_lock lock(m_lock);
-        auto& bucket = m_buckets[maxPriorityIndex];
-
-        bucket.idleWorkers += 1;
-        bucket.cond.wait(lock, [this, maxPriorityIndex, &entry] {
-          // Attempt to fetch a work item from the
-          // highest-priority queue that is not empty
-          for (uint32_t i = 0; i <= maxPriorityIndex; i++) {
-            if (!m_buckets[i].queue.empty()) {
-              entry = m_buckets[i].queue.front();
-              m_buckets[i].queue.pop();
-              return true;
-            }
-          }
-
-          return !m_workersRunning;
-        });
-
-        bucket.idleWorkers -= 1;
-
-        // Skip pending work, exiting early is
-        // more important in this case.
-        if (!m_workersRunning)
-          break;
+    const DxvkPipelinePriority maxPriority = m_queue.getMaxPriority(workerIndex);
+    env::setThreadName(str::format("dxvk-shader-", suffixes.at(uint32_t(maxPriority))));
+
+    Rc<PipelineTask> task;
+
+    while (m_queue.pop(workerIndex, task)) {
+      // Skip tasks that were superseded by a
+      // higher-priority task for the same object
+      if (beginTask(task)) {
+        if (task->pipelineLibrary)
+          task->pipelineLibrary->compilePipeline();
+        else if (task->graphicsPipeline) {
+          // Don't waste time on pipelines that went out of use
+          // while the task was queued, they get queued again
+          // once they are used again.
+          if (!task->graphicsPipeline->deferPipeline(task->graphicsState))
+            task->graphicsPipeline->compilePipeline(task->graphicsState);
+        }
       }
 
-      if (entry.pipelineLibrary) {
-        entry.pipelineLibrary->compilePipeline();
-      } else if (entry.graphicsPipeline) {
-        entry.graphicsPipeline->compilePipeline(entry.graphicsState);
-        entry.graphicsPipeline->releasePipeline();
-      }
+      // Release the pipeline that was acquired at enqueue
+      // time, regardless of whether the task was skipped
+      if (task->graphicsPipeline)
+        task->graphicsPipeline->releasePipeline();
+
+      task = nullptr;
 
       m_tasksCompleted += 1;
     }
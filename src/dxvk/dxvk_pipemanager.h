@@ -2,11 +2,11 @@
 #pragma once
 
 #include <mutex>
-#include <queue>
 #include <unordered_map>
 
 #include "dxvk_compute.h"
 #include "dxvk_graphics.h"
+#include "dxvk_pipeline_queue.h"
 
 namespace dxvk {
 
@@ -33,18 +33,14 @@ namespace dxvk {
     std::atomic<uint32_t> numComputePipelines   = { 0u };
   };
 
+  /**
+   * \brief Pipeline worker stats
+   */
   struct DxvkPipelineWorkerStats {
     uint64_t tasksCompleted;
     uint64_t tasksTotal;
-  };
-
-  /**
-   * \brief Pipeline priority
-   */
-  enum class DxvkPipelinePriority : uint32_t {
-    High    = 0,
-    Normal  = 1,
-    Low     = 2,
+    uint64_t tasksQueued;
+    uint64_t tasksStolen;
   };
 
   /**
@@ -52,6 +48,14 @@ namespace dxvk {
    *
    * Spawns worker threads to compile shader pipeline
    * libraries and optimized pipelines asynchronously.
+   * Tasks are scheduled through a work-stealing queue.
+   *
+   * Pending tasks are additionally tracked per object, so that
+   * redundant requests can be dropped at enqueue time, and tasks
+   * that got superseded by a higher-priority request for the same
+   * object are skipped once a worker picks them up. Optimized
+   * pipelines that went out of use while queued are deferred
+   * until the pipeline gets used again.
    */
   class DxvkPipelineWorkers {
 
@@ -72,6 +76,8 @@ namespace dxvk {
       DxvkPipelineWorkerStats result;
       result.tasksCompleted = m_tasksCompleted.load(std::memory_order_acquire);
       result.tasksTotal = m_tasksTotal.load(std::memory_order_relaxed);
+      result.tasksQueued = m_queue.getQueuedCount();
+      result.tasksStolen = m_queue.getStolenCount();
       return result;
     }
 
@@ -91,6 +97,9 @@ namespace dxvk {
     /**
      * \brief Compiles an optimized graphics pipeline
      *
+     * Does nothing if the same pipeline state is already queued
+     * with the same or a higher priority. The pipeline remains
+     * acquired until a worker has processed or skipped the task.
      * \param [in] pipeline Compute pipeline
      * \param [in] state Pipeline state
      */
@@ -109,25 +118,45 @@ namespace dxvk {
 
   private:
 
-    struct PipelineEntry {
-      PipelineEntry()
-      : pipelineLibrary(nullptr), graphicsPipeline(nullptr) { }
+    enum class PipelineTaskStatus : uint32_t {
+      Pending,
+      Running,
+      Cancelled,
+    };
 
-      PipelineEntry(DxvkShaderPipelineLibrary* l)
-      : pipelineLibrary(l), graphicsPipeline(nullptr) { }
+    struct PipelineTask : public RcObject {
+      PipelineTask(DxvkShaderPipelineLibrary* l, DxvkPipelinePriority p)
+      : pipelineLibrary(l), priority(p) { }
 
-      PipelineEntry(DxvkGraphicsPipeline* p, const DxvkGraphicsPipelineStateInfo& s)
-      : pipelineLibrary(nullptr), graphicsPipeline(p), graphicsState(s) { }
+      PipelineTask(DxvkGraphicsPipeline* g, const DxvkGraphicsPipelineStateInfo& s, DxvkPipelinePriority p)
+      : graphicsPipeline(g), graphicsState(s), priority(p) { }
 
-      DxvkShaderPipelineLibrary*    pipelineLibrary;
-      DxvkGraphicsPipeline*         graphicsPipeline;
+      DxvkShaderPipelineLibrary*    pipelineLibrary = nullptr;
+      DxvkGraphicsPipeline*         graphicsPipeline = nullptr;
       DxvkGraphicsPipelineStateInfo graphicsState;
+      DxvkPipelinePriority          priority;
+
+      /// Protected by the lock of the shard that
+      /// the task's object is assigned to
+      PipelineTaskStatus            status = PipelineTaskStatus::Pending;
+
+      const void* object() const {
+        return pipelineLibrary
+          ? static_cast<const void*>(pipelineLibrary)
+          : static_cast<const void*>(graphicsPipeline);
+      }
+
+      bool matches(const PipelineTask& other) const {
+        return pipelineLibrary == other.pipelineLibrary
+            && graphicsPipeline == other.graphicsPipeline
+            && (!graphicsPipeline || graphicsState.eq(other.graphicsState));
+      }
     };
 
-    struct PipelineBucket {
-      dxvk::condition_variable  cond;
-      std::queue<PipelineEntry> queue;
-      uint32_t                  idleWorkers = 0;
+    struct alignas(CACHE_LINE_SIZE) PipelineTaskShard {
+      dxvk::mutex               mutex;
+      std::unordered_map<const void*,
+        std::vector<Rc<PipelineTask>>> tasks;
     };
 
     DxvkDevice*                       m_device;
@@ -136,16 +165,27 @@ namespace dxvk {
     std::atomic<uint64_t>             m_tasksCompleted = { 0ull };
 
     dxvk::mutex                       m_lock;
-    std::array<PipelineBucket, 3>     m_buckets;
 
-    bool                              m_workersRunning = false;
+    DxvkPipelineTaskQueue<Rc<PipelineTask>> m_queue;
     std::vector<dxvk::thread>         m_workers;
 
-    void notifyWorkers(DxvkPipelinePriority priority);
+    std::array<PipelineTaskShard, 16> m_taskShards;
+
+    bool enqueueTask(
+            Rc<PipelineTask>&&              task);
+
+    bool registerTask(
+      const Rc<PipelineTask>&               task);
+
+    bool beginTask(
+      const Rc<PipelineTask>&               task);
+
+    PipelineTaskShard& getTaskShard(
+      const void*                           object);
 
     void startWorkers();
 
-    void runWorker(DxvkPipelinePriority maxPriority);
+    void runWorker(uint32_t workerIndex);
 
   };
 
@@ -356,6 +356,9 @@ namespace dxvk {
         m_samplers[i].lruNext = i + 1u;
     }
 
+    for (auto& entry : m_samplerCache)
+      entry.store(-1, std::memory_order_relaxed);
+
     // Default sampler, implicitly used for null descriptors or when creating
     // additional samplers fails for any reason. Keep a persistent reference
     // so that this sampler does not accidentally get recycled.
@@ -378,6 +381,15 @@ namespace dxvk {
 
 
   Rc<DxvkSampler> DxvkSamplerPool::createSampler(const DxvkSamplerKey& key) {
+    size_t hash = key.hash();
+
+    // Fast path, samplers that are currently in use can be looked up
+    // without locking since they cannot be recycled at the same time.
+    Rc<DxvkSampler> cached = lookupCachedSampler(key, hash);
+
+    if (likely(cached != nullptr))
+      return cached;
+
     std::unique_lock lock(m_mutex);
     auto entry = m_samplerLut.find(key);
 
@@ -394,6 +406,8 @@ namespace dxvk {
         m_samplersLive.store(m_samplersLive.load() + 1u, std::memory_order_relaxed);
       }
 
+      m_samplerCache[hash % CacheSize].store(makeCacheEntry(hash, entry->second), std::memory_order_release);
+
       // We already took a reference, forward the pointer as-is
       return Rc<DxvkSampler>::unsafeCreate(&sampler.object.value());
     }
@@ -412,19 +426,57 @@ namespace dxvk {
     auto& sampler = m_samplers.at(samplerIndex);
 
     if (sampler.object) {
+      size_t oldHash = sampler.object->key().hash();
+      int32_t expected = makeCacheEntry(oldHash, samplerIndex);
+
+      m_samplerCache[oldHash % CacheSize].compare_exchange_strong(
+        expected, -1, std::memory_order_relaxed);
+
       m_samplerLut.erase(sampler.object->key());
       sampler.object.reset();
     }
 
     removeLru(sampler, samplerIndex);
 
-    // Create new sampler object and set up the corresponding LUT entry
+    // Create new sampler object and set up the corresponding LUT entry.
+    // Publish the reference with release semantics so that lock-free
+    // lookups that acquire a reference also observe the new key.
     sampler.object.emplace(this, key, uint16_t(samplerIndex));
+    sampler.object->m_refCount.store(1u, std::memory_order_release);
+
     m_samplerLut.insert_or_assign(key, samplerIndex);
+    m_samplerCache[hash % CacheSize].store(makeCacheEntry(hash, samplerIndex), std::memory_order_release);
 
     // Update statistics
     m_samplersLive.store(m_samplersLive.load() + 1u, std::memory_order_relaxed);
-    return &sampler.object.value();
+    return Rc<DxvkSampler>::unsafeCreate(&sampler.object.value());
+  }
+
+
+  Rc<DxvkSampler> DxvkSamplerPool::lookupCachedSampler(const DxvkSamplerKey& key, size_t hash) {
+    int32_t entry = m_samplerCache[hash % CacheSize].load(std::memory_order_acquire);
+
+    if (entry < 0 || entry != makeCacheEntry(hash, entry & 0xffff))
+      return nullptr;
+
+    // Samplers with a ref count of zero may get recycled at any time,
+    // so only take a reference if the sampler is live. Cache entries
+    // are not invalidated reliably, so the entry may also refer to a
+    // sampler that got recycled for a different key in the meantime.
+    // Since a sampler object is only ever replaced while its ref count
+    // is zero, the key is stable once we successfully take a reference,
+    // so it must not be compared before that.
+    DxvkSampler* sampler = &(*m_samplers[entry & 0xffff].object);
+
+    if (!sampler->tryIncRef())
+      return nullptr;
+
+    if (unlikely(!sampler->key().eq(key))) {
+      sampler->decRef();
+      return nullptr;
+    }
+
+    return Rc<DxvkSampler>::unsafeCreate(sampler);
   }
 
 
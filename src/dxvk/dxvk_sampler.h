@@ -233,6 +233,17 @@ namespace dxvk {
 
     void release();
 
+    bool tryIncRef() {
+      uint64_t refCount = m_refCount.load(std::memory_order_relaxed);
+
+      while (refCount) {
+        if (m_refCount.compare_exchange_weak(refCount, refCount + 1u, std::memory_order_acquire))
+          return true;
+      }
+
+      return false;
+    }
+
     VkBorderColor determineBorderColorType(const VkSamplerCustomBorderColorCreateInfoEXT& info) const;
 
     static VkClearColorValue swizzleBorderColor(const VkClearColorValue& color, VkComponentMapping mapping);
@@ -336,7 +347,10 @@ namespace dxvk {
   /**
    * \brief Sampler pool
    *
-   * Manages unique samplers within a device.
+   * Manages unique samplers within a device. Looking up
+   * a sampler that is currently in use does not require
+   * locking, only creating new samplers or reviving ones
+   * that are in the LRU list does.
    */
   class DxvkSamplerPool {
     friend DxvkSampler;
@@ -345,6 +359,9 @@ namespace dxvk {
     // Lower limit for sampler counts in Vulkan.
     constexpr static uint32_t MaxSamplerCount = 2048u;
 
+    // Number of entries in the lock-free look-up cache.
+    constexpr static uint32_t CacheSize = 2u * MaxSamplerCount;
+
     DxvkSamplerPool(DxvkDevice* device);
 
     ~DxvkSamplerPool();
@@ -405,6 +422,8 @@ namespace dxvk {
 
     std::unordered_map<DxvkSamplerKey, int32_t, DxvkHash, DxvkEq> m_samplerLut;
 
+    std::array<std::atomic<int32_t>, CacheSize> m_samplerCache;
+
     int32_t m_lruHead = -1;
     int32_t m_lruTail = -1;
 
@@ -412,6 +431,15 @@ namespace dxvk {
 
     Rc<DxvkSampler> m_default = nullptr;
 
+    Rc<DxvkSampler> lookupCachedSampler(const DxvkSamplerKey& key, size_t hash);
+
+    static int32_t makeCacheEntry(size_t hash, int32_t index) {
+      // Store the hash bits not used to select the cache slot along with
+      // the sampler index, so that lookups can reject most mismatched
+      // entries before touching the sampler object at all.
+      return int32_t(((hash / CacheSize) & 0x7fffu) << 16u) | index;
+    }
+
     void releaseSampler(int32_t index);
 
     void appendLru(SamplerEntry& sampler, int32_t index);
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
+#include <string_view>
 #include <version.h>
 
 #include "dxvk_shader_cache.h"
@@ -9,8 +13,8 @@ namespace dxvk {
 
   DxvkShaderCache::Instance DxvkShaderCache::s_instance;
 
-  DxvkShaderCache::DxvkShaderCache()
-  : m_filePaths(getDefaultFilePaths()) {
+  DxvkShaderCache::DxvkShaderCache(uint64_t maxSize)
+  : m_filePaths(getDefaultFilePaths()), m_maxSize(maxSize) {
 
   }
 
@@ -24,6 +28,13 @@ namespace dxvk {
 
       m_writer.join();
     }
+
+    std::unique_lock lock(m_fileMutex);
+
+    if (m_status.load() == Status::OpenReadWrite) {
+      writeUsageLocked();
+      m_lutFile.flush();
+    }
   }
 
 
@@ -37,9 +48,9 @@ namespace dxvk {
     k.name = name;
     k.createInfo = options;
 
-    auto entry = m_lut.find(k);
+    auto entry = findEntry(k);
 
-    if (entry == m_lut.end()) {
+    if (!entry) {
       if (Logger::logLevel() <= LogLevel::Debug)
         Logger::debug(str::format("Shader cache miss: ", name));
 
@@ -48,21 +59,18 @@ namespace dxvk {
 
     if (Logger::logLevel() <= LogLevel::Debug) {
       Logger::debug(str::format("Shader cache hit: ", name,
-        " (offset: ", entry->second.offset,
-        ", size: ", entry->second.binarySize,
-        ", metadata: ", entry->second.metadataSize, ")"));
+        " (offset: ", entry->offset,
+        ", size: ", entry->binarySize,
+        ", metadata: ", entry->metadataSize, ")"));
     }
 
-    std::unique_lock lock(m_fileMutex);
-    auto shader = loadCachedShaderLocked(entry->first, entry->second);
+    auto shader = loadCachedShader(k, *entry);
 
     if (!shader) {
       Logger::warn(str::format("Failed to load cached shader ", name));
 
-      if (!openWriteOnlyLocked())
-        Logger::warn(str::format("Failed to re-initialize shader cache ", name));
-
-      m_status.store(Status::OpenWriteOnly, std::memory_order_release);
+      std::unique_lock lock(m_fileMutex);
+      invalidateLocked();
     }
 
     return shader;
@@ -77,7 +85,7 @@ namespace dxvk {
     k.name = shader->debugName();
     k.createInfo = shader->getShaderCreateInfo();
 
-    if (m_lut.find(k) == m_lut.end()) {
+    if (!findEntry(k)) {
       std::unique_lock lock(m_writeMutex);
       m_writeQueue.push(std::move(shader));
       m_writeCond.notify_one();
@@ -153,8 +161,16 @@ namespace dxvk {
 
   bool DxvkShaderCache::openWriteOnlyLocked() {
     // Didn't have a lot of success so far, nuke the files and retry.
+    // Drop all state referencing the mapped files before re-opening.
     auto path = m_filePaths.directory + env::PlatformDirSlash;
 
+    m_lutView = util::FileView();
+    m_binView = util::FileView();
+
+    m_index = LutIndex();
+    m_lut.clear();
+    m_usedSlots.clear();
+
     auto flags = util::FileFlags(
       util::FileFlag::AllowWrite,
       util::FileFlag::Truncate,
@@ -184,53 +200,200 @@ namespace dxvk {
 
     Logger::info(str::format("Created cache file: ", path + m_filePaths.binFile));
 
-    LutHeader header = { };
-    header.magic = { 'D', 'X', 'V', 'K' };
-    header.versionString = DXVK_VERSION;
-
-    if (!writeHeader(m_lutFile, header)) {
+    // Write an empty index, all entries go to the log for now
+    if (!writeLutFile(m_lutFile, { }, 1u, m_index)) {
       Logger::warn(str::format("Failed to write cache header: ", path + m_filePaths.lutFile));
       return false;
     }
 
+    m_indexOffset = m_index.slotOffset - sizeof(m_index);
     return true;
   }
 
 
   bool DxvkShaderCache::parseLut() {
-    LutHeader header;
+    m_lutView = m_lutFile.map();
+    m_binView = m_binFile.map();
 
-    size_t size = m_lutFile.size();
-    size_t offset = 0u;
+    std::vector<LutRecord> records;
 
-    if (!readBytes(m_lutFile, header.magic.data(), offset, header.magic.size())
-     || !readString(m_lutFile, offset, header.versionString)) {
-      Logger::warn("Failed to parse cache file header.");
+    if (!readLutFile(m_lutView, m_indexOffset, m_index, records))
       return false;
-    }
 
-    if (header.versionString != DXVK_VERSION) {
-      Logger::warn(str::format("Cache was created with DXVK version ", header.versionString,
-        ", but current version is ", DXVK_VERSION, ". Discarding old cache."));
-      return false;
+    if (needsCompaction(records, m_lutView.size(), m_binView.size(), m_maxSize)) {
+      // Compaction replaces both files, so close them first
+      m_lutView = util::FileView();
+      m_binView = util::FileView();
+
+      m_lutFile = util::File();
+      m_binFile = util::File();
+
+      if (!compactFiles(m_filePaths, m_maxSize, false)) {
+        Logger::warn("Failed to compact shader cache.");
+        return false;
+      }
+
+      if (!openReadWriteLocked())
+        return false;
+
+      m_lutView = m_lutFile.map();
+      m_binView = m_binFile.map();
+
+      records.clear();
+
+      if (!readLutFile(m_lutView, m_indexOffset, m_index, records))
+        return false;
     }
 
-    while (offset < size) {
-      LutKey k;
-      LutEntry e;
+    // Fold the log into the index once it gets large enough
+    // to meaningfully slow down startup. Otherwise, add log
+    // entries to the overlay look-up table.
+    uint32_t logCount = 0u;
 
-      if (!readShaderLutEntry(k, e, offset)) {
-        Logger::warn("Failed to parse cache look-up table.");
+    for (const auto& r : records)
+      logCount += r.fromLog;
+
+    if (logCount > m_index.entryCount / 4u) {
+      if (!rebuildIndexLocked(records)) {
+        Logger::warn("Failed to rebuild cache index.");
         return false;
       }
+    } else {
+      for (const auto& r : records) {
+        if (!r.fromLog)
+          continue;
+
+        util::FileView key(r.key.data(), r.key.size());
 
-      m_lut.insert_or_assign(k, e);
+        LutKey k;
+        size_t offset = 0u;
+
+        if (!readShaderLutKey(key, offset, k))
+          return false;
+
+        m_lut.insert_or_assign(std::move(k), r.entry);
+      }
     }
 
+    // Start a new generation for the purpose of tracking
+    // which entries were used recently.
+    m_index.generation += 1u;
+
+    if (!m_lutFile.write(m_indexOffset, sizeof(m_index), &m_index))
+      return false;
+
+    m_usedSlots = std::vector<std::atomic<uint64_t>>((m_index.slotCount + 63u) / 64u);
     return true;
   }
 
 
+  bool DxvkShaderCache::rebuildIndexLocked(const std::vector<LutRecord>& records) {
+    // All data has been copied out of the mapped file,
+    // so it is safe to rewrite the file at this point.
+    auto path = m_filePaths.directory + env::PlatformDirSlash + m_filePaths.lutFile;
+
+    m_lutView = util::FileView();
+    m_lutFile.open(path, util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive));
+
+    LutIndex index = { };
+
+    if (!m_lutFile || !writeLutFile(m_lutFile, records, m_index.generation, index) || !m_lutFile.flush())
+      return false;
+
+    m_lutFile.open(path, util::FileFlags(
+      util::FileFlag::AllowRead,
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Exclusive));
+
+    if (!m_lutFile)
+      return false;
+
+    m_lutView = m_lutFile.map();
+
+    if (!m_lutView)
+      return false;
+
+    Logger::info(str::format("Rebuilt shader cache index with ", index.entryCount, " entries"));
+
+    m_index = index;
+    m_indexOffset = index.slotOffset - sizeof(index);
+
+    m_lut.clear();
+    return true;
+  }
+
+
+  void DxvkShaderCache::invalidateLocked() {
+    // Lookups may still access the mapped files at this point, so
+    // they must not be truncated. Clear the header magic instead so
+    // that the cache gets discarded on the next launch.
+    std::array<char, 4u> magic = { };
+
+    m_lutFile.write(0u, magic.size(), magic.data());
+    m_lutFile.flush();
+
+    m_status.store(Status::CacheDisabled, std::memory_order_release);
+  }
+
+
+  void DxvkShaderCache::writeUsageLocked() {
+    // Stamp all index entries that were used since the last call with
+    // the current generation. Entries from the log are new anyway. Once
+    // written, the stamp is visible through the mapping, so lookups will
+    // not mark the same slot again.
+    for (size_t i = 0u; i < m_usedSlots.size(); i++) {
+      uint64_t mask = m_usedSlots[i].exchange(0u, std::memory_order_relaxed);
+
+      for (auto bit : bit::BitMask(mask)) {
+        size_t offset = m_index.slotOffset + (64u * i + bit) * sizeof(LutSlot)
+          + offsetof(LutSlot, lastUsed);
+
+        if (!m_lutFile.write(offset, sizeof(m_index.generation), &m_index.generation))
+          return;
+      }
+    }
+  }
+
+
+  std::optional<DxvkShaderCache::LutEntry> DxvkShaderCache::findEntry(const LutKey& key) {
+    // Entries from the log take precedence over indexed ones
+    auto entry = m_lut.find(key);
+
+    if (entry != m_lut.end())
+      return std::make_optional(entry->second);
+
+    uint64_t hash = key.stableHash();
+
+    for (uint32_t i = 0u; i < m_index.slotCount; i++) {
+      uint32_t index = uint32_t(hash + i) & (m_index.slotCount - 1u);
+      size_t offset = m_index.slotOffset + index * sizeof(LutSlot);
+
+      LutSlot slot;
+
+      if (!read(m_lutView, offset, slot) || !slot.keySize)
+        break;
+
+      if (slot.keyHash != hash)
+        continue;
+
+      LutKey k;
+      size_t keyOffset = slot.keyOffset;
+
+      if (readShaderLutKey(m_lutView, keyOffset, k) && k.eq(key)) {
+        if (slot.lastUsed != m_index.generation)
+          m_usedSlots[index / 64u].fetch_or(uint64_t(1u) << (index % 64u), std::memory_order_relaxed);
+
+        return std::make_optional(slot.entry);
+      }
+    }
+
+    return std::nullopt;
+  }
+
+
   bool DxvkShaderCache::writeShaderXfbInfo(util::File& stream, const dxbc_spv::ir::IoXfbInfo& xfb) {
     return writeString(stream, xfb.semanticName)
         && write(stream, xfb.semanticIndex)
@@ -256,36 +419,47 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkIrShader> DxvkShaderCache::loadCachedShaderLocked(const LutKey& key, const LutEntry& entry) {
-    std::vector<uint8_t> ir(entry.binarySize);
-
+  Rc<DxvkIrShader> DxvkShaderCache::loadCachedShader(const LutKey& key, const LutEntry& entry) const {
     size_t offset = entry.offset;
 
-    if (!readBytes(m_binFile, ir.data(), offset, entry.binarySize)) {
+    auto data = m_binView.ptr(offset, entry.binarySize);
+
+    if (!data) {
       Logger::warn("Failed to read cached shader binary");
       return nullptr;
     }
 
-    if (entry.checksum != bit::fnv1a_hash(ir.data(), ir.size())) {
+    if (entry.checksum != bit::fnv1a_hash(data, entry.binarySize)) {
       Logger::warn("Checksum mismatch for cached shader");
       return nullptr;
     }
 
+    // The shader may outlive the mapping, so it needs its own copy
+    uint32_t irSize = 0u;
+
+    if (entry.binarySize < sizeof(irSize) || !read(m_binView, offset, irSize)) {
+      Logger::warn("Failed to read cached shader binary");
+      return nullptr;
+    }
+
+    std::vector<uint8_t> ir(data + sizeof(irSize), data + entry.binarySize);
+    offset += entry.binarySize - sizeof(irSize);
+
     DxvkShaderMetadata metadata;
 
-    if (!readShaderMetadata(m_binFile, offset, metadata)) {
+    if (!readShaderMetadata(m_binView, offset, metadata)) {
       Logger::warn("Failed to read cached shader metadata");
       return nullptr;
     }
 
     DxvkPipelineLayoutBuilder layout;
 
-    if (!readShaderLayout(m_binFile, offset, layout)) {
+    if (!readShaderLayout(m_binView, offset, layout)) {
       Logger::warn("Failed to read cached shader binding layout");
       return nullptr;
     }
 
-    return new DxvkIrShader(key.name, key.createInfo, std::move(metadata), std::move(layout), std::move(ir));
+    return new DxvkIrShader(key.name, key.createInfo, std::move(metadata), std::move(layout), std::move(ir), irSize);
   }
 
 
@@ -306,7 +480,7 @@ namespace dxvk {
   }
 
 
-  bool DxvkShaderCache::readShaderIo(util::File& stream, size_t& offset, DxvkShaderIo& io) {
+  bool DxvkShaderCache::readShaderIo(const util::FileView& stream, size_t& offset, DxvkShaderIo& io) {
     uint8_t varCount = 0u;
 
     if (!read(stream, offset, varCount))
@@ -331,7 +505,7 @@ namespace dxvk {
   }
 
 
-  bool DxvkShaderCache::readShaderMetadata(util::File& stream, size_t& offset, DxvkShaderMetadata& metadata) {
+  bool DxvkShaderCache::readShaderMetadata(const util::FileView& stream, size_t& offset, DxvkShaderMetadata& metadata) {
     bool status = read(stream, offset, metadata.stage)
                && read(stream, offset, metadata.flags)
                && read(stream, offset, metadata.specConstantMask)
@@ -350,7 +524,7 @@ namespace dxvk {
   }
 
 
-  bool DxvkShaderCache::readShaderLayout(util::File& stream, size_t& offset, DxvkPipelineLayoutBuilder& layout) {
+  bool DxvkShaderCache::readShaderLayout(const util::FileView& stream, size_t& offset, DxvkPipelineLayoutBuilder& layout) {
     VkShaderStageFlags stageMask = { };
 
     if (!read(stream, offset, stageMask))
@@ -407,7 +581,7 @@ namespace dxvk {
   }
 
 
-  bool DxvkShaderCache::readShaderXfbInfo(util::File& stream, size_t& offset, dxbc_spv::ir::IoXfbInfo& xfb) {
+  bool DxvkShaderCache::readShaderXfbInfo(const util::FileView& stream, size_t& offset, dxbc_spv::ir::IoXfbInfo& xfb) {
     return readString(stream, offset, xfb.semanticName)
         && read(stream, offset, xfb.semanticIndex)
         && read(stream, offset, xfb.componentMask)
@@ -418,7 +592,7 @@ namespace dxvk {
  }
 
 
-  bool DxvkShaderCache::readShaderLutKey(util::File& stream, size_t& offset, LutKey& key) {
+  bool DxvkShaderCache::readShaderLutKey(const util::FileView& stream, size_t& offset, LutKey& key) {
     bool status = readString(stream, offset, key.name)
                && read(stream, offset, key.createInfo.options)
                && read(stream, offset, key.createInfo.flatShadingInputs)
@@ -436,11 +610,6 @@ namespace dxvk {
   }
 
 
-  bool DxvkShaderCache::readShaderLutEntry(LutKey& key, LutEntry& entry, size_t& offset) {
-    return readShaderLutKey(m_lutFile, offset, key) && read(m_lutFile, offset, entry);
-  }
-
-
   void DxvkShaderCache::runWriter() {
     small_vector<Rc<DxvkIrShader>, 128u> localQueue;
 
@@ -481,6 +650,11 @@ namespace dxvk {
 
         localQueue.clear();
 
+        // Also persist use stamps here so that they do not get lost
+        // if the process exits without destroying the cache object
+        if (m_status.load(std::memory_order_relaxed) == Status::OpenReadWrite)
+          writeUsageLocked();
+
         m_binFile.flush();
         m_lutFile.flush();
       }
@@ -549,30 +723,387 @@ namespace dxvk {
 
 
   std::optional<DxvkShaderCache::LutEntry> DxvkShaderCache::writeShaderBinary(util::File& stream, DxvkIrShader& shader) {
-    auto [data, size] = shader.getSerializedIr();
+    auto ir = shader.getSerializedIr();
+
+    // Store the uncompressed size in front of the IR so that it
+    // can be decompressed without consulting the look-up table
+    std::vector<char> binary(sizeof(uint32_t) + ir.size);
+
+    uint32_t rawSize = uint32_t(ir.rawSize);
+    std::memcpy(&binary[0u], &rawSize, sizeof(rawSize));
+    std::memcpy(&binary[sizeof(rawSize)], ir.data, ir.size);
 
     LutEntry entry = { };
     entry.offset = stream.size();
-    entry.binarySize = size;
+    entry.binarySize = uint32_t(binary.size());
 
-    if (!writeBytes(stream, data, size)
+    if (!writeBytes(stream, binary.data(), binary.size())
      || !writeShaderMetadata(stream, shader.getShaderMetadata())
      || !writeShaderLayout(stream, shader.getLayout()))
       return std::nullopt;
 
-
     entry.metadataSize = uint32_t(uint64_t(stream.size()) - (entry.offset + entry.binarySize));
-    entry.checksum = bit::fnv1a_hash(data, size);
+    entry.checksum = bit::fnv1a_hash(binary.data(), binary.size());
     return std::make_optional(entry);
   }
 
 
   bool DxvkShaderCache::writeHeader(util::File& stream, const LutHeader& header) {
     return writeBytes(stream, header.magic.data(), header.magic.size())
+        && write(stream, header.formatVersion)
         && writeString(stream, header.versionString);
   }
 
 
+  bool DxvkShaderCache::writeLutFile(util::File& stream, const std::vector<LutRecord>& records, uint32_t generation, LutIndex& index) {
+    LutHeader header = { };
+    header.magic = { 'D', 'X', 'V', 'K' };
+    header.formatVersion = LutFormatVersion;
+    header.versionString = DXVK_VERSION;
+
+    if (!writeHeader(stream, header))
+      return false;
+
+    // Use a load factor of at most 0.5 to keep probe sequences short
+    uint32_t slotCount = 0u;
+
+    if (!records.empty()) {
+      slotCount = 64u;
+
+      while (slotCount < 2u * records.size())
+        slotCount *= 2u;
+    }
+
+    std::vector<LutSlot> slots(slotCount);
+    std::vector<char> keyData;
+
+    index = LutIndex();
+    index.slotCount = slotCount;
+    index.entryCount = uint32_t(records.size());
+    index.slotOffset = stream.size() + sizeof(index);
+    index.generation = generation;
+
+    uint64_t keyOffset = index.slotOffset + slotCount * sizeof(LutSlot);
+
+    for (const auto& r : records) {
+      for (uint32_t i = 0u; i < slotCount; i++) {
+        auto& slot = slots[uint32_t(r.keyHash + i) & (slotCount - 1u)];
+
+        if (!slot.keySize) {
+          slot.keyHash = r.keyHash;
+          slot.keyOffset = keyOffset + keyData.size();
+          slot.keySize = uint32_t(r.key.size());
+          slot.lastUsed = r.lastUsed;
+          slot.entry = r.entry;
+
+          keyData.insert(keyData.end(), r.key.begin(), r.key.end());
+          break;
+        }
+      }
+    }
+
+    index.logOffset = keyOffset + keyData.size();
+
+    return write(stream, index)
+        && writeBytes(stream, reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(LutSlot))
+        && writeBytes(stream, keyData.data(), keyData.size());
+  }
+
+
+  bool DxvkShaderCache::readLutFile(const util::FileView& stream, size_t& indexOffset, LutIndex& index, std::vector<LutRecord>& records) {
+    LutHeader header;
+    size_t offset = 0u;
+
+    if (!readBytes(stream, header.magic.data(), offset, header.magic.size())
+     || !read(stream, offset, header.formatVersion)
+     || !readString(stream, offset, header.versionString)) {
+      Logger::warn("Failed to parse cache file header.");
+      return false;
+    }
+
+    if (header.magic != std::array<char, 4u>({ 'D', 'X', 'V', 'K' })
+     || header.formatVersion != LutFormatVersion) {
+      Logger::warn("Unsupported cache file format. Discarding old cache.");
+      return false;
+    }
+
+    if (header.versionString != DXVK_VERSION) {
+      Logger::warn(str::format("Cache was created with DXVK version ", header.versionString,
+        ", but current version is ", DXVK_VERSION, ". Discarding old cache."));
+      return false;
+    }
+
+    indexOffset = offset;
+
+    if (!read(stream, offset, index)
+     || !stream.ptr(index.slotOffset, size_t(index.slotCount) * sizeof(LutSlot))
+     || (index.slotCount & (index.slotCount - 1u))
+     || (index.logOffset > stream.size())) {
+      Logger::warn("Failed to parse cache index.");
+      return false;
+    }
+
+    // Gather unique entries, with entries from the log
+    // replacing indexed entries with the same key.
+    std::unordered_map<std::string_view, size_t> lookup;
+
+    auto insert = [&] (LutRecord&& record) {
+      std::string_view key(record.key.data(), record.key.size());
+      auto entry = lookup.find(key);
+
+      if (entry != lookup.end()) {
+        // Keep the existing key storage since the look-up
+        // table references it, the contents are identical
+        auto& dst = records[entry->second];
+        dst.lastUsed = record.lastUsed;
+        dst.fromLog = record.fromLog;
+        dst.entry = record.entry;
+      } else {
+        lookup.insert({ key, records.size() });
+        records.push_back(std::move(record));
+      }
+    };
+
+    for (uint32_t i = 0u; i < index.slotCount; i++) {
+      size_t slotOffset = index.slotOffset + i * sizeof(LutSlot);
+
+      LutSlot slot;
+
+      if (!read(stream, slotOffset, slot))
+        return false;
+
+      if (!slot.keySize)
+        continue;
+
+      auto key = stream.ptr(slot.keyOffset, slot.keySize);
+
+      if (!key) {
+        Logger::warn("Failed to parse cache index.");
+        return false;
+      }
+
+      LutRecord r;
+      r.keyHash = slot.keyHash;
+      r.lastUsed = slot.lastUsed;
+      r.entry = slot.entry;
+      r.key.assign(key, key + slot.keySize);
+
+      insert(std::move(r));
+    }
+
+    // Entries appended after the index was last built are not
+    // part of the hash table, so we need to parse them here.
+    offset = index.logOffset;
+
+    while (offset < stream.size()) {
+      size_t keyOffset = offset;
+
+      LutKey k;
+      LutRecord r;
+
+      if (!readShaderLutKey(stream, offset, k)) {
+        Logger::warn("Failed to parse cache look-up table.");
+        return false;
+      }
+
+      auto key = stream.ptr(keyOffset, offset - keyOffset);
+
+      if (!read(stream, offset, r.entry)) {
+        Logger::warn("Failed to parse cache look-up table.");
+        return false;
+      }
+
+      r.keyHash = k.stableHash();
+      r.lastUsed = index.generation;
+      r.fromLog = 1u;
+      r.key.assign(key, key + (offset - keyOffset - sizeof(r.entry)));
+
+      insert(std::move(r));
+    }
+
+    return true;
+  }
+
+
+  bool DxvkShaderCache::needsCompaction(const std::vector<LutRecord>& records, uint64_t lutSize, uint64_t binSize, uint64_t maxSize) {
+    if (maxSize && lutSize + binSize > maxSize)
+      return true;
+
+    // Compact if a significant portion of the binary
+    // file is no longer referenced by any entry
+    uint64_t liveSize = 0u;
+
+    for (const auto& r : records)
+      liveSize += r.entry.binarySize + r.entry.metadataSize;
+
+    return binSize - std::min(binSize, liveSize) > std::max<uint64_t>(binSize / 4u, 1u << 20u);
+  }
+
+
+  bool DxvkShaderCache::compactFiles(const FilePaths& paths, uint64_t maxSize, bool verify) {
+    auto path = paths.directory + env::PlatformDirSlash;
+
+    util::File lutFile(path + paths.lutFile, util::FileFlags(util::FileFlag::AllowRead, util::FileFlag::Exclusive));
+    util::File binFile(path + paths.binFile, util::FileFlags(util::FileFlag::AllowRead, util::FileFlag::Exclusive));
+
+    if (!lutFile || !binFile)
+      return false;
+
+    util::FileView lutView = lutFile.map();
+    util::FileView binView = binFile.map();
+
+    LutIndex index = { };
+    size_t indexOffset = 0u;
+
+    std::vector<LutRecord> records;
+
+    if (!readLutFile(lutView, indexOffset, index, records))
+      return false;
+
+    size_t oldSize = lutView.size() + binView.size();
+
+    // Drop entries that point to missing or corrupted data
+    for (size_t i = 0u; i < records.size(); ) {
+      const auto& e = records[i].entry;
+      auto data = binView.ptr(e.offset, e.binarySize + e.metadataSize);
+
+      bool valid = data && (!verify || e.checksum == bit::fnv1a_hash(data, e.binarySize));
+
+      if (!valid) {
+        records[i] = std::move(records.back());
+        records.pop_back();
+      } else {
+        i++;
+      }
+    }
+
+    // Evict least recently used entries until the files are well below the
+    // size limit, so that we don't have to compact again on the next launch.
+    if (maxSize) {
+      std::stable_sort(records.begin(), records.end(), [] (const LutRecord& a, const LutRecord& b) {
+        return a.lastUsed > b.lastUsed;
+      });
+
+      uint64_t targetSize = maxSize - maxSize / 4u;
+      uint64_t totalSize = 0u;
+
+      size_t count = 0u;
+
+      while (count < records.size()) {
+        const auto& r = records[count];
+        totalSize += r.entry.binarySize + r.entry.metadataSize + r.key.size() + 2u * sizeof(LutSlot);
+
+        if (totalSize > targetSize)
+          break;
+
+        count++;
+      }
+
+      records.resize(count);
+    }
+
+    // Write new files next to the old ones, ordered by the original
+    // offset in order to retain locality between related shaders.
+    std::sort(records.begin(), records.end(), [] (const LutRecord& a, const LutRecord& b) {
+      return a.entry.offset < b.entry.offset;
+    });
+
+    auto newFlags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    util::File newLutFile(path + paths.lutFile + ".tmp", newFlags);
+    util::File newBinFile(path + paths.binFile + ".tmp", newFlags);
+
+    if (!newLutFile || !newBinFile)
+      return false;
+
+    for (auto& r : records) {
+      auto data = binView.ptr(r.entry.offset, r.entry.binarySize + r.entry.metadataSize);
+      r.entry.offset = newBinFile.size();
+
+      if (!writeBytes(newBinFile, data, r.entry.binarySize + r.entry.metadataSize))
+        return false;
+    }
+
+    LutIndex newIndex = { };
+
+    if (!writeLutFile(newLutFile, records, index.generation, newIndex)
+     || !newLutFile.flush() || !newBinFile.flush())
+      return false;
+
+    size_t newSize = newLutFile.size() + newBinFile.size();
+
+    newLutFile = util::File();
+    newBinFile = util::File();
+
+    lutFile = util::File();
+    binFile = util::File();
+
+    if (!env::replaceFile(path + paths.binFile + ".tmp", path + paths.binFile)
+     || !env::replaceFile(path + paths.lutFile + ".tmp", path + paths.lutFile))
+      return false;
+
+    Logger::info(str::format("Compacted shader cache: ", records.size(), " entries, ",
+      oldSize >> 10u, " kB -> ", newSize >> 10u, " kB"));
+    return true;
+  }
+
+
+  std::optional<DxvkShaderCache::FileInfo> DxvkShaderCache::inspectFiles(const FilePaths& paths, bool verify) {
+    auto path = paths.directory + env::PlatformDirSlash;
+
+    util::File lutFile(path + paths.lutFile, util::FileFlags(util::FileFlag::AllowRead, util::FileFlag::Exclusive));
+    util::File binFile(path + paths.binFile, util::FileFlags(util::FileFlag::AllowRead, util::FileFlag::Exclusive));
+
+    if (!lutFile || !binFile)
+      return std::nullopt;
+
+    util::FileView lutView = lutFile.map();
+    util::FileView binView = binFile.map();
+
+    LutIndex index = { };
+    size_t indexOffset = 0u;
+
+    std::vector<LutRecord> records;
+
+    if (!readLutFile(lutView, indexOffset, index, records))
+      return std::nullopt;
+
+    FileInfo info;
+    info.versionString = DXVK_VERSION;
+    info.generation = index.generation;
+    info.lutSize = lutView.size();
+    info.binSize = binView.size();
+
+    for (const auto& r : records) {
+      util::FileView keyView(r.key.data(), r.key.size());
+
+      LutKey k;
+      size_t offset = 0u;
+
+      EntryInfo e;
+
+      if (readShaderLutKey(keyView, offset, k))
+        e.name = std::move(k.name);
+
+      e.offset = r.entry.offset;
+      e.binarySize = r.entry.binarySize;
+      e.metadataSize = r.entry.metadataSize;
+      e.lastUsed = r.lastUsed;
+
+      auto data = binView.ptr(r.entry.offset, r.entry.binarySize + r.entry.metadataSize);
+      e.valid = data && (!verify || r.entry.checksum == bit::fnv1a_hash(data, r.entry.binarySize));
+
+      info.logEntryCount += r.fromLog;
+      info.entries.push_back(std::move(e));
+    }
+
+    return std::make_optional(std::move(info));
+  }
+
+
   DxvkShaderCache::FilePaths DxvkShaderCache::getDefaultFilePaths() {
     std::string cachePath = env::getEnvVar("DXVK_SHADER_CACHE_PATH");
 
@@ -632,11 +1163,11 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkShaderCache> DxvkShaderCache::getInstance() {
+  Rc<DxvkShaderCache> DxvkShaderCache::getInstance(uint64_t maxSize) {
     std::lock_guard lock(s_instance.mutex);
 
     if (!s_instance.instance)
-      s_instance.instance = new DxvkShaderCache();
+      s_instance.instance = new DxvkShaderCache(maxSize);
 
     return s_instance.instance;
   }
@@ -648,7 +1179,7 @@ namespace dxvk {
     // The ref count can only be incremented from 0 to 1 inside a locked
     // context, so this check is safe. Don't destroy the object if another
     // thread has essentially revived it.
-    if (m_useCount.load(std::memory_order_relaxed) || s_instance.instance != this) {
+    if (!m_useCount.load(std::memory_order_relaxed)) {
       if (s_instance.instance == this)
         s_instance.instance = nullptr;
 
@@ -669,4 +1200,24 @@ namespace dxvk {
     return name == k.name && createInfo.eq(k.createInfo);
   }
 
+
+  uint64_t DxvkShaderCache::LutKey::stableHash() const {
+    // Unlike hash(), this gets persisted in the index, so only
+    // use data with a well-defined binary representation.
+    uint64_t hash = bit::fnv1a_hash(name.data(), name.size());
+
+    auto hashBytes = [&hash] (const auto& data) {
+      auto bytes = reinterpret_cast<const uint8_t*>(&data);
+
+      for (size_t i = 0u; i < sizeof(data); i++)
+        hash = bit::fnv1a_iter(hash, bytes[i]);
+    };
+
+    hashBytes(createInfo.options);
+    hashBytes(createInfo.flatShadingInputs);
+    hashBytes(createInfo.rasterizedStream);
+
+    return bit::fnv1a_iter(hash, createInfo.xfbEntries.size());
+  }
+
 }
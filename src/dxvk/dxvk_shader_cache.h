@@ -24,6 +24,20 @@ namespace dxvk {
    * The implementation creates two files that can trivially grow by appending
    * data to them: A binary blob that contains the actual serialized IR as well
    * as shader metadata, and a look-up table
+   *
+   * Both files are memory-mapped on startup. The look-up table starts with an
+   * open-addressing hash table that can be queried in place without parsing
+   * the file, followed by a log of entries appended since the table was last
+   * built. The table is only rebuilt on startup if that log grows too large.
+   * Lookups do not take any locks since the mapped data is never modified
+   * while the cache is in use, except for the use stamps described below.
+   *
+   * Each launch bumps a generation counter, and every entry stores the last
+   * generation it was used in. Stamps are written whenever the writer thread
+   * flushes a batch of new shaders, as well as when the cache object gets
+   * destroyed. On startup, the files get compacted if they
+   * contain too much stale data or exceed the configured size budget, in
+   * which case the least recently used entries get evicted.
    */
   class DxvkShaderCache {
 
@@ -35,6 +49,24 @@ namespace dxvk {
       std::string binFile;
     };
 
+    struct EntryInfo {
+      std::string name;
+      uint64_t offset = 0u;
+      uint32_t binarySize = 0u;
+      uint32_t metadataSize = 0u;
+      uint32_t lastUsed = 0u;
+      bool     valid = true;
+    };
+
+    struct FileInfo {
+      std::string versionString;
+      uint32_t generation = 0u;
+      uint32_t logEntryCount = 0u;
+      uint64_t lutSize = 0u;
+      uint64_t binSize = 0u;
+      std::vector<EntryInfo> entries;
+    };
+
     ~DxvkShaderCache();
 
     void incRef() {
@@ -74,9 +106,104 @@ namespace dxvk {
 
     /**
      * \brief Initializes shader cache
+     *
+     * \param [in] maxSize Maximum size of the cache files, in
+     *    bytes, or 0 for no limit. Only takes effect when the
+     *    instance is first created.
      * \returns Shader cache instance
      */
-    static Rc<DxvkShaderCache> getInstance();
+    static Rc<DxvkShaderCache> getInstance(uint64_t maxSize);
+
+    /**
+     * \brief Inspects cache files
+     *
+     * Parses the look-up table and optionally verifies
+     * the checksums of all shader binaries. The files
+     * must not be in use by another process.
+     * \param [in] paths Cache file paths
+     * \param [in] verify Whether to verify checksums
+     * \returns File info, or \c nullopt if the files
+     *    could not be opened or parsed.
+     */
+    static std::optional<FileInfo> inspectFiles(const FilePaths& paths, bool verify);
+
+    /**
+     * \brief Compacts cache files
+     *
+     * Rewrites both files without duplicate or unreachable
+     * entries. If a size limit is given and the files exceed
+     * it, the least recently used entries will be evicted.
+     * The files must not be in use by another process.
+     * \param [in] paths Cache file paths
+     * \param [in] maxSize Maximum size in bytes, or 0
+     * \param [in] verify Whether to drop entries with
+     *    checksum mismatches
+     * \returns \c true on success
+     */
+    static bool compactFiles(const FilePaths& paths, uint64_t maxSize, bool verify);
+
+    /**
+     * \brief Serializes shader binding layout
+     *
+     * The helpers below are shared with API-specific
+     * shader caches that use the same file layout.
+     * \param [in] stream File to append to
+     * \param [in] layout Binding layout
+     * \returns \c true on success
+     */
+    static bool writeShaderLayout(util::File& stream, const DxvkPipelineLayoutBuilder& layout);
+
+    /**
+     * \brief Deserializes shader binding layout
+     *
+     * \param [in] stream File to read from
+     * \param [in,out] offset Read offset
+     * \param [out] layout Binding layout
+     * \returns \c true on success
+     */
+    static bool readShaderLayout(const util::FileView& stream, size_t& offset, DxvkPipelineLayoutBuilder& layout);
+
+    static bool writeBytes(util::File& stream, const char* data, size_t size) {
+      return stream.append(size, data);
+    }
+
+    static bool writeBytes(util::File& stream, const uint8_t* data, size_t size) {
+      return writeBytes(stream, reinterpret_cast<const char*>(data), size);
+    }
+
+    static bool writeString(util::File& stream, const std::string& string) {
+      return write(stream, uint16_t(string.size())) && writeBytes(stream, string.data(), string.size());
+    }
+
+    template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
+    static bool write(util::File& stream, const T& data) {
+      return writeBytes(stream, reinterpret_cast<const char*>(&data), sizeof(data));
+    }
+
+    static bool readBytes(const util::FileView& stream, char* data, size_t& offset, size_t size) {
+      bool result = stream.read(offset, size, data);
+      offset += size;
+      return result;
+    }
+
+    static bool readBytes(const util::FileView& stream, uint8_t* data, size_t& offset, size_t size) {
+      return readBytes(stream, reinterpret_cast<char*>(data), offset, size);
+    }
+
+    static bool readString(const util::FileView& stream, size_t& offset, std::string& string) {
+      uint16_t len = 0u;
+
+      if (!read(stream, offset, len))
+        return false;
+
+      string.resize(len);
+      return readBytes(stream, string.data(), offset, len);
+    }
+
+    template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
+    static bool read(const util::FileView& stream, size_t& offset, T& data) {
+      return readBytes(stream, reinterpret_cast<char*>(&data), offset, sizeof(data));
+    }
 
   private:
 
@@ -87,11 +214,23 @@ namespace dxvk {
 
     static Instance s_instance;
 
+    constexpr static uint32_t LutFormatVersion = 4u;
+
     struct LutHeader {
       std::array<char, 4u>  magic = { };
+      uint32_t              formatVersion = 0u;
       std::string           versionString = { };
     };
 
+    struct LutIndex {
+      uint32_t slotCount = 0u;
+      uint32_t entryCount = 0u;
+      uint64_t slotOffset = 0u;
+      uint64_t logOffset = 0u;
+      uint32_t generation = 0u;
+      uint32_t reserved = 0u;
+    };
+
     struct LutKey {
       std::string name;
       DxvkIrShaderCreateInfo createInfo;
@@ -99,6 +238,8 @@ namespace dxvk {
       size_t hash() const;
 
       bool eq(const LutKey& k) const;
+
+      uint64_t stableHash() const;
     };
 
     struct LutEntry {
@@ -108,6 +249,22 @@ namespace dxvk {
       uint64_t checksum = 0u;
     };
 
+    struct LutSlot {
+      uint64_t keyHash = 0u;
+      uint64_t keyOffset = 0u;
+      uint32_t keySize = 0u;
+      uint32_t lastUsed = 0u;
+      LutEntry entry = { };
+    };
+
+    struct LutRecord {
+      uint64_t keyHash = 0u;
+      uint32_t lastUsed = 0u;
+      uint32_t fromLog = 0u;
+      LutEntry entry = { };
+      std::vector<char> key;
+    };
+
     enum class Status : uint32_t {
       Uninitialized   = 0u,
       CacheDisabled   = 1u,
@@ -118,13 +275,22 @@ namespace dxvk {
     std::atomic<uint32_t>         m_useCount = { 0u };
 
     FilePaths                     m_filePaths;
+    uint64_t                      m_maxSize = 0u;
     dxvk::mutex                   m_fileMutex;
 
     util::File                    m_lutFile;
     util::File                    m_binFile;
 
+    util::FileView                m_lutView;
+    util::FileView                m_binView;
+
     std::atomic<Status>           m_status = { Status::Uninitialized };
 
+    LutIndex                      m_index;
+    size_t                        m_indexOffset = 0u;
+
+    std::vector<std::atomic<uint64_t>> m_usedSlots;
+
     std::unordered_map<LutKey, LutEntry, DxvkHash, DxvkEq> m_lut;
 
     dxvk::mutex                   m_writeMutex;
@@ -133,7 +299,7 @@ namespace dxvk {
 
     dxvk::thread                  m_writer;
 
-    DxvkShaderCache();
+    explicit DxvkShaderCache(uint64_t maxSize);
 
     bool ensureStatus(Status status);
 
@@ -147,14 +313,20 @@ namespace dxvk {
 
     bool parseLut();
 
-    Rc<DxvkIrShader> loadCachedShaderLocked(const LutKey& key, const LutEntry& entry);
+    bool rebuildIndexLocked(const std::vector<LutRecord>& records);
+
+    void invalidateLocked();
+
+    void writeUsageLocked();
+
+    std::optional<LutEntry> findEntry(const LutKey& key);
+
+    Rc<DxvkIrShader> loadCachedShader(const LutKey& key, const LutEntry& entry) const;
 
     bool writeShaderLutEntry(DxvkIrShader& shader, const LutEntry& entry);
 
     bool writeShaderToCache(DxvkIrShader& shader);
 
-    bool readShaderLutEntry(LutKey& key, LutEntry& entry, size_t& offset);
-
     void runWriter();
 
     void freeInstance();
@@ -163,8 +335,6 @@ namespace dxvk {
 
     static bool writeShaderCreateInfo(util::File& stream, const DxvkIrShaderCreateInfo& createInfo);
 
-    static bool writeShaderLayout(util::File& stream, const DxvkPipelineLayoutBuilder& layout);
-
     static bool writeShaderIo(util::File& stream, const DxvkShaderIo& io);
 
     static bool writeShaderMetadata(util::File& stream, const DxvkShaderMetadata& metadata);
@@ -173,57 +343,19 @@ namespace dxvk {
 
     static bool writeHeader(util::File& stream, const LutHeader& header);
 
-    static bool readShaderIo(util::File& stream, size_t& offset, DxvkShaderIo& io);
-
-    static bool readShaderXfbInfo(util::File& stream, size_t& offset, dxbc_spv::ir::IoXfbInfo& xfb);
-
-    static bool readShaderLutKey(util::File& stream, size_t& offset, LutKey& key);
-
-    static bool readShaderMetadata(util::File& stream, size_t& offset, DxvkShaderMetadata& metadata);
-
-    static bool readShaderLayout(util::File& stream, size_t& offset, DxvkPipelineLayoutBuilder& layout);
-
-    static bool writeBytes(util::File& stream, const char* data, size_t size) {
-      return stream.append(size, data);
-    }
-
-    static bool writeBytes(util::File& stream, const uint8_t* data, size_t size) {
-      return writeBytes(stream, reinterpret_cast<const char*>(data), size);
-    }
-
-    static bool writeString(util::File& stream, const std::string& string) {
-      return write(stream, uint16_t(string.size())) && writeBytes(stream, string.data(), string.size());
-    }
-
-    template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
-    static bool write(util::File& stream, const T& data) {
-      return writeBytes(stream, reinterpret_cast<const char*>(&data), sizeof(data));
-    }
+    static bool writeLutFile(util::File& stream, const std::vector<LutRecord>& records, uint32_t generation, LutIndex& index);
 
-    static bool readBytes(util::File& stream, char* data, size_t& offset, size_t size) {
-      bool result = stream.read(offset, size, data);
-      offset += size;
-      return result;
-    }
+    static bool readLutFile(const util::FileView& stream, size_t& indexOffset, LutIndex& index, std::vector<LutRecord>& records);
 
-    static bool readBytes(util::File& stream, uint8_t* data, size_t& offset, size_t size) {
-      return readBytes(stream, reinterpret_cast<char*>(data), offset, size);
-    }
+    static bool needsCompaction(const std::vector<LutRecord>& records, uint64_t lutSize, uint64_t binSize, uint64_t maxSize);
 
-    static bool readString(util::File& stream, size_t& offset, std::string& string) {
-      uint16_t len = 0u;
+    static bool readShaderIo(const util::FileView& stream, size_t& offset, DxvkShaderIo& io);
 
-      if (!read(stream, offset, len))
-        return false;
+    static bool readShaderXfbInfo(const util::FileView& stream, size_t& offset, dxbc_spv::ir::IoXfbInfo& xfb);
 
-      string.resize(len);
-      return readBytes(stream, string.data(), offset, len);
-    }
+    static bool readShaderLutKey(const util::FileView& stream, size_t& offset, LutKey& key);
 
-    template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
-    static bool read(util::File& stream, size_t& offset, T& data) {
-      return readBytes(stream, reinterpret_cast<char*>(&data), offset, sizeof(data));
-    }
+    static bool readShaderMetadata(const util::FileView& stream, size_t& offset, DxvkShaderMetadata& metadata);
 
   };
 
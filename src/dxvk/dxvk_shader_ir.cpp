@@ -3,11 +3,16 @@
 #include <spirv/spirv_builder.h>
 
 #include <util/util_log.h>
+#include <util/util_lz.h>
 
 #include "dxvk_shader_ir.h"
 
 namespace dxvk {
 
+  std::atomic<uint64_t> DxvkIrShader::s_rawIrSize = { 0u };
+  std::atomic<uint64_t> DxvkIrShader::s_storedIrSize = { 0u };
+
+
   size_t DxvkIrShaderCreateInfo::hash() const {
     static_assert(std::is_trivially_copyable_v<DxvkShaderOptions>);
 
@@ -1559,18 +1564,19 @@ namespace dxvk {
     const DxvkIrShaderCreateInfo&   info,
           DxvkShaderMetadata        metadata,
           DxvkPipelineLayoutBuilder layout,
-          std::vector<uint8_t>      ir)
+          std::vector<uint8_t>      ir,
+          size_t                    irSize)
   : m_debugName   (std::move(name)), m_info(info),
     m_layout      (std::move(layout)),
-    m_ir          (std::move(ir)),
     m_convertedIr (true),
     m_metadata    (std::move(metadata)) {
-
+    setIr(std::move(ir), irSize);
   }
 
 
   DxvkIrShader::~DxvkIrShader() {
-
+    s_rawIrSize -= m_irSize;
+    s_storedIrSize -= m_ir.size();
   }
 
 
@@ -1719,10 +1725,14 @@ namespace dxvk {
   }
 
 
-  std::pair<const uint8_t*, size_t> DxvkIrShader::getSerializedIr() {
+  DxvkSerializedIr DxvkIrShader::getSerializedIr() {
     convertIr("getSerializedIr()");
 
-    return std::make_pair(m_ir.data(), m_ir.size());
+    DxvkSerializedIr result;
+    result.data = m_ir.data();
+    result.size = m_ir.size();
+    result.rawSize = m_irSize;
+    return result;
   }
 
 
@@ -1731,6 +1741,14 @@ namespace dxvk {
   }
 
 
+  DxvkIrMemoryStats DxvkIrShader::getMemoryStats() {
+    DxvkIrMemoryStats stats;
+    stats.rawSize = s_rawIrSize.load(std::memory_order_relaxed);
+    stats.storedSize = s_storedIrSize.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+
   void DxvkIrShader::convertIr(const char* reason) {
     if (m_convertedIr.load(std::memory_order_acquire))
       return;
@@ -1842,18 +1860,50 @@ namespace dxvk {
     std::vector<uint8_t> data(serializer.computeSerializedSize());
     serializer.serialize(data.data(), data.size());
 
-    m_ir = std::move(data);
+    // Only keep the compressed IR around if it actually saves a
+    // meaningful amount of memory, since every use of the IR will
+    // have to decompress it first.
+    size_t size = data.size();
+
+    std::vector<uint8_t> compressed = lz::compress(data.data(), data.size());
+
+    if (compressed.size() < size - size / 8u)
+      setIr(std::move(compressed), size);
+    else
+      setIr(std::move(data), size);
   }
 
 
   void DxvkIrShader::deserializeIr(dxbc_spv::ir::Builder& builder) const {
-    dxbc_spv::ir::Deserializer deserializer(m_ir.data(), m_ir.size());
+    std::vector<uint8_t> data;
+
+    const uint8_t* ir = m_ir.data();
+
+    if (m_ir.size() < m_irSize) {
+      data.resize(m_irSize);
+
+      if (!lz::decompress(m_ir.data(), m_ir.size(), data.data(), data.size()))
+        throw DxvkError("Failed to decompress shader");
+
+      ir = data.data();
+    }
+
+    dxbc_spv::ir::Deserializer deserializer(ir, m_irSize);
 
     if (!deserializer.deserialize(builder))
       throw DxvkError("Failed to deserialize shader");
   }
 
 
+  void DxvkIrShader::setIr(std::vector<uint8_t> ir, size_t irSize) {
+    s_rawIrSize += irSize - m_irSize;
+    s_storedIrSize += ir.size() - m_ir.size();
+
+    m_ir = std::move(ir);
+    m_irSize = irSize;
+  }
+
+
   void DxvkIrShader::dumpSource(const std::string& path) {
     if (m_baseIr)
       m_baseIr->dumpSource(path);
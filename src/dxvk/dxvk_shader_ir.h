@@ -99,6 +99,31 @@ namespace dxvk {
   };
 
 
+  /**
+   * \brief Serialized IR
+   *
+   * The IR is stored compressed if that saves memory,
+   * in which case \c size is smaller than \c rawSize.
+   */
+  struct DxvkSerializedIr {
+    const uint8_t* data = nullptr;
+    size_t size = 0u;
+    size_t rawSize = 0u;
+  };
+
+
+  /**
+   * \brief Resident IR memory statistics
+   *
+   * Sums over all live IR shaders, useful to
+   * assess the effect of IR compression.
+   */
+  struct DxvkIrMemoryStats {
+    uint64_t rawSize = 0u;
+    uint64_t storedSize = 0u;
+  };
+
+
   /**
    * \brief DXBC-SPIRV IR shader
    */
@@ -115,7 +140,8 @@ namespace dxvk {
       const DxvkIrShaderCreateInfo&   info,
             DxvkShaderMetadata        metadata,
             DxvkPipelineLayoutBuilder layout,
-            std::vector<uint8_t>      ir);
+            std::vector<uint8_t>      ir,
+            size_t                    irSize);
 
     ~DxvkIrShader();
 
@@ -167,8 +193,12 @@ namespace dxvk {
 
     /**
      * \brief Queries serialized IR
+     *
+     * Returns the IR in the form it is stored in memory,
+     * which may be compressed.
+     * \returns Serialized IR
      */
-    std::pair<const uint8_t*, size_t> getSerializedIr();
+    DxvkSerializedIr getSerializedIr();
 
     /**
      * \brief Retrieves debug name for this shader
@@ -176,8 +206,17 @@ namespace dxvk {
      */
     std::string debugName();
 
+    /**
+     * \brief Queries resident IR memory statistics
+     * \returns Memory statistics for all IR shaders
+     */
+    static DxvkIrMemoryStats getMemoryStats();
+
   private:
 
+    static std::atomic<uint64_t>  s_rawIrSize;
+    static std::atomic<uint64_t>  s_storedIrSize;
+
     Rc<DxvkIrShaderConverter>     m_baseIr;
     std::string                   m_debugName;
 
@@ -187,6 +226,7 @@ namespace dxvk {
     dxvk::mutex                   m_mutex;
 
     std::vector<uint8_t>          m_ir;
+    size_t                        m_irSize = 0u;
     std::atomic<bool>             m_convertedIr = { false };
 
     DxvkShaderMetadata            m_metadata = { };
@@ -199,6 +239,8 @@ namespace dxvk {
 
     void deserializeIr(dxbc_spv::ir::Builder& builder) const;
 
+    void setIr(std::vector<uint8_t> ir, size_t irSize);
+
     void dumpSource(const std::string& dumpPath);
 
     void dumpSpv(const std::string& dumpPath);
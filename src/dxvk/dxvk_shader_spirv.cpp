@@ -45,6 +45,36 @@ namespace dxvk {
   }
 
 
+  DxvkSpirvShader::DxvkSpirvShader(
+    const DxvkSpirvShaderCreateInfo&  info,
+          DxvkPipelineLayoutBuilder&& layout,
+          SpirvCompressedBuffer&&     code)
+  : m_info(info), m_code(std::move(code)), m_layout(std::move(layout)) {
+    m_info.bindingCount = 0u;
+    m_info.bindings = nullptr;
+
+    // Push data blocks are already part of the layout
+    m_info.sharedPushData = DxvkPushDataBlock();
+    m_info.localPushData = DxvkPushDataBlock();
+
+    m_metadata.stage = VkShaderStageFlagBits(m_layout.getStageMask());
+    m_metadata.flatShadingInputs = info.flatShadingInputs;
+    m_metadata.rasterizedStream = info.xfbRasterizedStream;
+    m_metadata.patchVertexCount = info.patchVertexCount;
+
+    // Metadata and ID offsets are cheap to gather compared
+    // to the compilation, so don't bother serializing them.
+    SpirvCodeBuffer spirv = m_code.decompress();
+    gatherIdOffsets(spirv);
+    gatherMetadata(spirv);
+
+    if (!info.debugName.empty())
+      m_debugName = info.debugName;
+    else if (m_debugName.empty())
+      m_debugName = std::to_string(getCookie());
+  }
+
+
   DxvkSpirvShader::~DxvkSpirvShader() {
 
   }
@@ -63,8 +93,11 @@ namespace dxvk {
   SpirvCodeBuffer DxvkSpirvShader::getCode(
     const DxvkShaderBindingMap*       bindings,
     const DxvkShaderLinkage*          linkage) {
-    SpirvCodeBuffer spirvCode = m_code.decompress();
-    patchResourceBindingsAndIoLocations(spirvCode, bindings, linkage);
+    // Patch bindings while decoding so that we don't
+    // need another pass over the entire code buffer
+    SpirvCodeBuffer spirvCode = m_code.decompress([&] (const SpirvInstruction& ins) {
+      patchResourceBindingsAndIoLocations(ins, bindings, linkage);
+    });
 
     // Undefined I/O handling is coarse, and not supported for tessellation shaders.
     if (linkage) {
@@ -144,6 +177,9 @@ namespace dxvk {
         case spv::OpConstant:
         case spv::OpVariable: {
           m_idToOffset.insert({ ins.arg(2u), ins.offset() });
+
+          if (ins.opCode() == spv::OpVariable && spv::StorageClass(ins.arg(3u)) == spv::StorageClassOutput)
+            m_outputVariables.insert(ins.arg(2u));
         } break;
 
         case spv::OpFunction:
@@ -559,89 +595,82 @@ namespace dxvk {
 
 
   void DxvkSpirvShader::patchResourceBindingsAndIoLocations(
-          SpirvCodeBuffer&            code,
+    const SpirvInstruction&           ins,
     const DxvkShaderBindingMap*       bindings,
     const DxvkShaderLinkage*          linkage) const {
-    for (auto i = code.begin(); i != code.end(); i++) {
-      auto ins = *i;
+    switch (ins.opCode()) {
+      case spv::OpDecorate: {
+        auto objectId = ins.arg(1u);
+        auto decorationType = spv::Decoration(ins.arg(2u));
+        const auto& decoration = getDecoration(objectId, -1);
 
-      switch (ins.opCode()) {
-        case spv::OpDecorate: {
-          auto objectId = ins.arg(1u);
-          auto decorationType = spv::Decoration(ins.arg(2u));
-          const auto& decoration = getDecoration(objectId, -1);
+        switch (decorationType) {
+          case spv::DecorationDescriptorSet:
+          case spv::DecorationBinding: {
+            uint32_t set = 0u;
+            uint32_t binding = 0u;
 
-          switch (decorationType) {
-            case spv::DecorationDescriptorSet:
-            case spv::DecorationBinding: {
-              uint32_t set = 0u;
-              uint32_t binding = 0u;
+            if (decoration.set)
+              set = *decoration.set;
 
-              if (decoration.set)
-                set = *decoration.set;
+            if (decoration.binding)
+              binding = *decoration.binding;
 
-              if (decoration.binding)
-                binding = *decoration.binding;
+            auto mappedBinding = bindings->mapBinding(
+              DxvkShaderBinding(m_metadata.stage, set, binding));
 
-              auto mappedBinding = bindings->mapBinding(
-                DxvkShaderBinding(m_metadata.stage, set, binding));
+            if (mappedBinding) {
+              if (decorationType == spv::DecorationDescriptorSet)
+                ins.setArg(3u, mappedBinding->getSet());
 
-              if (mappedBinding) {
-                if (decorationType == spv::DecorationDescriptorSet)
-                  ins.setArg(3u, mappedBinding->getSet());
+              if (decorationType == spv::DecorationBinding)
+                ins.setArg(3u, mappedBinding->getBinding());
+            }
+          } break;
 
-                if (decorationType == spv::DecorationBinding)
-                  ins.setArg(3u, mappedBinding->getBinding());
-              }
-            } break;
+          case spv::DecorationLocation:
+          case spv::DecorationIndex: {
+            if (!linkage || !linkage->fsDualSrcBlend)
+              break;
 
-            case spv::DecorationLocation:
-            case spv::DecorationIndex: {
-              if (!linkage || !linkage->fsDualSrcBlend)
-                break;
+            // Ensure that what we're patching is actually an output variable.
+            // Variables are declared after decorations, so we can't look at
+            // the code here since it may not have been decoded yet.
+            if (m_outputVariables.find(ins.arg(1u)) == m_outputVariables.end())
+              break;
 
-              // Ensure that what we're patching is actually an output variable
-              SpirvInstruction var(code.data(), m_idToOffset.at(ins.arg(1u)), code.dwords());
+            // Set location to 0 or index to 1 for location 1
+            if (decoration.location == 1u)
+              ins.setArg(3u, decorationType == spv::DecorationIndex ? 1u : 0u);
+          } break;
 
-              if (spv::StorageClass(var.arg(3u)) != spv::StorageClassOutput)
-                break;
+          default:
+            break;
+        }
+      } break;
 
-              // Set location to 0 or index to 1 for location 1
-              if (decoration.location == 1u)
-                ins.setArg(3u, decorationType == spv::DecorationIndex ? 1u : 0u);
-            } break;
+      case spv::OpMemberDecorate: {
+        auto objectId = ins.arg(1u);
+        auto decorationType = spv::Decoration(ins.arg(3u));
 
-            default:
+        switch (decorationType) {
+          case spv::DecorationOffset: {
+            if (objectId != m_pushConstantStructId)
               break;
-          }
-        } break;
-
-        case spv::OpMemberDecorate: {
-          auto objectId = ins.arg(1u);
-          auto decorationType = spv::Decoration(ins.arg(3u));
-
-          switch (decorationType) {
-            case spv::DecorationOffset: {
-              if (objectId != m_pushConstantStructId)
-                break;
 
-              uint32_t offset = bindings->mapPushData(m_metadata.stage, ins.arg(4u));
+            uint32_t offset = bindings->mapPushData(m_metadata.stage, ins.arg(4u));
 
-              if (offset < MaxTotalPushDataSize)
-                ins.setArg(4u, offset);
-            } break;
-
-            default:
-              break;
-          }
-        } break;
+            if (offset < MaxTotalPushDataSize)
+              ins.setArg(4u, offset);
+          } break;
 
-        case spv::OpFunction:
-          return;
+          default:
+            break;
+        }
+      } break;
 
-        default:
-          break;
-      }
+      default:
+        break;
     }
   }
 
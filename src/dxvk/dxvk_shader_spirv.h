@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <unordered_set>
 
 #include "dxvk_shader.h"
 
@@ -66,6 +67,21 @@ namespace dxvk {
       const uint32_t(&code)[N])
     : DxvkSpirvShader(info, SpirvCodeBuffer(N, code)) { }
 
+    /**
+     * \brief Re-creates shader from a previously compiled one
+     *
+     * Used to restore shaders from an on-disk cache. The binding
+     * layout is taken as-is, so the binding and push data infos
+     * in the create info are ignored.
+     * \param [in] info Shader create info
+     * \param [in] layout Binding layout of the original shader
+     * \param [in] code Compressed code of the original shader
+     */
+    DxvkSpirvShader(
+      const DxvkSpirvShaderCreateInfo&  info,
+            DxvkPipelineLayoutBuilder&& layout,
+            SpirvCompressedBuffer&&     code);
+
     ~DxvkSpirvShader();
 
     /**
@@ -98,6 +114,14 @@ namespace dxvk {
      */
     DxvkPipelineLayoutBuilder getLayout();
 
+    /**
+     * \brief Queries compressed, unpatched shader code
+     * \returns Compressed SPIR-V code buffer
+     */
+    const SpirvCompressedBuffer& getCompressedCode() const {
+      return m_code;
+    }
+
     /**
      * \brief Dumps SPIR-V binary to a stream
      * \param [in] outputStream Stream to write to
@@ -124,6 +148,7 @@ namespace dxvk {
 
     std::unordered_multimap<uint32_t, DxvkSpirvDecorations> m_decorations = { };
     std::unordered_map<uint32_t, uint32_t> m_idToOffset = { };
+    std::unordered_set<uint32_t> m_outputVariables = { };
 
     void gatherIdOffsets(
             SpirvCodeBuffer&          code);
@@ -158,7 +183,7 @@ namespace dxvk {
             spv::BuiltIn              builtIn) const;
 
     void patchResourceBindingsAndIoLocations(
-            SpirvCodeBuffer&          code,
+      const SpirvInstruction&         ins,
       const DxvkShaderBindingMap*     bindings,
       const DxvkShaderLinkage*        linkage) const;
 
@@ -16,11 +16,18 @@ namespace dxvk {
     CmdDispatchCalls,         ///< Number of compute calls
     CmdRenderPassCount,       ///< Number of render passes
     CmdBarrierCount,          ///< Number of pipeline barriers
+    CmdBarrierLayoutCount,    ///< Number of batched barriers with layout transitions
+    CmdBarrierHostCount,      ///< Number of batched barriers with host access
+    CmdBarrierMergedCount,    ///< Number of barriers merged into others
     PipeCountGraphics,        ///< Number of graphics pipelines
     PipeCountLibrary,         ///< Number of graphics shader libraries
     PipeCountCompute,         ///< Number of compute pipelines
     PipeTasksDone,            ///< Boolean indicating compiler activity
     PipeTasksTotal,           ///< Boolean indicating compiler activity
+    PipeTasksQueued,          ///< Number of pending compiler tasks
+    PipeTasksStolen,          ///< Tasks taken from another worker's queue
+    ShaderCacheHits,          ///< Shaders loaded from the on-disk cache
+    ShaderCacheMisses,        ///< Shaders not found in the on-disk cache
     QueueSubmitCount,         ///< Number of command buffer submissions
     QueuePresentCount,        ///< Number of present calls / frames
     GpuSyncCount,             ///< Number of GPU synchronizations
@@ -30,6 +37,10 @@ namespace dxvk {
     CsSyncTicks,              ///< Time spent waiting on CS
     CsIdleTicks,              ///< CS thread idle time in microseconds
     CsChunkCount,             ///< Submitted CS chunks
+    CsChunkPoolHits,          ///< CS chunks allocated from a thread-local cache
+    CsChunkPoolMisses,        ///< CS chunks that required a shared pool access
+    MemoryDefragBytes,        ///< Amount of memory relocated
+    MemoryDefragChunks,       ///< Chunks freed after defragmentation
     DescriptorPoolCount,      ///< Descriptor pool count
     DescriptorSetCount,       ///< Descriptor sets allocated
     DescriptorHeapCount,      ///< Number of descriptor heaps created
@@ -1,5 +1,7 @@
 #include "dxvk_hud_item.h"
 
+#include "../dxvk_shader_ir.h"
+
 #include <hud_chunk_frag_background.h>
 #include <hud_chunk_frag_visualize.h>
 #include <hud_chunk_vert_background.h>
@@ -642,6 +644,8 @@ namespace dxvk::hud {
       m_dispatchCount   = diffCounters.getCtr(DxvkStatCounter::CmdDispatchCalls);
       m_renderPassCount = diffCounters.getCtr(DxvkStatCounter::CmdRenderPassCount);
       m_barrierCount    = diffCounters.getCtr(DxvkStatCounter::CmdBarrierCount);
+      m_layoutCount     = diffCounters.getCtr(DxvkStatCounter::CmdBarrierLayoutCount);
+      m_mergedCount     = diffCounters.getCtr(DxvkStatCounter::CmdBarrierMergedCount);
 
       m_lastUpdate = time;
     }
@@ -673,8 +677,12 @@ namespace dxvk::hud {
     renderer.drawText(16, { position.x + 192, position.y }, 0xffffffffu, str::format(m_renderPassCount));
     
     position.y += 20;
+    std::string barrierCount = m_layoutCount || m_mergedCount
+      ? str::format(m_barrierCount, " (", m_layoutCount, " layout, ", m_mergedCount, " merged)")
+      : str::format(m_barrierCount);
+
     renderer.drawText(16, position, 0xffff8040, "Barriers:");
-    renderer.drawText(16, { position.x + 192, position.y }, 0xffffffffu, str::format(m_barrierCount));
+    renderer.drawText(16, { position.x + 192, position.y }, 0xffffffffu, barrierCount);
     
     position.y += 8;
     return position;
@@ -698,6 +706,12 @@ namespace dxvk::hud {
     m_graphicsPipelines = counters.getCtr(DxvkStatCounter::PipeCountGraphics);
     m_graphicsLibraries = counters.getCtr(DxvkStatCounter::PipeCountLibrary);
     m_computePipelines  = counters.getCtr(DxvkStatCounter::PipeCountCompute);
+    m_shaderCacheHits   = counters.getCtr(DxvkStatCounter::ShaderCacheHits);
+    m_shaderCacheMisses = counters.getCtr(DxvkStatCounter::ShaderCacheMisses);
+
+    DxvkIrMemoryStats irStats = DxvkIrShader::getMemoryStats();
+    m_irRawSize         = irStats.rawSize;
+    m_irStoredSize      = irStats.storedSize;
   }
 
 
@@ -721,6 +735,22 @@ namespace dxvk::hud {
     renderer.drawText(16, position, 0xffff40ff, "Compute shaders:");
     renderer.drawText(16, { position.x + 240, position.y }, 0xffffffffu, str::format(m_computePipelines));
 
+    uint64_t shaderCacheLookups = m_shaderCacheHits + m_shaderCacheMisses;
+
+    if (shaderCacheLookups) {
+      position.y += 20;
+      renderer.drawText(16, position, 0xffff40ff, "Shader cache hits:");
+      renderer.drawText(16, { position.x + 240, position.y }, 0xffffffffu, str::format(
+        m_shaderCacheHits, " / ", shaderCacheLookups, " (", (100u * m_shaderCacheHits) / shaderCacheLookups, "%)"));
+    }
+
+    if (m_irRawSize) {
+      position.y += 20;
+      renderer.drawText(16, position, 0xffff40ff, "Shader IR:");
+      renderer.drawText(16, { position.x + 240, position.y }, 0xffffffffu, str::format(
+        m_irStoredSize >> 10u, " kB (", (100u * m_irStoredSize) / m_irRawSize, "% of ", m_irRawSize >> 10u, " kB)"));
+    }
+
     position.y += 8;
     return position;
   }
@@ -821,6 +851,10 @@ namespace dxvk::hud {
   void HudMemoryStatsItem::update(dxvk::high_resolution_clock::time_point time) {
     for (uint32_t i = 0; i < m_memory.memoryHeapCount; i++)
       m_heaps[i] = m_device->getMemoryStats(i);
+
+    DxvkStatCounters counters = m_device->getStatCounters();
+    m_defragBytes = counters.getCtr(DxvkStatCounter::MemoryDefragBytes);
+    m_defragChunks = counters.getCtr(DxvkStatCounter::MemoryDefragChunks);
   }
 
 
@@ -850,6 +884,16 @@ namespace dxvk::hud {
       position.y += 4;
     }
 
+    if (m_defragBytes) {
+      std::string text = str::format(m_defragBytes >> 20, " MB moved, ", m_defragChunks, " chunks freed");
+
+      position.y += 16;
+      renderer.drawText(16, position, 0xff40ffffu, "Defrag:");
+      renderer.drawText(16, { position.x + 168, position.y }, 0xffffffffu, text);
+
+      position.y += 4;
+    }
+
     position.y += 4;
     return position;
   }
@@ -421,6 +421,8 @@ namespace dxvk::hud {
     uint64_t          m_dispatchCount   = 0;
     uint64_t          m_renderPassCount = 0;
     uint64_t          m_barrierCount    = 0;
+    uint64_t          m_layoutCount     = 0;
+    uint64_t          m_mergedCount     = 0;
 
     dxvk::high_resolution_clock::time_point m_lastUpdate
       = dxvk::high_resolution_clock::now();
@@ -455,6 +457,11 @@ namespace dxvk::hud {
     uint64_t m_graphicsPipelines  = 0;
     uint64_t m_graphicsLibraries  = 0;
     uint64_t m_computePipelines   = 0;
+    uint64_t m_shaderCacheHits    = 0;
+    uint64_t m_shaderCacheMisses  = 0;
+
+    uint64_t m_irRawSize          = 0;
+    uint64_t m_irStoredSize       = 0;
 
   };
 
@@ -528,6 +535,9 @@ namespace dxvk::hud {
     VkPhysicalDeviceMemoryProperties  m_memory;
     DxvkMemoryStats                   m_heaps[VK_MAX_MEMORY_HEAPS];
 
+    uint64_t                          m_defragBytes = 0u;
+    uint64_t                          m_defragChunks = 0u;
+
   };
 
 
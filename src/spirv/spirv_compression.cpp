@@ -1,7 +1,170 @@
+#include <algorithm>
+#include <cstring>
+
 #include "spirv_compression.h"
 
+#include "../util/util_bit.h"
+
 namespace dxvk {
 
+  // The compressed format is designed around the structure of SPIR-V
+  // code, and consists of a stream of 32-bit values as follows:
+  // - The module header, if present, is stored verbatim.
+  // - Each instruction token is stored as (opcode << 5) | wordCount,
+  //   with a word count of 31 indicating that the actual word count
+  //   follows as a separate value, and a word count of 0 indicating
+  //   that the next value is a raw dword not part of an instruction.
+  // - The first four operands of each instruction are stored as the
+  //   zigzag-encoded delta to the corresponding operand of the last
+  //   instruction with the same opcode, which captures result IDs,
+  //   type IDs, decoration targets and literal enums well. Further
+  //   operands are stored verbatim.
+  // Values are then packed in groups of four that share the same byte
+  // width of 0, 1, 2 or 4 bytes, with two bits per group stored in a
+  // separate control stream. This allows decoding each group with a
+  // handful of SSE2 unpack instructions and no data-dependent branches
+  // other than selecting the group width.
+  constexpr uint32_t WordCountBits   = 5u;
+  constexpr uint32_t WordCountEscape = (1u << WordCountBits) - 1u;
+  constexpr uint32_t DeltaArgCount   = 4u;
+
+  constexpr std::array<uint32_t, 4> GroupWidths = { 0u, 1u, 2u, 4u };
+
+
+  static uint32_t zigzagEncode(uint32_t value) {
+    return (value << 1u) ^ uint32_t(int32_t(value) >> 31);
+  }
+
+
+  static uint32_t zigzagDecode(uint32_t value) {
+    return (value >> 1u) ^ (0u - (value & 1u));
+  }
+
+
+  static uint32_t computeGroupWidth(const uint32_t* values) {
+    uint32_t max = values[0u] | values[1u] | values[2u] | values[3u];
+
+    if (!max)
+      return 0x0u;
+
+    if (max < 0x100u)
+      return 0x1u;
+
+    if (max < 0x10000u)
+      return 0x2u;
+
+    return 0x3u;
+  }
+
+
+  SpirvDecoder::SpirvDecoder(const SpirvCompressedBuffer& buffer) {
+    if (buffer.m_code.empty())
+      return;
+
+    SpirvCompressedBuffer::Header header;
+    std::memcpy(&header, buffer.m_code.data(), sizeof(header));
+
+    m_valueCount = header.valueCount;
+    m_rawCount = header.rawCount;
+
+    m_control = reinterpret_cast<const uint8_t*>(buffer.m_code.data()) + sizeof(header);
+    m_data = m_control + header.controlSize;
+  }
+
+
+  uint32_t SpirvDecoder::decodeHeader(uint32_t* dst) {
+    for (uint32_t i = 0u; i < m_rawCount; i++)
+      dst[i] = nextValue();
+
+    return m_rawCount;
+  }
+
+
+  uint32_t SpirvDecoder::decodeInstruction(uint32_t* dst) {
+    if (!m_valueCount)
+      return 0u;
+
+    uint32_t token = nextValue();
+
+    uint32_t op = token >> WordCountBits;
+    uint32_t length = token & WordCountEscape;
+
+    if (unlikely(!length)) {
+      dst[0u] = nextValue();
+      return 1u;
+    }
+
+    if (unlikely(length == WordCountEscape))
+      length = nextValue();
+
+    dst[0u] = op | (length << spv::WordCountShift);
+
+    auto& history = m_history[op % m_history.size()];
+
+    if (history.op != op) {
+      history.op = op;
+      history.args = { };
+    }
+
+    uint32_t deltaCount = std::min(length - 1u, DeltaArgCount);
+
+    for (uint32_t i = 0u; i < deltaCount; i++) {
+      history.args[i] += zigzagDecode(nextValue());
+      dst[i + 1u] = history.args[i];
+    }
+
+    for (uint32_t i = deltaCount + 1u; i < length; i++)
+      dst[i] = nextValue();
+
+    return length;
+  }
+
+
+  void SpirvDecoder::refill() {
+    // Each control byte covers four groups of four values
+    uint32_t control = *(m_control++);
+
+    for (uint32_t i = 0u; i < 4u; i++) {
+      uint32_t width = GroupWidths[(control >> (2u * i)) & 0x3u];
+      uint32_t* dst = &m_buffer[4u * i];
+
+#ifdef DXVK_ARCH_X86
+      __m128i zero = _mm_setzero_si128();
+      __m128i data = zero;
+
+      if (width == 1u) {
+        int32_t bytes;
+        std::memcpy(&bytes, m_data, sizeof(bytes));
+        data = _mm_cvtsi32_si128(bytes);
+        data = _mm_unpacklo_epi8(data, zero);
+        data = _mm_unpacklo_epi16(data, zero);
+      } else if (width == 2u) {
+        data = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(m_data));
+        data = _mm_unpacklo_epi16(data, zero);
+      } else if (width == 4u) {
+        data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_data));
+      }
+
+      _mm_store_si128(reinterpret_cast<__m128i*>(dst), data);
+#else
+      for (uint32_t j = 0u; j < 4u; j++) {
+        uint32_t value = 0u;
+
+        for (uint32_t k = 0u; k < width; k++)
+          value |= uint32_t(m_data[j * width + k]) << (8u * k);
+
+        dst[j] = value;
+      }
+#endif
+
+      m_data += 4u * width;
+    }
+
+    m_bufferIndex = 0u;
+    m_bufferCount = std::min<uint32_t>(m_buffer.size(), m_valueCount);
+  }
+
+
   SpirvCompressedBuffer::SpirvCompressedBuffer()
   : m_size(0) {
 
@@ -10,114 +173,110 @@ namespace dxvk {
 
   SpirvCompressedBuffer::SpirvCompressedBuffer(SpirvCodeBuffer& code)
   : m_size(code.dwords()) {
-    // The compression (detailed below) achieves roughly 55% of the
-    // original size on average and is very consistent, so an initial
-    // estimate of roughly 58% will be accurate most of the time.
     const uint32_t* data = code.data();
-    m_code.reserve((m_size * 75) / 128);
-
-    std::array<uint32_t, 16> block;
-    uint32_t blockMask = 0;
-    uint32_t blockOffset = 0;
-
-    // The algorithm used is a simple variable-to-fixed compression that
-    // encodes up to two consecutive SPIR-V tokens into one DWORD using
-    // a small number of different encodings. While not achieving great
-    // compression ratios, the main goal is to allow decompression code
-    // to be fast, with short dependency chains.
-    // Compressed tokens are stored in blocks of 16 DWORDs, each preceeded
-    // by a single DWORD which stores the layout for each DWORD, two bits
-    // each. The supported layouts, are as follows:
-    // 0x0: 1x 32-bit;  0x1: 1x 20-bit + 1x 12-bit
-    // 0x2: 2x 16-bit;  0x3: 1x 12-bit + 1x 20-bit
-    // These layouts are chosen to allow reasonably efficient encoding of
-    // opcode tokens, which usually fit into 20 bits, followed by type IDs,
-    // which tend to be low as well since most types are defined early.
-    for (size_t i = 0; i < m_size; ) {
-      if (likely(i + 1 < m_size)) {
-        uint32_t a = data[i];
-        uint32_t b = data[i + 1];
-        uint32_t schema;
-        uint32_t encode;
-
-        if (std::max(a, b) < (1u << 16)) {
-          schema = 0x2;
-          encode = a | (b << 16);
-        } else if (a < (1u << 20) && b < (1u << 12)) {
-          schema = 0x1;
-          encode = a | (b << 20);
-        } else if (a < (1u << 12) && b < (1u << 20)) {
-          schema = 0x3;
-          encode = a | (b << 12);
-        } else {
-          schema = 0x0;
-          encode = a;
-        }
-
-        block[blockOffset] = encode;
-        blockMask |= schema << (blockOffset << 1);
-        blockOffset += 1;
-
-        i += schema ? 2 : 1;
+
+    std::vector<uint32_t> values;
+    values.reserve(m_size + 16u);
+
+    // Store module header verbatim
+    uint32_t rawCount = 0u;
+
+    if (m_size >= 5u && data[0u] == spv::MagicNumber) {
+      rawCount = 5u;
+      values.insert(values.end(), data, data + rawCount);
+    }
+
+    std::array<std::pair<uint32_t, std::array<uint32_t, 4>>, 64> history;
+
+    for (auto& h : history)
+      h.first = ~0u;
+
+    for (size_t i = rawCount; i < m_size; ) {
+      uint32_t op = data[i] & spv::OpCodeMask;
+      uint32_t length = data[i] >> spv::WordCountShift;
+
+      // Emit raw dword if the code is malformed
+      if (unlikely(!length || length > m_size - i)) {
+        values.push_back(0u);
+        values.push_back(data[i++]);
+        continue;
+      }
+
+      if (length < WordCountEscape) {
+        values.push_back((op << WordCountBits) | length);
       } else {
-        block[blockOffset] = data[i++];
-        blockOffset += 1;
+        values.push_back((op << WordCountBits) | WordCountEscape);
+        values.push_back(length);
+      }
+
+      auto& h = history[op % history.size()];
+
+      if (h.first != op) {
+        h.first = op;
+        h.second = { };
       }
 
-      if (unlikely(blockOffset == 16) || unlikely(i == m_size)) {
-        m_code.insert(m_code.end(), blockMask);
-        m_code.insert(m_code.end(), block.begin(), block.begin() + blockOffset);
+      uint32_t deltaCount = std::min(length - 1u, DeltaArgCount);
 
-        blockMask = 0;
-        blockOffset = 0;
+      for (uint32_t j = 0u; j < deltaCount; j++) {
+        uint32_t arg = data[i + j + 1u];
+        values.push_back(zigzagEncode(arg - h.second[j]));
+        h.second[j] = arg;
       }
+
+      values.insert(values.end(), &data[i + deltaCount + 1u], &data[i + length]);
+      i += length;
     }
 
-    // Only shrink the array if we have lots of overhead for some reason.
-    // This should only happen on shaders where our initial estimate was
-    // too small. In general, we want to avoid reallocation here.
-    if (m_code.capacity() > (m_code.size() * 10) / 9)
-      m_code.shrink_to_fit();
-  }
+    // Pad value stream to a multiple of 16 so that the
+    // decoder can always process entire control bytes
+    Header header = { };
+    header.valueCount = uint32_t(values.size());
+    header.rawCount = rawCount;
 
-    
-  SpirvCompressedBuffer::~SpirvCompressedBuffer() {
+    values.resize(align(values.size(), 16u));
 
-  }
+    std::vector<uint8_t> control(values.size() / 16u);
+    std::vector<uint8_t> bytes;
+    bytes.reserve(values.size() * 2u);
 
+    for (size_t i = 0u; i < values.size(); i += 4u) {
+      uint32_t width = computeGroupWidth(&values[i]);
+      control[i / 16u] |= width << (2u * ((i / 4u) % 4u));
 
-  SpirvCodeBuffer SpirvCompressedBuffer::decompress() const {
-    SpirvCodeBuffer code(m_size);
-    uint32_t* data = code.data();
+      for (uint32_t j = 0u; j < 4u; j++) {
+        for (uint32_t k = 0u; k < GroupWidths[width]; k++)
+          bytes.push_back(uint8_t(values[i + j] >> (8u * k)));
+      }
+    }
 
-    uint32_t srcOffset = 0;
-    uint32_t dstOffset = 0;
+    header.controlSize = uint32_t(control.size());
 
-    constexpr uint32_t shiftAmounts = 0x0c101420;
+    size_t totalSize = sizeof(header) + control.size() + bytes.size();
+    m_code.resize(align(totalSize, sizeof(uint32_t)) / sizeof(uint32_t));
 
-    while (dstOffset < m_size) {
-      uint32_t blockMask = m_code[srcOffset];
+    auto dst = reinterpret_cast<uint8_t*>(m_code.data());
+    std::memcpy(dst, &header, sizeof(header));
+    std::memcpy(dst + sizeof(header), control.data(), control.size());
+    std::memcpy(dst + sizeof(header) + control.size(), bytes.data(), bytes.size());
+  }
 
-      for (uint32_t i = 0; i < 16 && dstOffset < m_size; i++) {
-        // Use 64-bit integers for some of the operands so we can
-        // shift by 32 bits and not handle it as a special cases
-        uint32_t schema = (blockMask >> (i << 1)) & 0x3;
-        uint32_t shift  = (shiftAmounts >> (schema << 3)) & 0xff;
-        uint64_t mask   = ~(~0ull << shift);
-        uint64_t encode = m_code[srcOffset + i + 1];
 
-        data[dstOffset] = encode & mask;
+  SpirvCompressedBuffer::SpirvCompressedBuffer(
+          size_t                  size,
+          std::vector<uint32_t>&& data)
+  : m_size(size), m_code(std::move(data)) {
 
-        if (likely(schema))
-          data[dstOffset + 1] = encode >> shift;
+  }
 
-        dstOffset += schema ? 2 : 1;
-      }
 
-      srcOffset += 17;
-    }
+  SpirvCompressedBuffer::~SpirvCompressedBuffer() {
+
+  }
 
-    return code;
+
+  SpirvCodeBuffer SpirvCompressedBuffer::decompress() const {
+    return decompress([] (const SpirvInstruction&) { });
   }
 
-}
\ No newline at end of file
+}
@@ -1,11 +1,80 @@
 #pragma once
 
+#include <array>
 #include <vector>
 
 #include "spirv_code_buffer.h"
 
+#include "../util/util_likely.h"
+
 namespace dxvk {
 
+  class SpirvCompressedBuffer;
+
+  /**
+   * \brief Streaming SPIR-V decoder
+   *
+   * Decodes one instruction at a time from a compressed
+   * buffer, so that consumers can process instructions
+   * while they are still hot in the cache.
+   */
+  class SpirvDecoder {
+
+  public:
+
+    explicit SpirvDecoder(const SpirvCompressedBuffer& buffer);
+
+    /**
+     * \brief Decodes module header
+     *
+     * Must be called once before decoding any instructions.
+     * \param [out] dst Destination pointer
+     * \returns Number of dwords written
+     */
+    uint32_t decodeHeader(uint32_t* dst);
+
+    /**
+     * \brief Decodes next instruction
+     *
+     * \param [out] dst Destination pointer. Must have room for
+     *    the remainder of the uncompressed code.
+     * \returns Number of dwords written, or 0 if the end of
+     *    the stream has been reached.
+     */
+    uint32_t decodeInstruction(uint32_t* dst);
+
+  private:
+
+    struct OpHistory {
+      uint32_t op = ~0u;
+      std::array<uint32_t, 4> args = { };
+    };
+
+    const uint8_t*  m_control   = nullptr;
+    const uint8_t*  m_data      = nullptr;
+
+    uint32_t        m_valueCount  = 0u;
+    uint32_t        m_rawCount    = 0u;
+
+    uint32_t        m_bufferIndex = 0u;
+    uint32_t        m_bufferCount = 0u;
+
+    alignas(16) std::array<uint32_t, 16>  m_buffer = { };
+    std::array<OpHistory, 64>             m_history = { };
+
+    uint32_t nextValue() {
+      if (unlikely(m_bufferIndex == m_bufferCount))
+        refill();
+
+      m_valueCount -= 1u;
+      return m_buffer[m_bufferIndex++];
+    }
+
+    void refill();
+
+  };
+
+
   /**
    * \brief Compressed SPIR-V code buffer
    *
@@ -13,26 +82,76 @@ namespace dxvk {
    * to keep memory footprint low.
    */
   class SpirvCompressedBuffer {
-
+    friend class SpirvDecoder;
   public:
 
     SpirvCompressedBuffer();
 
     SpirvCompressedBuffer(SpirvCodeBuffer& code);
-    
+
+    SpirvCompressedBuffer(
+            size_t                  size,
+            std::vector<uint32_t>&& data);
+
     ~SpirvCompressedBuffer();
-    
+
     SpirvCodeBuffer decompress() const;
 
+    /**
+     * \brief Decompresses code and processes instructions
+     *
+     * Invokes the given function for each instruction right after
+     * it has been decoded. The function may modify the instruction
+     * in place, which avoids a separate pass over the code.
+     * \param [in] proc Function taking a \c SpirvInstruction
+     * \returns Uncompressed code buffer
+     */
+    template<typename Proc>
+    SpirvCodeBuffer decompress(const Proc& proc) const {
+      SpirvCodeBuffer code(m_size);
+      SpirvDecoder decoder(*this);
+
+      uint32_t* data = code.data();
+      uint32_t offset = decoder.decodeHeader(data);
+
+      while (uint32_t length = decoder.decodeInstruction(&data[offset])) {
+        proc(SpirvInstruction(data, offset, m_size));
+        offset += length;
+      }
+
+      return code;
+    }
+
+    /**
+     * \brief Size of the uncompressed code, in dwords
+     * \returns Uncompressed dword count
+     */
+    size_t dwords() const {
+      return m_size;
+    }
+
+    /**
+     * \brief Compressed data
+     *
+     * Can be used to serialize the compressed buffer
+     * and re-create it later without re-compressing.
+     * \returns Compressed dwords
+     */
+    const std::vector<uint32_t>& getCompressedData() const {
+      return m_code;
+    }
+
   private:
 
+    struct Header {
+      uint32_t valueCount;
+      uint32_t controlSize;
+      uint32_t rawCount;
+    };
+
     size_t                m_size;
     std::vector<uint32_t> m_code;
 
-    void encodeDword(uint32_t dw);
-
-    uint32_t decodeDword(size_t& offset) const;
-
   };
 
-}
\ No newline at end of file
+}
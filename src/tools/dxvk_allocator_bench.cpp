@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../dxvk/dxvk_allocator.h"
+
+#include "../util/util_likely.h"
+#include "../util/util_math.h"
+#include "../util/util_time.h"
+
+using namespace dxvk;
+
+namespace {
+
+  struct BenchArgs {
+    uint32_t operationCount = 1000000u;
+    uint32_t chunkCount     = 16u;
+    uint32_t seed           = 1u;
+  };
+
+
+  /**
+   * \brief Pre-generated allocator operation
+   *
+   * Allocations store their result in the given slot,
+   * and frees release whatever allocation is in the slot,
+   * so that the same seed always produces the same stream.
+   */
+  struct Operation {
+    bool     free;
+    uint32_t slot;
+    uint32_t count;
+    uint32_t alignment;
+  };
+
+
+  struct BenchResult {
+    uint64_t totalNs      = 0u;
+    uint64_t p50Ns        = 0u;
+    uint64_t p99Ns        = 0u;
+    uint64_t maxNs        = 0u;
+    uint32_t chunksAdded  = 0u;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [operations] [initial chunks] [seed]\n\n", name);
+    std::printf("Replays a random stream of page allocations and frees against\n");
+    std::printf("the page allocator. Memory is first filled to about 80%%, and\n");
+    std::printf("then allocations are freed and replaced at random. Reports the\n");
+    std::printf("average, median, 99th percentile and maximum time per operation.\n");
+  }
+
+
+  std::vector<Operation> generateOperations(const BenchArgs& args) {
+    std::mt19937 rng(args.seed);
+
+    uint64_t targetPages = uint64_t(args.chunkCount) * (4u << DxvkPageAllocator::ChunkPageBits) / 5u;
+    uint64_t livePages = 0u;
+
+    std::vector<Operation> ops;
+    ops.reserve(args.operationCount);
+
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    uint32_t slotCount = 0u;
+
+    while (ops.size() < args.operationCount) {
+      bool alloc = livePages < targetPages;
+
+      // Once the fill level is reached, mix
+      // allocations and frees about evenly
+      if (livePages + 256u >= targetPages && !live.empty())
+        alloc = rng() % 2u;
+
+      if (alloc) {
+        // Mostly small allocations, like buffers and small
+        // images, with the occasional large render target
+        uint32_t maxCount = (rng() % 16u) ? 16u : 256u;
+        uint32_t alignment = 1u << (rng() % 5u);
+        uint32_t count = align(1u + rng() % maxCount, alignment);
+
+        live.push_back({ slotCount, count });
+        livePages += count;
+
+        ops.push_back({ false, slotCount++, count, alignment });
+      } else {
+        size_t index = rng() % live.size();
+        auto entry = live[index];
+
+        live[index] = live.back();
+        live.pop_back();
+
+        livePages -= entry.second;
+        ops.push_back({ true, entry.first, entry.second, 1u });
+      }
+    }
+
+    return ops;
+  }
+
+
+  BenchResult runBench(const BenchArgs& args, const std::vector<Operation>& ops, uint32_t slotCount) {
+    DxvkPageAllocator allocator;
+
+    for (uint32_t i = 0u; i < args.chunkCount; i++)
+      allocator.addChunk(DxvkPageAllocator::MaxChunkSize);
+
+    std::vector<int32_t> slots(slotCount, -1);
+    std::vector<uint64_t> times;
+    times.reserve(ops.size());
+
+    BenchResult result = { };
+
+    for (const auto& op : ops) {
+      auto t0 = high_resolution_clock::now();
+
+      if (!op.free) {
+        int32_t index = allocator.allocPages(op.count, op.alignment);
+
+        if (unlikely(index < 0)) {
+          // Fragmentation may require more memory,
+          // just like the real allocator would do
+          allocator.addChunk(DxvkPageAllocator::MaxChunkSize);
+          index = allocator.allocPages(op.count, op.alignment);
+          result.chunksAdded += 1u;
+        }
+
+        slots[op.slot] = index;
+      } else {
+        allocator.freePages(uint32_t(slots[op.slot]), op.count);
+      }
+
+      auto t1 = high_resolution_clock::now();
+      times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    }
+
+    for (uint64_t t : times)
+      result.totalNs += t;
+
+    std::sort(times.begin(), times.end());
+
+    result.p50Ns = times[times.size() / 2u];
+    result.p99Ns = times[size_t(double(times.size() - 1u) * 0.99)];
+    result.maxNs = times.back();
+    return result;
+  }
+
+
+  void printResult(const BenchResult& result, size_t opCount) {
+    std::printf("%8.1f ns/op, p50 %6llu ns, p99 %6llu ns, max %8llu ns, %u chunks added\n",
+      double(result.totalNs) / double(opCount),
+      (unsigned long long)result.p50Ns, (unsigned long long)result.p99Ns,
+      (unsigned long long)result.maxNs, result.chunksAdded);
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+
+  if (argc > 4) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (argc > 1) args.operationCount = std::strtoul(argv[1], nullptr, 10);
+  if (argc > 2) args.chunkCount     = std::strtoul(argv[2], nullptr, 10);
+  if (argc > 3) args.seed           = std::strtoul(argv[3], nullptr, 10);
+
+  if (!args.operationCount || !args.chunkCount) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  auto ops = generateOperations(args);
+
+  uint32_t slotCount = 0u;
+
+  for (const auto& op : ops)
+    slotCount += op.free ? 0u : 1u;
+
+  std::printf("%u operations, %u initial chunks of %u pages\n",
+    args.operationCount, args.chunkCount, 1u << DxvkPageAllocator::ChunkPageBits);
+
+  printResult(runBench(args, ops, slotCount), ops.size());
+  return 0;
+}
@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../dxvk/dxvk_allocator.h"
+
+#include "../util/util_math.h"
+#include "../util/util_string.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of random operations per test */
+  constexpr uint32_t OperationCount = 200000u;
+
+  /** Number of operations between full page mask comparisons */
+  constexpr uint32_t ValidationInterval = 997u;
+
+  /** Number of chunks to start with */
+  constexpr uint32_t InitialChunkCount = 4u;
+
+  /** Maximum number of live chunks */
+  constexpr uint32_t MaxChunkCount = 16u;
+
+  uint32_t g_failures = 0u;
+
+
+  void fail(const std::string& message) {
+    if (g_failures++ < 32u)
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+  }
+
+
+  /**
+   * \brief Reference model of a page allocator
+   *
+   * Tracks page usage with one flag per page, so that allocations
+   * can be validated and allocation failures can be checked for
+   * whether any suitable free range exists at all.
+   */
+  struct ReferenceChunk {
+    std::vector<uint8_t>  pages;
+    uint32_t              pagesUsed = 0u;
+    bool                  disabled  = false;
+    bool                  removed   = false;
+  };
+
+
+  struct PageAllocation {
+    uint32_t index;
+    uint32_t count;
+  };
+
+
+  class PageAllocatorTest {
+
+  public:
+
+    PageAllocatorTest(uint32_t seed)
+    : m_rng(seed) {
+      for (uint32_t i = 0u; i < InitialChunkCount; i++)
+        addChunk();
+    }
+
+    void run() {
+      for (uint32_t i = 0u; i < OperationCount && !g_failures; i++) {
+        uint32_t op = m_rng() % 100u;
+
+        if (op < 50u)
+          allocPages();
+        else if (op < 96u)
+          freePages();
+        else if (op < 98u)
+          toggleChunk();
+        else
+          recycleChunk();
+
+        if (!(i % ValidationInterval))
+          validateMasks();
+      }
+
+      while (!m_allocations.empty() && !g_failures)
+        freePages();
+
+      validateMasks();
+
+      for (uint32_t i = 0u; i < m_chunks.size(); i++) {
+        if (!m_chunks[i].removed)
+          if (m_allocator.pagesUsed(i))
+            fail(str::format("Chunk ", i, " not empty after freeing all pages"));
+      }
+    }
+
+  private:
+
+    std::mt19937                m_rng;
+    DxvkPageAllocator           m_allocator;
+
+    std::vector<ReferenceChunk> m_chunks;
+    std::vector<PageAllocation> m_allocations;
+
+    void addChunk() {
+      // Use odd page counts as well to exercise partial chunks
+      uint32_t pageCount = 1u + m_rng() % (1u << DxvkPageAllocator::ChunkPageBits);
+      uint32_t chunkIndex = m_allocator.addChunk(uint64_t(pageCount) * DxvkPageAllocator::PageSize);
+
+      if (chunkIndex >= m_chunks.size())
+        m_chunks.resize(chunkIndex + 1u);
+
+      auto& chunk = m_chunks[chunkIndex];
+      chunk.pages.assign(pageCount, 0u);
+      chunk.pagesUsed = 0u;
+      chunk.disabled = false;
+      chunk.removed = false;
+
+      if (m_allocator.pageCount(chunkIndex) != pageCount) {
+        fail(str::format("Chunk ", chunkIndex, " has ",
+          m_allocator.pageCount(chunkIndex), " pages, expected ", pageCount));
+      }
+    }
+
+    uint32_t getRandomPageCount() {
+      // Mostly small allocations, with the occasional large one
+      uint32_t maxCount = (m_rng() % 8u) ? 16u : 1024u;
+      return 1u + m_rng() % maxCount;
+    }
+
+    bool canAllocate(uint32_t count, uint32_t alignment) const {
+      for (const auto& chunk : m_chunks) {
+        if (chunk.disabled || chunk.removed)
+          continue;
+
+        uint32_t pageCount = uint32_t(chunk.pages.size());
+        uint32_t runStart = 0u;
+
+        // Check whether any run of free pages can
+        // hold the allocation after applying alignment
+        for (uint32_t i = 0u; i <= pageCount; i++) {
+          if (i < pageCount && !chunk.pages[i])
+            continue;
+
+          if (align(runStart, alignment) + count <= i)
+            return true;
+
+          runStart = i + 1u;
+        }
+      }
+
+      return false;
+    }
+
+    void allocPages() {
+      uint32_t alignment = 1u << (m_rng() % 5u);
+      uint32_t count = align(getRandomPageCount(), alignment);
+
+      int32_t index = m_allocator.allocPages(count, alignment);
+
+      if (index < 0) {
+        if (canAllocate(count, alignment)) {
+          fail(str::format("Failed to allocate ", count,
+            " pages with alignment ", alignment, " despite free space"));
+        }
+
+        return;
+      }
+
+      uint32_t chunkIndex = uint32_t(index) >> DxvkPageAllocator::ChunkPageBits;
+      uint32_t pageIndex = uint32_t(index) & DxvkPageAllocator::ChunkPageMask;
+
+      if (chunkIndex >= m_chunks.size() || m_chunks[chunkIndex].removed) {
+        fail(str::format("Allocation in invalid chunk ", chunkIndex));
+        return;
+      }
+
+      auto& chunk = m_chunks[chunkIndex];
+
+      if (chunk.disabled)
+        fail(str::format("Allocation in disabled chunk ", chunkIndex));
+
+      if (pageIndex % alignment)
+        fail(str::format("Page ", pageIndex, " not aligned to ", alignment));
+
+      if (pageIndex + count > chunk.pages.size()) {
+        fail(str::format("Allocation ", pageIndex, "+", count,
+          " exceeds chunk ", chunkIndex, " size ", chunk.pages.size()));
+        return;
+      }
+
+      for (uint32_t i = 0u; i < count; i++) {
+        if (chunk.pages[pageIndex + i])
+          fail(str::format("Page ", pageIndex + i, " in chunk ", chunkIndex, " allocated twice"));
+
+        chunk.pages[pageIndex + i] = 1u;
+      }
+
+      chunk.pagesUsed += count;
+      m_allocations.push_back({ uint32_t(index), count });
+
+      if (m_allocator.pagesUsed(chunkIndex) != chunk.pagesUsed) {
+        fail(str::format("Chunk ", chunkIndex, " reports ",
+          m_allocator.pagesUsed(chunkIndex), " used pages, expected ", chunk.pagesUsed));
+      }
+    }
+
+    void freePages() {
+      if (m_allocations.empty())
+        return;
+
+      size_t index = m_rng() % m_allocations.size();
+      PageAllocation allocation = m_allocations[index];
+
+      m_allocations[index] = m_allocations.back();
+      m_allocations.pop_back();
+
+      uint32_t chunkIndex = allocation.index >> DxvkPageAllocator::ChunkPageBits;
+      uint32_t pageIndex = allocation.index & DxvkPageAllocator::ChunkPageMask;
+
+      auto& chunk = m_chunks[chunkIndex];
+
+      for (uint32_t i = 0u; i < allocation.count; i++)
+        chunk.pages[pageIndex + i] = 0u;
+
+      chunk.pagesUsed -= allocation.count;
+
+      bool chunkFreed = m_allocator.freePages(allocation.index, allocation.count);
+
+      if (chunkFreed != !chunk.pagesUsed) {
+        fail(str::format("Freeing pages in chunk ", chunkIndex,
+          " returned ", chunkFreed, " with ", chunk.pagesUsed, " pages in use"));
+      }
+    }
+
+    void toggleChunk() {
+      uint32_t chunkIndex = m_rng() % m_chunks.size();
+      auto& chunk = m_chunks[chunkIndex];
+
+      if (chunk.removed)
+        return;
+
+      if (chunk.disabled)
+        m_allocator.reviveChunk(chunkIndex);
+      else
+        m_allocator.killChunk(chunkIndex);
+
+      chunk.disabled = !chunk.disabled;
+
+      if (m_allocator.chunkIsAvailable(chunkIndex) == chunk.disabled)
+        fail(str::format("Chunk ", chunkIndex, " availability not updated"));
+    }
+
+    void recycleChunk() {
+      // Remove an empty chunk if there is any, and add a new
+      // one so that chunk indices get reused over time.
+      uint32_t liveCount = 0u;
+
+      for (uint32_t i = 0u; i < m_chunks.size(); i++) {
+        auto& chunk = m_chunks[i];
+
+        if (!chunk.removed && !chunk.pagesUsed) {
+          m_allocator.removeChunk(i);
+
+          chunk.pages.clear();
+          chunk.removed = true;
+        } else if (!chunk.removed) {
+          liveCount += 1u;
+        }
+      }
+
+      if (liveCount < MaxChunkCount)
+        addChunk();
+    }
+
+    void validateMasks() {
+      std::vector<uint32_t> mask((1u << DxvkPageAllocator::ChunkPageBits) / 32u);
+
+      for (uint32_t i = 0u; i < m_chunks.size(); i++) {
+        const auto& chunk = m_chunks[i];
+
+        if (chunk.removed)
+          continue;
+
+        std::fill(mask.begin(), mask.end(), 0u);
+        m_allocator.getPageAllocationMask(i, mask.data());
+
+        for (uint32_t j = 0u; j < chunk.pages.size(); j++) {
+          bool used = (mask[j / 32u] >> (j % 32u)) & 1u;
+
+          if (used != bool(chunk.pages[j])) {
+            fail(str::format("Page ", j, " in chunk ", i,
+              " is ", used ? "used" : "free", " in allocation mask"));
+            return;
+          }
+        }
+      }
+    }
+
+  };
+
+
+  /**
+   * \brief Pool allocator test
+   *
+   * Performs random small allocations and checks that
+   * returned address ranges never overlap and are
+   * aligned to their size class.
+   */
+  class PoolAllocatorTest {
+
+  public:
+
+    PoolAllocatorTest(uint32_t seed)
+    : m_rng(seed) { }
+
+    void run() {
+      for (uint32_t i = 0u; i < OperationCount && !g_failures; i++) {
+        if (m_rng() % 2u)
+          alloc();
+        else
+          free();
+      }
+
+      while (!m_allocations.empty() && !g_failures)
+        free();
+
+      for (uint32_t i = 0u; i < m_pageAllocator.chunkCount(); i++) {
+        if (m_pageAllocator.chunkIsAvailable(i))
+          if (m_pageAllocator.pagesUsed(i))
+            fail(str::format("Pool chunk ", i, " not empty after freeing all objects"));
+      }
+    }
+
+  private:
+
+    std::mt19937                  m_rng;
+    DxvkPageAllocator             m_pageAllocator;
+    DxvkPoolAllocator             m_poolAllocator = { m_pageAllocator };
+
+    /// Live allocations by address, storing the size
+    std::map<uint64_t, uint64_t>  m_ranges;
+    std::vector<std::pair<uint64_t, uint64_t>> m_allocations;
+
+    void alloc() {
+      uint64_t size = 1u + m_rng() % DxvkPoolAllocator::MaxSize;
+      int64_t address = m_poolAllocator.alloc(size);
+
+      if (address < 0) {
+        // Out of memory, add a chunk and try again
+        m_pageAllocator.addChunk(DxvkPageAllocator::MaxChunkSize);
+        address = m_poolAllocator.alloc(size);
+      }
+
+      if (address < 0) {
+        fail(str::format("Failed to allocate ", size, " bytes"));
+        return;
+      }
+
+      uint64_t sizeClass = DxvkPoolAllocator::MinSize;
+
+      while (sizeClass < size)
+        sizeClass *= 2u;
+
+      if (uint64_t(address) % sizeClass)
+        fail(str::format("Address ", address, " not aligned to size class ", sizeClass));
+
+      auto next = m_ranges.lower_bound(uint64_t(address));
+
+      if (next != m_ranges.end()) {
+        if (next->first < uint64_t(address) + size)
+          fail(str::format("Allocation at ", address, " overlaps allocation at ", next->first));
+      }
+
+      if (next != m_ranges.begin()) {
+        auto prev = std::prev(next);
+
+        if (prev->first + prev->second > uint64_t(address))
+          fail(str::format("Allocation at ", address, " overlaps allocation at ", prev->first));
+      }
+
+      m_ranges.insert({ uint64_t(address), size });
+      m_allocations.push_back({ uint64_t(address), size });
+    }
+
+    void free() {
+      if (m_allocations.empty())
+        return;
+
+      size_t index = m_rng() % m_allocations.size();
+      auto allocation = m_allocations[index];
+
+      m_allocations[index] = m_allocations.back();
+      m_allocations.pop_back();
+
+      m_ranges.erase(allocation.first);
+      m_poolAllocator.free(allocation.first, allocation.second);
+    }
+
+  };
+
+}
+
+
+int main() {
+  const std::array<uint32_t, 3> seeds = { 1u, 0x1234567u, 0xdeadbeefu };
+
+  for (uint32_t seed : seeds) {
+    PageAllocatorTest(seed).run();
+    PoolAllocatorTest(seed).run();
+  }
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
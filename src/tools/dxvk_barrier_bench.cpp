@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../dxvk/dxvk_barrier.h"
+
+#include "../util/util_time.h"
+
+using namespace dxvk;
+
+namespace {
+
+  struct BenchArgs {
+    uint32_t operationCount = 1000000u;
+    uint32_t seed           = 1u;
+  };
+
+
+  enum class OpType : uint32_t {
+    Find,
+    Insert,
+    Clear,
+  };
+
+
+  /**
+   * \brief Recorded barrier tracker operation
+   *
+   * Stores the expected result of lookups, so that
+   * replays can be validated against the recording.
+   */
+  struct Operation {
+    OpType            type;
+    DxvkAccess        access;
+    bool              result;
+    DxvkAddressRange  range;
+  };
+
+
+  struct Access {
+    DxvkAddressRange  range;
+    DxvkAccess        access;
+  };
+
+
+  /**
+   * \brief Operation recorder
+   *
+   * Emulates the way contexts use the barrier tracker: For each
+   * draw or dispatch, all resource accesses are checked for
+   * hazards first. If any is found, a barrier is emitted and the
+   * tracker is reset, and then all accesses are inserted.
+   * Lookup results are computed with a brute-force search
+   * over all ranges inserted since the last reset.
+   */
+  class Recorder {
+
+  public:
+
+    Recorder(uint32_t operationCount)
+    : m_operationCount(operationCount) {
+      m_ops.reserve(operationCount + 16u);
+    }
+
+    bool done() const {
+      return m_ops.size() >= m_operationCount;
+    }
+
+    void draw(const std::vector<Access>& accesses) {
+      bool hazard = false;
+
+      for (const auto& a : accesses) {
+        hazard |= find(a.range, DxvkAccess::Write);
+
+        if (a.access == DxvkAccess::Write)
+          hazard |= find(a.range, DxvkAccess::Read);
+      }
+
+      if (hazard) {
+        m_accesses.clear();
+        m_ops.push_back({ OpType::Clear, DxvkAccess::None, false, DxvkAddressRange() });
+      }
+
+      for (const auto& a : accesses) {
+        m_accesses.push_back(a);
+        m_ops.push_back({ OpType::Insert, a.access, false, a.range });
+      }
+    }
+
+    std::vector<Operation> getOperations() {
+      return std::move(m_ops);
+    }
+
+  private:
+
+    uint32_t                m_operationCount;
+    std::vector<Access>     m_accesses;
+    std::vector<Operation>  m_ops;
+
+    bool find(const DxvkAddressRange& range, DxvkAccess access) {
+      bool result = false;
+
+      for (const auto& a : m_accesses)
+        result |= a.access == access && a.range.overlaps(range);
+
+      m_ops.push_back({ OpType::Find, access, result, range });
+      return result;
+    }
+
+  };
+
+
+  struct Scenario {
+    const char*             name;
+    std::vector<Operation>  ops;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [operations] [seed]\n\n", name);
+    std::printf("Records insertRange/findRange/clear sequences for a number of\n");
+    std::printf("synthetic access patterns, then replays each recording against\n");
+    std::printf("the barrier tracker and reports the time per operation. Lookup\n");
+    std::printf("results are checked against a brute-force search.\n");
+  }
+
+
+  DxvkAddressRange makeRange(uint64_t resource, uint64_t offset, uint64_t size) {
+    DxvkAddressRange range;
+    range.resource = bit::uint48_t(resource);
+    range.rangeStart = offset;
+    range.rangeEnd = offset + size - 1u;
+    return range;
+  }
+
+
+  uint64_t getResourceCookie(uint32_t index) {
+    // Resource IDs are derived from allocation addresses
+    return 0x7f1200000000ull + uint64_t(index) * 0x10000u;
+  }
+
+
+  Scenario recordUavWrites(const BenchArgs& args) {
+    // Compute shaders writing small sequential slices of a few large
+    // buffers, reading constant data, and occasionally reading back
+    // results, which requires a barrier.
+    std::mt19937 rng(args.seed);
+    Recorder recorder(args.operationCount);
+
+    constexpr uint32_t BufferCount = 4u;
+    constexpr uint32_t SliceSize = 64u;
+    constexpr uint32_t ReadbackInterval = 2048u;
+
+    std::vector<uint64_t> offsets(BufferCount);
+    std::vector<Access> accesses;
+
+    for (uint32_t i = 0u; !recorder.done(); i++) {
+      uint32_t buffer = i % BufferCount;
+
+      accesses.clear();
+      accesses.push_back({ makeRange(getResourceCookie(0u), (rng() % 64u) * 256u, 256u), DxvkAccess::Read });
+      accesses.push_back({ makeRange(getResourceCookie(1u + buffer), offsets[buffer], SliceSize), DxvkAccess::Write });
+
+      // Read back the slice written by the previous dispatch
+      if (!(i % ReadbackInterval) && i) {
+        uint32_t prev = (i - 1u) % BufferCount;
+        accesses.push_back({ makeRange(getResourceCookie(1u + prev), offsets[prev] - SliceSize, SliceSize), DxvkAccess::Read });
+      }
+
+      offsets[buffer] += SliceSize;
+      recorder.draw(accesses);
+    }
+
+    return { "Sequential UAV writes", recorder.getOperations() };
+  }
+
+
+  Scenario recordMergedReads(const BenchArgs& args) {
+    // Streaming reads of disjoint blocks from one large buffer in
+    // ascending order, with the occasional larger read covering
+    // multiple blocks, which merges and thus removes tree nodes.
+    std::mt19937 rng(args.seed);
+    Recorder recorder(args.operationCount);
+
+    constexpr uint32_t BlockSize = 256u;
+    constexpr uint32_t ReadbackInterval = 4096u;
+
+    std::vector<Access> accesses;
+
+    uint64_t readOffset = 0u;
+    uint64_t writeOffset = 0u;
+
+    for (uint32_t i = 0u; !recorder.done(); i++) {
+      accesses.clear();
+
+      if (!(i % 16u) && readOffset >= 8u * BlockSize)
+        accesses.push_back({ makeRange(getResourceCookie(0u), readOffset - 8u * BlockSize, 6u * BlockSize), DxvkAccess::Read });
+      else
+        accesses.push_back({ makeRange(getResourceCookie(0u), readOffset, BlockSize), DxvkAccess::Read });
+
+      accesses.push_back({ makeRange(getResourceCookie(1u), writeOffset, BlockSize), DxvkAccess::Write });
+
+      // Read back the most recently written block
+      if (!(i % ReadbackInterval) && i)
+        accesses.push_back({ makeRange(getResourceCookie(1u), writeOffset - BlockSize, BlockSize), DxvkAccess::Read });
+
+      readOffset += 2u * BlockSize + (rng() % 2u) * BlockSize;
+      writeOffset += BlockSize;
+      recorder.draw(accesses);
+    }
+
+    return { "Merged reads", recorder.getOperations() };
+  }
+
+
+  Scenario recordManyResources(const BenchArgs& args) {
+    // Draws reading random small ranges of many different buffers
+    // and images, with the occasional write to one of them.
+    std::mt19937 rng(args.seed);
+    Recorder recorder(args.operationCount);
+
+    constexpr uint32_t ResourceCount = 2048u;
+
+    std::vector<Access> accesses;
+
+    for (uint32_t i = 0u; !recorder.done(); i++) {
+      accesses.clear();
+
+      for (uint32_t j = 0u; j < 6u; j++) {
+        uint32_t resource = rng() % ResourceCount;
+        accesses.push_back({ makeRange(getResourceCookie(resource), (rng() % 64u) * 256u, 256u), DxvkAccess::Read });
+      }
+
+      // Occasionally write to a resource that is otherwise read
+      if (!(i % 64u)) {
+        uint32_t resource = rng() % ResourceCount;
+        accesses.push_back({ makeRange(getResourceCookie(resource), 0u, 16384u), DxvkAccess::Write });
+      }
+
+      recorder.draw(accesses);
+    }
+
+    return { "Many resources", recorder.getOperations() };
+  }
+
+
+  uint64_t replay(const std::vector<Operation>& ops, uint32_t& mismatches) {
+    // Allocate on the heap since trackers are not copyable
+    auto tracker = std::make_unique<DxvkBarrierTracker>();
+
+    uint32_t count = 0u;
+
+    auto t0 = high_resolution_clock::now();
+
+    for (const auto& op : ops) {
+      switch (op.type) {
+        case OpType::Find:
+          count += tracker->findRange(op.range, op.access) != op.result ? 1u : 0u;
+          break;
+
+        case OpType::Insert:
+          tracker->insertRange(op.range, op.access);
+          break;
+
+        case OpType::Clear:
+          tracker->clear();
+          break;
+      }
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    mismatches += count;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  }
+
+
+  uint64_t replayBest(const std::vector<Operation>& ops, uint32_t& mismatches) {
+    uint64_t best = ~0ull;
+
+    for (uint32_t i = 0u; i < 3u; i++)
+      best = std::min(best, replay(ops, mismatches));
+
+    return best;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+
+  if (argc > 3) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (argc > 1) args.operationCount = std::strtoul(argv[1], nullptr, 10);
+  if (argc > 2) args.seed           = std::strtoul(argv[2], nullptr, 10);
+
+  if (!args.operationCount) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Scenario> scenarios;
+  scenarios.push_back(recordUavWrites(args));
+  scenarios.push_back(recordMergedReads(args));
+  scenarios.push_back(recordManyResources(args));
+
+  uint32_t mismatches = 0u;
+
+  for (const auto& s : scenarios) {
+    uint32_t clears = 0u;
+
+    for (const auto& op : s.ops)
+      clears += op.type == OpType::Clear ? 1u : 0u;
+
+    uint64_t ns = replayBest(s.ops, mismatches);
+
+    std::printf("%-22s %8zu ops, %6u clears: %7.1f ns/op\n",
+      s.name, s.ops.size(), clears, double(ns) / double(s.ops.size()));
+  }
+
+  if (mismatches) {
+    std::fprintf(stderr, "%u lookups did not match the expected result\n", mismatches);
+    return 1;
+  }
+
+  return 0;
+}
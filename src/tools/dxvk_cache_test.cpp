@@ -0,0 +1,252 @@
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../util/thread.h"
+#include "../util/util_time.h"
+
+#include "../dxvk/dxvk_shader_cache.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of shaders to write, more than one writer batch */
+  constexpr uint32_t ShaderCount = 300u;
+
+  /** Number of threads to perform concurrent lookups on */
+  constexpr uint32_t ThreadCount = 8u;
+
+  constexpr const char* ShaderPrefix = "test_shader_";
+
+  uint32_t g_failures = 0u;
+
+
+  void check(bool condition, const std::string& message) {
+    if (!condition) {
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+      g_failures += 1u;
+    }
+  }
+
+
+  std::string getShaderName(uint32_t index) {
+    return str::format(ShaderPrefix, index);
+  }
+
+
+  std::vector<uint8_t> getShaderIr(uint32_t index) {
+    std::vector<uint8_t> ir(64u + index);
+
+    for (size_t i = 0u; i < ir.size(); i++)
+      ir[i] = uint8_t(index * 7u + i);
+
+    return ir;
+  }
+
+
+  Rc<DxvkIrShader> createShader(uint32_t index) {
+    DxvkShaderMetadata metadata = { };
+    metadata.stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+    auto ir = getShaderIr(index);
+    size_t irSize = ir.size();
+
+    return new DxvkIrShader(getShaderName(index), DxvkIrShaderCreateInfo(),
+      std::move(metadata), DxvkPipelineLayoutBuilder(VK_SHADER_STAGE_VERTEX_BIT),
+      std::move(ir), irSize);
+  }
+
+
+  /** Shaders looked up in the second session, and thus recently used */
+  bool isHot(uint32_t index) {
+    return !(index % 2u);
+  }
+
+
+  bool isHot(const std::string& name) {
+    return isHot(uint32_t(std::strtoul(name.c_str() + std::strlen(ShaderPrefix), nullptr, 10)));
+  }
+
+
+  bool resetFiles(const DxvkShaderCache::FilePaths& paths) {
+    if (!env::createDirectory(paths.directory))
+      return false;
+
+    auto path = paths.directory + env::PlatformDirSlash;
+
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate);
+
+    return util::File(path + paths.lutFile, flags)
+        && util::File(path + paths.binFile, flags);
+  }
+
+
+  void writeShaders() {
+    auto cache = DxvkShaderCache::getInstance(0u);
+
+    for (uint32_t i = 0u; i < ShaderCount; i++)
+      cache->addShader(createShader(i));
+  }
+
+
+  bool lookUpShader(DxvkShaderCache& cache, uint32_t index) {
+    auto shader = cache.lookupShader(getShaderName(index), DxvkIrShaderCreateInfo());
+
+    if (!shader)
+      return false;
+
+    auto expected = getShaderIr(index);
+    auto ir = shader->getSerializedIr();
+
+    return ir.rawSize == expected.size() && ir.size == expected.size()
+        && !std::memcmp(ir.data, expected.data(), expected.size());
+  }
+
+
+  void lookUpShaders() {
+    auto cache = DxvkShaderCache::getInstance(0u);
+
+    for (uint32_t i = 0u; i < ShaderCount; i++) {
+      if (isHot(i)) {
+        check(lookUpShader(*cache, i),
+          str::format("Shader ", i, " not found or has unexpected contents"));
+      }
+    }
+  }
+
+
+  void lookUpShadersConcurrently() {
+    auto cache = DxvkShaderCache::getInstance(0u);
+
+    // Lookups only read the mapped index, so all threads should find
+    // every shader. Only look up hot shaders here so that use stamps
+    // remain meaningful for the eviction check.
+    std::array<uint32_t, ThreadCount> failures = { };
+    std::vector<dxvk::thread> threads;
+
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < ThreadCount; i++) {
+      threads.emplace_back([&cache, &failures, i] {
+        for (uint32_t j = 0u; j < ShaderCount; j++) {
+          uint32_t index = (i + j) % ShaderCount;
+
+          if (isHot(index) && !lookUpShader(*cache, index))
+            failures[i] += 1u;
+        }
+      });
+    }
+
+    for (auto& thread : threads)
+      thread.join();
+
+    auto t1 = high_resolution_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+    for (uint32_t i = 0u; i < ThreadCount; i++)
+      check(!failures[i], str::format("Thread ", i, " failed ", failures[i], " lookups"));
+
+    std::printf("%u threads looked up %u shaders each in %lld us\n",
+      ThreadCount, ShaderCount / 2u, (long long)us);
+  }
+
+
+  void checkUseStamps(const DxvkShaderCache::FilePaths& paths) {
+    auto info = DxvkShaderCache::inspectFiles(paths, true);
+    check(info.has_value(), "Failed to inspect cache files");
+
+    if (!info)
+      return;
+
+    check(info->entries.size() == ShaderCount, str::format("Expected ", ShaderCount,
+      " entries, found ", info->entries.size()));
+
+    for (const auto& e : info->entries) {
+      check(e.valid, str::format(e.name, ": checksum mismatch"));
+
+      if (isHot(e.name)) {
+        check(e.lastUsed == info->generation, str::format(e.name,
+          ": use stamp ", e.lastUsed, " not persisted, expected ", info->generation));
+      } else {
+        check(e.lastUsed < info->generation, str::format(e.name,
+          ": unexpected use stamp ", e.lastUsed));
+      }
+    }
+  }
+
+
+  void checkEviction(const DxvkShaderCache::FilePaths& paths) {
+    auto info = DxvkShaderCache::inspectFiles(paths, false);
+
+    if (!info)
+      return;
+
+    // Compaction evicts down to 75% of the budget, so
+    // this should keep roughly half of all entries.
+    uint64_t maxSize = (info->lutSize + info->binSize) * 2u / 3u;
+
+    check(DxvkShaderCache::compactFiles(paths, maxSize, true), "Failed to compact cache files");
+
+    info = DxvkShaderCache::inspectFiles(paths, true);
+    check(info.has_value(), "Failed to inspect compacted cache files");
+
+    if (!info)
+      return;
+
+    uint32_t hotCount = 0u;
+    uint32_t coldCount = 0u;
+
+    for (const auto& e : info->entries) {
+      check(e.valid, str::format(e.name, ": checksum mismatch after compaction"));
+
+      if (isHot(e.name))
+        hotCount += 1u;
+      else
+        coldCount += 1u;
+    }
+
+    check(hotCount + coldCount < ShaderCount, "Compaction did not evict any shaders");
+    check(!coldCount || hotCount == ShaderCount / 2u, str::format("Compaction kept ",
+      coldCount, " cold shaders but evicted ", ShaderCount / 2u - hotCount, " hot shaders"));
+  }
+
+}
+
+
+int main() {
+  auto paths = DxvkShaderCache::getDefaultFilePaths();
+
+  if (paths.directory.empty()) {
+    std::fprintf(stderr, "No cache path, set DXVK_SHADER_CACHE_PATH\n");
+    return 1;
+  }
+
+  if (!resetFiles(paths)) {
+    std::fprintf(stderr, "Failed to create cache files in %s\n", paths.directory.c_str());
+    return 1;
+  }
+
+  // Each step creates and destroys the cache instance,
+  // so that all state has to go through the files.
+  writeShaders();
+  lookUpShaders();
+
+  checkUseStamps(paths);
+
+  lookUpShadersConcurrently();
+  checkEviction(paths);
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../dxvk/dxvk_shader_cache.h"
+
+using namespace dxvk;
+
+namespace {
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s <command> <file.lut> [options]\n\n", name);
+    std::printf("Commands:\n");
+    std::printf("  info              Print summary of the cache files\n");
+    std::printf("  list              List all shaders in the cache\n");
+    std::printf("  verify            Verify checksums of all shader binaries\n");
+    std::printf("  compact [size]    Compact cache files, optionally evicting\n");
+    std::printf("                    shaders until the files fit within the\n");
+    std::printf("                    given size in Megabytes\n");
+  }
+
+
+  bool getFilePaths(const std::string& lutPath, DxvkShaderCache::FilePaths& paths) {
+    const std::string lutExt = ".lut";
+    const std::string binExt = ".bin";
+
+    if (lutPath.size() <= lutExt.size() || lutPath.compare(lutPath.size() - lutExt.size(), lutExt.size(), lutExt))
+      return false;
+
+    size_t nameStart = lutPath.find_last_of("/\\");
+
+    if (nameStart != std::string::npos) {
+      paths.directory = lutPath.substr(0u, nameStart);
+      paths.lutFile = lutPath.substr(nameStart + 1u);
+    } else {
+      paths.directory = ".";
+      paths.lutFile = lutPath;
+    }
+
+    paths.binFile = paths.lutFile.substr(0u, paths.lutFile.size() - lutExt.size()) + binExt;
+    return true;
+  }
+
+
+  int printInfo(const DxvkShaderCache::FilePaths& paths, bool list, bool verify) {
+    auto info = DxvkShaderCache::inspectFiles(paths, verify);
+
+    if (!info) {
+      std::fprintf(stderr, "Failed to read cache files\n");
+      return 1;
+    }
+
+    uint64_t liveSize = 0u;
+    uint32_t invalidCount = 0u;
+
+    for (const auto& e : info->entries) {
+      liveSize += e.binarySize + e.metadataSize;
+      invalidCount += e.valid ? 0u : 1u;
+
+      if (list || (verify && !e.valid)) {
+        std::printf("%-48s offset %10llu, size %8u, metadata %6u, last used %u%s\n",
+          e.name.c_str(), (unsigned long long)e.offset, e.binarySize, e.metadataSize,
+          e.lastUsed, e.valid ? "" : " (invalid)");
+      }
+    }
+
+    std::printf("Version:      %s\n", info->versionString.c_str());
+    std::printf("Generation:   %u\n", info->generation);
+    std::printf("Entries:      %zu (%u not indexed)\n", info->entries.size(), info->logEntryCount);
+    std::printf("LUT size:     %llu kB\n", (unsigned long long)(info->lutSize >> 10u));
+    std::printf("Binary size:  %llu kB (%llu kB referenced)\n",
+      (unsigned long long)(info->binSize >> 10u), (unsigned long long)(liveSize >> 10u));
+
+    if (verify)
+      std::printf("Invalid:      %u\n", invalidCount);
+
+    return invalidCount ? 1 : 0;
+  }
+
+
+  int compact(const DxvkShaderCache::FilePaths& paths, uint64_t maxSize) {
+    if (!DxvkShaderCache::compactFiles(paths, maxSize, true)) {
+      std::fprintf(stderr, "Failed to compact cache files\n");
+      return 1;
+    }
+
+    return printInfo(paths, false, false);
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::string command = argv[1];
+
+  DxvkShaderCache::FilePaths paths;
+
+  if (!getFilePaths(argv[2], paths)) {
+    std::fprintf(stderr, "Not a cache look-up table: %s\n", argv[2]);
+    return 1;
+  }
+
+  if (command == "info")
+    return printInfo(paths, false, false);
+
+  if (command == "list")
+    return printInfo(paths, true, false);
+
+  if (command == "verify")
+    return printInfo(paths, false, true);
+
+  if (command == "compact") {
+    uint64_t maxSize = argc > 3 ? std::strtoull(argv[3], nullptr, 10) << 20u : 0u;
+    return compact(paths, maxSize);
+  }
+
+  printUsage(argv[0]);
+  return 1;
+}
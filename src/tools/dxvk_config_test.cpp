@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "../util/config/config.h"
+#include "../util/config/config_matcher.h"
+
+#include "../util/log/log.h"
+#include "../util/util_string.h"
+#include "../util/util_time.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Use every n-th path for the lookup benchmark */
+  constexpr size_t BenchPathInterval = 16u;
+
+  /** Paths that should not match any real profile */
+  const std::vector<std::string> g_extraPaths = {
+    "",
+    "\\",
+    "C:\\windows\\system32\\rundll32.exe",
+    "Z:\\home\\user\\Games\\SomeGame\\Binaries\\Win64\\SomeGame-Win64-Shipping.exe",
+    "C:\\Program Files (x86)\\Steam\\steamapps\\common\\Unknown Game\\game.exe",
+    "/usr/bin/wine64-preloader",
+  };
+
+  uint32_t g_failures = 0u;
+
+
+  void fail(const std::string& message) {
+    if (g_failures++ < 32u)
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+  }
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [path list]...\n\n", name);
+    std::printf("Checks that app profile matching is equivalent to std::regex_search\n");
+    std::printf("for every built-in profile pattern on a set of executable paths, and\n");
+    std::printf("compares lookup times. Paths are generated from the patterns, and\n");
+    std::printf("additional paths can be read from files with one path per line.\n");
+  }
+
+
+  /**
+   * \brief Generates a string from a pattern
+   *
+   * Produces a string that is likely, but not guaranteed to match
+   * the given pattern, by resolving escapes and taking the first
+   * option of any bracket expression or alternation. This does not
+   * need to be exact since results are compared with std::regex.
+   */
+  std::string generatePath(const char* pattern) {
+    std::string result;
+    uint32_t depth = 0u;
+
+    for (const char* p = pattern; *p; p++) {
+      switch (*p) {
+        case '\\':
+          if (p[1])
+            result.push_back(*(++p));
+          break;
+
+        case '^':
+        case '$':
+        case '?':
+        case '*':
+        case '+':
+          break;
+
+        case '(':
+          depth += 1u;
+          break;
+
+        case ')':
+          depth -= depth ? 1u : 0u;
+          break;
+
+        case '.':
+          result.push_back('x');
+          break;
+
+        case '{':
+          while (p[1] && *p != '}')
+            p++;
+          break;
+
+        case '[': {
+          bool negate = p[1] == '^';
+          p += negate ? 2u : 1u;
+
+          if (*p)
+            result.push_back(negate ? '_' : *p);
+
+          // A closing bracket right at the start is part of the set
+          while (p[1] && *(++p) != ']')
+            continue;
+        } break;
+
+        case '|': {
+          // Skip remaining options of the current group
+          uint32_t level = 0u;
+
+          while (p[1] && (level || p[1] != ')')) {
+            p++;
+
+            if (*p == '\\' && p[1])
+              p++;
+            else if (*p == '(')
+              level += 1u;
+            else if (*p == ')')
+              level -= 1u;
+          }
+
+          if (!depth)
+            return result;
+        } break;
+
+        default:
+          result.push_back(*p);
+      }
+    }
+
+    return result;
+  }
+
+
+  std::vector<std::string> generatePaths(const std::vector<const char*>& patterns) {
+    std::vector<std::string> paths;
+
+    for (auto pattern : patterns) {
+      std::string path = generatePath(pattern);
+
+      std::string upper = path;
+      std::string dots = path;
+
+      for (auto& c : upper)
+        c = std::toupper(c);
+
+      std::replace(dots.begin(), dots.end(), '.', '_');
+
+      // Exercise anchors, case insensitivity and escaped dots
+      paths.push_back(path);
+      paths.push_back("C:\\Program Files\\Game" + path);
+      paths.push_back("Z:\\games" + upper + ".old");
+      paths.push_back(path.substr(0, path.size() - (path.empty() ? 0u : 1u)));
+      paths.push_back(dots);
+    }
+
+    paths.insert(paths.end(), g_extraPaths.begin(), g_extraPaths.end());
+    return paths;
+  }
+
+
+  bool readPaths(const char* file, std::vector<std::string>& paths) {
+    std::ifstream stream(file);
+
+    if (!stream)
+      return false;
+
+    std::string line;
+
+    while (std::getline(stream, line)) {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+      paths.push_back(line);
+    }
+
+    return true;
+  }
+
+
+  std::regex compileRegex(const char* pattern) {
+    return std::regex(pattern, std::regex::extended | std::regex::icase);
+  }
+
+
+  void checkPatterns(const std::vector<const char*>& patterns, const std::vector<std::string>& paths) {
+    std::vector<int32_t> expected(paths.size(), -1);
+    uint32_t matchCount = 0u;
+
+    for (size_t i = 0u; i < patterns.size(); i++) {
+      std::regex expr = compileRegex(patterns[i]);
+
+      AppProfileMatcher matcher;
+      matcher.add(patterns[i]);
+
+      for (size_t j = 0u; j < paths.size(); j++) {
+        bool regexMatch = std::regex_search(paths[j], expr);
+        bool matcherMatch = matcher.find(paths[j]) == 0;
+
+        if (regexMatch != matcherMatch) {
+          fail(str::format("Pattern ", patterns[i], " ", regexMatch ? "matches" : "does not match",
+            " ", paths[j], " with std::regex"));
+        }
+
+        if (regexMatch && expected[j] < 0) {
+          expected[j] = int32_t(i);
+          matchCount += 1u;
+        }
+      }
+    }
+
+    // Also check that the full list yields the first matching profile
+    AppProfileMatcher matcher;
+
+    for (auto pattern : patterns)
+      matcher.add(pattern);
+
+    for (size_t i = 0u; i < paths.size(); i++) {
+      int32_t index = matcher.find(paths[i]);
+
+      if (index != expected[i]) {
+        fail(str::format("Found profile ", index, " for ", paths[i],
+          ", expected ", expected[i]));
+      }
+    }
+
+    std::printf("Checked %zu patterns against %zu paths, %u paths match a profile\n",
+      patterns.size(), paths.size(), matchCount);
+  }
+
+
+  int32_t findProfileRegex(const std::vector<const char*>& patterns, const std::string& path) {
+    for (size_t i = 0u; i < patterns.size(); i++) {
+      if (std::regex_search(path, compileRegex(patterns[i])))
+        return int32_t(i);
+    }
+
+    return -1;
+  }
+
+
+  int32_t findProfileMatcher(const std::vector<const char*>& patterns, const std::string& path) {
+    AppProfileMatcher matcher;
+
+    for (auto pattern : patterns)
+      matcher.add(pattern);
+
+    return matcher.find(path);
+  }
+
+
+  template<typename Proc>
+  uint64_t measureLookups(const std::vector<std::string>& paths, const Proc& proc) {
+    auto t0 = high_resolution_clock::now();
+
+    for (const auto& path : paths)
+      proc(path);
+
+    auto t1 = high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  }
+
+
+  void benchLookups(const std::vector<const char*>& patterns, const std::vector<std::string>& paths) {
+    // Lookups work the same way as on process startup, i.e. without
+    // any state persisting between lookups. Non-matching paths are
+    // the common case, and the most expensive one.
+    std::vector<std::string> benchPaths = g_extraPaths;
+
+    for (size_t i = 0u; i < paths.size(); i += BenchPathInterval)
+      benchPaths.push_back(paths[i]);
+
+    uint64_t regexNs = measureLookups(benchPaths, [&patterns] (const std::string& path) {
+      findProfileRegex(patterns, path);
+    });
+
+    uint64_t matcherNs = measureLookups(benchPaths, [&patterns] (const std::string& path) {
+      findProfileMatcher(patterns, path);
+    });
+
+    // Subsequent lookups within the same process reuse the matcher
+    AppProfileMatcher matcher;
+
+    for (auto pattern : patterns)
+      matcher.add(pattern);
+
+    uint64_t cachedNs = measureLookups(benchPaths, [&matcher] (const std::string& path) {
+      matcher.find(path);
+    });
+
+    std::printf("std::regex lookup: %8.1f us\n", double(regexNs) / double(1000u * benchPaths.size()));
+    std::printf("Matcher lookup:    %8.1f us\n", double(matcherNs) / double(1000u * benchPaths.size()));
+    std::printf("Cached lookup:     %8.1f us\n", double(cachedNs) / double(1000u * benchPaths.size()));
+    std::printf("Speedup:           %8.1fx\n", double(regexNs) / double(std::max<uint64_t>(matcherNs, 1u)));
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  auto patterns = Config::getAppProfilePatterns();
+  auto paths = generatePaths(patterns);
+
+  for (int i = 1; i < argc; i++) {
+    if (!readPaths(argv[i], paths)) {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  checkPatterns(patterns, paths);
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  benchLookups(patterns, paths);
+
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../d3d9/d3d9_caps.h"
+
+#include "../util/util_math.h"
+#include "../util/util_time.h"
+#include "../util/util_vector.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of float registers covered by one bit in the range bitmap */
+  constexpr uint32_t BlockSize = 16u;
+
+  /** Number of 64-bit words in the range bitmap */
+  constexpr uint32_t BitmapWords = caps::MaxFloatConstantsSoftware / BlockSize / 64u;
+
+  /** Alignment of constant buffer slices */
+  constexpr size_t SliceAlignment = 256u;
+
+  /** Dirty flags for each constant type */
+  constexpr uint32_t FloatBit = 1u << 0;
+  constexpr uint32_t IntBit   = 1u << 1;
+  constexpr uint32_t BoolBit  = 1u << 2;
+
+
+  struct BenchArgs {
+    uint32_t drawCount  = 100000u;
+    uint32_t floatCount = 2048u;
+    uint32_t seed       = 1u;
+  };
+
+
+  enum class Strategy : uint32_t {
+    SingleFlag,
+    PerType,
+    RangeBitmap,
+  };
+
+
+  /**
+   * \brief Per-draw constant updates
+   *
+   * Number of float registers that the application changes
+   * before each draw, and how often it changes an int or bool
+   * register, at a random location within the first 64 registers.
+   */
+  struct Scenario {
+    const char* name;
+    uint32_t    floatCount;
+    uint32_t    intInterval;
+    uint32_t    boolInterval;
+  };
+
+
+  struct Constants {
+    Vector4i iConsts[caps::MaxOtherConstantsSoftware];
+    Vector4  fConsts[caps::MaxFloatConstantsSoftware];
+    uint32_t bConsts[caps::MaxOtherConstantsSoftware / 32];
+  };
+
+
+  /**
+   * \brief Upload ring buffer
+   *
+   * Stands in for the constant buffer, every upload
+   * gets a fresh slice just like on the device.
+   */
+  class UploadRing {
+
+  public:
+
+    UploadRing()
+    : m_data(64u << 20) { }
+
+    void* alloc(size_t size) {
+      size = align(size, SliceAlignment);
+
+      if (m_offset + size > m_data.size())
+        m_offset = 0u;
+
+      void* ptr = &m_data[m_offset];
+      m_offset += size;
+      m_bytes += size;
+      return ptr;
+    }
+
+    uint64_t bytes() const {
+      return m_bytes;
+    }
+
+  private:
+
+    std::vector<char> m_data;
+    size_t            m_offset = 0u;
+    uint64_t          m_bytes  = 0u;
+
+  };
+
+
+  struct Uploader {
+    Strategy    strategy;
+    uint32_t    floatCount;
+    uint32_t    dirty = ~0u;
+
+    std::array<uint64_t, BitmapWords> floatBlocks = { };
+
+    UploadRing  ring;
+    Vector4*    lastFloats = nullptr;
+
+    void setFloats(uint32_t reg, uint32_t count) {
+      dirty |= FloatBit;
+
+      for (uint32_t i = reg / BlockSize; i <= (reg + count - 1u) / BlockSize; i++)
+        floatBlocks[i / 64u] |= uint64_t(1u) << (i % 64u);
+    }
+
+    void upload(const Constants& src) {
+      if (!dirty)
+        return;
+
+      uint32_t types = strategy == Strategy::SingleFlag ? ~0u : dirty;
+      dirty = 0u;
+
+      if (types & FloatBit) {
+        auto dst = reinterpret_cast<Vector4*>(ring.alloc(floatCount * sizeof(Vector4)));
+
+        if (strategy == Strategy::RangeBitmap && lastFloats) {
+          // Copy changed blocks from the application's constants, and
+          // the rest from the previous slice. Either way, every block
+          // that the shader can access has to be written.
+          for (uint32_t i = 0u; i < floatCount; i += BlockSize) {
+            uint32_t block = i / BlockSize;
+            bool changed = floatBlocks[block / 64u] & (uint64_t(1u) << (block % 64u));
+
+            std::memcpy(&dst[i], changed ? &src.fConsts[i] : &lastFloats[i],
+              std::min(BlockSize, floatCount - i) * sizeof(Vector4));
+          }
+        } else {
+          std::memcpy(dst, src.fConsts, floatCount * sizeof(Vector4));
+        }
+
+        floatBlocks = { };
+        lastFloats = dst;
+      }
+
+      if (types & IntBit)
+        std::memcpy(ring.alloc(caps::MaxOtherConstants * sizeof(Vector4i)), src.iConsts, caps::MaxOtherConstants * sizeof(Vector4i));
+
+      if (types & BoolBit)
+        std::memcpy(ring.alloc(sizeof(uint32_t)), src.bConsts, sizeof(uint32_t));
+    }
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [draws] [float constants] [seed]\n\n", name);
+    std::printf("Simulates SWVP constant uploads for a number of draws, with the\n");
+    std::printf("application changing a few constants before each draw. Compares\n");
+    std::printf("a single dirty flag, per-type dirty flags as used by the device,\n");
+    std::printf("and a bitmap of dirty %u-register ranges that copies unchanged\n", BlockSize);
+    std::printf("ranges from the previous slice. Reports time and bytes per draw.\n");
+  }
+
+
+  bool run(const BenchArgs& args, const Scenario& scenario, Strategy strategy, uint64_t& ns, uint64_t& bytes) {
+    std::mt19937 rng(args.seed);
+
+    auto src = std::make_unique<Constants>();
+    auto uploader = std::make_unique<Uploader>();
+    uploader->strategy = strategy;
+    uploader->floatCount = args.floatCount;
+
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < args.drawCount; i++) {
+      uint32_t reg = rng() % 64u;
+
+      if (scenario.floatCount) {
+        for (uint32_t j = 0u; j < scenario.floatCount; j++)
+          src->fConsts[reg + j] = Vector4(float(i), float(j), 0.0f, 1.0f);
+
+        uploader->setFloats(reg, scenario.floatCount);
+      }
+
+      if (scenario.intInterval && !(i % scenario.intInterval)) {
+        src->iConsts[reg % caps::MaxOtherConstants] = Vector4i(int32_t(i), 0, 0, 0);
+        uploader->dirty |= IntBit;
+      }
+
+      if (scenario.boolInterval && !(i % scenario.boolInterval)) {
+        src->bConsts[0] ^= 1u << (reg % 32u);
+        uploader->dirty |= BoolBit;
+      }
+
+      uploader->upload(*src);
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    bytes = uploader->ring.bytes();
+
+    // The most recent float slice must match the application's constants
+    return !uploader->lastFloats || !std::memcmp(uploader->lastFloats,
+      src->fConsts, args.floatCount * sizeof(Vector4));
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+
+  if (argc > 4) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (argc > 1) args.drawCount  = std::strtoul(argv[1], nullptr, 10);
+  if (argc > 2) args.floatCount = std::strtoul(argv[2], nullptr, 10);
+  if (argc > 3) args.seed       = std::strtoul(argv[3], nullptr, 10);
+
+  if (!args.drawCount || args.floatCount < 64u + 4u || args.floatCount > caps::MaxFloatConstantsSoftware) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  static const std::array<Scenario, 4> scenarios = {{
+    { "Floats",          4u, 0u, 0u },
+    { "Bools",           0u, 0u, 1u },
+    { "Ints",            0u, 1u, 0u },
+    { "Floats + bools",  4u, 0u, 4u },
+  }};
+
+  static const std::array<std::pair<Strategy, const char*>, 3> strategies = {{
+    { Strategy::SingleFlag,  "single flag" },
+    { Strategy::PerType,     "per type" },
+    { Strategy::RangeBitmap, "range bitmap" },
+  }};
+
+  uint32_t failures = 0u;
+
+  for (const auto& s : scenarios) {
+    for (const auto& strategy : strategies) {
+      uint64_t ns = ~0ull;
+      uint64_t bytes = 0u;
+
+      // Take the best of a few runs to reduce noise
+      for (uint32_t i = 0u; i < 3u; i++) {
+        uint64_t runNs = 0u;
+
+        if (!run(args, s, strategy.first, runNs, bytes)) {
+          std::fprintf(stderr, "%s, %s: uploaded constants do not match\n", s.name, strategy.second);
+          failures += 1u;
+        }
+
+        ns = std::min(ns, runNs);
+      }
+
+      std::printf("%-16s %-13s %9.1f ns/draw %9.1f bytes/draw\n", s.name, strategy.second,
+        double(ns) / double(args.drawCount), double(bytes) / double(args.drawCount));
+    }
+  }
+
+  return failures ? 1 : 0;
+}
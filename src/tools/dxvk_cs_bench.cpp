@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../util/thread.h"
+#include "../util/util_time.h"
+
+#include "../dxvk/dxvk_cs.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Keeps chunks of no-op commands well within the chunk size */
+  constexpr uint32_t MaxCommandCount = 256u;
+
+
+  struct BenchArgs {
+    uint32_t maxThreadCount   = 0u;
+    uint32_t chunkCount       = 20000u;
+    uint32_t commandCount     = 64u;
+  };
+
+
+  /** Per-chunk submission timestamp and measured latency */
+  struct ChunkTiming {
+    high_resolution_clock::time_point submitted;
+    uint64_t latencyNs = 0u;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [max threads] [chunks per thread] [commands per chunk]\n\n", name);
+    std::printf("Submits chunks of no-op commands to a CS thread from an increasing\n");
+    std::printf("number of producer threads and reports chunk throughput as well as\n");
+    std::printf("the latency from submission to execution. No device is required.\n");
+    std::printf("At most %u commands can be recorded per chunk.\n", MaxCommandCount);
+  }
+
+
+  DxvkCsChunkRef createChunk(DxvkCsChunkPool& pool, uint32_t commandCount, ChunkTiming* timing) {
+    DxvkCsChunkRef chunk(pool.allocChunk(DxvkCsChunkFlag::SingleUse), &pool);
+
+    for (uint32_t i = 1u; i < commandCount; i++)
+      chunk->push([] (DxvkContext*) { });
+
+    chunk->push([timing] (DxvkContext*) {
+      auto t = high_resolution_clock::now();
+      timing->latencyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t - timing->submitted).count();
+    });
+
+    return chunk;
+  }
+
+
+  uint64_t getPercentile(const std::vector<uint64_t>& sorted, double percentile) {
+    size_t index = size_t(double(sorted.size() - 1u) * percentile);
+    return sorted[index];
+  }
+
+
+  void runBench(const BenchArgs& args, uint32_t threadCount) {
+    DxvkCsChunkPool pool(nullptr);
+    DxvkCsThread cs(nullptr, nullptr);
+
+    std::vector<std::vector<ChunkTiming>> timings(threadCount,
+      std::vector<ChunkTiming>(args.chunkCount));
+
+    std::vector<dxvk::thread> producers;
+    producers.reserve(threadCount);
+
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < threadCount; i++) {
+      producers.emplace_back([&pool, &cs, &timings, &args, i] {
+        for (uint32_t j = 0u; j < args.chunkCount; j++) {
+          ChunkTiming* timing = &timings[i][j];
+
+          // Record the chunk first so that only the
+          // submission itself counts toward latency
+          DxvkCsChunkRef chunk = createChunk(pool, args.commandCount, timing);
+
+          timing->submitted = high_resolution_clock::now();
+          cs.injectChunk(DxvkCsQueue::Ordered, std::move(chunk), false);
+        }
+      });
+    }
+
+    for (auto& thread : producers)
+      thread.join();
+
+    // Injected chunks are executed in queue order, so waiting
+    // for an empty chunk also waits for all previous chunks.
+    cs.injectChunk(DxvkCsQueue::Ordered, DxvkCsChunkRef(
+      pool.allocChunk(DxvkCsChunkFlag::SingleUse), &pool), true);
+
+    auto t1 = high_resolution_clock::now();
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(threadCount * args.chunkCount);
+
+    for (const auto& list : timings) {
+      for (const auto& timing : list)
+        latencies.push_back(timing.latencyNs);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    double chunksPerSecond = double(latencies.size()) * 1000000.0 / double(std::max<int64_t>(us, 1));
+
+    std::printf("%3u threads: %10.0f chunks/s, %12.0f cmds/s, latency p50 %7.1f us, p99 %7.1f us, p99.9 %8.1f us, max %8.1f us\n",
+      threadCount, chunksPerSecond, chunksPerSecond * double(args.commandCount),
+      double(getPercentile(latencies, 0.5))   / 1000.0,
+      double(getPercentile(latencies, 0.99))  / 1000.0,
+      double(getPercentile(latencies, 0.999)) / 1000.0,
+      double(latencies.back()) / 1000.0);
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+
+  if (argc > 4) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (argc > 1) args.maxThreadCount = std::strtoul(argv[1], nullptr, 10);
+  if (argc > 2) args.chunkCount     = std::strtoul(argv[2], nullptr, 10);
+  if (argc > 3) args.commandCount   = std::strtoul(argv[3], nullptr, 10);
+
+  if (!args.chunkCount || !args.commandCount || args.commandCount > MaxCommandCount) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (!args.maxThreadCount)
+    args.maxThreadCount = std::max(dxvk::thread::hardware_concurrency(), 1u);
+
+  std::printf("%u chunks per thread, %u commands per chunk\n",
+    args.chunkCount, args.commandCount);
+
+  for (uint32_t i = 1u; i < 2u * args.maxThreadCount; i *= 2u)
+    runBench(args, std::min(i, args.maxThreadCount));
+
+  return 0;
+}
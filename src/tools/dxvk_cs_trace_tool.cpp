@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../util/util_time.h"
+
+#include "../dxvk/dxvk_cs.h"
+#include "../dxvk/dxvk_cs_trace.h"
+
+using namespace dxvk;
+
+namespace {
+
+  struct TraceCommand {
+    uint32_t type     = 0u;
+    uint64_t duration = 0u;
+  };
+
+
+  struct TraceChunk {
+    uint32_t                  queue     = 0u;
+    uint64_t                  timestamp = 0u;
+    std::vector<TraceCommand> commands;
+  };
+
+
+  struct Trace {
+    std::vector<std::string>  typeNames;
+    std::vector<TraceChunk>   chunks;
+  };
+
+
+  struct CommandStats {
+    std::string           name;
+    std::vector<uint64_t> durations;
+    uint64_t              total = 0u;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [--replay] <file.dxcs> [count]\n\n", name);
+    std::printf("Prints CPU time spent executing each CS command type,\n");
+    std::printf("sorted by total time. Optionally limits the output to\n");
+    std::printf("the given number of command types.\n\n");
+    std::printf("With --replay, the recorded chunks are submitted to a CS\n");
+    std::printf("thread again, with each command busy-waiting for its\n");
+    std::printf("recorded execution time, and the times measured during\n");
+    std::printf("replay are printed along with the CS thread overhead.\n");
+    std::printf("This does not require a device.\n");
+  }
+
+
+  uint64_t getPercentile(const std::vector<uint64_t>& sorted, uint32_t percent) {
+    if (sorted.empty())
+      return 0u;
+
+    size_t index = (sorted.size() - 1u) * percent / 100u;
+    return sorted[index];
+  }
+
+
+  bool readTrace(const std::string& path, Trace& trace) {
+    util::File file(path, util::FileFlags(util::FileFlag::AllowRead));
+
+    if (!file) {
+      std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+      return false;
+    }
+
+    util::FileView view = file.map();
+
+    DxvkCsTraceHeader header = { };
+
+    if (!view.read(0u, sizeof(header), &header)
+     || header.magic != std::array<char, 4>({ 'D', 'X', 'C', 'S' })) {
+      std::fprintf(stderr, "Not a CS trace file: %s\n", path.c_str());
+      return false;
+    }
+
+    if (header.version != DxvkCsTraceWriter::Version) {
+      std::fprintf(stderr, "Unsupported trace version %u\n", header.version);
+      return false;
+    }
+
+    size_t offset = sizeof(header);
+
+    while (offset + sizeof(DxvkCsTraceRecord) <= view.size()) {
+      DxvkCsTraceRecord record = { };
+      view.read(offset, sizeof(record), &record);
+      offset += sizeof(record);
+
+      switch (record.type) {
+        case DxvkCsTraceRecordType::CommandType: {
+          auto name = view.ptr(offset, record.data);
+
+          if (!name) {
+            std::fprintf(stderr, "Truncated trace file\n");
+            return false;
+          }
+
+          if (record.index >= trace.typeNames.size())
+            trace.typeNames.resize(record.index + 1u);
+
+          trace.typeNames[record.index] = std::string(name, record.data);
+          offset += record.data;
+        } break;
+
+        case DxvkCsTraceRecordType::Chunk: {
+          if (record.index > uint32_t(DxvkCsQueue::HighPriority)) {
+            std::fprintf(stderr, "Invalid queue %u at offset %zu\n", record.index, offset - sizeof(record));
+            return false;
+          }
+
+          auto& chunk = trace.chunks.emplace_back();
+          chunk.queue = record.index;
+          chunk.timestamp = record.data;
+        } break;
+
+        case DxvkCsTraceRecordType::Command: {
+          if (trace.chunks.empty()) {
+            std::fprintf(stderr, "Command outside of chunk at offset %zu\n", offset - sizeof(record));
+            return false;
+          }
+
+          if (record.index >= trace.typeNames.size())
+            trace.typeNames.resize(record.index + 1u);
+
+          auto& command = trace.chunks.back().commands.emplace_back();
+          command.type = record.index;
+          command.duration = record.data;
+        } break;
+
+        default:
+          std::fprintf(stderr, "Invalid record type %u at offset %zu\n",
+            uint32_t(record.type), offset - sizeof(record));
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  void printCommandStats(std::vector<CommandStats>& commands, uint64_t totalTime, size_t maxCount) {
+    std::sort(commands.begin(), commands.end(), [] (const CommandStats& a, const CommandStats& b) {
+      return a.total > b.total;
+    });
+
+    std::printf("\n%10s %10s %6s %8s %8s %8s %8s  %s\n",
+      "count", "total ms", "%", "mean us", "p50 us", "p99 us", "max us", "command");
+
+    if (maxCount)
+      commands.resize(std::min(commands.size(), maxCount));
+
+    for (auto& stats : commands) {
+      if (stats.durations.empty())
+        continue;
+
+      std::sort(stats.durations.begin(), stats.durations.end());
+
+      std::printf("%10zu %10.3f %6.2f %8.2f %8.2f %8.2f %8.2f  %s\n",
+        stats.durations.size(),
+        double(stats.total) / 1e6,
+        totalTime ? 100.0 * double(stats.total) / double(totalTime) : 0.0,
+        double(stats.total) / double(stats.durations.size()) / 1e3,
+        double(getPercentile(stats.durations, 50u)) / 1e3,
+        double(getPercentile(stats.durations, 99u)) / 1e3,
+        double(stats.durations.back()) / 1e3,
+        stats.name.c_str());
+    }
+  }
+
+
+  std::vector<CommandStats> createCommandStats(const Trace& trace) {
+    std::vector<CommandStats> commands(trace.typeNames.size());
+
+    for (size_t i = 0u; i < commands.size(); i++)
+      commands[i].name = trace.typeNames[i];
+
+    return commands;
+  }
+
+
+  int printStats(const Trace& trace, size_t maxCount) {
+    std::vector<CommandStats> commands = createCommandStats(trace);
+    std::vector<uint64_t> queues;
+
+    uint64_t commandCount = 0u;
+    uint64_t totalTime = 0u;
+
+    for (const auto& chunk : trace.chunks) {
+      if (chunk.queue >= queues.size())
+        queues.resize(chunk.queue + 1u);
+
+      queues[chunk.queue] += 1u;
+
+      for (const auto& command : chunk.commands) {
+        auto& stats = commands[command.type];
+        stats.durations.push_back(command.duration);
+        stats.total += command.duration;
+
+        commandCount += 1u;
+        totalTime += command.duration;
+      }
+    }
+
+    uint64_t lastTimestamp = trace.chunks.empty() ? 0u : trace.chunks.back().timestamp;
+
+    std::printf("Trace duration: %.3f ms\n", double(lastTimestamp) / 1e6);
+    std::printf("Commands:       %llu (%zu types)\n", (unsigned long long)commandCount, commands.size());
+    std::printf("Execution time: %.3f ms\n", double(totalTime) / 1e6);
+
+    for (size_t i = 0u; i < queues.size(); i++)
+      std::printf("Queue %zu:        %llu chunks\n", i, (unsigned long long)queues[i]);
+
+    printCommandStats(commands, totalTime, maxCount);
+    return 0;
+  }
+
+
+  void spinFor(uint64_t ns) {
+    auto t0 = high_resolution_clock::now();
+
+    while (uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        high_resolution_clock::now() - t0).count()) < ns)
+      continue;
+  }
+
+
+  int replay(const Trace& trace, size_t maxCount) {
+    std::vector<CommandStats> commands = createCommandStats(trace);
+
+    uint64_t commandCount = 0u;
+    uint64_t recordedTime = 0u;
+
+    for (const auto& chunk : trace.chunks) {
+      for (const auto& command : chunk.commands) {
+        recordedTime += command.duration;
+        commandCount += 1u;
+      }
+    }
+
+    DxvkCsChunkPool pool(nullptr);
+    DxvkCsThread cs(nullptr, nullptr);
+
+    // Commands only run on the CS thread, and all stats are read
+    // after the final synchronization, so no locking is needed.
+    auto t0 = high_resolution_clock::now();
+
+    for (const auto& chunk : trace.chunks) {
+      DxvkCsQueue queue = DxvkCsQueue(chunk.queue);
+      DxvkCsChunkRef ref(pool.allocChunk(DxvkCsChunkFlag::SingleUse), &pool);
+
+      for (const auto& command : chunk.commands) {
+        auto replayCommand = [&commands, command] (DxvkContext*) {
+          auto start = high_resolution_clock::now();
+          spinFor(command.duration);
+          auto end = high_resolution_clock::now();
+
+          auto& stats = commands[command.type];
+          uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+          stats.durations.push_back(ns);
+          stats.total += ns;
+        };
+
+        // Replay commands may be larger than the recorded ones,
+        // so split the chunk if it runs out of space.
+        if (!ref->push(replayCommand)) {
+          cs.injectChunk(queue, std::move(ref), false);
+
+          ref = DxvkCsChunkRef(pool.allocChunk(DxvkCsChunkFlag::SingleUse), &pool);
+          ref->push(replayCommand);
+        }
+      }
+
+      cs.injectChunk(queue, std::move(ref), false);
+    }
+
+    // Chunks are executed in queue order, so waiting
+    // for an empty chunk also waits for all previous chunks.
+    for (auto queue : { DxvkCsQueue::HighPriority, DxvkCsQueue::Ordered }) {
+      cs.injectChunk(queue, DxvkCsChunkRef(
+        pool.allocChunk(DxvkCsChunkFlag::SingleUse), &pool), true);
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    uint64_t replayTime = 0u;
+
+    for (const auto& stats : commands)
+      replayTime += stats.total;
+
+    uint64_t wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    uint64_t overhead = wallTime > replayTime ? wallTime - replayTime : 0u;
+
+    std::printf("Chunks:         %zu\n", trace.chunks.size());
+    std::printf("Commands:       %llu (%zu types)\n", (unsigned long long)commandCount, commands.size());
+    std::printf("Recorded time:  %.3f ms\n", double(recordedTime) / 1e6);
+    std::printf("Replay time:    %.3f ms\n", double(replayTime) / 1e6);
+    std::printf("Wall time:      %.3f ms\n", double(wallTime) / 1e6);
+    std::printf("CS overhead:    %.3f ms (%.1f ns per command)\n", double(overhead) / 1e6,
+      commandCount ? double(overhead) / double(commandCount) : 0.0);
+
+    printCommandStats(commands, replayTime, maxCount);
+    return 0;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  bool doReplay = argc > 1 && !std::strcmp(argv[1], "--replay");
+
+  int argIndex = doReplay ? 2 : 1;
+
+  if (argc <= argIndex || argc > argIndex + 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  size_t maxCount = argc > argIndex + 1 ? std::strtoull(argv[argIndex + 1], nullptr, 10) : 0u;
+
+  Trace trace;
+
+  if (!readTrace(argv[argIndex], trace))
+    return 1;
+
+  return doReplay
+    ? replay(trace, maxCount)
+    : printStats(trace, maxCount);
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../util/log/log.h"
+#include "../util/util_lru.h"
+#include "../util/util_string.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of objects used for the randomized test */
+  constexpr uint32_t TestObjectCount = 64u;
+
+  /** Number of random operations per test */
+  constexpr uint32_t TestOperationCount = 200000u;
+
+  uint32_t g_failures = 0u;
+
+
+  struct Object : public lru_node<Object> {
+    uint32_t id = 0u;
+  };
+
+
+  void fail(const std::string& message) {
+    if (g_failures++ < 32u)
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+  }
+
+
+  /**
+   * \brief Randomized LRU list test
+   *
+   * Applies random operations to both the list and a
+   * \c std::list model, and compares the full order
+   * of objects after each operation.
+   */
+  class LruTest {
+
+  public:
+
+    LruTest(uint32_t seed)
+    : m_rng(seed), m_objects(TestObjectCount) {
+      for (uint32_t i = 0u; i < TestObjectCount; i++)
+        m_objects[i].id = i;
+    }
+
+    void run() {
+      for (uint32_t i = 0u; i < TestOperationCount && !g_failures; i++) {
+        uint32_t op = m_rng() % 100u;
+        Object* object = &m_objects[m_rng() % TestObjectCount];
+
+        if (op < 30u)
+          insert(object);
+        else if (op < 70u)
+          touch(object);
+        else if (op < 90u)
+          remove(object);
+        else if (op < 98u)
+          evict(1u + m_rng() % 8u);
+        else
+          touchCopy(object);
+
+        validate();
+      }
+
+      // Drain the list so that no object is linked on destruction
+      evict(TestObjectCount);
+
+      if (m_list.size() || m_list.leastRecentlyUsed())
+        fail("List not empty after evicting all objects");
+    }
+
+  private:
+
+    std::mt19937        m_rng;
+    std::vector<Object> m_objects;
+
+    lru_list<Object>    m_list;
+    std::list<Object*>  m_model;
+
+    void insert(Object* object) {
+      m_list.insert(object);
+
+      m_model.remove(object);
+      m_model.push_back(object);
+    }
+
+    void touch(Object* object) {
+      m_list.touch(object);
+
+      auto iter = std::find(m_model.begin(), m_model.end(), object);
+
+      if (iter != m_model.end())
+        m_model.splice(m_model.end(), m_model, iter);
+    }
+
+    void remove(Object* object) {
+      m_list.remove(object);
+      m_model.remove(object);
+    }
+
+    void evict(uint32_t count) {
+      // Walk the list and remove objects while iterating,
+      // the same way mapped textures get unmapped.
+      for (auto object = m_list.leastRecentlyUsed(); object && count; count--) {
+        auto next = m_list.next(object);
+        m_list.remove(object);
+        object = next;
+
+        m_model.pop_front();
+      }
+    }
+
+    void touchCopy(Object* object) {
+      // Copies of linked objects must not be linked themselves
+      Object copy = *object;
+
+      uint32_t size = m_list.size();
+      m_list.touch(&copy);
+      m_list.remove(&copy);
+
+      if (m_list.size() != size)
+        fail(str::format("Touching copy of object ", copy.id, " modified the list"));
+    }
+
+    void validate() {
+      if (m_list.size() != m_model.size()) {
+        fail(str::format("List has ", m_list.size(), " objects, expected ", m_model.size()));
+        return;
+      }
+
+      Object* object = m_list.leastRecentlyUsed();
+
+      for (auto expected : m_model) {
+        if (object != expected) {
+          fail(str::format("Found object ", object ? int32_t(object->id) : -1,
+            " in LRU order, expected ", expected->id));
+          return;
+        }
+
+        object = m_list.next(object);
+      }
+
+      if (object)
+        fail(str::format("Object ", object->id, " not expected in list"));
+    }
+
+  };
+
+}
+
+
+int main() {
+  for (uint32_t seed : { 1u, 0x1234567u, 0xdeadbeefu })
+    LruTest(seed).run();
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../dxvk/dxvk_allocator.h"
+#include "../dxvk/dxvk_memory_trace.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of alloc and free events between fragmentation samples */
+  constexpr uint64_t SampleInterval = 1024u;
+
+
+  struct ReplayPool {
+    DxvkPageAllocator     pageAllocator;
+    DxvkPoolAllocator     poolAllocator = { pageAllocator };
+
+    /// Maps traced addresses to replayed addresses
+    std::unordered_map<uint64_t, uint64_t> addressMap;
+    /// Maps traced chunk indices to replayed chunk indices
+    std::unordered_map<uint32_t, uint32_t> chunkMap;
+
+    uint64_t allocCount       = 0u;
+    uint64_t allocFailed      = 0u;
+    uint64_t freeCount        = 0u;
+    uint64_t chunkCount       = 0u;
+    uint64_t chunkKept        = 0u;
+
+    uint64_t memoryAllocated  = 0u;
+    uint64_t memoryUsed       = 0u;
+    uint64_t peakAllocated    = 0u;
+    uint64_t peakUsed         = 0u;
+
+    uint64_t dedicatedCount   = 0u;
+    uint64_t dedicatedMemory  = 0u;
+    uint64_t peakDedicated    = 0u;
+
+    uint64_t relocationCount  = 0u;
+    uint64_t relocationMemory = 0u;
+
+    uint64_t sampleCount      = 0u;
+    double   sumUtilization   = 0.0;
+    double   sumFragmentation = 0.0;
+    double   maxFragmentation = 0.0;
+
+    std::vector<uint64_t> allocTimes;
+    std::vector<uint64_t> freeTimes;
+
+    int64_t alloc(uint64_t size, uint64_t alignment) {
+      if (size <= DxvkPoolAllocator::MaxSize)
+        return poolAllocator.alloc(size);
+      else
+        return pageAllocator.alloc(size, alignment);
+    }
+
+    void free(uint64_t address, uint64_t size) {
+      if (size <= DxvkPoolAllocator::MaxSize)
+        poolAllocator.free(address, size);
+      else
+        pageAllocator.free(address, size);
+    }
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s <file.dxmt>\n\n", name);
+    std::printf("Replays a memory allocator trace against the page and pool\n");
+    std::printf("allocators, and prints allocation latency as well as memory\n");
+    std::printf("utilization and fragmentation statistics for each pool.\n");
+  }
+
+
+  uint64_t getPercentile(const std::vector<uint64_t>& sorted, uint32_t percent) {
+    if (sorted.empty())
+      return 0u;
+
+    size_t index = (sorted.size() - 1u) * percent / 100u;
+    return sorted[index];
+  }
+
+
+  uint64_t measure(high_resolution_clock::time_point t0) {
+    auto t1 = high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  }
+
+
+  void samplePool(ReplayPool& pool) {
+    // Compute page utilization of live chunks as well as external
+    // fragmentation, i.e. how much of the free memory cannot be used
+    // for a single allocation, from the page allocation masks.
+    std::vector<uint32_t> mask((1u << DxvkPageAllocator::ChunkPageBits) / 32u);
+
+    uint64_t pagesTotal = 0u;
+    uint64_t pagesUsed = 0u;
+    uint64_t pagesFree = 0u;
+    uint64_t largestFree = 0u;
+
+    for (uint32_t i = 0u; i < pool.pageAllocator.chunkCount(); i++) {
+      uint32_t pageCount = pool.pageAllocator.pageCount(i);
+
+      if (!pageCount)
+        continue;
+
+      pagesTotal += pageCount;
+      pagesUsed += pool.pageAllocator.pagesUsed(i);
+
+      if (!pool.pageAllocator.chunkIsAvailable(i))
+        continue;
+
+      pool.pageAllocator.getPageAllocationMask(i, mask.data());
+
+      uint64_t run = 0u;
+
+      for (uint32_t j = 0u; j < pageCount; j++) {
+        if (mask[j / 32u] & (1u << (j % 32u))) {
+          run = 0u;
+        } else {
+          pagesFree += 1u;
+          largestFree = std::max(largestFree, ++run);
+        }
+      }
+    }
+
+    if (!pagesTotal)
+      return;
+
+    double fragmentation = pagesFree
+      ? 1.0 - double(largestFree) / double(pagesFree)
+      : 0.0;
+
+    pool.sampleCount += 1u;
+    pool.sumUtilization += double(pagesUsed) / double(pagesTotal);
+    pool.sumFragmentation += fragmentation;
+    pool.maxFragmentation = std::max(pool.maxFragmentation, fragmentation);
+  }
+
+
+  void printLatency(const char* name, std::vector<uint64_t>& times) {
+    if (times.empty())
+      return;
+
+    std::sort(times.begin(), times.end());
+
+    uint64_t total = 0u;
+
+    for (auto t : times)
+      total += t;
+
+    std::printf("  %-6s latency: mean %7.1f ns, p50 %6llu ns, p99 %6llu ns, max %8llu ns\n", name,
+      double(total) / double(times.size()),
+      (unsigned long long)getPercentile(times, 50u),
+      (unsigned long long)getPercentile(times, 99u),
+      (unsigned long long)times.back());
+  }
+
+
+  void printPool(uint32_t index, ReplayPool& pool) {
+    std::printf("\nMemory type %u (%s):\n", index / 2u, (index & 1u) ? "mapped" : "device");
+    std::printf("  Chunks:         %llu created, %llu kept alive by replay\n",
+      (unsigned long long)pool.chunkCount, (unsigned long long)pool.chunkKept);
+    std::printf("  Allocations:    %llu (%llu failed), %llu freed\n",
+      (unsigned long long)pool.allocCount, (unsigned long long)pool.allocFailed,
+      (unsigned long long)pool.freeCount);
+    std::printf("  Peak memory:    %.1f MB allocated, %.1f MB used\n",
+      double(pool.peakAllocated) / double(1u << 20),
+      double(pool.peakUsed) / double(1u << 20));
+
+    if (pool.dedicatedCount) {
+      std::printf("  Dedicated:      %llu allocations, %.1f MB peak\n",
+        (unsigned long long)pool.dedicatedCount,
+        double(pool.peakDedicated) / double(1u << 20));
+    }
+
+    if (pool.relocationCount) {
+      std::printf("  Relocations:    %llu, %.1f MB\n",
+        (unsigned long long)pool.relocationCount,
+        double(pool.relocationMemory) / double(1u << 20));
+    }
+
+    if (pool.sampleCount) {
+      std::printf("  Utilization:    %.1f%% average\n",
+        100.0 * pool.sumUtilization / double(pool.sampleCount));
+      std::printf("  Fragmentation:  %.1f%% average, %.1f%% max\n",
+        100.0 * pool.sumFragmentation / double(pool.sampleCount),
+        100.0 * pool.maxFragmentation);
+    }
+
+    printLatency("alloc", pool.allocTimes);
+    printLatency("free", pool.freeTimes);
+  }
+
+
+  int replay(const std::string& path) {
+    util::File file(path, util::FileFlags(util::FileFlag::AllowRead));
+
+    if (!file) {
+      std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+      return 1;
+    }
+
+    util::FileView view = file.map();
+
+    DxvkMemoryTraceHeader header = { };
+
+    if (!view.read(0u, sizeof(header), &header)
+     || header.magic != std::array<char, 4>({ 'D', 'X', 'M', 'T' })) {
+      std::fprintf(stderr, "Not a memory trace file: %s\n", path.c_str());
+      return 1;
+    }
+
+    if (header.version != DxvkMemoryTraceWriter::Version) {
+      std::fprintf(stderr, "Unsupported trace version %u\n", header.version);
+      return 1;
+    }
+
+    std::map<uint32_t, std::unique_ptr<ReplayPool>> pools;
+
+    uint64_t eventCount = 0u;
+    uint64_t lastTimestamp = 0u;
+    uint64_t unknownFrees = 0u;
+
+    size_t offset = sizeof(header);
+
+    while (offset + sizeof(DxvkMemoryTraceRecord) <= view.size()) {
+      DxvkMemoryTraceRecord record = { };
+      view.read(offset, sizeof(record), &record);
+      offset += sizeof(record);
+
+      auto& poolEntry = pools[record.pool];
+
+      if (!poolEntry)
+        poolEntry = std::make_unique<ReplayPool>();
+
+      auto& pool = *poolEntry;
+
+      uint32_t chunkIndex = uint32_t(record.address >> DxvkPageAllocator::ChunkAddressBits);
+      auto chunk = pool.chunkMap.find(chunkIndex);
+
+      switch (record.type) {
+        case DxvkMemoryTraceEvent::ChunkCreate: {
+          pool.chunkMap[chunkIndex] = pool.pageAllocator.addChunk(record.size);
+          pool.chunkCount += 1u;
+          pool.memoryAllocated += record.size;
+          pool.peakAllocated = std::max(pool.peakAllocated, pool.memoryAllocated);
+        } break;
+
+        case DxvkMemoryTraceEvent::ChunkDestroy: {
+          if (chunk == pool.chunkMap.end())
+            break;
+
+          // If allocations ended up in different places during the
+          // replay, the chunk may still be in use. Keep it alive but
+          // do not place any further allocations in it.
+          if (pool.pageAllocator.pagesUsed(chunk->second)) {
+            pool.pageAllocator.killChunk(chunk->second);
+            pool.chunkKept += 1u;
+          } else {
+            pool.pageAllocator.removeChunk(chunk->second);
+            pool.memoryAllocated -= record.size;
+          }
+
+          pool.chunkMap.erase(chunk);
+        } break;
+
+        case DxvkMemoryTraceEvent::ChunkDisable: {
+          if (chunk != pool.chunkMap.end())
+            pool.pageAllocator.killChunk(chunk->second);
+        } break;
+
+        case DxvkMemoryTraceEvent::ChunkEnable: {
+          if (chunk != pool.chunkMap.end())
+            pool.pageAllocator.reviveChunk(chunk->second);
+        } break;
+
+        case DxvkMemoryTraceEvent::ChunkEnableAll: {
+          pool.pageAllocator.reviveChunks();
+        } break;
+
+        case DxvkMemoryTraceEvent::Alloc: {
+          auto t0 = high_resolution_clock::now();
+          int64_t address = pool.alloc(record.size, uint64_t(1u) << record.alignment);
+          pool.allocTimes.push_back(measure(t0));
+
+          pool.allocCount += 1u;
+
+          if (address < 0) {
+            pool.allocFailed += 1u;
+            break;
+          }
+
+          pool.addressMap[record.address] = uint64_t(address);
+          pool.memoryUsed += record.size;
+          pool.peakUsed = std::max(pool.peakUsed, pool.memoryUsed);
+
+          if (!(pool.allocCount % SampleInterval))
+            samplePool(pool);
+        } break;
+
+        case DxvkMemoryTraceEvent::Free: {
+          auto entry = pool.addressMap.find(record.address);
+
+          if (entry == pool.addressMap.end()) {
+            unknownFrees += 1u;
+            break;
+          }
+
+          auto t0 = high_resolution_clock::now();
+          pool.free(entry->second, record.size);
+          pool.freeTimes.push_back(measure(t0));
+
+          pool.addressMap.erase(entry);
+          pool.freeCount += 1u;
+          pool.memoryUsed -= record.size;
+
+          if (!(pool.freeCount % SampleInterval))
+            samplePool(pool);
+        } break;
+
+        case DxvkMemoryTraceEvent::DedicatedAlloc: {
+          pool.dedicatedCount += 1u;
+          pool.dedicatedMemory += record.size;
+          pool.peakDedicated = std::max(pool.peakDedicated, pool.dedicatedMemory);
+        } break;
+
+        case DxvkMemoryTraceEvent::DedicatedFree: {
+          pool.dedicatedMemory -= std::min(pool.dedicatedMemory, record.size);
+        } break;
+
+        case DxvkMemoryTraceEvent::Relocate: {
+          pool.relocationCount += 1u;
+          pool.relocationMemory += record.size;
+        } break;
+
+        default:
+          std::fprintf(stderr, "Invalid event type %u at offset %zu\n",
+            uint32_t(record.type), offset - sizeof(record));
+          return 1;
+      }
+
+      eventCount += 1u;
+      lastTimestamp = record.timestamp;
+    }
+
+    std::printf("Trace duration: %.3f s\n", double(lastTimestamp) / 1e9);
+    std::printf("Events:         %llu\n", (unsigned long long)eventCount);
+
+    if (unknownFrees)
+      std::printf("Unmatched frees: %llu\n", (unsigned long long)unknownFrees);
+
+    for (auto& pool : pools)
+      printPool(pool.first, *pool.second);
+
+    return 0;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  return replay(argv[1]);
+}
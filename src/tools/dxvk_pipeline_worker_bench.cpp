@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../util/thread.h"
+#include "../util/util_time.h"
+
+#include "../dxvk/dxvk_pipeline_queue.h"
+
+using namespace dxvk;
+
+namespace {
+
+  struct BenchArgs {
+    uint32_t producerCount  = 4u;
+    uint32_t taskCount      = 100000u;
+    uint32_t spinCount      = 1000u;
+    uint32_t maxWorkerCount = 0u;
+  };
+
+
+  /**
+   * \brief Dummy task
+   *
+   * Spins for a while and then marks itself as executed.
+   */
+  struct BenchTask {
+    uint8_t*  flag      = nullptr;
+    uint32_t  spinCount = 0u;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s [producers] [tasks per producer] [spin iterations] [max workers]\n\n", name);
+    std::printf("Enqueues dummy tasks with mixed priorities from multiple producer\n");
+    std::printf("threads and measures task throughput of the pipeline task queue\n");
+    std::printf("for increasing worker counts, up to the number of CPU cores.\n");
+  }
+
+
+  void spin(uint32_t count) {
+    volatile uint32_t value = 0u;
+
+    for (uint32_t i = 0u; i < count; i++)
+      value = value + i;
+  }
+
+
+  bool runBench(const BenchArgs& args, uint32_t workerCount) {
+    DxvkPipelineTaskQueue<BenchTask> queue;
+    queue.init(workerCount);
+    queue.start();
+
+    std::atomic<uint64_t> tasksCompleted = { 0ull };
+
+    std::vector<dxvk::thread> workers;
+    workers.reserve(workerCount);
+
+    for (uint32_t i = 0u; i < workerCount; i++) {
+      workers.emplace_back([&queue, &tasksCompleted, i] {
+        BenchTask task;
+
+        while (queue.pop(i, task)) {
+          spin(task.spinCount);
+          *task.flag += 1u;
+
+          tasksCompleted.fetch_add(1u, std::memory_order_release);
+        }
+      });
+    }
+
+    // One counter per task so that every single task can be
+    // verified to run exactly once without a shared atomic
+    std::vector<std::vector<uint8_t>> executed(args.producerCount,
+      std::vector<uint8_t>(args.taskCount));
+
+    std::vector<dxvk::thread> producers;
+    producers.reserve(args.producerCount);
+
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < args.producerCount; i++) {
+      producers.emplace_back([&queue, &executed, &args, i] {
+        auto& flags = executed[i];
+
+        for (uint32_t j = 0u; j < args.taskCount; j++) {
+          // Mostly low-priority tasks, much like optimized pipelines
+          // during a loading screen, with the occasional library.
+          auto priority = DxvkPipelinePriority::Low;
+
+          if (!(j % 16u))
+            priority = DxvkPipelinePriority::High;
+          else if (!(j % 4u))
+            priority = DxvkPipelinePriority::Normal;
+
+          BenchTask task;
+          task.flag = &flags[j];
+          task.spinCount = args.spinCount;
+
+          queue.push(std::move(task), priority);
+        }
+      });
+    }
+
+    for (auto& thread : producers)
+      thread.join();
+
+    auto t1 = high_resolution_clock::now();
+
+    uint64_t taskTotal = uint64_t(args.producerCount) * args.taskCount;
+    while (tasksCompleted.load(std::memory_order_acquire) < taskTotal)
+      dxvk::this_thread::yield();
+
+    auto t2 = high_resolution_clock::now();
+
+    queue.stop();
+
+    for (auto& thread : workers)
+      thread.join();
+
+    uint32_t failures = 0u;
+
+    for (const auto& flags : executed) {
+      for (const auto& flag : flags)
+        failures += flag != 1u ? 1u : 0u;
+    }
+
+    auto enqueueUs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    auto totalUs = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t0).count();
+
+    std::printf("%3u workers: %10.0f tasks/s, enqueue %8lld us, total %8lld us, %llu stolen\n",
+      workerCount, double(taskTotal) * 1000000.0 / double(std::max<int64_t>(totalUs, 1)),
+      (long long)enqueueUs, (long long)totalUs, (unsigned long long)queue.getStolenCount());
+
+    if (failures)
+      std::fprintf(stderr, "%u tasks were not executed exactly once\n", failures);
+
+    return !failures;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+
+  if (argc > 5) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (argc > 1) args.producerCount  = std::strtoul(argv[1], nullptr, 10);
+  if (argc > 2) args.taskCount      = std::strtoul(argv[2], nullptr, 10);
+  if (argc > 3) args.spinCount      = std::strtoul(argv[3], nullptr, 10);
+  if (argc > 4) args.maxWorkerCount = std::strtoul(argv[4], nullptr, 10);
+
+  if (!args.producerCount || !args.taskCount) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (!args.maxWorkerCount)
+    args.maxWorkerCount = std::max(dxvk::thread::hardware_concurrency(), 1u);
+
+  std::printf("%u producers, %u tasks each, %u spin iterations per task\n",
+    args.producerCount, args.taskCount, args.spinCount);
+
+  bool success = true;
+
+  for (uint32_t i = 1u; i < 2u * args.maxWorkerCount; i *= 2u)
+    success &= runBench(args, std::min(i, args.maxWorkerCount));
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../spirv/spirv_compression.h"
+
+#include "../util/util_time.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of times each shader gets compressed and decompressed */
+  constexpr uint32_t IterationCount = 16u;
+
+
+  struct BenchStats {
+    uint64_t fileCount        = 0u;
+    uint64_t failedCount      = 0u;
+    uint64_t rawSize          = 0u;
+    uint64_t compressedSize   = 0u;
+    uint64_t compressNs       = 0u;
+    uint64_t decompressNs     = 0u;
+    uint64_t streamNs         = 0u;
+  };
+
+
+  void printUsage(const char* name) {
+    std::printf("Usage: %s <file.spv | directory>...\n\n", name);
+    std::printf("Compresses and decompresses each SPIR-V binary, verifies that\n");
+    std::printf("the code round-trips, and prints the compression ratio as well\n");
+    std::printf("as codec throughput. Directories are searched recursively for\n");
+    std::printf("*.spv files, e.g. as written with DXVK_SHADER_DUMP_PATH.\n");
+  }
+
+
+  template<typename Proc>
+  uint64_t measure(const Proc& proc) {
+    auto t0 = high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < IterationCount; i++)
+      proc();
+
+    auto t1 = high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  }
+
+
+  void benchFile(const std::filesystem::path& path, BenchStats& stats) {
+    std::ifstream stream(path, std::ios::binary);
+    SpirvCodeBuffer code(stream);
+
+    if (!code.dwords())
+      return;
+
+    SpirvCompressedBuffer compressed(code);
+
+    // Make sure that decoding reproduces the input exactly
+    SpirvCodeBuffer decoded = compressed.decompress();
+
+    if (decoded.dwords() != code.dwords() || std::memcmp(decoded.data(), code.data(), code.size())) {
+      std::fprintf(stderr, "Round-trip mismatch: %s\n", path.string().c_str());
+      stats.failedCount += 1u;
+      return;
+    }
+
+    stats.fileCount += 1u;
+    stats.rawSize += code.size();
+    stats.compressedSize += compressed.getCompressedData().size() * sizeof(uint32_t);
+
+    stats.compressNs += measure([&code] {
+      SpirvCompressedBuffer buffer(code);
+    });
+
+    stats.decompressNs += measure([&compressed] {
+      compressed.decompress();
+    });
+
+    // Mimic a binding patch pass that inspects every instruction
+    uint32_t opcodes = 0u;
+
+    stats.streamNs += measure([&compressed, &opcodes] {
+      compressed.decompress([&opcodes] (const SpirvInstruction& ins) {
+        opcodes += uint32_t(ins.opCode());
+      });
+    });
+  }
+
+
+  void benchPath(const std::filesystem::path& path, BenchStats& stats) {
+    if (std::filesystem::is_directory(path)) {
+      for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".spv")
+          benchFile(entry.path(), stats);
+      }
+    } else {
+      benchFile(path, stats);
+    }
+  }
+
+
+  double getThroughput(uint64_t size, uint64_t ns) {
+    return ns ? (double(size) * double(IterationCount) * 1000.0) / (double(ns) * 1024.0 * 1024.0) : 0.0;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  BenchStats stats;
+
+  for (int i = 1; i < argc; i++)
+    benchPath(argv[i], stats);
+
+  if (!stats.fileCount) {
+    std::fprintf(stderr, "No SPIR-V binaries found\n");
+    return 1;
+  }
+
+  std::printf("Shaders:          %llu (%llu failed)\n",
+    (unsigned long long)stats.fileCount, (unsigned long long)stats.failedCount);
+  std::printf("Raw size:         %llu kB\n", (unsigned long long)(stats.rawSize >> 10u));
+  std::printf("Compressed size:  %llu kB (%.1f%%)\n", (unsigned long long)(stats.compressedSize >> 10u),
+    100.0 * double(stats.compressedSize) / double(stats.rawSize));
+  std::printf("Compress:         %8.1f MB/s\n", getThroughput(stats.rawSize, stats.compressNs));
+  std::printf("Decompress:       %8.1f MB/s\n", getThroughput(stats.rawSize, stats.decompressNs));
+  std::printf("Streaming decode: %8.1f MB/s\n", getThroughput(stats.rawSize, stats.streamNs));
+
+  return stats.failedCount ? 1 : 0;
+}
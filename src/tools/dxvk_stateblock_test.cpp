@@ -0,0 +1,667 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../d3d9/d3d9_stateblock_program.h"
+
+#include "../util/log/log.h"
+#include "../util/util_string.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** Number of lights stored in each source state */
+  constexpr uint32_t LightCount = 8u;
+
+  /** Number of state blocks with random captures */
+  constexpr uint32_t RandomTestCount = 64u;
+
+  uint32_t g_failures = 0u;
+
+
+  /**
+   * \brief State block contents
+   *
+   * Holds captured state values the same way the state block does,
+   * but without any dynamic allocation of individual state groups.
+   */
+  struct TestState {
+    Com<D3D9VertexDecl,  false>                         vertexDecl;
+    Com<D3D9IndexBuffer, false>                         indices;
+
+    std::array<DWORD, RenderStateCount>                 renderStates = {};
+
+    std::array<
+      std::array<DWORD, SamplerStateCount>,
+      SamplerCount>                                     samplerStates = {};
+
+    std::array<D3D9VBO, caps::MaxStreams>               vertexBuffers = {};
+    std::array<IDirect3DBaseTexture9*, SamplerCount>    textures = {};
+
+    Com<D3D9VertexShader, false>                        vertexShader;
+    Com<D3D9PixelShader,  false>                        pixelShader;
+
+    D3DVIEWPORT9                                        viewport = {};
+    RECT                                                scissorRect = {};
+
+    std::array<D3D9ClipPlane, caps::MaxClipPlanes>      clipPlanes = {};
+
+    std::array<
+      std::array<DWORD, TextureStageStateCount>,
+      caps::TextureStageCount>                          textureStages = {};
+
+    static_item<D3D9ShaderConstantsVSSoftware>          vsConsts;
+    static_item<D3D9ShaderConstantsPS>                  psConsts;
+
+    std::array<UINT, caps::MaxStreams>                  streamFreq = {};
+    std::array<Matrix4, caps::MaxTransforms>            transforms = {};
+
+    D3DMATERIAL9                                        material = {};
+
+    std::vector<std::optional<D3DLIGHT9>>               lights;
+    std::array<DWORD, caps::MaxEnabledLights>           enabledLightIndices = {};
+
+    bool IsLightEnabled(DWORD Index) const {
+      const auto& enabledIndices = enabledLightIndices;
+      return std::find(enabledIndices.begin(), enabledIndices.end(), Index) != enabledIndices.end();
+    }
+  };
+
+
+  /**
+   * \brief Applied state
+   *
+   * Maps each individual state, i.e. a render state, a sampler
+   * state of a given sampler or a single constant register, to
+   * the raw value it was last set to.
+   */
+  using StateKey = std::tuple<D3D9StateBlockOpType, uint32_t, uint32_t>;
+  using StateMap = std::map<StateKey, std::string>;
+
+
+  template<typename T>
+  void setState(StateMap& state, D3D9StateBlockOpType type, uint32_t stage, uint32_t index, const T& value) {
+    state[StateKey(type, stage, index)] = std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+
+  /**
+   * \brief Recording device
+   *
+   * Provides the state setters that state blocks use on the
+   * device, and records the values they set. Constant ranges
+   * and bool bit fields are split into individual registers.
+   */
+  class RecordingDevice {
+
+  public:
+
+    HRESULT SetVertexDeclaration(D3D9VertexDecl* pDecl) {
+      return set(D3D9StateBlockOpType::VertexDecl, 0u, 0u, pDecl);
+    }
+
+    HRESULT SetIndices(D3D9IndexBuffer* pIndexData) {
+      return set(D3D9StateBlockOpType::Indices, 0u, 0u, pIndexData);
+    }
+
+    HRESULT SetRenderState(D3DRENDERSTATETYPE State, DWORD Value) {
+      return set(D3D9StateBlockOpType::RenderState, 0u, State, Value);
+    }
+
+    HRESULT SetStateSamplerState(DWORD StateSampler, D3DSAMPLERSTATETYPE Type, DWORD Value) {
+      return set(D3D9StateBlockOpType::SamplerState, StateSampler, Type, Value);
+    }
+
+    HRESULT SetStreamSource(UINT StreamNumber, D3D9VertexBuffer* pStreamData, UINT OffsetInBytes, UINT Stride) {
+      return set(D3D9StateBlockOpType::VertexBuffer, 0u, StreamNumber,
+        std::array<uint64_t, 3>({ uint64_t(uintptr_t(pStreamData)), OffsetInBytes, Stride }));
+    }
+
+    HRESULT SetStreamSourceFreq(UINT StreamNumber, UINT Setting) {
+      return set(D3D9StateBlockOpType::StreamFreq, 0u, StreamNumber, Setting);
+    }
+
+    HRESULT SetStateTexture(DWORD StateSampler, IDirect3DBaseTexture9* pTexture) {
+      return set(D3D9StateBlockOpType::Texture, 0u, StateSampler, pTexture);
+    }
+
+    HRESULT SetVertexShader(D3D9VertexShader* pShader) {
+      return set(D3D9StateBlockOpType::VertexShader, 0u, 0u, pShader);
+    }
+
+    HRESULT SetPixelShader(D3D9PixelShader* pShader) {
+      return set(D3D9StateBlockOpType::PixelShader, 0u, 0u, pShader);
+    }
+
+    HRESULT SetMaterial(const D3DMATERIAL9* pMaterial) {
+      return set(D3D9StateBlockOpType::Material, 0u, 0u, *pMaterial);
+    }
+
+    HRESULT SetLight(DWORD Index, const D3DLIGHT9* pLight) {
+      return set(D3D9StateBlockOpType::Lights, 0u, Index, *pLight);
+    }
+
+    HRESULT LightEnable(DWORD Index, BOOL Enable) {
+      return set(D3D9StateBlockOpType::LightEnable, 0u, Index, Enable);
+    }
+
+    HRESULT SetStateTransform(uint32_t idx, const D3DMATRIX* pMatrix) {
+      return set(D3D9StateBlockOpType::Transform, 0u, idx, *pMatrix);
+    }
+
+    HRESULT SetStateTextureStageState(DWORD Stage, D3D9TextureStageStateTypes Type, DWORD Value) {
+      return set(D3D9StateBlockOpType::TextureStageState, Stage, Type, Value);
+    }
+
+    HRESULT SetViewport(const D3DVIEWPORT9* pViewport) {
+      return set(D3D9StateBlockOpType::Viewport, 0u, 0u, *pViewport);
+    }
+
+    HRESULT SetScissorRect(const RECT* pRect) {
+      return set(D3D9StateBlockOpType::ScissorRect, 0u, 0u, *pRect);
+    }
+
+    HRESULT SetClipPlane(DWORD Index, const float* pPlane) {
+      D3D9ClipPlane plane;
+      std::memcpy(plane.coeff, pPlane, sizeof(plane.coeff));
+      return set(D3D9StateBlockOpType::ClipPlane, 0u, Index, plane);
+    }
+
+    HRESULT SetVertexShaderConstantF(UINT StartRegister, const float* pConstantData, UINT Vector4fCount) {
+      return setConstants<Vector4>(D3D9StateBlockOpType::VsConstantsF, StartRegister, pConstantData, Vector4fCount);
+    }
+
+    HRESULT SetVertexShaderConstantI(UINT StartRegister, const int* pConstantData, UINT Vector4iCount) {
+      return setConstants<Vector4i>(D3D9StateBlockOpType::VsConstantsI, StartRegister, pConstantData, Vector4iCount);
+    }
+
+    HRESULT SetVertexBoolBitfield(uint32_t idx, uint32_t mask, uint32_t bits) {
+      return setBools(D3D9StateBlockOpType::VsConstantsB, idx, mask, bits);
+    }
+
+    HRESULT SetPixelShaderConstantF(UINT StartRegister, const float* pConstantData, UINT Vector4fCount) {
+      return setConstants<Vector4>(D3D9StateBlockOpType::PsConstantsF, StartRegister, pConstantData, Vector4fCount);
+    }
+
+    HRESULT SetPixelShaderConstantI(UINT StartRegister, const int* pConstantData, UINT Vector4iCount) {
+      return setConstants<Vector4i>(D3D9StateBlockOpType::PsConstantsI, StartRegister, pConstantData, Vector4iCount);
+    }
+
+    HRESULT SetPixelBoolBitfield(uint32_t idx, uint32_t mask, uint32_t bits) {
+      return setBools(D3D9StateBlockOpType::PsConstantsB, idx, mask, bits);
+    }
+
+    const StateMap& getState() const {
+      return m_state;
+    }
+
+    uint32_t getCallCount() const {
+      return m_calls;
+    }
+
+    uint32_t getConstantCallCount() const {
+      return m_constantCalls;
+    }
+
+  private:
+
+    StateMap m_state;
+    uint32_t m_calls = 0u;
+    uint32_t m_constantCalls = 0u;
+
+    template<typename T>
+    HRESULT set(D3D9StateBlockOpType type, uint32_t stage, uint32_t index, const T& value) {
+      m_calls += 1u;
+
+      setState(m_state, type, stage, index, value);
+      return D3D_OK;
+    }
+
+    template<typename T, typename S>
+    HRESULT setConstants(D3D9StateBlockOpType type, UINT StartRegister, const S* pConstantData, UINT Count) {
+      m_calls += 1u;
+      m_constantCalls += 1u;
+
+      for (uint32_t i = 0u; i < Count; i++)
+        setState(m_state, type, 0u, StartRegister + i, reinterpret_cast<const T*>(pConstantData)[i]);
+
+      return D3D_OK;
+    }
+
+    HRESULT setBools(D3D9StateBlockOpType type, uint32_t idx, uint32_t mask, uint32_t bits) {
+      m_calls += 1u;
+
+      for (uint32_t bit : bit::BitMask(mask))
+        setState(m_state, type, 0u, idx * 32u + bit, (bits >> bit) & 1u);
+
+      return D3D_OK;
+    }
+
+  };
+
+
+  void fail(const std::string& message) {
+    if (g_failures++ < 32u)
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+  }
+
+
+  void fillState(TestState& state, std::mt19937& rng) {
+    for (auto& rs : state.renderStates)
+      rs = rng();
+
+    for (auto& sampler : state.samplerStates) {
+      for (auto& value : sampler)
+        value = rng();
+    }
+
+    for (uint32_t i = 0u; i < state.vertexBuffers.size(); i++) {
+      state.vertexBuffers[i].offset = rng() % 4096u;
+      state.vertexBuffers[i].stride = 4u * (1u + rng() % 16u);
+    }
+
+    for (auto& stage : state.textureStages) {
+      for (auto& value : stage)
+        value = rng();
+    }
+
+    for (auto& freq : state.streamFreq)
+      freq = 1u + rng() % 4u;
+
+    for (auto& transform : state.transforms) {
+      for (uint32_t i = 0u; i < 4u; i++)
+        transform[i] = Vector4(float(rng() % 256u), float(rng() % 256u), float(rng() % 256u), 1.0f);
+    }
+
+    for (auto& plane : state.clipPlanes) {
+      for (auto& coeff : plane.coeff)
+        coeff = float(rng() % 256u);
+    }
+
+    state.viewport = { DWORD(rng() % 64u), DWORD(rng() % 64u), 1280u, 720u, 0.0f, 1.0f };
+    state.scissorRect = { LONG(rng() % 64u), LONG(rng() % 64u), 1280, 720 };
+
+    state.material.Power = float(rng() % 256u);
+    state.material.Diffuse = { 1.0f, float(rng() % 256u), 1.0f, 1.0f };
+
+    for (uint32_t i = 0u; i < caps::MaxFloatConstantsVS; i++)
+      state.vsConsts->fConsts[i] = Vector4(float(rng()), float(rng()), float(rng()), float(rng()));
+
+    for (uint32_t i = 0u; i < caps::MaxOtherConstants; i++)
+      state.vsConsts->iConsts[i] = Vector4i(int(rng()), int(rng()), int(rng()), int(rng()));
+
+    state.vsConsts->bConsts[0] = rng();
+
+    for (uint32_t i = 0u; i < caps::MaxSM3FloatConstantsPS; i++)
+      state.psConsts->fConsts[i] = Vector4(float(rng()), float(rng()), float(rng()), float(rng()));
+
+    for (uint32_t i = 0u; i < caps::MaxOtherConstants; i++)
+      state.psConsts->iConsts[i] = Vector4i(int(rng()), int(rng()), int(rng()), int(rng()));
+
+    state.psConsts->bConsts[0] = rng();
+
+    state.lights.resize(LightCount);
+
+    for (uint32_t i = 0u; i < LightCount; i++) {
+      D3DLIGHT9 light = { };
+      light.Type = D3DLIGHT_POINT;
+      light.Range = float(rng() % 256u);
+      state.lights[i] = light;
+    }
+
+    for (uint32_t i = 0u; i < caps::MaxEnabledLights; i++)
+      state.enabledLightIndices[i] = (rng() % 2u) ? i : std::numeric_limits<uint32_t>::max();
+  }
+
+
+  /**
+   * \brief Captures roughly what a D3DSBT_ALL state block captures
+   */
+  void captureAll(D3D9StateCaptures& captures) {
+    captures.flags.set(
+      D3D9CapturedStateFlag::VertexDecl,
+      D3D9CapturedStateFlag::Indices,
+      D3D9CapturedStateFlag::RenderStates,
+      D3D9CapturedStateFlag::SamplerStates,
+      D3D9CapturedStateFlag::VertexBuffers,
+      D3D9CapturedStateFlag::Textures,
+      D3D9CapturedStateFlag::VertexShader,
+      D3D9CapturedStateFlag::PixelShader,
+      D3D9CapturedStateFlag::Viewport,
+      D3D9CapturedStateFlag::ScissorRect,
+      D3D9CapturedStateFlag::ClipPlanes,
+      D3D9CapturedStateFlag::VsConstants,
+      D3D9CapturedStateFlag::PsConstants,
+      D3D9CapturedStateFlag::StreamFreq,
+      D3D9CapturedStateFlag::Transforms,
+      D3D9CapturedStateFlag::TextureStages,
+      D3D9CapturedStateFlag::Material,
+      D3D9CapturedStateFlag::Lights);
+
+    for (uint32_t i = D3DRS_ZENABLE; i <= D3DRS_BLENDOPALPHA; i++)
+      captures.renderStates.set(i, true);
+
+    captures.samplers.setAll();
+    captures.textures.setAll();
+
+    for (auto& sampler : captures.samplerStates) {
+      for (uint32_t i = D3DSAMP_ADDRESSU; i < SamplerStateCount; i++)
+        sampler.set(i, true);
+    }
+
+    captures.vertexBuffers.setAll();
+    captures.clipPlanes.setAll();
+    captures.streamFreq.setAll();
+    captures.textureStages.setAll();
+
+    for (auto& stage : captures.textureStageStates)
+      stage.setAll();
+
+    // View, projection and texture transforms, and the first world matrix
+    for (uint32_t i = 0u; i <= GetTransformIndex(D3DTS_WORLD); i++)
+      captures.transforms.set(i, true);
+
+    captures.vsConsts.fConsts.setN(caps::MaxFloatConstantsVS);
+    captures.vsConsts.iConsts.setN(caps::MaxOtherConstants);
+    captures.vsConsts.bConsts.setN(caps::MaxOtherConstants);
+
+    captures.psConsts.fConsts.setN(caps::MaxSM3FloatConstantsPS);
+    captures.psConsts.iConsts.setN(caps::MaxOtherConstants);
+    captures.psConsts.bConsts.setN(caps::MaxOtherConstants);
+
+    captures.lightEnabledChanges.setN(LightCount);
+  }
+
+
+  /**
+   * \brief Captures random sets of states
+   *
+   * Consecutive constant registers are captured in runs
+   * of random length, so that programs merge some of them.
+   */
+  void captureRandom(D3D9StateCaptures& captures, std::mt19937& rng) {
+    for (uint32_t i = 0u; i <= uint32_t(D3D9CapturedStateFlag::Lights); i++) {
+      if (rng() % 2u)
+        captures.flags.set(D3D9CapturedStateFlag(i));
+    }
+
+    auto setRandom = [&rng] (auto& bits, uint32_t count, uint32_t maxRun) {
+      for (uint32_t i = 0u; i < count; i++) {
+        uint32_t start = rng() % bits.bitCount();
+        uint32_t end = std::min<uint32_t>(start + 1u + rng() % maxRun, bits.bitCount());
+
+        for (uint32_t j = start; j < end; j++)
+          bits.set(j, true);
+      }
+    };
+
+    setRandom(captures.renderStates, 16u, 1u);
+    setRandom(captures.samplers, 4u, 1u);
+    setRandom(captures.textures, 4u, 1u);
+    setRandom(captures.vertexBuffers, 2u, 1u);
+    setRandom(captures.clipPlanes, 2u, 1u);
+    setRandom(captures.streamFreq, 2u, 1u);
+    setRandom(captures.transforms, 4u, 1u);
+    setRandom(captures.textureStages, 2u, 1u);
+
+    for (auto& sampler : captures.samplerStates)
+      setRandom(sampler, 4u, 1u);
+
+    for (auto& stage : captures.textureStageStates)
+      setRandom(stage, 4u, 1u);
+
+    setRandom(captures.vsConsts.fConsts, 16u, 8u);
+    setRandom(captures.vsConsts.iConsts, 4u, 4u);
+    setRandom(captures.vsConsts.bConsts, 4u, 4u);
+
+    setRandom(captures.psConsts.fConsts, 8u, 8u);
+    setRandom(captures.psConsts.iConsts, 4u, 4u);
+    setRandom(captures.psConsts.bConsts, 4u, 4u);
+
+    for (uint32_t i = 0u; i < LightCount; i++)
+      captures.lightEnabledChanges.set(i, rng() % 2u);
+  }
+
+
+  /**
+   * \brief Computes expected state after applying a state block
+   *
+   * Tests every captured bit individually, independent of
+   * how the program orders or merges operations.
+   */
+  StateMap expectState(const D3D9StateCaptures& captures, const TestState& src) {
+    StateMap state;
+
+    auto forEach = [] (const auto& bits, const auto& proc) {
+      for (uint32_t i = 0u; i < bits.bitCount(); i++) {
+        if (bits.get(i))
+          proc(i);
+      }
+    };
+
+    if (captures.flags.test(D3D9CapturedStateFlag::VertexDecl) && src.vertexDecl != nullptr)
+      setState(state, D3D9StateBlockOpType::VertexDecl, 0u, 0u, src.vertexDecl.ptr());
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Indices))
+      setState(state, D3D9StateBlockOpType::Indices, 0u, 0u, src.indices.ptr());
+
+    if (captures.flags.test(D3D9CapturedStateFlag::StreamFreq)) {
+      forEach(captures.streamFreq, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::StreamFreq, 0u, i, src.streamFreq[i]);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::RenderStates)) {
+      forEach(captures.renderStates, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::RenderState, 0u, i, src.renderStates[i]);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::SamplerStates)) {
+      forEach(captures.samplers, [&] (uint32_t s) {
+        forEach(captures.samplerStates[s], [&] (uint32_t i) {
+          setState(state, D3D9StateBlockOpType::SamplerState, s, i, src.samplerStates[s][i]);
+        });
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::VertexBuffers)) {
+      forEach(captures.vertexBuffers, [&] (uint32_t i) {
+        const auto& vbo = src.vertexBuffers[i];
+        setState(state, D3D9StateBlockOpType::VertexBuffer, 0u, i, std::array<uint64_t, 3>({
+          uint64_t(uintptr_t(vbo.vertexBuffer.ptr())), vbo.offset, vbo.stride }));
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Material))
+      setState(state, D3D9StateBlockOpType::Material, 0u, 0u, src.material);
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Textures)) {
+      forEach(captures.textures, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::Texture, 0u, i, src.textures[i]);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::VertexShader))
+      setState(state, D3D9StateBlockOpType::VertexShader, 0u, 0u, src.vertexShader.ptr());
+
+    if (captures.flags.test(D3D9CapturedStateFlag::PixelShader))
+      setState(state, D3D9StateBlockOpType::PixelShader, 0u, 0u, src.pixelShader.ptr());
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Transforms)) {
+      forEach(captures.transforms, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::Transform, 0u, i, src.transforms[i]);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::TextureStages)) {
+      forEach(captures.textureStages, [&] (uint32_t s) {
+        forEach(captures.textureStageStates[s], [&] (uint32_t i) {
+          setState(state, D3D9StateBlockOpType::TextureStageState, s, i, src.textureStages[s][i]);
+        });
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Viewport))
+      setState(state, D3D9StateBlockOpType::Viewport, 0u, 0u, src.viewport);
+
+    if (captures.flags.test(D3D9CapturedStateFlag::ScissorRect))
+      setState(state, D3D9StateBlockOpType::ScissorRect, 0u, 0u, src.scissorRect);
+
+    if (captures.flags.test(D3D9CapturedStateFlag::ClipPlanes)) {
+      forEach(captures.clipPlanes, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::ClipPlane, 0u, i, src.clipPlanes[i]);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::VsConstants)) {
+      forEach(captures.vsConsts.fConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::VsConstantsF, 0u, i, src.vsConsts->fConsts[i]);
+      });
+
+      forEach(captures.vsConsts.iConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::VsConstantsI, 0u, i, src.vsConsts->iConsts[i]);
+      });
+
+      forEach(captures.vsConsts.bConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::VsConstantsB, 0u, i, (src.vsConsts->bConsts[i / 32u] >> (i % 32u)) & 1u);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::PsConstants)) {
+      forEach(captures.psConsts.fConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::PsConstantsF, 0u, i, src.psConsts->fConsts[i]);
+      });
+
+      forEach(captures.psConsts.iConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::PsConstantsI, 0u, i, src.psConsts->iConsts[i]);
+      });
+
+      forEach(captures.psConsts.bConsts, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::PsConstantsB, 0u, i, (src.psConsts->bConsts[i / 32u] >> (i % 32u)) & 1u);
+      });
+    }
+
+    if (captures.flags.test(D3D9CapturedStateFlag::Lights)) {
+      for (uint32_t i = 0u; i < src.lights.size(); i++) {
+        if (src.lights[i])
+          setState(state, D3D9StateBlockOpType::Lights, 0u, i, *src.lights[i]);
+      }
+
+      forEach(captures.lightEnabledChanges, [&] (uint32_t i) {
+        setState(state, D3D9StateBlockOpType::LightEnable, 0u, i, BOOL(src.IsLightEnabled(i)));
+      });
+    }
+
+    return state;
+  }
+
+
+  /**
+   * \brief Applies a program and compares the result to the model
+   *
+   * Applies the program with both source states in turn, since
+   * values must be read from the state block on every apply.
+   */
+  void checkProgram(
+    const char*                   name,
+    const D3D9StateBlockProgram&  program,
+    const D3D9StateCaptures&      captures,
+    const TestState* const        (&states)[2]) {
+    for (uint32_t i = 0u; i < 2u; i++) {
+      RecordingDevice device;
+      program.Apply(&device, states[i]);
+
+      StateMap expected = expectState(captures, *states[i]);
+      const StateMap& actual = device.getState();
+
+      if (actual != expected) {
+        size_t missing = 0u;
+        size_t different = 0u;
+
+        for (const auto& entry : expected) {
+          auto iter = actual.find(entry.first);
+
+          if (iter == actual.end())
+            missing += 1u;
+          else if (iter->second != entry.second)
+            different += 1u;
+        }
+
+        fail(str::format(name, ": ", missing, " states not applied, ", different, " with wrong values, ",
+          actual.size() + missing - expected.size(), " applied without being captured"));
+        return;
+      }
+
+      // Merging constant ranges must never add setter calls
+      if (device.getCallCount() > expected.size()) {
+        fail(str::format(name, ": ", device.getCallCount(), " setter calls for ",
+          expected.size(), " captured states"));
+      }
+    }
+  }
+
+}
+
+
+int main() {
+  std::mt19937 rng(1u);
+
+  std::unique_ptr<TestState> state0 = std::make_unique<TestState>();
+  std::unique_ptr<TestState> state1 = std::make_unique<TestState>();
+
+  fillState(*state0, rng);
+  fillState(*state1, rng);
+
+  const TestState* const states[2] = { state0.get(), state1.get() };
+
+  // Nothing captured, nothing applied
+  D3D9StateCaptures none;
+  D3D9StateBlockProgram program;
+  program.Compile(none);
+
+  if (program.GetOpCount())
+    fail(str::format("Empty state block compiled to ", program.GetOpCount(), " ops"));
+
+  checkProgram("Empty", program, none, states);
+
+  // All states, float and int constants must be merged
+  // into a single range per type and shader stage
+  D3D9StateCaptures all;
+  captureAll(all);
+
+  program.Compile(all);
+  checkProgram("D3DSBT_ALL", program, all, states);
+
+  RecordingDevice allDevice;
+  program.Apply(&allDevice, states[0]);
+
+  if (allDevice.getConstantCallCount() != 4u)
+    fail(str::format("D3DSBT_ALL: ", allDevice.getConstantCallCount(), " constant setter calls, expected 4"));
+
+  // Random captures, compiled into the same program object to check
+  // that recompiling replaces operations the way EndStateBlock does
+  for (uint32_t i = 0u; i < RandomTestCount; i++) {
+    D3D9StateCaptures captures;
+    captureRandom(captures, rng);
+
+    program.Compile(captures);
+    checkProgram(str::format("Random ", i).c_str(), program, captures, states);
+  }
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,8 @@
+#include "../util/log/log.h"
+
+namespace dxvk {
+  // The DXVK libraries expect each binary to
+  // provide the logger instance, share one
+  // between all tools.
+  Logger Logger::s_instance("dxvk-tools.log");
+}
@@ -0,0 +1,248 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../d3d9/d3d9_up_batch.h"
+
+#include "../util/util_string.h"
+
+using namespace dxvk;
+
+namespace {
+
+  /** UP buffer size used by the tests */
+  constexpr VkDeviceSize BufferSize = 1ull << 20;
+
+  uint32_t g_failures = 0u;
+
+
+  void fail(const std::string& message) {
+    if (g_failures++ < 32u)
+      std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+  }
+
+
+  void check(bool condition, const char* test, const char* message) {
+    if (!condition)
+      fail(str::format(test, ": ", message));
+  }
+
+
+  /**
+   * \brief UP draw command in a CS chunk
+   *
+   * Records a single draw command the same way the device does
+   * for the first draw of a batch, and collects the draws that
+   * the command receives when the chunk gets executed.
+   */
+  class TestDraw {
+
+  public:
+
+    TestDraw(uint32_t vertexCount) {
+      m_chunk = new DxvkCsChunk();
+      m_chunk->init(DxvkCsChunkFlag::SingleUse);
+
+      auto command = [this] (DxvkContext*, const VkDrawIndirectCommand* draws, size_t count) {
+        m_executed.assign(draws, draws + count);
+      };
+
+      m_block = m_chunk->pushCmd<VkDrawIndirectCommand>(command, 1u);
+
+      auto draw = reinterpret_cast<VkDrawIndirectCommand*>(m_block->first());
+      draw->vertexCount = vertexCount;
+      draw->instanceCount = 1u;
+      draw->firstVertex = 0u;
+      draw->firstInstance = 0u;
+    }
+
+    DxvkCsChunk* chunk() {
+      return m_chunk.ptr();
+    }
+
+    DxvkCsDataBlock* block() {
+      return m_block;
+    }
+
+    const VkDrawIndirectCommand& draw(uint32_t idx) {
+      return *reinterpret_cast<const VkDrawIndirectCommand*>(m_block->at(idx));
+    }
+
+    const std::vector<VkDrawIndirectCommand>& execute() {
+      m_chunk->executeAll(nullptr);
+      return m_executed;
+    }
+
+  private:
+
+    Rc<DxvkCsChunk>                     m_chunk;
+    DxvkCsDataBlock*                    m_block = nullptr;
+    std::vector<VkDrawIndirectCommand>  m_executed;
+
+  };
+
+
+  void testInactive() {
+    TestDraw draw(3u);
+
+    D3D9UPDrawBatch batch;
+    VkDeviceSize dataOffset = 0u;
+
+    check(!batch.active(), "Inactive", "New batch is active");
+    check(!batch.append(draw.chunk(), D3DPT_TRIANGLELIST, 3u, 16u, 64u, BufferSize, dataOffset),
+      "Inactive", "Draw appended without a pending batch");
+
+    batch.begin(draw.block(), D3DPT_TRIANGLELIST, 16u, 0u);
+    check(batch.active(), "Inactive", "Batch not active after begin");
+
+    batch.reset();
+    check(!batch.active(), "Inactive", "Batch active after reset");
+    check(!batch.append(draw.chunk(), D3DPT_TRIANGLELIST, 3u, 16u, 64u, BufferSize, dataOffset),
+      "Inactive", "Draw appended after reset");
+
+    check(draw.block()->count() == 1u, "Inactive", "Rejected draws were added to the command");
+  }
+
+
+  void testMismatch() {
+    TestDraw draw(3u);
+
+    D3D9UPDrawBatch batch;
+    batch.begin(draw.block(), D3DPT_TRIANGLELIST, 16u, 0u);
+
+    VkDeviceSize dataOffset = 0u;
+
+    check(!batch.append(draw.chunk(), D3DPT_TRIANGLESTRIP, 3u, 16u, 64u, BufferSize, dataOffset),
+      "Mismatch", "Draw with different primitive type appended");
+    check(!batch.append(draw.chunk(), D3DPT_TRIANGLELIST, 3u, 20u, 64u, BufferSize, dataOffset),
+      "Mismatch", "Draw with different stride appended");
+    check(draw.block()->count() == 1u,
+      "Mismatch", "Rejected draws were added to the command");
+  }
+
+
+  void testAppend() {
+    // First draw at offset 128, stride 24. The allocation offset after
+    // the first draw is rounded to 192, which is not a multiple of the
+    // stride relative to the batch, so the data must move up to 200.
+    TestDraw draw(2u);
+
+    D3D9UPDrawBatch batch;
+    batch.begin(draw.block(), D3DPT_TRIANGLELIST, 24u, 128u);
+
+    VkDeviceSize dataOffset = 0u;
+
+    check(batch.append(draw.chunk(), D3DPT_TRIANGLELIST, 6u, 24u, 192u, BufferSize, dataOffset),
+      "Append", "Draw not appended");
+    check(dataOffset == 200u, "Append", "Unaligned data offset");
+
+    // Already aligned offset must be used as-is
+    check(batch.append(draw.chunk(), D3DPT_TRIANGLELIST, 3u, 24u, 416u, BufferSize, dataOffset),
+      "Append", "Draw not appended");
+    check(dataOffset == 416u, "Append", "Aligned data offset was moved");
+
+    check(draw.block()->count() == 3u, "Append", "Wrong number of draws in command");
+
+    if (draw.block()->count() != 3u)
+      return;
+
+    const auto& first = draw.draw(0u);
+    const auto& second = draw.draw(1u);
+    const auto& third = draw.draw(2u);
+
+    check(first.vertexCount == 2u && first.firstVertex == 0u,
+      "Append", "First draw was modified");
+    check(second.vertexCount == 6u && second.firstVertex == 3u
+       && second.instanceCount == 1u && second.firstInstance == 0u,
+      "Append", "Wrong parameters for second draw");
+    check(third.vertexCount == 3u && third.firstVertex == 12u
+       && third.instanceCount == 1u && third.firstInstance == 0u,
+      "Append", "Wrong parameters for third draw");
+
+    // The command must receive all draws, and the bound range
+    // must cover the vertex data of the last draw.
+    const auto& executed = draw.execute();
+
+    check(executed.size() == 3u, "Append", "Wrong number of executed draws");
+    check(D3D9UPDrawBatch::getBufferLength(48u, 24u, executed.data(), executed.size()) == 15u * 24u,
+      "Append", "Buffer range does not cover all draws");
+  }
+
+
+  void testBufferSize() {
+    TestDraw draw(4u);
+
+    D3D9UPDrawBatch batch;
+    batch.begin(draw.block(), D3DPT_LINELIST, 32u, 0u);
+
+    VkDeviceSize dataOffset = 0u;
+
+    check(batch.append(draw.chunk(), D3DPT_LINELIST, 4u, 32u, 128u, 256u, dataOffset),
+      "Buffer size", "Draw that fits the buffer not appended");
+    check(!batch.append(draw.chunk(), D3DPT_LINELIST, 4u, 32u, 136u, 256u, dataOffset),
+      "Buffer size", "Draw that exceeds the buffer appended");
+    check(draw.block()->count() == 2u, "Buffer size", "Wrong number of draws in command");
+  }
+
+
+  void testChunkFull() {
+    TestDraw draw(1u);
+
+    D3D9UPDrawBatch batch;
+    batch.begin(draw.block(), D3DPT_TRIANGLELIST, 16u, 0u);
+
+    VkDeviceSize offset = 16u;
+    VkDeviceSize dataOffset = 0u;
+
+    uint32_t appended = 0u;
+
+    while (appended < DxvkCsChunkSize && batch.append(draw.chunk(),
+        D3DPT_TRIANGLELIST, 1u, 16u, offset, BufferSize, dataOffset)) {
+      offset = dataOffset + 16u;
+      appended += 1u;
+    }
+
+    check(appended > 0u && appended < DxvkCsChunkSize / sizeof(VkDrawIndirectCommand),
+      "Chunk full", "Appending did not stop when the chunk was full");
+    check(draw.block()->count() == appended + 1u,
+      "Chunk full", "Wrong number of draws in command");
+    check(draw.execute().size() == appended + 1u,
+      "Chunk full", "Wrong number of executed draws");
+  }
+
+
+  void testBufferLength() {
+    VkDrawIndirectCommand draws[3] = { };
+    draws[0] = { 4u, 1u, 0u, 0u };
+    draws[1] = { 2u, 1u, 8u, 0u };
+    draws[2] = { 1u, 1u, 5u, 0u };
+
+    // Single draw keeps the length of the first draw, which
+    // may include padding for a larger vertex declaration.
+    check(D3D9UPDrawBatch::getBufferLength(72u, 16u, draws, 1u) == 72u,
+      "Buffer length", "Length of single draw changed");
+
+    // The largest end offset counts, not the last draw
+    check(D3D9UPDrawBatch::getBufferLength(64u, 16u, draws, 3u) == 160u,
+      "Buffer length", "Range does not end at the last vertex of the batch");
+  }
+
+}
+
+
+int main() {
+  testInactive();
+  testMismatch();
+  testAppend();
+  testBufferSize();
+  testChunkFull();
+  testBufferLength();
+
+  if (g_failures) {
+    std::fprintf(stderr, "%u checks failed\n", g_failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
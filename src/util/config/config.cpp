@@ -2,13 +2,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <regex>
+#include <unordered_map>
 #include <utility>
 
 #include "config.h"
+#include "config_matcher.h"
 
 #include "../log/log.h"
 
+#include "../thread.h"
+
 #include "../util_env.h"
 
 #include "../sha1/sha1_util.h"
@@ -1340,22 +1343,25 @@ namespace dxvk {
 
 
   const Config* findProfile(const ProfileList& profiles, const std::string& appName) {
-    auto appConfig = std::find_if(profiles.begin(), profiles.end(),
-      [&appName] (const std::pair<const char*, Config>& pair) {
-        // With certain locales, regex parsing will simply crash. Using regex::imbue
-        // does not resolve this; only the global locale seems to matter here. Catch
-        // bad_alloc errors to work around this for now.
-        try {
-          std::regex expr(pair.first, std::regex::extended | std::regex::icase);
-          return std::regex_search(appName, expr);
-        } catch (const std::bad_alloc& e) {
-          Logger::err(str::format("Failed to parse regular expression: ", pair.first));
-          return false;
-        }
-      });
+    // Matchers keep compiled patterns around, so
+    // create only one matcher per profile list.
+    static dxvk::mutex s_mutex;
+    static std::unordered_map<const ProfileList*, AppProfileMatcher> s_matchers;
 
-    return appConfig != profiles.end()
-      ? &appConfig->second
+    std::lock_guard lock(s_mutex);
+
+    auto entry = s_matchers.try_emplace(&profiles);
+    auto& matcher = entry.first->second;
+
+    if (entry.second) {
+      for (const auto& pair : profiles)
+        matcher.add(pair.first);
+    }
+
+    int32_t index = matcher.find(appName);
+
+    return index >= 0
+      ? &profiles[index].second
       : nullptr;
   }
 
@@ -1658,6 +1664,19 @@ namespace dxvk {
   }
 
 
+  std::vector<const char*> Config::getAppProfilePatterns() {
+    std::vector<const char*> patterns;
+
+    for (const auto& pair : g_profiles)
+      patterns.push_back(pair.first);
+
+    for (const auto& pair : g_deckProfiles)
+      patterns.push_back(pair.first);
+
+    return patterns;
+  }
+
+
   Config Config::getUserConfig() {
     Config config;
 
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace dxvk {
 
@@ -103,6 +104,15 @@ namespace dxvk {
      */
     static Config getUserConfig();
 
+    /**
+     * \brief Retrieves built-in app profile patterns
+     *
+     * Includes profiles that are only used on Steam Deck. Only
+     * useful to validate app profile matching in developer tools.
+     * \returns Regular expressions of all built-in app profiles
+     */
+    static std::vector<const char*> getAppProfilePatterns();
+
     static std::string toLower(std::string str);
 
   private:
@@ -0,0 +1,640 @@
+#include <bitset>
+#include <cstring>
+#include <regex>
+
+#include "config_matcher.h"
+
+#include "../log/log.h"
+
+#include "../util_string.h"
+
+namespace dxvk {
+
+  static char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+  }
+
+
+  static bool isEscapable(char c) {
+    return c && std::strchr(".[]\\()|*+?{}^$", c);
+  }
+
+
+  /**
+   * \brief Compiled app profile pattern
+   *
+   * Parses the regular expression into a small syntax tree and
+   * compiles that into a non-deterministic state machine, which
+   * is simulated for all candidate start positions in lockstep.
+   * Characters are stored in lower case, and the input string
+   * must be converted to lower case as well.
+   */
+  class AppProfileProgram {
+
+  public:
+
+    /**
+     * \brief Compiles pattern
+     *
+     * \param [in] pattern Regular expression
+     * \returns \c false if the pattern uses unsupported syntax
+     */
+    bool compile(const char* pattern) {
+      Parser parser = { pattern };
+      Node root = parseAlt(parser);
+
+      if (!parser.ok || *parser.p)
+        return false;
+
+      emit(root);
+      m_ops.push_back({ OpType::Match });
+      return true;
+    }
+
+    /**
+     * \brief Searches string for a match
+     *
+     * \param [in] str Lower-case string
+     * \returns \c true if any substring matches
+     */
+    bool match(const std::string& str) const {
+      std::vector<uint32_t> curr;
+      std::vector<uint32_t> next;
+      std::vector<uint32_t> marks(m_ops.size(), ~0u);
+
+      uint32_t mark = 0u;
+
+      for (size_t pos = 0; pos <= str.size(); pos++) {
+        // Start a new thread at every position since
+        // the match is not anchored to the beginning
+        if (addThread(curr, marks, mark, 0u, pos, str.size()))
+          return true;
+
+        if (pos == str.size())
+          break;
+
+        next.clear();
+        mark += 1u;
+
+        uint8_t c = uint8_t(str[pos]);
+
+        for (uint32_t pc : curr) {
+          if (m_ops[pc].chars.test(c)) {
+            if (addThread(next, marks, mark, pc + 1u, pos + 1u, str.size()))
+              return true;
+          }
+        }
+
+        std::swap(curr, next);
+      }
+
+      return false;
+    }
+
+  private:
+
+    enum class OpType : uint8_t {
+      Char,   ///< Consumes one character from the set
+      Split,  ///< Continues at both target instructions
+      Jump,   ///< Continues at the target instruction
+      Begin,  ///< Asserts start of string
+      End,    ///< Asserts end of string
+      Match,  ///< Pattern matched
+    };
+
+    struct Op {
+      OpType            type    = OpType::Match;
+      uint32_t          x       = 0u;
+      uint32_t          y       = 0u;
+      std::bitset<256>  chars;
+    };
+
+    enum class NodeType : uint8_t {
+      Chars,
+      Begin,
+      End,
+      Concat,
+      Alt,
+      Quest,
+      Star,
+      Plus,
+    };
+
+    struct Node {
+      NodeType          type = NodeType::Concat;
+      std::bitset<256>  chars;
+      std::vector<Node> children;
+    };
+
+    struct Parser {
+      const char* p;
+      bool        ok = true;
+    };
+
+    std::vector<Op> m_ops;
+
+    bool addThread(
+            std::vector<uint32_t>& list,
+            std::vector<uint32_t>& marks,
+            uint32_t        mark,
+            uint32_t        pc,
+            size_t          pos,
+            size_t          len) const {
+      if (marks[pc] == mark)
+        return false;
+
+      marks[pc] = mark;
+
+      const Op& op = m_ops[pc];
+
+      switch (op.type) {
+        case OpType::Char:
+          list.push_back(pc);
+          return false;
+
+        case OpType::Split:
+          return addThread(list, marks, mark, op.x, pos, len)
+              || addThread(list, marks, mark, op.y, pos, len);
+
+        case OpType::Jump:
+          return addThread(list, marks, mark, op.x, pos, len);
+
+        case OpType::Begin:
+          return pos == 0u && addThread(list, marks, mark, pc + 1u, pos, len);
+
+        case OpType::End:
+          return pos == len && addThread(list, marks, mark, pc + 1u, pos, len);
+
+        case OpType::Match:
+          return true;
+      }
+
+      return false;
+    }
+
+    void emit(const Node& node) {
+      switch (node.type) {
+        case NodeType::Chars: {
+          Op op;
+          op.type = OpType::Char;
+          op.chars = node.chars;
+          m_ops.push_back(op);
+        } break;
+
+        case NodeType::Begin:
+          m_ops.push_back({ OpType::Begin });
+          break;
+
+        case NodeType::End:
+          m_ops.push_back({ OpType::End });
+          break;
+
+        case NodeType::Concat: {
+          for (const auto& child : node.children)
+            emit(child);
+        } break;
+
+        case NodeType::Alt: {
+          std::vector<uint32_t> jumps;
+
+          for (size_t i = 0; i + 1u < node.children.size(); i++) {
+            uint32_t split = uint32_t(m_ops.size());
+            m_ops.push_back({ OpType::Split, split + 1u });
+            emit(node.children[i]);
+
+            jumps.push_back(uint32_t(m_ops.size()));
+            m_ops.push_back({ OpType::Jump });
+
+            m_ops[split].y = uint32_t(m_ops.size());
+          }
+
+          emit(node.children.back());
+
+          for (uint32_t jump : jumps)
+            m_ops[jump].x = uint32_t(m_ops.size());
+        } break;
+
+        case NodeType::Quest: {
+          uint32_t split = uint32_t(m_ops.size());
+          m_ops.push_back({ OpType::Split, split + 1u });
+          emit(node.children[0]);
+
+          m_ops[split].y = uint32_t(m_ops.size());
+        } break;
+
+        case NodeType::Star: {
+          uint32_t split = uint32_t(m_ops.size());
+          m_ops.push_back({ OpType::Split, split + 1u });
+          emit(node.children[0]);
+          m_ops.push_back({ OpType::Jump, split });
+
+          m_ops[split].y = uint32_t(m_ops.size());
+        } break;
+
+        case NodeType::Plus: {
+          uint32_t start = uint32_t(m_ops.size());
+          emit(node.children[0]);
+
+          uint32_t split = uint32_t(m_ops.size());
+          m_ops.push_back({ OpType::Split, start, split + 1u });
+        } break;
+      }
+    }
+
+    static Node parseAlt(Parser& parser) {
+      Node node;
+      node.type = NodeType::Alt;
+      node.children.push_back(parseConcat(parser));
+
+      while (parser.ok && *parser.p == '|') {
+        parser.p += 1;
+        node.children.push_back(parseConcat(parser));
+      }
+
+      if (node.children.size() == 1u)
+        return std::move(node.children[0]);
+
+      return node;
+    }
+
+    static Node parseConcat(Parser& parser) {
+      Node node;
+      node.type = NodeType::Concat;
+
+      while (parser.ok && *parser.p && *parser.p != '|' && *parser.p != ')') {
+        Node atom = parseAtom(parser);
+
+        while (parser.ok) {
+          NodeType type;
+
+          if (*parser.p == '?')
+            type = NodeType::Quest;
+          else if (*parser.p == '*')
+            type = NodeType::Star;
+          else if (*parser.p == '+')
+            type = NodeType::Plus;
+          else
+            break;
+
+          parser.p += 1;
+
+          Node repeat;
+          repeat.type = type;
+          repeat.children.push_back(std::move(atom));
+          atom = std::move(repeat);
+        }
+
+        // Bounded repetition is not supported
+        if (parser.ok && *parser.p == '{')
+          parser.ok = false;
+
+        node.children.push_back(std::move(atom));
+      }
+
+      return node;
+    }
+
+    static Node parseAtom(Parser& parser) {
+      Node node;
+      node.type = NodeType::Chars;
+
+      char c = *(parser.p++);
+
+      switch (c) {
+        case '(': {
+          node = parseAlt(parser);
+
+          if (parser.ok && *parser.p == ')')
+            parser.p += 1;
+          else
+            parser.ok = false;
+        } break;
+
+        case '[': {
+          parser.ok = parseBracket(parser, node);
+        } break;
+
+        case '.': {
+          // POSIX regular expressions match anything but null here
+          node.chars.set();
+          node.chars.reset(0);
+        } break;
+
+        case '^': {
+          node.type = NodeType::Begin;
+        } break;
+
+        case '$': {
+          node.type = NodeType::End;
+        } break;
+
+        case '\\': {
+          c = *parser.p;
+
+          if (isEscapable(c)) {
+            node.chars.set(uint8_t(toLowerAscii(c)));
+            parser.p += 1;
+          } else {
+            parser.ok = false;
+          }
+        } break;
+
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+          parser.ok = false;
+          break;
+
+        default:
+          node.chars.set(uint8_t(toLowerAscii(c)));
+      }
+
+      return node;
+    }
+
+    static bool parseBracket(Parser& parser, Node& node) {
+      bool negate = *parser.p == '^';
+
+      if (negate)
+        parser.p += 1;
+
+      bool first = true;
+
+      while (*parser.p != ']' || first) {
+        char lo = parser.p[0];
+
+        // Character classes, collating elements and
+        // escapes inside brackets are not supported
+        if (!lo || lo == '\\' || (lo == '[' && parser.p[1] && std::strchr(":.=", parser.p[1])))
+          return false;
+
+        char hi = lo;
+        parser.p += 1;
+
+        if (parser.p[0] == '-' && parser.p[1] && parser.p[1] != ']') {
+          hi = parser.p[1];
+          parser.p += 2;
+
+          if (hi == '\\' || hi == '[' || uint8_t(hi) < uint8_t(lo))
+            return false;
+        }
+
+        for (uint32_t i = uint8_t(lo); i <= uint8_t(hi); i++)
+          node.chars.set(uint8_t(toLowerAscii(char(i))));
+
+        first = false;
+      }
+
+      parser.p += 1;
+
+      if (negate) {
+        node.chars.flip();
+        node.chars.reset(0);
+      }
+
+      return true;
+    }
+
+  };
+
+
+  static bool containsLiteral(
+    const std::string&  str,
+    const char*         begin,
+    const char*         end) {
+    // The literal is stored as it appears in the pattern, so
+    // resolve escapes on the fly rather than copying it.
+    char first = toLowerAscii((*begin == '\\') ? begin[1] : begin[0]);
+
+    for (size_t i = str.find(first); i != std::string::npos; i = str.find(first, i + 1u)) {
+      const char* p = begin;
+      size_t j = i;
+
+      while (p < end && j < str.size()) {
+        char c = (*p == '\\') ? p[1] : p[0];
+
+        if (toLowerAscii(c) != str[j])
+          break;
+
+        p += (*p == '\\') ? 2u : 1u;
+        j += 1u;
+      }
+
+      if (p == end)
+        return true;
+    }
+
+    return false;
+  }
+
+
+  static const char* findAlternatives(const char* p) {
+    // Accept groups consisting only of plain, non-empty alternatives,
+    // such as (a|b|c), and only if the group itself is not optional.
+    // Returns a pointer to the closing parenthesis on success.
+    bool empty = true;
+
+    while (*p && *p != ')') {
+      char c = *(p++);
+
+      if (c == '\\') {
+        if (!isEscapable(*p))
+          return nullptr;
+
+        p += 1;
+      } else if (c == '|') {
+        if (empty)
+          return nullptr;
+
+        empty = true;
+        continue;
+      } else if (std::strchr(".[(^$?*+{", c)) {
+        return nullptr;
+      }
+
+      empty = false;
+    }
+
+    if (empty || *p != ')' || (p[1] && std::strchr("?*{", p[1])))
+      return nullptr;
+
+    return p;
+  }
+
+
+  /**
+   * \brief Compiled pattern
+   *
+   * Uses the state machine if the pattern
+   * could be compiled, \c std::regex otherwise.
+   */
+  struct AppProfilePattern::Compiled {
+    bool                        isProgram = false;
+    AppProfileProgram           program;
+    std::unique_ptr<std::regex> regex;
+  };
+
+
+  AppProfilePattern::AppProfilePattern(const char* pattern)
+  : m_pattern(pattern) {
+    // Find the longest run of plain characters that every match must
+    // contain. Groups, brackets and optional characters end the current
+    // run, and top-level alternation means that there is no such run.
+    const char* runBegin = nullptr;
+    uint32_t runLength = 0u;
+    uint32_t depth = 0u;
+
+    for (const char* p = pattern; *p; ) {
+      const char* charBegin = p;
+      char c = *(p++);
+
+      if (c == '\\') {
+        c = *p;
+
+        if (!isEscapable(c)) {
+          m_literal = Range();
+          m_alternatives = Range();
+          return;
+        }
+
+        p += 1;
+      } else if (c == '[') {
+        p += (*p == '^') ? 1 : 0;
+        p += (*p == ']') ? 1 : 0;
+
+        while (*p && *p != ']')
+          p += 1;
+
+        p += *p ? 1 : 0;
+        runLength = 0u;
+        continue;
+      } else if (c == '(' || c == ')') {
+        // A top-level group of plain alternatives is usually a list
+        // of executable names, which is a better filter than a common
+        // suffix like .exe, so keep those as well.
+        if (c == '(' && !depth && !m_alternatives.begin) {
+          const char* groupEnd = findAlternatives(p);
+
+          if (groupEnd)
+            m_alternatives = { p, groupEnd, 0u };
+        }
+
+        depth += (c == '(') ? 1u : -1u;
+        runLength = 0u;
+        continue;
+      } else if (c == '|' && !depth) {
+        m_literal = Range();
+        m_alternatives = Range();
+        return;
+      } else if (std::strchr(".^$|?*+{", c)) {
+        runLength = 0u;
+        continue;
+      }
+
+      if (depth)
+        continue;
+
+      // A quantifier may make the character optional
+      if (*p == '?' || *p == '*' || *p == '{') {
+        runLength = 0u;
+        continue;
+      }
+
+      if (!runLength)
+        runBegin = charBegin;
+
+      runLength += 1u;
+
+      if (runLength > m_literal.length)
+        m_literal = { runBegin, p, runLength };
+
+      // The character may repeat, so start a new run
+      if (*p == '+') {
+        runBegin = charBegin;
+        runLength = 1u;
+      }
+    }
+  }
+
+
+  AppProfilePattern::AppProfilePattern(AppProfilePattern&& other) = default;
+
+
+  AppProfilePattern::~AppProfilePattern() = default;
+
+
+  bool AppProfilePattern::match(
+    const std::string&  str,
+    const std::string&  original) const {
+    if (m_literal.length && !containsLiteral(str, m_literal.begin, m_literal.end))
+      return false;
+
+    if (m_alternatives.begin) {
+      bool found = false;
+
+      for (const char* a = m_alternatives.begin; a < m_alternatives.end && !found; ) {
+        const char* b = a;
+
+        while (b < m_alternatives.end && *b != '|')
+          b += (*b == '\\') ? 2u : 1u;
+
+        found = containsLiteral(str, a, b);
+        a = b + 1u;
+      }
+
+      if (!found)
+        return false;
+    }
+
+    const Compiled& compiled = getCompiled();
+
+    if (compiled.isProgram)
+      return compiled.program.match(str);
+
+    return compiled.regex && std::regex_search(original, *compiled.regex);
+  }
+
+
+  const AppProfilePattern::Compiled& AppProfilePattern::getCompiled() const {
+    if (m_compiled)
+      return *m_compiled;
+
+    m_compiled = std::make_unique<Compiled>();
+    m_compiled->isProgram = m_compiled->program.compile(m_pattern);
+
+    if (!m_compiled->isProgram) {
+      // With certain locales, regex parsing will simply crash. Using regex::imbue
+      // does not resolve this; only the global locale seems to matter here. Catch
+      // bad_alloc errors to work around this for now.
+      try {
+        m_compiled->regex = std::make_unique<std::regex>(m_pattern, std::regex::extended | std::regex::icase);
+      } catch (const std::bad_alloc& e) {
+        Logger::err(str::format("Failed to parse regular expression: ", m_pattern));
+      }
+    }
+
+    return *m_compiled;
+  }
+
+
+  void AppProfileMatcher::add(const char* pattern) {
+    m_patterns.emplace_back(pattern);
+  }
+
+
+  int32_t AppProfileMatcher::find(const std::string& appName) const {
+    std::string name = appName;
+
+    for (auto& c : name)
+      c = toLowerAscii(c);
+
+    for (size_t i = 0; i < m_patterns.size(); i++) {
+      if (m_patterns[i].match(name, appName))
+        return int32_t(i);
+    }
+
+    return -1;
+  }
+
+}
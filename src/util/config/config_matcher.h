@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief App profile pattern
+   *
+   * Case-insensitive POSIX extended regular expression, as used to
+   * match executable paths against app profiles. Matching is equivalent
+   * to \c std::regex_search with the \c extended and \c icase flags.
+   *
+   * Any match must contain a literal substring that is extracted up
+   * front, as well as one alternative of the first top-level group of
+   * plain alternatives, so that most patterns can be rejected with a
+   * plain string search. Only patterns passing this test are compiled
+   * into a small state machine, or a \c std::regex if it uses
+   * unsupported syntax. The compiled pattern is kept for subsequent
+   * matches, which means that matching is not thread-safe. Literals
+   * are not copied, so the pattern string must outlive this object.
+   */
+  class AppProfilePattern {
+
+  public:
+
+    AppProfilePattern(const char* pattern);
+
+    AppProfilePattern(AppProfilePattern&& other);
+
+    ~AppProfilePattern();
+
+    /**
+     * \brief Matches pattern against a string
+     *
+     * \param [in] str String to search, converted to lower case
+     * \param [in] original String in its original case
+     * \returns \c true if any substring matches the pattern
+     */
+    bool match(
+      const std::string&  str,
+      const std::string&  original) const;
+
+  private:
+
+    /// Part of the pattern string, with escapes
+    struct Range {
+      const char* begin   = nullptr;
+      const char* end     = nullptr;
+      uint32_t    length  = 0u;
+    };
+
+    struct Compiled;
+
+    const char*   m_pattern;
+    Range         m_literal;
+    Range         m_alternatives;
+
+    mutable std::unique_ptr<Compiled> m_compiled;
+
+    const Compiled& getCompiled() const;
+
+  };
+
+
+  /**
+   * \brief App profile matcher
+   *
+   * Finds the first pattern of a
+   * profile list matching a given
+   * executable path. Not thread-safe.
+   */
+  class AppProfileMatcher {
+
+  public:
+
+    /**
+     * \brief Adds a pattern
+     *
+     * Patterns are tested in the order they are added.
+     * \param [in] pattern Regular expression
+     */
+    void add(const char* pattern);
+
+    /**
+     * \brief Finds first matching pattern
+     *
+     * \param [in] appName Executable path
+     * \returns Index of the first matching pattern,
+     *    or -1 if no pattern matches the path.
+     */
+    int32_t find(const std::string& appName) const;
+
+  private:
+
+    std::vector<AppProfilePattern> m_patterns;
+
+  };
+
+}
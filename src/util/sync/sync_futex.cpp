@@ -0,0 +1,80 @@
+#include "sync_futex.h"
+
+#include "../thread.h"
+
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+namespace dxvk::sync {
+
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+#ifdef _WIN32
+  using RtlWaitOnAddressProc = LONG (WINAPI *)(const void*, const void*, SIZE_T, const LARGE_INTEGER*);
+  using RtlWakeAddressProc = void (WINAPI *)(const void*);
+
+  struct FutexProcs {
+    RtlWaitOnAddressProc  waitOnAddress     = nullptr;
+    RtlWakeAddressProc    wakeAddressSingle = nullptr;
+    RtlWakeAddressProc    wakeAddressAll    = nullptr;
+
+    FutexProcs() {
+      HMODULE ntdll = ::GetModuleHandleW(L"ntdll.dll");
+
+      if (ntdll) {
+        waitOnAddress = reinterpret_cast<RtlWaitOnAddressProc>(
+          ::GetProcAddress(ntdll, "RtlWaitOnAddress"));
+        wakeAddressSingle = reinterpret_cast<RtlWakeAddressProc>(
+          ::GetProcAddress(ntdll, "RtlWakeAddressSingle"));
+        wakeAddressAll = reinterpret_cast<RtlWakeAddressProc>(
+          ::GetProcAddress(ntdll, "RtlWakeAddressAll"));
+      }
+    }
+  };
+
+  static const FutexProcs& getFutexProcs() {
+    static FutexProcs s_procs;
+    return s_procs;
+  }
+#endif
+
+
+  void futexWait(const std::atomic<uint32_t>& value, uint32_t expected) {
+#if defined(_WIN32)
+    auto& procs = getFutexProcs();
+
+    if (procs.waitOnAddress)
+      procs.waitOnAddress(&value, &expected, sizeof(expected), nullptr);
+    else
+      dxvk::this_thread::yield();
+#elif defined(__linux__)
+    ::syscall(SYS_futex, &value, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    // Callers will re-check their condition in a loop anyway
+    dxvk::this_thread::yield();
+#endif
+  }
+
+
+  void futexWake(const std::atomic<uint32_t>& value, bool all) {
+#if defined(_WIN32)
+    auto& procs = getFutexProcs();
+
+    if (all && procs.wakeAddressAll)
+      procs.wakeAddressAll(&value);
+    else if (!all && procs.wakeAddressSingle)
+      procs.wakeAddressSingle(&value);
+#elif defined(__linux__)
+    ::syscall(SYS_futex, &value, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, nullptr, nullptr, 0);
+#else
+    (void)value;
+    (void)all;
+#endif
+  }
+
+}
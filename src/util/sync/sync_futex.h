@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dxvk::sync {
+
+  /**
+   * \brief Waits on an address
+   *
+   * Blocks the calling thread as long as the given value
+   * is equal to \c expected, or until it gets woken up.
+   * Spurious wake-ups are possible, so callers must
+   * re-check their wait condition.
+   * \param [in] value Value to wait on
+   * \param [in] expected Value to compare against
+   */
+  void futexWait(const std::atomic<uint32_t>& value, uint32_t expected);
+
+  /**
+   * \brief Wakes up threads waiting on an address
+   *
+   * \param [in] value Value that threads are waiting on
+   * \param [in] all Whether to wake up all threads or just one
+   */
+  void futexWake(const std::atomic<uint32_t>& value, bool all);
+
+
+  /**
+   * \brief Parking spot
+   *
+   * Allows threads to block until a condition becomes \c true
+   * without the thread that changes the condition having to
+   * take a lock. If no thread is parked, notifying is just a
+   * memory barrier and an atomic load.
+   */
+  class ParkingSpot {
+
+  public:
+
+    ParkingSpot() { }
+
+    ParkingSpot             (const ParkingSpot&) = delete;
+    ParkingSpot& operator = (const ParkingSpot&) = delete;
+
+    /**
+     * \brief Waits for a condition to become true
+     *
+     * \param [in] pred Condition to test
+     */
+    template<typename Pred>
+    void wait(const Pred& pred) {
+      while (!pred()) {
+        uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+        // Pairs with the barrier in notify, so that either the
+        // notifying thread sees this thread as parked, or this
+        // thread sees whatever the notifying thread changed.
+        m_waiters.fetch_add(1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!pred())
+          futexWait(m_signal, signal);
+
+        m_waiters.fetch_sub(1u, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * \brief Wakes up parked threads
+     *
+     * Must be called after changing the condition
+     * that any parked thread may be waiting for.
+     * \param [in] all Whether to wake up all threads
+     */
+    void notify(bool all) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (m_waiters.load(std::memory_order_relaxed)) {
+        m_signal.fetch_add(1u, std::memory_order_release);
+        futexWake(m_signal, all);
+      }
+    }
+
+    /**
+     * \brief Wakes up parked threads without a barrier
+     *
+     * Only wakes up threads that are already known to be parked,
+     * and may miss threads that are about to park. Useful for
+     * frequently changing conditions, as long as the caller
+     * eventually calls \c notify, e.g. before waiting itself.
+     * \param [in] all Whether to wake up all threads
+     */
+    void notifyParked(bool all) {
+      if (m_waiters.load(std::memory_order_relaxed)) {
+        m_signal.fetch_add(1u, std::memory_order_release);
+        futexWake(m_signal, all);
+      }
+    }
+
+  private:
+
+    std::atomic<uint32_t> m_signal  = { 0u };
+    std::atomic<uint32_t> m_waiters = { 0u };
+
+  };
+
+}
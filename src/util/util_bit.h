@@ -394,11 +394,15 @@ namespace dxvk::bit {
       return m_dwords[idx];
     }
 
-    constexpr size_t bitCount() {
+    constexpr uint32_t dword(uint32_t idx) const {
+      return m_dwords[idx];
+    }
+
+    constexpr size_t bitCount() const {
       return Bits;
     }
 
-    constexpr size_t dwordCount() {
+    constexpr size_t dwordCount() const {
       return Dwords;
     }
 
@@ -501,6 +505,10 @@ namespace dxvk::bit {
       return m_dwords[idx];
     }
 
+    uint32_t dword(uint32_t idx) const {
+      return m_dwords[idx];
+    }
+
     size_t bitCount() const {
       return m_bitCount;
     }
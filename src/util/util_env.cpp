@@ -150,5 +150,17 @@ namespace dxvk::env {
     return std::filesystem::is_directory(path) || std::filesystem::create_directories(path);
 #endif
   }
+
+
+  bool replaceFile(const std::string& src, const std::string& dst) {
+#ifdef _WIN32
+    return MoveFileExW(str::tows(src.c_str()).c_str(),
+      str::tows(dst.c_str()).c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    std::error_code ec;
+    std::filesystem::rename(src, dst, ec);
+    return !ec;
+#endif
+  }
   
 }
@@ -75,5 +75,16 @@ namespace dxvk::env {
    * \returns \c true on success
    */
   bool createDirectory(const std::string& path);
+
+  /**
+   * \brief Replaces a file with another one
+   *
+   * Moves \c src to \c dst, overwriting \c dst if
+   * it already exists.
+   * \param [in] src Path to source file
+   * \param [in] dst Path to destination file
+   * \returns \c true on success
+   */
+  bool replaceFile(const std::string& src, const std::string& dst);
   
 }
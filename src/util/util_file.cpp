@@ -1,5 +1,12 @@
 #include <fstream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "./com/com_include.h"
 
 #include "./log/log.h"
@@ -54,6 +61,7 @@ namespace dxvk::util {
     }
 
     ~Win32File() {
+      unmap();
       CloseHandle(m_file);
     }
 
@@ -98,10 +106,46 @@ namespace dxvk::util {
       return FlushFileBuffers(m_file);
     }
 
+    FileView map() {
+      unmap();
+
+      size_t fileSize = size();
+
+      if (!fileSize)
+        return FileView();
+
+      m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+      if (!m_mapping)
+        return FileView();
+
+      m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+      if (!m_view) {
+        unmap();
+        return FileView();
+      }
+
+      return FileView(m_view, fileSize);
+    }
+
+    void unmap() {
+      if (m_view)
+        UnmapViewOfFile(m_view);
+
+      if (m_mapping)
+        CloseHandle(m_mapping);
+
+      m_view = nullptr;
+      m_mapping = nullptr;
+    }
+
   private:
 
-    FileFlags m_flags = { };
-    HANDLE    m_file  = INVALID_HANDLE_VALUE;
+    FileFlags m_flags   = { };
+    HANDLE    m_file    = INVALID_HANDLE_VALUE;
+    HANDLE    m_mapping = nullptr;
+    void*     m_view    = nullptr;
 
     bool seek(size_t offset, DWORD method) {
       if (!m_file)
@@ -154,7 +198,8 @@ namespace dxvk::util {
 
   public:
 
-    StlFile(const std::string& path, FileFlags flags) {
+    StlFile(const std::string& path, FileFlags flags)
+    : m_flags(flags), m_path(path) {
       std::ios_base::openmode mode = std::ios_base::binary;
 
       if (flags.test(FileFlag::AllowRead))
@@ -170,7 +215,7 @@ namespace dxvk::util {
     }
 
     ~StlFile() {
-
+      unmap();
     }
 
     bool read(size_t offset, size_t size, void* data) {
@@ -229,11 +274,53 @@ namespace dxvk::util {
       return true;
     }
 
+    FileView map() {
+      unmap();
+
+      // Make sure that any buffered writes are visible
+      if (!flush())
+        return FileView();
+
+      // fstream does not expose the underlying file descriptor,
+      // so open the file again. The mapping stays valid after
+      // closing the descriptor.
+      int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+      if (fd < 0)
+        return FileView();
+
+      struct stat st = { };
+
+      if (!::fstat(fd, &st) && st.st_size > 0) {
+        void* view = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (view != MAP_FAILED) {
+          m_view = view;
+          m_viewSize = st.st_size;
+        }
+      }
+
+      ::close(fd);
+      return FileView(m_view, m_viewSize);
+    }
+
+    void unmap() {
+      if (m_view)
+        ::munmap(m_view, m_viewSize);
+
+      m_view = nullptr;
+      m_viewSize = 0u;
+    }
+
   private:
 
     FileFlags     m_flags = { };
+    std::string   m_path;
     std::fstream  m_file;
 
+    void*         m_view      = nullptr;
+    size_t        m_viewSize  = 0u;
+
   };
 
   using FileImpl = StlFile;
@@ -300,6 +387,18 @@ namespace dxvk::util {
     return m_impl && m_impl->flush();
   }
 
+  FileView File::map() {
+    if (!m_impl)
+      return FileView();
+
+    return m_impl->map();
+  }
+
+  void File::unmap() {
+    if (m_impl)
+      m_impl->unmap();
+  }
+
   File::operator bool () const {
     return m_impl && m_impl->status();
   }
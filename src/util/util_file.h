@@ -3,6 +3,8 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <string>
 
 #include "util_flags.h"
 #include "util_likely.h"
@@ -24,6 +26,63 @@ namespace dxvk::util {
   using FileFlags = Flags<FileFlag>;
 
 
+  /**
+   * \brief Read-only view of file data
+   *
+   * Non-owning view of a memory region, typically a memory-mapped
+   * file. Provides the same read interface as \c File so that
+   * parsing code can be shared, but reads never lock or block.
+   */
+  class FileView {
+
+  public:
+
+    FileView() = default;
+
+    FileView(const void* data, size_t size)
+    : m_data(reinterpret_cast<const char*>(data)), m_size(size) { }
+
+    /**
+     * \brief Queries pointer to a range of data
+     *
+     * \param [in] offset Offset of the range
+     * \param [in] size Size of the range
+     * \returns Pointer to the data, or \c nullptr
+     *    if the range is out of bounds.
+     */
+    const char* ptr(size_t offset, size_t size) const {
+      if (offset > m_size || size > m_size - offset)
+        return nullptr;
+
+      return m_data + offset;
+    }
+
+    bool read(size_t offset, size_t size, void* data) const {
+      auto src = ptr(offset, size);
+
+      if (unlikely(!src))
+        return false;
+
+      std::memcpy(data, src, size);
+      return true;
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+    explicit operator bool () const {
+      return m_data != nullptr;
+    }
+
+  private:
+
+    const char* m_data = nullptr;
+    size_t      m_size = 0u;
+
+  };
+
+
   /**
    * \brief Platform-specific file interface
    */
@@ -45,6 +104,10 @@ namespace dxvk::util {
 
     virtual bool flush() = 0;
 
+    virtual FileView map() = 0;
+
+    virtual void unmap() = 0;
+
     force_inline void incRef() {
       m_refCount.fetch_add(1u, std::memory_order_acquire);
     }
@@ -94,6 +157,24 @@ namespace dxvk::util {
 
     bool flush();
 
+    /**
+     * \brief Maps file into memory
+     *
+     * Creates a read-only mapping of the file as it is at the time
+     * of the call. Data appended to the file later on may not be
+     * visible through the view. Any previous mapping is released.
+     * \returns View of the mapped data, or an empty view on error
+     */
+    FileView map();
+
+    /**
+     * \brief Releases memory mapping
+     *
+     * Invalidates any view previously returned by \c map. This
+     * also happens implicitly when the file is closed or re-opened.
+     */
+    void unmap();
+
     explicit operator bool () const;
 
   private:
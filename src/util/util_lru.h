@@ -1,68 +1,159 @@
+#pragma once
+
 #include <cstdint>
-#include <list>
-#include <unordered_map>
 
 namespace dxvk {
 
   template<typename T>
-  class lru_list {
-
+  class lru_list;
+
+  /**
+   * \brief LRU list node
+   *
+   * Objects tracked by an \c lru_list must derive from this class.
+   * The links are stored in the object itself, so that inserting,
+   * removing or touching an object is O(1) and never allocates
+   * memory. An object can only be part of one list at a time.
+   */
+  template<typename T>
+  class lru_node {
+    friend class lru_list<T>;
   public:
-    typedef typename std::list<T>::const_iterator const_iterator;
 
-    void insert(T value) {
-      auto cacheIter = m_cache.find(value);
-      if (cacheIter != m_cache.end())
-        m_list.erase(cacheIter->second);
+    lru_node() { }
 
-      m_list.push_back(value);
-      auto iter = m_list.cend();
-      iter--;
-      m_cache[value] = iter;
+    // Copies are never part of the list
+    lru_node(const lru_node&) { }
+
+    lru_node& operator = (const lru_node&) {
+      return *this;
     }
 
-    void remove(const T& value) {
-      auto cacheIter = m_cache.find(value);
-      if (cacheIter == m_cache.end())
-        return;
+  private:
 
-      m_list.erase(cacheIter->second);
-      m_cache.erase(cacheIter);
-    }
+    T*    m_prev    = nullptr;
+    T*    m_next    = nullptr;
+    bool  m_linked  = false;
+
+  };
+
+
+  /**
+   * \brief Intrusive LRU list
+   *
+   * Orders objects from least recently used to most recently
+   * used. The list does not take ownership of objects, which
+   * must be removed from the list before being destroyed.
+   */
+  template<typename T>
+  class lru_list {
+
+  public:
 
-    const_iterator remove(const_iterator iter) {
-      auto cacheIter = m_cache.find(*iter);
-      m_cache.erase(cacheIter);
-      return m_list.erase(iter);
+    /**
+     * \brief Inserts object as most recently used
+     *
+     * If the object is already in the list, this
+     * behaves the same way as \c touch.
+     * \param [in] value Object to insert
+     */
+    void insert(T* value) {
+      if (node(value).m_linked)
+        unlink(value);
+
+      link(value);
     }
 
-    void touch(const T& value) {
-      auto cacheIter = m_cache.find(value);
-      if (cacheIter == m_cache.end())
-        return;
+    /**
+     * \brief Removes object from the list
+     *
+     * Does nothing if the object is not in the list.
+     * \param [in] value Object to remove
+     */
+    void remove(T* value) {
+      if (node(value).m_linked)
+        unlink(value);
+    }
 
-      m_list.erase(cacheIter->second);
-      m_list.push_back(value);
-      auto iter = m_list.cend();
-      --iter;
-      m_cache[value] = iter;
+    /**
+     * \brief Marks object as most recently used
+     *
+     * Does nothing if the object is not in the list.
+     * \param [in] value Object to touch
+     */
+    void touch(T* value) {
+      if (node(value).m_linked && value != m_tail) {
+        unlink(value);
+        link(value);
+      }
     }
 
-    const_iterator leastRecentlyUsedIter() const {
-      return m_list.cbegin();
+    /**
+     * \brief Queries least recently used object
+     * \returns Least recently used object, or \c nullptr
+     */
+    T* leastRecentlyUsed() const {
+      return m_head;
     }
 
-    const_iterator leastRecentlyUsedEndIter() const {
-      return m_list.cend();
+    /**
+     * \brief Queries next object in LRU order
+     *
+     * \param [in] value Object in the list
+     * \returns The next more recently used object,
+     *    or \c nullptr if \c value is the last one.
+     */
+    T* next(T* value) const {
+      return node(value).m_next;
     }
 
     uint32_t size() const noexcept {
-      return m_list.size();
+      return m_size;
     }
 
   private:
-    std::list<T> m_list;
-    std::unordered_map<T, const_iterator> m_cache;
+
+    T*        m_head = nullptr;
+    T*        m_tail = nullptr;
+    uint32_t  m_size = 0u;
+
+    static lru_node<T>& node(T* value) {
+      return *value;
+    }
+
+    void link(T* value) {
+      auto& n = node(value);
+      n.m_prev = m_tail;
+      n.m_next = nullptr;
+      n.m_linked = true;
+
+      if (m_tail)
+        node(m_tail).m_next = value;
+      else
+        m_head = value;
+
+      m_tail = value;
+      m_size += 1u;
+    }
+
+    void unlink(T* value) {
+      auto& n = node(value);
+
+      if (n.m_prev)
+        node(n.m_prev).m_next = n.m_next;
+      else
+        m_head = n.m_next;
+
+      if (n.m_next)
+        node(n.m_next).m_prev = n.m_prev;
+      else
+        m_tail = n.m_prev;
+
+      n.m_prev = nullptr;
+      n.m_next = nullptr;
+      n.m_linked = false;
+      m_size -= 1u;
+    }
 
   };
 
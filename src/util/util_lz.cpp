@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "util_lz.h"
+
+namespace dxvk::lz {
+
+  /** Minimum match length that can be encoded */
+  constexpr size_t MinMatch = 4u;
+
+  /** Matches must not extend into the last few bytes, and the last match
+   *  must start at a safe distance from the end of the input. These match
+   *  the LZ4 block format restrictions. */
+  constexpr size_t LastLiterals = 5u;
+  constexpr size_t MatchSafeDistance = 12u;
+
+  /** Maximum distance of a match to the current position */
+  constexpr size_t MaxOffset = 65535u;
+
+  /** Number of bits used for the hash table index */
+  constexpr uint32_t HashBits = 12u;
+
+
+  static uint32_t load32(const uint8_t* p) {
+    uint32_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return result;
+  }
+
+
+  static uint32_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32u - HashBits);
+  }
+
+
+  static uint8_t* writeLength(uint8_t* dst, size_t length) {
+    while (length >= 255u) {
+      *(dst++) = 255u;
+      length -= 255u;
+    }
+
+    *(dst++) = uint8_t(length);
+    return dst;
+  }
+
+
+  static bool readLength(const uint8_t* src, size_t srcSize, size_t& offset, size_t& length) {
+    uint8_t value;
+
+    do {
+      if (offset >= srcSize)
+        return false;
+
+      value = src[offset++];
+      length += value;
+    } while (value == 255u);
+
+    return true;
+  }
+
+
+  static uint8_t* writeSequence(
+          uint8_t*                    dst,
+    const uint8_t*                    literals,
+          size_t                      literalCount,
+          size_t                      matchOffset,
+          size_t                      matchLength) {
+    uint8_t* token = dst++;
+
+    *token = uint8_t(std::min<size_t>(literalCount, 15u) << 4u);
+
+    if (literalCount >= 15u)
+      dst = writeLength(dst, literalCount - 15u);
+
+    // Literals may be null if the input is empty
+    if (literalCount) {
+      std::memcpy(dst, literals, literalCount);
+      dst += literalCount;
+    }
+
+    // The final sequence only consists of literals
+    if (matchOffset) {
+      *(dst++) = uint8_t(matchOffset);
+      *(dst++) = uint8_t(matchOffset >> 8u);
+
+      matchLength -= MinMatch;
+      *token |= uint8_t(std::min<size_t>(matchLength, 15u));
+
+      if (matchLength >= 15u)
+        dst = writeLength(dst, matchLength - 15u);
+    }
+
+    return dst;
+  }
+
+
+  size_t compress(
+    const uint8_t*                    src,
+          size_t                      srcSize,
+          uint8_t*                    dst) {
+    uint8_t* out = dst;
+
+    size_t anchor = 0u;
+    size_t pos = 0u;
+
+    if (srcSize > MatchSafeDistance) {
+      std::array<uint32_t, 1u << HashBits> table = { };
+
+      size_t matchLimit = srcSize - LastLiterals;
+      size_t searchLimit = srcSize - MatchSafeDistance;
+
+      while (pos < searchLimit) {
+        uint32_t sequence = load32(&src[pos]);
+        uint32_t& entry = table[hash32(sequence)];
+
+        size_t candidate = entry;
+        entry = uint32_t(pos);
+
+        if (candidate < pos && pos - candidate <= MaxOffset && load32(&src[candidate]) == sequence) {
+          size_t length = MinMatch;
+
+          while (pos + length < matchLimit && src[candidate + length] == src[pos + length])
+            length += 1u;
+
+          out = writeSequence(out, &src[anchor], pos - anchor, pos - candidate, length);
+
+          pos += length;
+          anchor = pos;
+        } else {
+          // Skip ahead faster in regions that don't compress well
+          pos += 1u + ((pos - anchor) >> 6u);
+        }
+      }
+    }
+
+    out = writeSequence(out, &src[anchor], srcSize - anchor, 0u, 0u);
+    return size_t(out - dst);
+  }
+
+
+  std::vector<uint8_t> compress(
+    const uint8_t*                    src,
+          size_t                      srcSize) {
+    std::vector<uint8_t> result(compressBound(srcSize));
+    result.resize(compress(src, srcSize, result.data()));
+    result.shrink_to_fit();
+    return result;
+  }
+
+
+  bool decompress(
+    const uint8_t*                    src,
+          size_t                      srcSize,
+          uint8_t*                    dst,
+          size_t                      dstSize) {
+    size_t in = 0u;
+    size_t out = 0u;
+
+    while (in < srcSize) {
+      uint8_t token = src[in++];
+
+      // Copy literals
+      size_t literalCount = token >> 4u;
+
+      if (literalCount == 15u && !readLength(src, srcSize, in, literalCount))
+        return false;
+
+      if (literalCount > srcSize - in || literalCount > dstSize - out)
+        return false;
+
+      if (literalCount) {
+        std::memcpy(&dst[out], &src[in], literalCount);
+
+        in += literalCount;
+        out += literalCount;
+      }
+
+      // The last sequence does not have a match
+      if (in == srcSize)
+        break;
+
+      if (srcSize - in < 2u)
+        return false;
+
+      size_t matchOffset = size_t(src[in]) | (size_t(src[in + 1u]) << 8u);
+      in += 2u;
+
+      if (!matchOffset || matchOffset > out)
+        return false;
+
+      size_t matchLength = token & 0xfu;
+
+      if (matchLength == 15u && !readLength(src, srcSize, in, matchLength))
+        return false;
+
+      matchLength += MinMatch;
+
+      if (matchLength > dstSize - out)
+        return false;
+
+      // Matches may overlap the output, in which case
+      // we need to copy the data one byte at a time
+      const uint8_t* match = &dst[out - matchOffset];
+
+      if (matchOffset >= matchLength) {
+        std::memcpy(&dst[out], match, matchLength);
+      } else {
+        for (size_t i = 0u; i < matchLength; i++)
+          dst[out + i] = match[i];
+      }
+
+      out += matchLength;
+    }
+
+    return out == dstSize;
+  }
+
+}
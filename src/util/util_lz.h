@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dxvk::lz {
+
+  /**
+   * \brief Computes worst-case compressed size
+   *
+   * Incompressible data grows slightly due to
+   * literal length encoding overhead.
+   * \param [in] size Uncompressed size, in bytes
+   * \returns Maximum compressed size, in bytes
+   */
+  inline size_t compressBound(size_t size) {
+    return size + size / 255u + 16u;
+  }
+
+  /**
+   * \brief Compresses a block of data
+   *
+   * Uses a greedy LZ77 scheme with a single-entry hash table
+   * that produces LZ4-compatible block data. This is designed
+   * to be fast rather than to achieve a high compression ratio.
+   * \param [in] src Source data
+   * \param [in] srcSize Source size, in bytes
+   * \param [out] dst Destination buffer. Must be at least
+   *    \c compressBound(srcSize) bytes in size.
+   * \returns Compressed size, in bytes
+   */
+  size_t compress(
+    const uint8_t*                    src,
+          size_t                      srcSize,
+          uint8_t*                    dst);
+
+  /**
+   * \brief Compresses a block of data into a vector
+   *
+   * \param [in] src Source data
+   * \param [in] srcSize Source size, in bytes
+   * \returns Compressed data
+   */
+  std::vector<uint8_t> compress(
+    const uint8_t*                    src,
+          size_t                      srcSize);
+
+  /**
+   * \brief Decompresses a block of data
+   *
+   * Validates all offsets and lengths against the buffer
+   * sizes, so this is safe to use on untrusted input.
+   * \param [in] src Compressed data
+   * \param [in] srcSize Compressed size, in bytes
+   * \param [out] dst Destination buffer
+   * \param [in] dstSize Exact uncompressed size, in bytes
+   * \returns \c true if the data was decompressed successfully
+   *    and the decompressed size matches \c dstSize.
+   */
+  bool decompress(
+    const uint8_t*                    src,
+          size_t                      srcSize,
+          uint8_t*                    dst,
+          size_t                      dstSize);
+
+}